@@ -0,0 +1,141 @@
+#include "c_move.h"
+#include "config_motion.h"
+#include "els_core.h"
+#include <Arduino.h>
+
+#if SPINDLE_MODE == SPINDLE_MODE_STEPPER
+#include "spindle_stepper.h"
+#endif
+
+// ============================================================================
+// Static member initialization
+// ============================================================================
+volatile bool CMove::active = false;
+bool CMove::abort_req = false;
+volatile CMove::Result CMove::result = ZMove::MR_IDLE;
+bool CMove::started = false;
+uint8_t CMove::last_seq = 0;
+volatile uint8_t CMove::seq_done = 0;
+uint8_t CMove::seq_pending = 0;
+int32_t CMove::target = 0;
+int32_t CMove::rpm = 0;
+int64_t CMove::goal = 0;
+volatile bool CMove::start_req = false;
+volatile bool CMove::stop_req = false;
+uint8_t CMove::req_seq = 0;
+int32_t CMove::req_target = 0;
+int32_t CMove::req_rpm = 0;
+static portMUX_TYPE request_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// ============================================================================
+// Requests: latched on the SPI loop's core, applied in update(), as ZMove
+// does. A latched start already counts as active, so the SPI loop never
+// hands the ELS enable back to the UI under a move starting up.
+// ============================================================================
+void CMove::request(bool run, uint8_t seq, int32_t to, int32_t speed_rpm) {
+	if (run && seq != last_seq && !isActive()) {
+		portENTER_CRITICAL(&request_mux);
+		req_seq = seq;
+		req_target = to;
+		req_rpm = speed_rpm;
+		stop_req = false;
+		start_req = true;
+		portEXIT_CRITICAL(&request_mux);
+	} else if (!run && isActive()) {
+		portENTER_CRITICAL(&request_mux);
+		stop_req = true;
+		portEXIT_CRITICAL(&request_mux);
+	}
+	// Dropping the request re-arms it, so a restarted UI's seq still counts
+	last_seq = run ? seq : 0;
+}
+
+bool CMove::isActive() {
+	portENTER_CRITICAL_SAFE(&request_mux);
+	const bool a = active || start_req;
+	portEXIT_CRITICAL_SAFE(&request_mux);
+	return a;
+}
+
+void CMove::applyRequest() {
+	if (!start_req && !stop_req) return;
+	portENTER_CRITICAL(&request_mux);
+	const bool start = start_req;
+	const bool stop = stop_req;
+	if (start) {
+		seq_pending = req_seq;
+		target = req_target;
+		rpm = req_rpm;
+		abort_req = false;
+		started = false;
+		result = ZMove::MR_MOVING;
+		active = true;
+	}
+	start_req = false;
+	stop_req = false;
+	portEXIT_CRITICAL(&request_mux);
+	if (stop && active) abort_req = true;
+}
+
+void CMove::jog(int32_t steps) {
+#if SPINDLE_MODE == SPINDLE_MODE_STEPPER
+	if (isActive() || steps == 0) return;
+	const int64_t pos = SpindleStepper::getPosition();
+	int64_t to = (SpindleStepper::isMoving() ? SpindleStepper::getMoveTarget() : pos) + steps;
+	// A flick of the wheel leads the spindle by a rev at most
+	if (to > pos + SPINDLE_STEPS_PER_REV) to = pos + SPINDLE_STEPS_PER_REV;
+	if (to < pos - SPINDLE_STEPS_PER_REV) to = pos - SPINDLE_STEPS_PER_REV;
+	SpindleStepper::moveTo(to, SPINDLE_C_JOG_RPM);
+#else
+	(void)steps;
+#endif
+}
+
+void CMove::finish(Result r) {
+	seq_done = seq_pending;
+	result = r;
+	active = false;
+}
+
+// ============================================================================
+// Update - motion task
+// ============================================================================
+void CMove::update() {
+	applyRequest();
+	if (!active) return;
+#if SPINDLE_MODE == SPINDLE_MODE_STEPPER
+	if (!started) {
+		if (abort_req) {
+			finish(ZMove::MR_STOPPED);
+			return;
+		}
+		if (ElsCore::isEnabled()) {
+			finish(ZMove::MR_REFUSED);
+			return;
+		}
+		// The short way round, from where a jog in progress is going
+		const int64_t from = SpindleStepper::isMoving() ? SpindleStepper::getMoveTarget()
+														: SpindleStepper::getPosition();
+		const int32_t rev = SPINDLE_STEPS_PER_REV;
+		const int32_t at = (int32_t)(((from % rev) + rev) % rev);
+		int32_t d = (int32_t)(((int64_t)target * rev / C_COUNTS_PER_REV - at) % rev);
+		if (d >= rev / 2) d -= rev;
+		if (d < -rev / 2) d += rev;
+		goal = from + d;
+		// Refused while the direction switch runs (or ramps down) the spindle
+		if (!SpindleStepper::moveTo(goal, rpm)) {
+			finish(ZMove::MR_REFUSED);
+			return;
+		}
+		started = true;
+		return;
+	}
+
+	if (abort_req) SpindleStepper::cancelMove();
+	if (SpindleStepper::isMoving() || (abort_req && SpindleStepper::isRunning())) return;
+	// Ended on the goal, unless stopped (or the switch took the spindle back)
+	finish(SpindleStepper::getPosition() == goal ? ZMove::MR_DONE : ZMove::MR_STOPPED);
+#else
+	finish(ZMove::MR_REFUSED);
+#endif
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include "z_move.h"
+
+// ============================================================================
+// C move-to: positions the stepper spindle as a C axis (dividing head) with
+// the direction switch off. The spindle's own pulse stream makes the move,
+// ramped at the spindle limits and stopping on the target step, so C is
+// always the pulses that went out. Targets are an angle within the rev (C
+// counts), reached the short way round from where C is (or is going).
+// The MPG's C jog goes the same way, a step target at a time.
+// Stepper spindle only: with the encoder spindle every move is refused.
+// ============================================================================
+
+class CMove {
+public:
+    using Result = ZMove::Result;
+
+    // SPI loop (core 0): the UI's move. Run set with a new seq (non-zero)
+    // starts a move to target (C counts, 0 .. one rev) at up to rpm; run
+    // going false while it runs ramps the spindle down. Latched, and taken
+    // by update().
+    static void request(bool run, uint8_t seq, int32_t target, int32_t rpm);
+
+    // Motion task: MPG C jog, steps on from where C is going. Ignored while
+    // a UI move runs.
+    static void jog(int32_t steps);
+
+    // Motion task
+    static void update();
+
+    // While active the move owns the spindle (and keeps the ELS off); a
+    // move the SPI loop has asked for and update() not yet taken counts
+    static bool isActive();
+    static Result getResult() { return result; }
+    static uint8_t getSeq() { return seq_done; }  // Seq of the move result is for
+
+private:
+    static volatile bool active;
+    static bool abort_req;
+    static volatile Result result;
+    static bool started;
+    static uint8_t last_seq;
+    static volatile uint8_t seq_done;
+    static uint8_t seq_pending;
+    static int32_t target;
+    static int32_t rpm;
+    static int64_t goal;           // Spindle position the move ends on
+
+    // The SPI loop's request, under request_mux until applyRequest()
+    static volatile bool start_req;
+    static volatile bool stop_req;
+    static uint8_t req_seq;
+    static int32_t req_target;
+    static int32_t req_rpm;
+
+    static void applyRequest();
+    static void finish(Result r);
+};
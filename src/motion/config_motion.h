@@ -26,6 +26,25 @@
 // Avoid strap pins for encoder inputs.
 static constexpr int C_PINA = 16;  // encoder A
 static constexpr int C_PINB = 17;  // encoder B
+// Index (Z channel), one pulse per revolution; -1 = not fitted. The count
+// is latched at both pulse edges, so the middle of the pulse is the same
+// spindle angle in either direction.
+static constexpr int C_PIN_INDEX = -1;
+static constexpr int32_t SPINDLE_INDEX_MAX_WIDTH = 16;  // Counts; wider = noise, ignored
+// Re-home the count on the index: the first index lands on
+// SPINDLE_INDEX_PHASE (C phase, and the sync C0 with it, then mean the same
+// spindle angle after every boot), later ones put back counts the encoder
+// lost or gained. A correction is only made once two index pulses in a row
+// agree on it; above SPINDLE_INDEX_MAX_CORRECT counts only while the ELS
+// isn't following the spindle.
+static constexpr bool SPINDLE_INDEX_REHOME = true;
+static constexpr int32_t SPINDLE_INDEX_PHASE = 0;
+static constexpr int32_t SPINDLE_INDEX_MAX_CORRECT = 8;
+// Calibration mode: every SPINDLE_INDEX_CAL_MS print the counts per
+// revolution measured between index pulses since boot (what
+// C_COUNTS_PER_REV should be) and the per-revolution error
+static constexpr bool     SPINDLE_INDEX_CAL = false;
+static constexpr uint32_t SPINDLE_INDEX_CAL_MS = 5000;
 
 // ============================================================================
 // Spindle Stepper Mode Configuration (SPINDLE_MODE_STEPPER)
@@ -43,8 +62,17 @@ static constexpr int32_t SPINDLE_MIN_RPM = 1; // Minimum commanded RPM
 static constexpr bool SPINDLE_INVERT_DIR = false;
 static constexpr uint32_t SPINDLE_PULSE_US = 2;          // Step pulse width
 static constexpr uint32_t SPINDLE_RMT_RES_HZ = 500000;   // 2us tick to allow long low times
+static constexpr uint32_t SPINDLE_RMT_MEM_SYMBOLS = 64;  // Streamed, refilled from the TX ISR
 static constexpr uint32_t SPINDLE_MIN_STEP_PERIOD_US = 12;   // ~83k steps/s cap
-static constexpr uint32_t SPINDLE_MAX_STEP_PERIOD_US = 50000; // 20 Hz min
+static constexpr uint32_t SPINDLE_MAX_STEP_PERIOD_US = 50000; // 20 Hz min, start/stop speed
+// Count the STEP pulses actually emitted on a PCNT unit (STEP edges signed
+// by the DIR level, read back through the GPIO matrix); without it the
+// position is the pulses encoded, up to one RMT buffer ahead of the pin
+static constexpr bool SPINDLE_STEP_PCNT = true;
+// Measurement mode: every SPINDLE_STEP_VERIFY_MS print the pulses counted
+// and the pulses encoded, each as a running total since the first report
+static constexpr bool     SPINDLE_STEP_VERIFY = false;
+static constexpr uint32_t SPINDLE_STEP_VERIFY_MS = 10000;
 
 // MPG (Manual Pulse Generator) encoder for speed control
 // Quadrature encoder replaces potentiometer for precise RPM adjustment.
@@ -53,19 +81,48 @@ static constexpr int MPG_PINA = 34;					  // MPG encoder A (input only pin)
 static constexpr int MPG_PINB = 35;					  // MPG encoder B (input only pin, VN)
 static constexpr int32_t MPG_COUNTS_TO_MAX_RPM = 200 * 4 * 3; // 0-3000 RPM range (200 PPR * 4 quadrature)
 static constexpr bool MPG_INVERT_DIR = false;
+// Decode the MPG on a PCNT unit (true; GPIO34/35 reach it through the GPIO
+// matrix) or with GPIO CHANGE interrupts (false, kept for comparison)
+static constexpr bool MPG_PCNT = true;
+static constexpr uint32_t MPG_GLITCH_NS = 1000;  // PCNT input filter
+// Jog scaling (JOG_Z, JOG_C) from wheel speed, counts/s smoothed over
+// MPG_SPEED_TAU_MS: x1 turned slowly, x10 above MPG_X10_CPS, x100 above
+// MPG_X100_CPS. Scaling back down waits for MPG_SCALE_HYST_PCT below.
+static constexpr int32_t  MPG_X10_CPS = 600;    // ~0.75 rev/s of a 200 PPR wheel
+static constexpr int32_t  MPG_X100_CPS = 2400;  // ~3 rev/s
+static constexpr int32_t  MPG_SCALE_HYST_PCT = 25;
+static constexpr uint32_t MPG_SPEED_TAU_MS = 50;
+// JOG_Z: Z follows the wheel through the jog profile (ELS_JOG_ACCEL,
+// ELS_JOG_JERK, up to ELS_STEPPER_MAX_SPS). Steps it is behind by more than
+// this are dropped, so Z stops soon after the wheel does.
+static constexpr int32_t MPG_JOG_MAX_LAG_STEPS = 4000;
 
 // Direction switch inputs (active LOW, external pullups recommended)
 // Both off = stopped, FWD on = forward, REV on = reverse
 static constexpr int SPINDLE_FWD_PIN = 36; // Forward switch (input only pin)
 static constexpr int SPINDLE_REV_PIN = 39; // Reverse switch (input only pin, VN)
 
-// Acceleration limit (RPM per second) - prevents jerky speed changes
+// Acceleration limit (RPM per second) - prevents jerky speed changes.
+// Applied per step by the pulse synthesizer, so it holds at any speed.
 static constexpr int32_t SPINDLE_ACCEL_RPM_PER_SEC = 500;
+// Jerk limit (RPM per second^2): > 0 ramps the acceleration in and out
+// (S-curve), 0 = trapezoidal ramp
+static constexpr int32_t SPINDLE_JERK_RPM_PER_SEC2 = 0;
+// Thread end: the ELS running Z towards a soft endstop ramps the spindle
+// down (at the limits above) so the gear brings Z to rest on the limit and
+// the thread keeps its phase. The spindle then holds until the direction
+// switch changes. false = Z brakes alone and the spindle runs on.
+static constexpr bool SPINDLE_THREAD_END_STOP = true;
+// C axis (direction switch off): positioning moves land on their target
+// step at the limits above. MPG C jog: steps per scaled MPG count, and the
+// speed it runs at.
+static constexpr int32_t SPINDLE_C_JOG_STEPS_PER_COUNT = 2;
+static constexpr int32_t SPINDLE_C_JOG_RPM = 60;
 
 // ============================================================================
 // Linear Encoders (always used)
 // ============================================================================
-// Linear encoder pins (quadrature, GPIO ISR)
+// Linear encoder pins (quadrature)
 static constexpr int X_PINA = 25;
 static constexpr int X_PINB = 26;
 static constexpr int Z_PINA = 27;
@@ -75,6 +132,23 @@ static constexpr int Z_PINB = 14;
 static constexpr bool X_INVERT_DIR = false;
 static constexpr bool Z_INVERT_DIR = false;
 
+// Decode X/Z on PCNT units (true) or with GPIO CHANGE interrupts (false,
+// one ISR per edge on the motion core; kept for comparison)
+static constexpr bool LINEAR_SCALE_PCNT = true;
+static constexpr uint32_t LINEAR_SCALE_GLITCH_NS = 1000;  // PCNT input filter
+// Measurement mode: every ENC_ISR_MEASURE_MS print X/Z decode (and spindle
+// speed event) interrupt rate and CPU time (handler body only, not interrupt
+// entry/exit)
+static constexpr bool     ENC_ISR_MEASURE = false;
+static constexpr uint32_t ENC_ISR_MEASURE_MS = 2000;
+// With ENC_ISR_MEASURE, drive a quadrature test signal of this many cycles/s
+// (4x the edges) onto the X scale pins from two LEDC channels, so both
+// LINEAR_SCALE_PCNT settings are measured at a known edge rate. The X scale
+// must be unplugged. 0 measures whatever the scales do.
+static constexpr uint32_t ENC_ISR_MEASURE_TEST_HZ = 10000;
+// Window for the encoder edge rate / peak rate integrity counters
+static constexpr uint32_t ENC_RATE_WINDOW_MS = 10;
+
 // Electronic leadscrew (step/dir stepper driver)
 static constexpr int ELS_STEP_PIN = 32;
 static constexpr int ELS_DIR_PIN  = 33;
@@ -88,15 +162,171 @@ static constexpr bool ELS_INVERT_DIR = false;
 
 // Step pulse width (us)
 static constexpr int32_t ELS_PULSE_US = 2;
-// Cap steps per update cycle to avoid extreme bursts if we fall behind
+// Cap jog steps per update cycle to avoid extreme bursts if we fall behind
 static constexpr int32_t ELS_MAX_STEPS_PER_CYCLE = 800;
-// Constant jog feed (Z axis), used for long-press jog buttons
-static constexpr int32_t ELS_JOG_MM_PER_MIN = 100;
+// Jog feed (Z axis), used for long-press jog buttons
+static constexpr int32_t ELS_JOG_MM_PER_MIN = 600;
+// Jog profile (long-press jog and MPG JOG_Z): Z speeds up and slows down at
+// no more than ELS_JOG_ACCEL, the acceleration itself ramped in and out at
+// ELS_JOG_JERK (S-curve; 0 = trapezoidal)
+static constexpr int32_t ELS_JOG_ACCEL = 40000;    // steps/s^2
+static constexpr int32_t ELS_JOG_JERK = 2000000;   // steps/s^3, 20 ms to full accel
+// Threading cycle (ThreadCycle): Z returns from the end of each pass to its
+// start at this rate, on the jog profile's accel/jerk (capped at
+// ELS_STEPPER_MAX_SPS)
+static constexpr int32_t ELS_THREAD_RAPID_MM_PER_MIN = 1500;
+// Z move-to (ZMove, MOVE_Z_TO): the profile runs on steps, then the Z scale
+// checks where it ended up. Off by more than ELS_MOVE_TOLERANCE_UM, Z creeps
+// the difference, up to ELS_MOVE_MAX_CORRECTIONS times. Each check waits for
+// Z to have been at rest ELS_MOVE_SETTLE_MS.
+static constexpr int32_t ELS_MOVE_TOLERANCE_UM = Z_UM_PER_COUNT;
+static constexpr int32_t ELS_MOVE_MAX_CORRECTIONS = 3;
+static constexpr uint32_t ELS_MOVE_SETTLE_MS = 20;
+static constexpr int32_t ELS_MOVE_CREEP_MM_PER_MIN = 60;
+
+// ============================================================================
+// ELS DRIVE MODE
+// ============================================================================
+// How the spindle->Z gear is serviced:
+//   ELS_DRIVE_POLL  - once per 1 kHz motion task tick
+//   ELS_DRIVE_EDGE  - spindle encoder edges wake the motion task as soon as a
+//                     Z step is due (encoder spindle mode only)
+//   ELS_DRIVE_TIMER - gptimer ISR on core 1 at ELS_TIMER_RATE_HZ, queueing at
+//                     most ELS_TIMER_MAX_STEPS_PER_TICK steps per tick
+//   ELS_DRIVE_COUPLED - once locked, the spindle pulse synthesizer runs the
+//                     gear itself, one spindle step at a time, and the Z RMT
+//                     stream replays the same step periods: Z pulses sit on
+//                     the spindle's own timeline (stepper spindle mode only)
+
+#define ELS_DRIVE_POLL    0
+#define ELS_DRIVE_EDGE    1
+#define ELS_DRIVE_TIMER   2
+#define ELS_DRIVE_COUPLED 3
+
+#define ELS_DRIVE_MODE ELS_DRIVE_POLL
+
+#if ELS_DRIVE_MODE == ELS_DRIVE_EDGE && SPINDLE_MODE != SPINDLE_MODE_ENCODER
+#error "ELS_DRIVE_EDGE needs SPINDLE_MODE_ENCODER (stepper spindle position is only sampled at 1 kHz)"
+#endif
+#if ELS_DRIVE_MODE == ELS_DRIVE_COUPLED && SPINDLE_MODE != SPINDLE_MODE_STEPPER
+#error "ELS_DRIVE_COUPLED needs SPINDLE_MODE_STEPPER (Z follows the generated spindle pulses)"
+#endif
+
+// ELS_DRIVE_COUPLED settings
+// Spindle step slots kept between the synthesizer and both RMT streams
+static constexpr uint32_t ELS_COUPLED_SLOTS = 256;              // Power of two
+// Z steps one spindle step may carry; more (the catch-up when coupling
+// starts, ratios above 1) roll over to the following steps
+static constexpr int32_t  ELS_COUPLED_MAX_STEPS_PER_SLOT = 4;
+
+// ELS_DRIVE_TIMER settings
+static constexpr uint32_t ELS_TIMER_RATE_HZ = 20000;          // 10-50 kHz
+static constexpr uint32_t ELS_TIMER_RES_HZ = 10000000;        // 10 MHz gptimer tick
+static constexpr int32_t  ELS_TIMER_MAX_STEPS_PER_TICK = 2;   // Steps queued per ISR, rest carries over
+// Measurement mode: every ELS_TIMER_MEASURE_MS print achieved rate, period
+// jitter and ISR load, then move to the next rate in ELS_TIMER_SWEEP_HZ
+static constexpr bool     ELS_TIMER_MEASURE = false;
+static constexpr uint32_t ELS_TIMER_MEASURE_MS = 2000;
+static constexpr uint32_t ELS_TIMER_SWEEP_HZ[] = {10000, 20000, 30000, 40000, 50000};
+
+// Spindle tracking filter (SpindleTracker): alpha-beta gains in Q16, fed
+// once per motion tick. Residuals beyond RESET_COUNTS (MPG C jog, count wrap)
+// restart it from the raw counts.
+static constexpr int64_t SPINDLE_TRACK_ALPHA_Q16 = 16384;    // 0.25
+static constexpr int64_t SPINDLE_TRACK_BETA_Q16 = 2340;      // ~alpha^2 / (2 - alpha)
+static constexpr int32_t SPINDLE_TRACK_RESET_COUNTS = 64;
+static constexpr int32_t SPINDLE_TRACK_MAX_EXTRAP_US = 5000; // Never predict further ahead
+
+// Spindle speed from edge timestamps (SpindleRate, encoder mode): counts
+// between two timestamped spindle events over their exact time apart. A
+// second PCNT unit on the spindle pins has EVENT_COUNTS for its limits and
+// each time it reaches one the count is stamped: at 3000 RPM that is 5000
+// interrupts/s, where stamping every A-rising edge took 20000. The window grows back from the newest
+// event until it is at least MIN_US long and spans MIN_COUNTS, so it is
+// ~MIN_US at speed and longer (more precise) at low RPM. No event pair
+// inside MAX_US (under ~1.2 RPM) reads as stopped.
+static constexpr int16_t  SPINDLE_RATE_EVENT_COUNTS = 16;
+static constexpr uint32_t SPINDLE_RATE_MIN_US = 4000;
+static constexpr int32_t  SPINDLE_RATE_MIN_COUNTS = 32;
+static constexpr uint32_t SPINDLE_RATE_MAX_US = 500000;
+// Acceleration: speed difference between estimates at least this far apart
+static constexpr uint32_t SPINDLE_RATE_ACCEL_US = 50000;
+
+// The ELS gear runs on tracker-interpolated spindle sub-counts (1/2^BITS of
+// a count), so Z steps land between encoder counts instead of on them
+static constexpr int32_t ELS_SUBCOUNT_BITS = 8;
+// Latency feed-forward: Z is driven from the spindle position this far ahead
+// of now. A polled batch is the spindle's travel over the last cycle and goes
+// out over the next ELS_STEP_SPREAD_PCT of one, so its steps trail the
+// spindle by about a whole cycle less half the unused spread (not half a
+// span: the batch starts out once its travel is already done).
+static constexpr uint32_t ELS_LEAD_US = (ELS_DRIVE_MODE == ELS_DRIVE_TIMER) ? 50 :
+                                        (ELS_DRIVE_MODE == ELS_DRIVE_EDGE) ? 500 : 950;
+
+// ELS engage/disengage envelope: starting from standstill (enable, end of
+// jog, sync lock) Z ramps up at ELS_ENGAGE_ACCEL while the gear's deficit
+// is tracked, then locks with no net error. Disable ramps Z down the same way.
+// Endstop faults still stop at once.
+static constexpr bool    ELS_ENGAGE_RAMP = true;
+static constexpr int32_t ELS_ENGAGE_ACCEL = 40000;        // steps/s^2
+static constexpr int32_t ELS_STEPPER_MAX_SPS = 50000;     // Z driver/motor limit, steps/s
+
+// Fast sync engagement: instead of waiting (up to a revolution) for the
+// spindle to reach the sync phase, lock the gear at once and close the phase
+// error with a trapezoidal Z catch-up move on top of it. Errors needing more
+// than ELS_SYNC_CATCHUP_MAX_UM of Z still wait for the phase crossing.
+static constexpr bool    ELS_SYNC_FAST_ENGAGE = true;
+static constexpr int32_t ELS_SYNC_CATCHUP_MAX_UM = 1500;
+static constexpr int32_t ELS_SYNC_CATCHUP_ACCEL = 20000;   // steps/s^2
+static constexpr int32_t ELS_SYNC_CATCHUP_MAX_SPS = 4000;  // steps/s, on top of the gear
+
+// Keep the thread phase across jogs, MPG moves, disable/enable and direction
+// reversals: Z displacement is tracked in steps against the last locked
+// helix, so sync re-engages at once (plus a catch-up move for any fraction
+// of a pitch) instead of waiting for the spindle to come round again.
+static constexpr bool ELS_SYNC_KEEP_PHASE = true;
+
+// Boot-time gear benchmark: prints cycles/update and cumulative step error
+// of the legacy fixed-point path vs the exact rational gear (ElsCore::init)
+static constexpr bool    ELS_GEAR_BENCHMARK = false;
+static constexpr int32_t ELS_GEAR_BENCH_REVS = 100000; // simulated spindle revolutions
 
 // Use ESP-IDF RMT for precise step pulse timing (recommended)
 static constexpr bool     ELS_USE_RMT = true;
 static constexpr uint32_t ELS_RMT_RES_HZ = 1000000;  // 1 MHz tick -> 1us resolution
-static constexpr int32_t  ELS_RMT_CHUNK_STEPS = 200; // keep small to reduce phase lag
+static constexpr uint32_t ELS_RMT_MEM_SYMBOLS = 64;  // Channel memory, refilled from the TX ISR
+// Step queue between ElsCore and the RMT stream. Steps that don't fit stay
+// with the caller and are retried; the StatusPacket reports the overload.
+static constexpr uint32_t ELS_STEP_QUEUE_LEN = 128;        // Segments, power of two
+static constexpr int32_t  ELS_STEP_QUEUE_MAX_STEPS = 2000; // ~8 ms of pulses at ELS_PULSE_US
+static constexpr uint32_t STEP_OVERLOAD_HOLD_MS = 250;     // StatusPacket flag hold time
+// Step spacing: each batch of steps is spread over the time it was produced
+// in (its span), scaled by ELS_STEP_SPREAD_PCT so it finishes just before the
+// next batch. Spans are capped so an isolated step can't hold off the next.
+static constexpr uint32_t ELS_STEP_SPREAD_PCT = 90;
+static constexpr uint32_t ELS_STEP_SPAN_MAX_US = 2000;
+// Step timing trace: print the next ELS_STEP_TRACE_LEN step periods (RMT
+// ticks) to serial whenever a capture fills up (Stepper::traceUpdate)
+static constexpr bool     ELS_STEP_TRACE = false;
+static constexpr uint32_t ELS_STEP_TRACE_LEN = 128;
+
+// Worst-case execution time of each ElsCore state handler, measured with
+// CCOUNT every cycle. Any state over budget sets the wcet_over status flag
+// and is logged (ElsCore::reportUpdate); the budget is part of the 1 ms
+// motion cycle, leaving room for the encoder and spindle updates.
+static constexpr bool     ELS_WCET_MEASURE = true;
+static constexpr uint32_t ELS_WCET_BUDGET_US = 150;
+static constexpr uint32_t ELS_WCET_REPORT_MS = 5000;
+
+#if ELS_DRIVE_MODE == ELS_DRIVE_TIMER
+static_assert(ELS_USE_RMT, "ELS_DRIVE_TIMER queues steps from the ISR and needs ELS_USE_RMT");
+#endif
+#if ELS_DRIVE_MODE == ELS_DRIVE_COUPLED
+static_assert(ELS_USE_RMT, "ELS_DRIVE_COUPLED streams Z from the spindle timeline and needs ELS_USE_RMT");
+static_assert(SPINDLE_STEP_PCNT, "ELS_DRIVE_COUPLED finds the spindle pulse on the wire with SPINDLE_STEP_PCNT");
+static_assert(C_COUNTS_PER_REV == SPINDLE_STEPS_PER_REV, "ELS_DRIVE_COUPLED: one spindle step must be one C count");
+static_assert(ELS_RMT_RES_HZ % SPINDLE_RMT_RES_HZ == 0, "ELS_DRIVE_COUPLED: Z RMT ticks must divide spindle ticks");
+#endif
 
 // PCNT limits (keep comfortably below int16 limits)
 static constexpr int16_t PCNT_H_LIM = 12000;
@@ -108,6 +338,9 @@ static constexpr int SPI_SLAVE_MOSI = 23;
 static constexpr int SPI_SLAVE_MISO = 19;
 static constexpr int SPI_SLAVE_CLK  = 18;
 static constexpr int SPI_SLAVE_CS   = 13;
+// Every Nth transaction carries a TelemetryPacket instead of the status
+// (0 = never)
+static constexpr uint32_t SPI_TELEMETRY_EVERY = 10;
 
 // ============================================================================
 // Reserved pins (future X stepper axis)
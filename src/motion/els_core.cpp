@@ -3,28 +3,78 @@
 #include "encoder_motion.h"
 #include "stepper.h"
 #include <Arduino.h>
+#include "esp_cpu.h"
+#include "esp_timer.h"
+#include "spindle_tracker.h"
 
 #if SPINDLE_MODE == SPINDLE_MODE_STEPPER
 #include "spindle_stepper.h"
 #endif
 
+#if ELS_DRIVE_MODE == ELS_DRIVE_TIMER
+#include "els_timer.h"
+#endif
+
 // ============================================================================
 // Spindle position abstraction - works for both encoder and stepper modes
+// Positions are in sub-counts (1 / 2^ELS_SUBCOUNT_BITS of a count), read from
+// the spindle tracking filter so they interpolate between samples.
 // ============================================================================
-static inline int32_t getSpindlePosition()
+static constexpr int32_t SUBCOUNTS_PER_COUNT = 1 << ELS_SUBCOUNT_BITS;
+static constexpr int32_t SUBCOUNTS_PER_REV = C_COUNTS_PER_REV * SUBCOUNTS_PER_COUNT;
+
+static inline SpindleTracker &spindleTracker()
+{
+#if SPINDLE_MODE == SPINDLE_MODE_ENCODER
+	return EncoderMotion::getSpindleTracker();
+#else
+	return SpindleStepper::getTracker();
+#endif
+}
+
+static inline uint32_t nowUs()
+{
+	return (uint32_t)esp_timer_get_time();
+}
+
+// Spindle speed, counts/s. Encoder mode measures it from edge timestamps and
+// carries it forward with the measured acceleration; the stepper spindle's
+// tracker follows its own step count.
+static inline int32_t spindleCountsPerSec()
 {
 #if SPINDLE_MODE == SPINDLE_MODE_ENCODER
-	return EncoderMotion::getSpindleCount();
+	return EncoderMotion::getSpindleRate().getCountsPerSecAt(nowUs());
 #else
-	return SpindleStepper::getPosition();
+	return spindleTracker().getCountsPerSec();
 #endif
 }
 
+static inline int64_t spindleFineAt(uint32_t t_us)
+{
+	return spindleTracker().positionAt(t_us) >> (16 - ELS_SUBCOUNT_BITS);
+}
+
+// Where the Z output stage will be when steps queued now come out
+static inline int64_t spindleFineLead()
+{
+	return spindleFineAt(nowUs() + ELS_LEAD_US);
+}
+
 // Static member initialization
 bool ElsCore::enabled = false;
 bool ElsCore::fault = false;
 bool ElsCore::endstop_triggered = false;
 
+volatile bool ElsCore::enable_req = false;
+bool ElsCore::enable_applied = false;
+volatile int32_t ElsCore::pitch_req = 1000;
+volatile int8_t ElsCore::direction_req = 1;
+volatile bool ElsCore::sync_req_pending = false;
+bool ElsCore::sync_req_enabled = false;
+int32_t ElsCore::sync_req_z_um = 0;
+int32_t ElsCore::sync_req_c_ticks = 0;
+static portMUX_TYPE request_mux = portMUX_INITIALIZER_UNLOCKED;
+
 int32_t ElsCore::pitch_um = 1000;  // Default 1mm pitch
 int8_t ElsCore::direction_mul = 1;
 
@@ -35,107 +85,217 @@ int32_t ElsCore::sync_z_um = 0;
 int32_t ElsCore::sync_phase_ticks = 0;
 int32_t ElsCore::sync_tolerance_out_um = 25;
 int32_t ElsCore::sync_ref_z_um = 0;
-int32_t ElsCore::sync_ref_spindle = 0;
+int64_t ElsCore::sync_ref_spindle = 0;
+int32_t ElsCore::sync_prev_err = 0;
+int32_t ElsCore::sync_prev_target = -1;
+int64_t ElsCore::sync_prev_pos = 0;
+uint32_t ElsCore::sync_wait_start_ms = 0;
+uint16_t ElsCore::sync_engage_ms = 0;
+volatile bool ElsCore::sync_catchup = false;
+int32_t ElsCore::catchup_left = 0;
+int32_t ElsCore::catchup_sps = 0;
+int64_t ElsCore::catchup_acc = 0;
+uint32_t ElsCore::catchup_last_us = 0;
+bool ElsCore::track_valid = false;
+int8_t ElsCore::track_dir = 1;
+int32_t ElsCore::track_pitch_um = 0;
+int64_t ElsCore::track_spindle = 0;
+int32_t ElsCore::track_steps = 0;
+int64_t ElsCore::track_frac = 0;
+bool ElsCore::sync_detached = false;
+ElsCore::EnvState ElsCore::env_state = ElsCore::ENV_IDLE;
+int32_t ElsCore::env_sps = 0;
+int64_t ElsCore::env_acc = 0;
+uint32_t ElsCore::env_last_us = 0;
 int32_t ElsCore::last_z_um = 0;
 volatile bool ElsCore::jog_active = false;
 volatile int8_t ElsCore::jog_dir = 0;
-bool ElsCore::jog_prev_active = false;
+ElsCore::State ElsCore::state = ElsCore::ST_IDLE;
+uint32_t ElsCore::wcet_cycles[ElsCore::ST_COUNT] = {};
+volatile bool ElsCore::wcet_over = false;
+#if DEBUG_SPI_LOGGING
+volatile int32_t ElsCore::dbg_spindle_delta = 0;
+volatile int32_t ElsCore::dbg_steps_output = 0;
+#endif
 uint32_t ElsCore::jog_last_us = 0;
-int64_t ElsCore::jog_step_accumulator = 0;
+JogProfile ElsCore::jog_profile(ELS_STEPPER_MAX_SPS, ELS_JOG_ACCEL, ELS_JOG_JERK);
+int32_t ElsCore::land_sps = 0;
+#if SPINDLE_MODE == SPINDLE_MODE_STEPPER
+bool ElsCore::thread_end = false;
+volatile bool ElsCore::thread_end_report = false;
+int64_t ElsCore::thread_end_pos = 0;
+int8_t ElsCore::thread_end_dir = 0;
+#endif
 
 int32_t ElsCore::endstop_min_um = INT32_MIN;
 int32_t ElsCore::endstop_max_um = INT32_MAX;
 bool ElsCore::endstop_min_enabled = false;
 bool ElsCore::endstop_max_enabled = false;
 
-int32_t ElsCore::last_spindle_count = 0;
-int64_t ElsCore::step_accumulator = 0;
+int64_t ElsCore::last_spindle_pos = 0;
+int64_t ElsCore::spindle_lead = 0;
+ElsGear ElsCore::gear;
+volatile bool ElsCore::gear_dirty = true;
+int32_t ElsCore::step_debt = 0;
+uint32_t ElsCore::last_step_us = 0;
 
-// Fixed-point scale for sub-step precision (16 fractional bits)
-static constexpr int64_t FP_SCALE = 65536;
-static constexpr int64_t JOG_STEPS_PER_US_FP =
-	(int64_t)ELS_JOG_MM_PER_MIN * 1000LL * (int64_t)ELS_STEPS_PER_REV * FP_SCALE /
-	(60LL * 1000000LL * (int64_t)ELS_LEADSCREW_PITCH_UM);
+#if ELS_DRIVE_MODE == ELS_DRIVE_EDGE
+TaskHandle_t ElsCore::edge_wake_task = nullptr;
+volatile uint32_t ElsCore::edge_wake_ref = 0;
+volatile int32_t ElsCore::edge_wake_lo = INT32_MIN;
+volatile int32_t ElsCore::edge_wake_hi = INT32_MAX;
+volatile bool ElsCore::edge_stamp_pending = false;
+volatile uint32_t ElsCore::edge_stamp_us = 0;
+uint32_t ElsCore::edge_latency_max_us = 0;
+#endif
 
-static inline int32_t wrap_phase(int32_t count) {
-	int32_t r = count % C_COUNTS_PER_REV;
-	if (r < 0) r += C_COUNTS_PER_REV;
-	return r;
-}
+#if ELS_DRIVE_MODE == ELS_DRIVE_COUPLED
+bool ElsCore::coupled = false;
+int8_t ElsCore::coupled_hold = 0;
+#endif
 
-static inline bool crossed_phase(int32_t prev, int32_t curr, int32_t target_phase) {
-	const int32_t delta = curr - prev;
-	if (delta == 0) return false;
-	if (delta >= C_COUNTS_PER_REV || delta <= -C_COUNTS_PER_REV) return true;
+#if ELS_DRIVE_MODE == ELS_DRIVE_TIMER
+volatile bool ElsCore::tick_armed = false;
+uint32_t ElsCore::tick_span_us = 0;
+static portMUX_TYPE tick_mux = portMUX_INITIALIZER_UNLOCKED;
+#endif
 
-	const int32_t prev_phase = wrap_phase(prev);
-	const int32_t curr_phase = wrap_phase(curr);
-	const int32_t target = wrap_phase(target_phase);
+// Fixed-point scale (16 fractional bits)
+static constexpr int64_t FP_SCALE = 65536;
+// Long-press jog speed, steps/s
+static constexpr int32_t JOG_SPS = (int32_t)(
+	(int64_t)ELS_JOG_MM_PER_MIN * 1000LL * (int64_t)ELS_STEPS_PER_REV /
+	(60LL * (int64_t)ELS_LEADSCREW_PITCH_UM));
 
-	if (prev_phase == target || curr_phase == target) return true;
+// Thread model resolution: the unreduced gear denominator, so every reduced
+// gear phase maps onto it exactly
+static constexpr int64_t TRACK_DEN = (int64_t)SUBCOUNTS_PER_REV * (int64_t)ELS_LEADSCREW_PITCH_UM;
 
-	if (delta > 0) {
-		if (prev_phase < curr_phase) return (target > prev_phase && target < curr_phase);
-		return (target > prev_phase || target < curr_phase);
-	}
+static inline int32_t wrap_phase(int64_t pos) {
+	int64_t r = pos % SUBCOUNTS_PER_REV;
+	if (r < 0) r += SUBCOUNTS_PER_REV;
+	return (int32_t)r;
+}
 
-	if (prev_phase > curr_phase) return (target < prev_phase && target > curr_phase);
-	return (target < prev_phase || target > curr_phase);
+// Signed distance from phase to target, in (-rev/2, rev/2]
+static inline int32_t phase_error(int32_t target, int32_t phase) {
+	int32_t e = target - phase;
+	if (e > SUBCOUNTS_PER_REV / 2) e -= SUBCOUNTS_PER_REV;
+	else if (e <= -SUBCOUNTS_PER_REV / 2) e += SUBCOUNTS_PER_REV;
+	return e;
 }
 
 void ElsCore::init() {
     enabled = false;
+	enable_req = false;
+	enable_applied = false;
+	pitch_req = pitch_um;
+	direction_req = direction_mul;
+	sync_req_pending = false;
     fault = false;
     endstop_triggered = false;
-	last_spindle_count = getSpindlePosition();
-	step_accumulator = 0;
+	last_spindle_pos = spindleFineLead();
+	resetGearPhase();
 	sync_enabled = false;
 	sync_waiting = false;
 	sync_in = false;
 	sync_ref_z_um = 0;
 	sync_ref_spindle = 0;
+	track_valid = false;
+	sync_detached = false;
 	last_z_um = EncoderMotion::getZCount() * Z_UM_PER_COUNT;
 	jog_active = false;
 	jog_dir = 0;
-	jog_prev_active = false;
+	state = ST_IDLE;
 	jog_last_us = 0;
-	jog_step_accumulator = 0;
+	jog_profile.stop();
+	land_sps = 0;
+#if SPINDLE_MODE == SPINDLE_MODE_STEPPER
+	thread_end = false;
+#endif
+	updateGearRatio();
+
+#if ELS_DRIVE_MODE == ELS_DRIVE_EDGE
+	EncoderMotion::setSpindleEdgeHook(onSpindleEdge);
+#endif
+
+	if (ELS_GEAR_BENCHMARK) runGearBenchmark();
 }
 
-void ElsCore::setEnabled(bool on) {
+// ============================================================================
+// Requests (setters): latched on whichever core, applied here in update()
+// ============================================================================
+void ElsCore::setSync(bool on, int32_t z_um, int32_t c_ticks) {
+	// The SPI loop repeats the same values every pass; only changes go over
+	if (on == sync_req_enabled && z_um == sync_req_z_um && c_ticks == sync_req_c_ticks) return;
+	portENTER_CRITICAL(&request_mux);
+	sync_req_enabled = on;
+	sync_req_z_um = z_um;
+	sync_req_c_ticks = c_ticks;
+	sync_req_pending = true;
+	portEXIT_CRITICAL(&request_mux);
+}
+
+// Same order the SPI loop sets them in
+void ElsCore::applyRequests() {
+	const bool en = enable_req;
+	if (en != enable_applied) {
+		enable_applied = en;
+		applyEnabled(en);
+	}
+	const int32_t pitch = pitch_req;
+	if (pitch != pitch_um) applyPitchUm(pitch);
+	const int8_t mul = direction_req;
+	if (mul != direction_mul) applyDirectionMul(mul);
+	if (sync_req_pending) {
+		portENTER_CRITICAL(&request_mux);
+		const bool on = sync_req_enabled;
+		const int32_t z_um = sync_req_z_um;
+		const int32_t c_ticks = sync_req_c_ticks;
+		sync_req_pending = false;
+		portEXIT_CRITICAL(&request_mux);
+		applySync(on, z_um, c_ticks);
+	}
+}
+
+void ElsCore::applyEnabled(bool on) {
     if (on && !enabled) {
         // Enabling: sync to current spindle position
-		last_spindle_count = getSpindlePosition();
-		step_accumulator = 0;
+		last_spindle_pos = spindleFineLead();
+		resetGearPhase();
         fault = false;
         endstop_triggered = false;
 		last_z_um = EncoderMotion::getZCount() * Z_UM_PER_COUNT;
     }
     enabled = on;
 	if (!enabled) {
+#if SPINDLE_MODE == SPINDLE_MODE_STEPPER
+		thread_end = false;
+#endif
 		sync_waiting = false;
 		sync_in = false;
+		sync_catchup = false;
 	} else if (sync_enabled) {
-		sync_waiting = true;
+		beginSyncWait();
 		sync_in = false;
 	}
 }
 
-void ElsCore::setPitchUm(int32_t pitch) {
-    if (pitch == pitch_um) return;
+void ElsCore::applyPitchUm(int32_t pitch) {
     pitch_um = pitch;
+	gear_dirty = true;
+	track_valid = false;  // A different thread
 	if (sync_enabled && enabled) {
-		sync_waiting = true;
+		beginSyncWait();
 		sync_in = false;
 	}
 }
 
-void ElsCore::setDirectionMul(int8_t mul) {
-    int8_t new_mul = (mul < 0) ? -1 : 1;
-	if (new_mul == direction_mul) return;
-    direction_mul = new_mul;
+void ElsCore::applyDirectionMul(int8_t mul) {
+    direction_mul = mul;
+	gear_dirty = true;
 	if (sync_enabled && enabled) {
-		sync_waiting = true;
+		beginSyncWait();
 		sync_in = false;
 	}
 }
@@ -152,21 +312,25 @@ void ElsCore::setJog(int8_t dir, bool active)
 	jog_active = active && (new_dir != 0);
 }
 
-void ElsCore::setSync(bool enabled, int32_t z_um, int32_t c_ticks) {
+void ElsCore::applySync(bool on, int32_t z_um, int32_t c_ticks) {
 	const bool was_enabled = sync_enabled;
 	const int32_t prev_z = sync_z_um;
 	const int32_t prev_phase = sync_phase_ticks;
-	sync_enabled = enabled;
+	sync_enabled = on;
 	sync_z_um = z_um;
 	sync_phase_ticks = c_ticks;
 	if (!sync_enabled) {
 		sync_waiting = false;
 		sync_in = false;
+		sync_catchup = false;
+		track_valid = false;
 		return;
 	}
 	if (!was_enabled || prev_z != z_um || prev_phase != c_ticks) {
 		sync_in = false;
-		sync_waiting = ElsCore::enabled;
+		track_valid = false;
+		if (enabled) beginSyncWait();
+		else sync_waiting = false;
 	}
 }
 
@@ -177,187 +341,971 @@ void ElsCore::setEndstops(int32_t min_um, int32_t max_um, bool min_en, bool max_
     endstop_max_enabled = max_en;
 }
 
-bool ElsCore::checkEndstops(int32_t z_um) {
+int32_t ElsCore::endstopRoom(bool forward) {
+	if (forward ? !endstop_max_enabled : !endstop_min_enabled) return INT32_MAX;
+	// Scale position plus what is still queued (steps and Z share a sense)
+	const int32_t queued = Stepper::getCommanded() - Stepper::getPosition();
+	const int64_t z_um = (int64_t)EncoderMotion::getZCount() * Z_UM_PER_COUNT +
+						 (int64_t)queued * ELS_LEADSCREW_PITCH_UM / ELS_STEPS_PER_REV;
+	const int64_t gap_um = forward ? (int64_t)endstop_max_um - z_um : z_um - (int64_t)endstop_min_um;
+	const int64_t steps = gap_um * ELS_STEPS_PER_REV / ELS_LEADSCREW_PITCH_UM;
+	if (steps > INT32_MAX - 1) return INT32_MAX - 1;
+	if (steps < -INT32_MAX) return -INT32_MAX;
+	return (int32_t)steps;
+}
+
+// Endstops for the spindle-driven paths, Z running at sps. Outside a limit:
+// false, the caller faults at once. Heading for one with no more room than
+// Z needs to stop in: the fault is latched now and Z carries on at sps on
+// the jog profile, which brakes it onto the limit (handleJog). The gear
+// still runs out this cycle, which the margin allows for.
+bool ElsCore::checkEndstops(int32_t z_um, int32_t sps) {
     if (endstop_min_enabled && z_um < endstop_min_um) {
         return false;  // Out of bounds
     }
     if (endstop_max_enabled && z_um > endstop_max_um) {
         return false;  // Out of bounds
     }
-    return true;  // In bounds
+	if (sps == 0) return true;
+	const int32_t room = endstopRoom(sps > 0);
+	if (room == INT32_MAX) return true;
+#if SPINDLE_MODE == SPINDLE_MODE_STEPPER
+	if (SPINDLE_THREAD_END_STOP && threadEndStop(room)) return true;
+#endif
+	const int32_t abs_sps = (sps < 0) ? -sps : sps;
+	if (room > jog_profile.stopSteps(sps) + abs_sps / 1000 + 1) return true;  // 1 ms cycle
+
+	enabled = false;
+	fault = true;
+	endstop_triggered = true;
+	track_valid = false;
+	land_sps = sps;
+	jog_profile.start(sps);
+	jog_last_us = micros();
+	return true;
+}
+
+#if SPINDLE_MODE == SPINDLE_MODE_STEPPER
+// Thread end: rather than Z braking off the gear (which leaves the thread
+// with a taper where it stopped), the spindle ramps down onto the spindle
+// position that puts Z on the limit, and Z stays on the gear all the way.
+// room is Z steps, measured off the scale, which may read up to a count
+// behind Z: the stop is kept that much short, and the spindle stop is
+// rounded short of the limit on top. True while the spindle has the stop,
+// is held on it (until the ELS is switched off), or it isn't due yet; false
+// to leave it to the Z landing: the spindle is not running towards it, or
+// is too close to ramp down in time.
+bool ElsCore::threadEndStop(int32_t room) {
+	const int32_t cps = spindleCountsPerSec();
+	if (thread_end) return (int64_t)cps * thread_end_dir >= 0;
+	room -= (Z_UM_PER_COUNT * ELS_STEPS_PER_REV + ELS_LEADSCREW_PITCH_UM - 1) / ELS_LEADSCREW_PITCH_UM;
+	if (room < 0 || pitch_um == 0 || cps == 0) return false;
+	const int64_t abs_pitch = (pitch_um < 0) ? -(int64_t)pitch_um : (int64_t)pitch_um;
+	const int64_t room_fine = (int64_t)room * SUBCOUNTS_PER_REV * ELS_LEADSCREW_PITCH_UM /
+							  (abs_pitch * ELS_STEPS_PER_REV);
+	const int32_t abs_cps = (cps < 0) ? -cps : cps;
+	// The room moves a scale count at a time
+	const int64_t scale_counts = (int64_t)Z_UM_PER_COUNT * C_COUNTS_PER_REV / abs_pitch + 1;
+	if (room_fine / SUBCOUNTS_PER_COUNT > SpindleStepper::brakeSteps() + abs_cps / 1000 + 2 + scale_counts) {
+		return true;  // Not due yet (1 ms cycle)
+	}
+
+	// Whole spindle steps, short of the limit in the direction it runs
+	int64_t stop_pos;
+	if (cps > 0) {
+		const int64_t p = last_spindle_pos + room_fine;
+		stop_pos = (p >= 0) ? p / SUBCOUNTS_PER_COUNT : -((-p + SUBCOUNTS_PER_COUNT - 1) / SUBCOUNTS_PER_COUNT);
+	} else {
+		const int64_t p = last_spindle_pos - room_fine;
+		stop_pos = (p >= 0) ? (p + SUBCOUNTS_PER_COUNT - 1) / SUBCOUNTS_PER_COUNT : -(-p / SUBCOUNTS_PER_COUNT);
+	}
+	if (!SpindleStepper::stopAt(stop_pos)) return false;
+	thread_end = true;
+	thread_end_pos = stop_pos;
+	thread_end_dir = (cps > 0) ? 1 : -1;
+	thread_end_report = true;
+	return true;
+}
+#endif
+
+// Speed the ELS has Z at, steps/s
+int32_t ElsCore::envSps() {
+	if (env_state == ENV_LOCKED) return gearRateSps();
+	return (env_state == ENV_IDLE) ? 0 : env_sps;
 }
 
 void ElsCore::update() {
-	const bool jog_active_now = jog_active;
-	const int8_t jog_dir_now = jog_dir;
-	if (jog_active_now && jog_dir_now != 0)
-	{
-		if (!jog_prev_active)
-		{
-			jog_prev_active = true;
-			jog_last_us = micros();
-			jog_step_accumulator = 0;
-			last_spindle_count = getSpindlePosition();
-			last_z_um = EncoderMotion::getZCount() * Z_UM_PER_COUNT;
-			step_accumulator = 0;
-			if (sync_enabled)
-			{
-				sync_waiting = true;
-				sync_in = false;
-			}
-		}
+#if ELS_DRIVE_MODE == ELS_DRIVE_TIMER
+	// Take the gear back from the tick ISR while the control logic runs;
+	// process() hands it back once stepping is allowed
+	disarmTick();
+#endif
 
-		const uint32_t now_us = micros();
-		const uint32_t dt_us = now_us - jog_last_us;
-		jog_last_us = now_us;
+	// Commands latched since the last cycle. None of them touch the gear
+	// while the tick or the synthesizer has it; the coupled check below
+	// takes it back if they changed what it runs on.
+	applyRequests();
 
-		if (dt_us > 0 && JOG_STEPS_PER_US_FP > 0)
-		{
-			const int64_t step_delta_fp = (int64_t)dt_us * JOG_STEPS_PER_US_FP;
-			jog_step_accumulator += step_delta_fp;
-
-			int32_t steps_to_output = (int32_t)(jog_step_accumulator / FP_SCALE);
-			if (steps_to_output != 0)
-			{
-				if (steps_to_output > ELS_MAX_STEPS_PER_CYCLE)
-					steps_to_output = ELS_MAX_STEPS_PER_CYCLE;
-				jog_step_accumulator -= (int64_t)steps_to_output * FP_SCALE;
-				Stepper::step(steps_to_output * (int32_t)jog_dir_now);
-			}
-		}
-		return;
+#if ELS_DRIVE_MODE == ELS_DRIVE_COUPLED
+	// Take the gear back from the synthesizer before anything changes it;
+	// it stays there only while Z is locked to the gear and nothing else runs
+	if (coupled && (gear_dirty || selectState() != ST_SYNCED || env_state != ENV_LOCKED ||
+					!SpindleStepper::isCoupled())) {
+		decouple();
 	}
+#endif
 
-	if (jog_prev_active)
-	{
-		jog_prev_active = false;
-		jog_step_accumulator = 0;
-		last_spindle_count = getSpindlePosition();
+#if SPINDLE_MODE == SPINDLE_MODE_ENCODER
+	// The index re-homed the spindle count: positions held here move with
+	// it, so a kept thread model still points at the same helix
+	const int32_t rehome = EncoderMotion::takeIndexRehome();
+	if (rehome != 0) rebaseSpindle(rehome);
+#endif
+
+	// Pitch/direction changed (applyRequests): re-reduce the ratio
+	if (gear_dirty) updateGearRatio();
+
+#if SPINDLE_MODE == SPINDLE_MODE_STEPPER
+	// Thread end done: Z is on the limit with the gear (and the thread
+	// model) intact, so only the endstop is reported
+	if (thread_end && !endstop_triggered && !SpindleStepper::isStopping()) {
+		endstop_triggered = true;
+	}
+#endif
+
+	process();
+
+#if ELS_DRIVE_MODE == ELS_DRIVE_EDGE
+	// A wake that produced no step must not be charged to a later one
+	edge_stamp_pending = false;
+	armEdgeWake();
+#endif
+}
+
+// ============================================================================
+// State machine
+// selectState() derives the state from the command inputs each cycle;
+// enterState() runs the transition work, then the state's handler runs.
+// Handlers are timed with CCOUNT so the worst case per state is known.
+// ============================================================================
+const ElsCore::StateInfo ElsCore::STATE_TABLE[ST_COUNT] = {
+	{ "IDLE",   &ElsCore::handleIdle },
+	{ "JOG",    &ElsCore::handleJog },
+	{ "WAIT",   &ElsCore::handleWaitSync },
+	{ "SYNCED", &ElsCore::handleSynced },
+	{ "FAULT",  &ElsCore::handleFault },
+};
+
+ElsCore::State ElsCore::selectState() {
+	// A released jog (or an endstop landing) stays in JOG until Z stops
+	if ((jog_active && jog_dir != 0) || !jog_profile.isStopped()) return ST_JOG;
+	if (!enabled) return fault ? ST_FAULT : ST_IDLE;
+	if (sync_enabled && !sync_in) return ST_WAIT_SYNC;
+	return ST_SYNCED;
+}
+
+void ElsCore::enterState(State next) {
+	if (next == ST_JOG) {
+		// A jog takes Z over at whatever speed the ELS left it; an endstop
+		// landing already has the profile running
+		if (jog_profile.isStopped()) {
+			jog_last_us = micros();
+			jog_profile.start(envSps());
+		}
+		env_state = ENV_IDLE;
+		last_spindle_pos = spindleFineLead();
 		last_z_um = EncoderMotion::getZCount() * Z_UM_PER_COUNT;
-		step_accumulator = 0;
+		resetGearPhase();
+		if (sync_enabled)
+		{
+			beginSyncWait();
+			sync_in = false;
+		}
+	} else if (state == ST_JOG) {
+		jog_profile.stop();
+		land_sps = 0;
+		last_spindle_pos = spindleFineLead();
+		last_z_um = EncoderMotion::getZCount() * Z_UM_PER_COUNT;
+		resetGearPhase();
 		if (sync_enabled && enabled)
 		{
-			sync_waiting = true;
+			beginSyncWait();
 			sync_in = false;
 		}
 	}
+	state = next;
+}
+
+void ElsCore::process() {
+	const State next = selectState();
+	if (next != state) enterState(next);
+
+	const State s = state;
+	const uint32_t start = ELS_WCET_MEASURE ? esp_cpu_get_cycle_count() : 0;
+	STATE_TABLE[s].handler();
+	if (ELS_WCET_MEASURE) {
+		const uint32_t cycles = esp_cpu_get_cycle_count() - start;
+		if (cycles > wcet_cycles[s]) wcet_cycles[s] = cycles;
+	}
+}
+
+void ElsCore::handleIdle() {
+	// Bring Z down from whatever speed the ELS left it at
+	if (env_state == ENV_RAMP_UP || env_state == ENV_LOCKED) beginRampDown();
+	if (env_state != ENV_RAMP_DOWN) return;
+	const uint32_t now_us = micros();
+	const uint32_t span_us = Stepper::spanUs(now_us - last_step_us);
+	last_step_us = now_us;
+	const int32_t steps = rampDownSteps(nowUs());
+	if (steps != 0) Stepper::step(steps, span_us);
+}
+
+void ElsCore::handleFault() {
+	// Latched until re-enabled or clearFault(); Z already stopped
+}
+
+void ElsCore::handleJog() {
+	const int8_t dir = jog_dir;
+	const uint32_t now_us = micros();
+	const uint32_t dt_us = now_us - jog_last_us;
+	jog_last_us = now_us;
+
+	// A jog button overrides an endstop landing; either way the endstops
+	// bound the move and it lands on them
+	const bool jogging = jog_active && dir != 0;
+	if (jogging) land_sps = 0;
+	const int32_t v_target = jogging ? (int32_t)dir * JOG_SPS : land_sps;
+	const int32_t steps = jog_profile.toSpeed(v_target, dt_us, endstopRoom(true), endstopRoom(false));
+	if (steps == 0) return;
+	int32_t n = steps;
+	if (n > ELS_MAX_STEPS_PER_CYCLE) n = ELS_MAX_STEPS_PER_CYCLE;
+	if (n < -ELS_MAX_STEPS_PER_CYCLE) n = -ELS_MAX_STEPS_PER_CYCLE;
+	// Only what the step queue took is done; the rest stays owed
+	const int32_t accepted = Stepper::step(n, Stepper::spanUs(dt_us));
+	jog_profile.giveBack(steps - accepted);
+}
+
+// Spindle position now (for sync, which compares against measured Z) and
+// ELS_LEAD_US ahead (for stepping, to cancel the output pipeline delay)
+ElsCore::Sample ElsCore::takeSample() {
+	Sample s;
+	s.t_us = nowUs();
+	s.spindle_now = spindleFineAt(s.t_us);
+	s.spindle_led = spindleFineAt(s.t_us + ELS_LEAD_US);
+	s.z_um = EncoderMotion::getZCount() * Z_UM_PER_COUNT;
+	spindle_lead = s.spindle_led - s.spindle_now;
+	return s;
+}
+
+// Sync lost or not started: Z holds until the wait engages
+void ElsCore::holdForSync(const Sample &s) {
+	last_spindle_pos = s.spindle_led;
+	last_z_um = s.z_um;
+	resetGearPhase();
+	env_state = ENV_IDLE;
+}
+
+void ElsCore::handleWaitSync() {
+	const Sample s = takeSample();
+
+	if (!sync_waiting) {
+		beginSyncWait();
+		holdForSync(s);
+		return;
+	}
+
+	if (pitch_um == 0) {
+		sync_waiting = false;
+		sync_in = false;
+	} else if (sync_catchup) {
+		// Gear is locked; in sync once the catch-up move is out and the
+		// envelope has made up what it held back from a standing start
+		if (catchup_left == 0 && env_state != ENV_RAMP_UP) {
+			sync_catchup = false;
+			sync_waiting = false;
+			sync_in = true;
+			recordSyncEngage();
+		}
+	} else if (engageFromTrack(s.t_us, s.spindle_now, s.spindle_led, s.z_um)) {
+		// Re-engaged from the kept thread model, or running reversed
+		// away from it: either way Z follows the gear from here
+	} else {
+		const int64_t phase_num = (int64_t)(s.z_um - sync_z_um) *
+								  (int64_t)SUBCOUNTS_PER_REV *
+								  (int64_t)direction_mul;
+		const int64_t phase_delta = phase_num / (int64_t)pitch_um;
+		const int32_t target_phase =
+			wrap_phase((int64_t)sync_phase_ticks * SUBCOUNTS_PER_COUNT + phase_delta);
+		const int32_t err = phase_error(target_phase, wrap_phase(s.spindle_now));
+
+		// Crossed when the error changes sign between two samples with the
+		// same target, by no more than the spindle moved in between
+		const int64_t moved = s.spindle_now - sync_prev_pos;
+		const int64_t abs_moved = (moved < 0) ? -moved : moved;
+		const int32_t abs_err = (err < 0) ? -err : err;
+		const bool crossed = (err == 0) ||
+			(target_phase == sync_prev_target &&
+			 (err < 0) != (sync_prev_err < 0) &&
+			 abs_err <= abs_moved);
+		sync_prev_err = err;
+		sync_prev_target = target_phase;
+		sync_prev_pos = s.spindle_now;
+
+		// Fast engage: lock the gear now and let a catch-up move take
+		// Z to where the current phase wants it, unless that is too far
+		const int64_t catchup_um = (int64_t)abs_err * (int64_t)pitch_um / SUBCOUNTS_PER_REV;
+		if (!crossed && ELS_SYNC_FAST_ENGAGE && catchup_um <= ELS_SYNC_CATCHUP_MAX_UM) {
+			resetGearPhase();
+			sync_ref_z_um = s.z_um;
+			sync_ref_spindle = s.spindle_now + err;
+			// From the spindle now, as the reference is: this cycle's gear
+			// steps take Z the lead on, like every cycle after it
+			last_spindle_pos = s.spindle_now;
+			// Z is where the spindle at +err wants it: owe the gear -err
+			catchup_left = gear.advance(-err);
+			catchup_sps = 0;
+			catchup_acc = 0;
+			catchup_last_us = s.t_us;
+			sync_catchup = true;
+		} else if (!crossed) {
+			last_spindle_pos = s.spindle_led;
+			last_z_um = s.z_um;
+			env_state = ENV_IDLE;
+			return;
+		} else {
+			sync_waiting = false;
+			sync_in = true;
+			resetGearPhase();
+			// Reference the exact sub-count crossing point; the overshoot
+			// since then and the lead are owed to the gear on this cycle
+			sync_ref_z_um = s.z_um;
+			sync_ref_spindle = s.spindle_now + err;
+			last_spindle_pos = s.spindle_now + err;
+			recordSyncEngage();
+		}
+	}
 
-    if (!enabled) return;
+	driveGear(s);
+}
 
-	// Get current spindle position (from encoder or stepper, depending on mode)
-	int32_t spindle_count = getSpindlePosition();
-	const int32_t z_um = EncoderMotion::getZCount() * Z_UM_PER_COUNT;
+void ElsCore::handleSynced() {
+	const Sample s = takeSample();
 
 	if (sync_enabled) {
-		if (sync_waiting) {
-			if (pitch_um == 0) {
-				sync_waiting = false;
-				sync_in = false;
-			} else {
-				const int64_t phase_num = (int64_t)(z_um - sync_z_um) *
-										  (int64_t)C_COUNTS_PER_REV *
-										  (int64_t)direction_mul;
-				const int32_t phase_delta = (int32_t)(phase_num / (int64_t)pitch_um);
-				const int32_t target_phase = wrap_phase(sync_phase_ticks + phase_delta);
-				const int32_t current_phase = wrap_phase(spindle_count);
-				if (current_phase != target_phase &&
-					!crossed_phase(last_spindle_count, spindle_count, target_phase)) {
-					last_spindle_count = spindle_count;
-					last_z_um = z_um;
-					return;
-				}
-				sync_waiting = false;
-				sync_in = true;
-				sync_ref_z_um = z_um;
-				sync_ref_spindle = spindle_count;
-				last_spindle_count = spindle_count;
-				step_accumulator = 0;
-			}
-		} else if (!sync_in) {
-			sync_waiting = true;
-			last_spindle_count = spindle_count;
-			last_z_um = z_um;
-			step_accumulator = 0;
+		const int64_t spindle_delta = s.spindle_now - sync_ref_spindle;
+		const int64_t numerator = spindle_delta * (int64_t)pitch_um * (int64_t)direction_mul;
+		const int32_t expected_z = sync_ref_z_um + (int32_t)(numerator / (int64_t)SUBCOUNTS_PER_REV);
+		const int32_t err = s.z_um - expected_z;
+		const int32_t abs_err = (err < 0) ? -err : err;
+		if (abs_err > sync_tolerance_out_um) {
+#if ELS_DRIVE_MODE == ELS_DRIVE_COUPLED
+			decouple();
+#endif
+			// Z didn't follow (lost steps, crash): the model is no use either
+			sync_in = false;
+			track_valid = false;
+			beginSyncWait();
+			holdForSync(s);
 			return;
 		}
+#if ELS_DRIVE_MODE == ELS_DRIVE_COUPLED
+		// A coupled Z stream holds steps the commanded count doesn't have yet
+		if (ELS_SYNC_KEEP_PHASE && !coupled && !Stepper::isCoupled()) snapshotTrack();
+#else
+		if (ELS_SYNC_KEEP_PHASE) snapshotTrack();
+#endif
+	}
 
-		if (sync_in) {
-			const int32_t spindle_delta = spindle_count - sync_ref_spindle;
-			const int64_t numerator = (int64_t)spindle_delta * (int64_t)pitch_um * (int64_t)direction_mul;
-			const int32_t expected_z = sync_ref_z_um + (int32_t)(numerator / (int64_t)C_COUNTS_PER_REV);
-			const int32_t err = z_um - expected_z;
-			const int32_t abs_err = (err < 0) ? -err : err;
-			if (abs_err > sync_tolerance_out_um) {
-				sync_in = false;
-				sync_waiting = true;
-				last_spindle_count = spindle_count;
-				last_z_um = z_um;
-				step_accumulator = 0;
-				return;
-			}
+	driveGear(s);
+}
+
+// Gear, catch-up and envelope -> step queue (or hand over to tick())
+void ElsCore::driveGear(const Sample &s) {
+	const int32_t catchup_steps = sync_catchup ? catchupAdvance(s.t_us) : 0;
+	// Locked, the envelope's clock still runs: a ramp-down carries on from
+	// the last cycle the gear drove Z, with no cycle dropped in between
+	if (env_state == ENV_LOCKED) env_last_us = s.t_us;
+
+#if ELS_DRIVE_MODE == ELS_DRIVE_TIMER
+	if (env_state == ENV_LOCKED) {
+		last_z_um = s.z_um;
+		step_debt += catchup_steps;
+		if ((s.spindle_led != last_spindle_pos || catchup_steps != 0) && !checkEndstops(s.z_um, envSps())) {
+			faultStop();
+			return;
 		}
+		// tick() carries on from last_spindle_pos at the timer rate
+		const uint32_t rate = ElsTimer::getRateHz();
+		tick_span_us = (rate > 0) ? (1000000 / rate) * ELS_STEP_SPREAD_PCT / 100 : 0;
+		tick_armed = true;
+		return;
 	}
+	// Still ramping: the task runs the gear through the envelope until lock
+#endif
 
-	int32_t spindle_delta = spindle_count - last_spindle_count;
-    last_spindle_count = spindle_count;
-	last_z_um = z_um;
-    
-    if (spindle_delta == 0) return;
+#if ELS_DRIVE_MODE == ELS_DRIVE_COUPLED
+	// Coupled: the synthesizer runs the gear, the task only watches the
+	// endstops. Just decoupled: the synthesizer ran the gear up to where the
+	// spindle will be a buffer ahead, so wait for it to get there.
+	bool hold = coupled;
+	if (!hold && coupled_hold != 0) {
+		const int64_t d = s.spindle_led - last_spindle_pos;
+		hold = (coupled_hold > 0) ? (d < 0) : (d > 0);
+		if (!hold) coupled_hold = 0;
+	}
+	if (hold) {
+		last_z_um = s.z_um;
+		const bool in_bounds = checkEndstops(s.z_um, envSps());
+		if (!in_bounds || land_sps != 0) {
+			// The stream runs ahead of what has been commanded: end it here,
+			// and from the scale either fault or land on the limit
+			// What the dropped slots held is owed again
+			decouple();
+			int32_t owed;
+			SpindleStepper::abortCoupled(owed);
+			step_debt += owed;
+			if (!in_bounds) faultStop();
+		}
+		return;
+	}
+	// Locked with nothing owed and Z idle: hand the gear over
+	if (env_state == ENV_LOCKED && catchup_steps == 0 && !sync_catchup && step_debt == 0 &&
+		Stepper::isIdle() && SpindleStepper::couple(&gear, last_spindle_pos)) {
+		coupled = true;
+		last_z_um = s.z_um;
+		return;
+	}
+#endif
+
+	// Sub-count delta: one cycle of spindle motion is far inside int32
+	int32_t spindle_delta = (int32_t)(s.spindle_led - last_spindle_pos);
+	last_z_um = s.z_um;
     
+    // Nothing to do unless Z is still coasting down from before the enable
+    if (spindle_delta == 0 && step_debt == 0 && catchup_steps == 0 && env_state != ENV_RAMP_DOWN) return;
+
 #if DEBUG_SPI_LOGGING
-    // Debug: log spindle movement
-    static uint32_t last_debug_ms = 0;
-    static int32_t total_spindle_delta = 0;
-    static int32_t total_steps_output = 0;
-    total_spindle_delta += spindle_delta;
-    
-    if (millis() - last_debug_ms > 1000) {
-        Serial.printf("[ELS] pitch=%ld um, spindle_delta=%ld, steps_out=%ld\n",
-            pitch_um, total_spindle_delta, total_steps_output);
-        total_spindle_delta = 0;
-        total_steps_output = 0;
-        last_debug_ms = millis();
-    }
+    dbg_spindle_delta += spindle_delta;
 #endif
     
-    // Check endstops before moving
-    if (!checkEndstops(z_um)) {
-        enabled = false;
-        fault = true;
-        endstop_triggered = true;
+    // Check endstops before moving (past one, or too close to stop short),
+    // last_spindle_pos still where the steps queued so far take Z
+    const bool in_bounds = checkEndstops(s.z_um, envSps());
+    last_spindle_pos = s.spindle_led;
+    if (!in_bounds) {
+        faultStop();
         return;
     }
     
-    // Calculate required Z movement in microns
-    // spindle_delta counts / C_COUNTS_PER_REV = revolutions
-    // revolutions * pitch_um = microns to travel
-    // microns / ELS_LEADSCREW_PITCH_UM * ELS_STEPS_PER_REV = steps
-    
-    // Use fixed-point math for precision:
-    // steps = (spindle_delta * pitch_um * ELS_STEPS_PER_REV * direction_mul) 
-    //         / (C_COUNTS_PER_REV * ELS_LEADSCREW_PITCH_UM)
-    
-    int64_t numerator = (int64_t)spindle_delta * (int64_t)pitch_um * 
-                        (int64_t)ELS_STEPS_PER_REV * (int64_t)direction_mul * FP_SCALE;
-    int64_t denominator = (int64_t)C_COUNTS_PER_REV * (int64_t)ELS_LEADSCREW_PITCH_UM;
-    
-    int64_t step_delta_fp = numerator / denominator;
-    
-    // Accumulate fractional steps
-    step_accumulator += step_delta_fp;
-    
-    // Extract whole steps
-    int32_t steps_to_output = (int32_t)(step_accumulator / FP_SCALE);
+    // Gear ratio is reduced once (updateGearRatio); per cycle this is a few
+    // 32-bit multiplies and adds, and the remainder keeps every fractional step.
+    // Steps the queue refused last cycle are still owed and go out first.
+    int32_t steps_to_output = step_debt + catchup_steps + gear.advance(spindle_delta);
+
+    // Starting from standstill (or from the speed a ramp-down has left):
+    // ramp up rather than jump to the gear rate. Whatever the envelope holds
+    // back stays in step_debt until it locks.
+    if (env_state == ENV_IDLE || env_state == ENV_RAMP_DOWN) beginRampUp(s.t_us);
+    const int32_t out = (env_state == ENV_RAMP_UP) ? rampUpSteps(steps_to_output, s.t_us)
+                                                   : steps_to_output;
+
+    // Spread this batch over the time it took the spindle to produce it
+    const uint32_t now_us = micros();
+    const uint32_t span_us = Stepper::spanUs(now_us - last_step_us);
+    last_step_us = now_us;
     
-    if (steps_to_output != 0) {
-        // Remove outputted steps from accumulator
-        step_accumulator -= (int64_t)steps_to_output * FP_SCALE;
-        
-#if DEBUG_SPI_LOGGING
-        total_steps_output += abs(steps_to_output);
+    int32_t accepted = 0;
+    if (out != 0) {
+
+#if ELS_DRIVE_MODE == ELS_DRIVE_EDGE
+        if (edge_stamp_pending) {
+            const uint32_t latency_us = (uint32_t)esp_timer_get_time() - edge_stamp_us;
+            if (latency_us > edge_latency_max_us) edge_latency_max_us = latency_us;
+            edge_stamp_pending = false;
+        }
 #endif
         
         // Output steps
-        Stepper::step(steps_to_output);
+        accepted = Stepper::step(out, span_us);
+#if DEBUG_SPI_LOGGING
+        dbg_steps_output += abs(accepted);
+#endif
     }
+    step_debt = steps_to_output - accepted;
+}
+
+// ============================================================================
+// Reporting (loop(), core 0): keeps Serial out of the motion task
+// ============================================================================
+void ElsCore::reportUpdate() {
+	const uint32_t now_ms = millis();
+#if SPINDLE_MODE == SPINDLE_MODE_STEPPER
+	if (thread_end_report) {
+		Serial.printf("[ELS] Thread end: spindle stopping at %lld\n", (long long)thread_end_pos);
+		thread_end_report = false;
+	}
+#endif
+#if DEBUG_SPI_LOGGING
+	static uint32_t last_debug_ms = 0;
+	if (now_ms - last_debug_ms > 1000) {
+		const int32_t spindle_delta = dbg_spindle_delta;
+		const int32_t steps_out = dbg_steps_output;
+		dbg_spindle_delta = 0;
+		dbg_steps_output = 0;
+		if (spindle_delta != 0 || steps_out != 0) {
+			Serial.printf("[ELS] pitch=%ld um, spindle_delta=%ld sub-counts, steps_out=%ld\n",
+				pitch_um, spindle_delta, steps_out);
+#if ELS_DRIVE_MODE == ELS_DRIVE_EDGE
+			Serial.printf("[ELS] edge->step latency max=%lu us\n",
+				(unsigned long)edge_latency_max_us);
+#endif
+		}
+		last_debug_ms = now_ms;
+	}
+#endif
+
+	if (!ELS_WCET_MEASURE) return;
+	static uint32_t last_report_ms = 0;
+	if (now_ms - last_report_ms < ELS_WCET_REPORT_MS) return;
+	last_report_ms = now_ms;
+
+	const uint32_t mhz = getCpuFrequencyMhz();
+	for (int i = 0; i < ST_COUNT; i++) {
+		const uint32_t cycles = wcet_cycles[i];
+		if (cycles == 0) continue;
+		const uint32_t us = cycles / mhz;
+		const bool over = (us > ELS_WCET_BUDGET_US);
+		if (over && !wcet_over) {
+			Serial.printf("[ELS] WCET %s %lu us exceeds budget %lu us\n",
+				STATE_TABLE[i].name, (unsigned long)us, (unsigned long)ELS_WCET_BUDGET_US);
+		}
+		if (over) wcet_over = true;
+	}
+#if DEBUG_SPI_LOGGING
+	Serial.printf("[ELS] WCET cycles: IDLE %lu JOG %lu WAIT %lu SYNCED %lu FAULT %lu\n",
+		(unsigned long)wcet_cycles[ST_IDLE], (unsigned long)wcet_cycles[ST_JOG],
+		(unsigned long)wcet_cycles[ST_WAIT_SYNC], (unsigned long)wcet_cycles[ST_SYNCED],
+		(unsigned long)wcet_cycles[ST_FAULT]);
+#endif
+}
+
+void ElsCore::resetWcet() {
+	for (int i = 0; i < ST_COUNT; i++) wcet_cycles[i] = 0;
+	wcet_over = false;
+}
+
+void ElsCore::faultStop() {
+	enabled = false;
+	fault = true;
+	endstop_triggered = true;
+	env_state = ENV_IDLE;  // No ramp-down past a limit
+	track_valid = false;
+}
+
+// ============================================================================
+// Engage/disengage envelope
+// Ramp up: the output speed chases the gear rate plus the speed that closes
+// the deficit braking at half the limit (sqrt(a d)), changing by at most
+// ELS_ENGAGE_ACCEL. The deficit is just step_debt, so once it is gone and
+// the speeds match the envelope locks and the gear passes straight through
+// with no net error. Ramp down decelerates from the last speed to zero.
+// ============================================================================
+int32_t ElsCore::gearRateSps() {
+	const int64_t cps = spindleCountsPerSec();
+	return (int32_t)(cps * (int64_t)pitch_um * (int64_t)ELS_STEPS_PER_REV * (int64_t)direction_mul /
+					 ((int64_t)C_COUNTS_PER_REV * (int64_t)ELS_LEADSCREW_PITCH_UM));
+}
+
+void ElsCore::beginRampUp(uint32_t t_us) {
+	if (!ELS_ENGAGE_RAMP) {
+		env_state = ENV_LOCKED;
+		return;
+	}
+	// Re-engaging during a ramp-down keeps the speed Z still has, and the
+	// time it last stepped at it
+	if (env_state != ENV_RAMP_DOWN) {
+		env_sps = 0;
+		env_acc = 0;
+		env_last_us = t_us;
+	}
+	env_state = ENV_RAMP_UP;
+}
+
+void ElsCore::beginRampDown() {
+	if (!ELS_ENGAGE_RAMP) {
+		env_state = ENV_IDLE;
+		return;
+	}
+	if (env_state == ENV_LOCKED) {
+		env_sps = gearRateSps();
+		env_acc = 0;
+	}
+	env_state = ENV_RAMP_DOWN;
+}
+
+static inline int32_t envelope_dt_us(uint32_t t_us, uint32_t &last_us) {
+	uint32_t dt_us = t_us - last_us;
+	last_us = t_us;
+	if (dt_us > 10000) dt_us = 10000;
+	return (int32_t)dt_us;
+}
+
+int32_t ElsCore::rampUpSteps(int32_t owed, uint32_t t_us) {
+	const int32_t dt_us = envelope_dt_us(t_us, env_last_us);
+	int32_t dv = (int32_t)(((int64_t)ELS_ENGAGE_ACCEL * dt_us) / 1000000);
+	if (dv < 1) dv = 1;
+
+	// Deficit left once this cycle has gone out at the current speed; a
+	// step either way is within the gear's own phase and is not chased.
+	// The closing speed brakes at half the limit (sqrt(a d)): a speed that
+	// lands a little above that curve can still get back onto it, where
+	// one braking at the full limit would run out of deficit still too fast.
+	const int32_t v_gear = gearRateSps();
+	const int32_t deficit = owed - (int32_t)(((int64_t)env_sps * dt_us) / 1000000);
+	const int32_t abs_deficit = (deficit < 0) ? -deficit : deficit;
+	const int32_t close = (abs_deficit > 1)
+		? (int32_t)sqrtf((float)ELS_ENGAGE_ACCEL * (float)abs_deficit) : 0;
+	int64_t v_cmd = (int64_t)v_gear + ((deficit < 0) ? -close : close);
+	if (v_cmd > ELS_STEPPER_MAX_SPS) v_cmd = ELS_STEPPER_MAX_SPS;
+	if (v_cmd < -ELS_STEPPER_MAX_SPS) v_cmd = -ELS_STEPPER_MAX_SPS;
+
+	int64_t dvv = v_cmd - env_sps;
+	if (dvv > dv) dvv = dv;
+	if (dvv < -dv) dvv = -dv;
+	env_sps += (int32_t)dvv;
+
+	env_acc += (int64_t)env_sps * dt_us;
+	int32_t n = (int32_t)(env_acc / 1000000);
+	env_acc -= (int64_t)n * 1000000;
+	// Not held to what is owed: re-engaged during a ramp-down Z may still
+	// be running ahead of the gear (or the other way), and a deficit gone
+	// negative just brakes it back within the limit
+
+	const int32_t left = owed - n;
+	const int32_t v_err = env_sps - v_gear;
+	if (left >= -1 && left <= 1 && v_err >= -dv && v_err <= dv) {
+		env_state = ENV_LOCKED;
+		return owed;
+	}
+	return n;
+}
+
+int32_t ElsCore::rampDownSteps(uint32_t t_us) {
+	const int32_t dt_us = envelope_dt_us(t_us, env_last_us);
+	int32_t dv = (int32_t)(((int64_t)ELS_ENGAGE_ACCEL * dt_us) / 1000000);
+	if (dv < 1) dv = 1;
+
+	if (env_sps > dv) env_sps -= dv;
+	else if (env_sps < -dv) env_sps += dv;
+	else env_sps = 0;
+
+	env_acc += (int64_t)env_sps * dt_us;
+	const int32_t n = (int32_t)(env_acc / 1000000);
+	env_acc -= (int64_t)n * 1000000;
+	if (env_sps == 0) {
+		env_acc = 0;
+		env_state = ENV_IDLE;
+	}
+	return n;
+}
+
+// ============================================================================
+// Sync engagement
+// ============================================================================
+void ElsCore::beginSyncWait() {
+	sync_waiting = true;
+	sync_catchup = false;
+	sync_wait_start_ms = millis();
+}
+
+// ============================================================================
+// Thread model
+// While in sync, every cycle records where the helix is: commanded steps plus
+// step_debt and the gear phase, against last_spindle_pos. After a jog, MPG
+// move, disable or reversal, the commanded step count says exactly where Z
+// went, so the offset from the helix is known without waiting for a crossing.
+// Whole pitches of it are a different turn of the same thread; only the
+// remainder needs a catch-up move.
+// ============================================================================
+void ElsCore::snapshotTrack() {
+	track_spindle = last_spindle_pos;
+	track_steps = Stepper::getCommanded() + step_debt;
+	track_frac = (int64_t)gear.getRemainder() * (TRACK_DEN / gear.getDenominator());
+	track_dir = direction_mul;
+	track_pitch_um = pitch_um;
+	track_valid = true;
+}
+
+bool ElsCore::engageFromTrack(uint32_t t_us, int64_t spindle_now, int64_t spindle_led, int32_t z_um) {
+	sync_detached = false;
+	if (!ELS_SYNC_KEEP_PHASE || !track_valid || track_pitch_um != pitch_um) return false;
+	if (direction_mul != track_dir) {
+		// Reversed off the thread (retract): run free, keep the model
+		sync_detached = true;
+		return true;
+	}
+
+	const int64_t num = (int64_t)pitch_um * (int64_t)ELS_STEPS_PER_REV * (int64_t)direction_mul;
+	const int64_t pitch_scaled = ((num < 0) ? -num : num) * SUBCOUNTS_PER_REV;
+
+	// Z now vs. the helix at spindle_led, in steps * TRACK_DEN. Whole
+	// spindle turns only move the helix by whole pitches, so drop them first.
+	const int64_t turns_off = (spindle_led - track_spindle) % SUBCOUNTS_PER_REV;
+	int64_t off = (int64_t)(Stepper::getCommanded() - track_steps) * TRACK_DEN - track_frac - turns_off * num;
+	off %= pitch_scaled;
+	if (off > pitch_scaled / 2) off -= pitch_scaled;
+	else if (off <= -pitch_scaled / 2) off += pitch_scaled;
+
+	const int64_t abs_off = (off < 0) ? -off : off;
+	const int64_t max_off = (int64_t)ELS_SYNC_CATCHUP_MAX_UM * ELS_STEPS_PER_REV * TRACK_DEN / ELS_LEADSCREW_PITCH_UM;
+	if (abs_off > max_off) {
+		track_valid = false;  // Too far to catch up: wait for the crossing
+		return false;
+	}
+
+	// Owe the gear -off: whole steps go to the catch-up move, the fraction
+	// becomes the gear phase
+	int64_t owed = -off;
+	int64_t whole = owed / TRACK_DEN;
+	int64_t frac = owed % TRACK_DEN;
+	if (frac < 0) {
+		frac += TRACK_DEN;
+		whole -= 1;
+	}
+	resetGearPhase();
+	gear.setPhase((int32_t)(frac / (TRACK_DEN / gear.getDenominator())));
+	last_spindle_pos = spindle_led;
+	last_z_um = z_um;
+	// Z is on the helix where the spindle was off / num sub-counts from now
+	sync_ref_z_um = z_um;
+	sync_ref_spindle = spindle_now + off / num;
+	catchup_left = (int32_t)whole;
+	catchup_sps = 0;
+	catchup_acc = 0;
+	catchup_last_us = t_us;
+	sync_catchup = true;
+	return true;
+}
+
+void ElsCore::recordSyncEngage() {
+	const uint32_t ms = millis() - sync_wait_start_ms;
+	sync_engage_ms = (ms > UINT16_MAX) ? UINT16_MAX : (uint16_t)ms;
+}
+
+// Trapezoidal catch-up on top of the locked gear: accelerate at
+// ELS_SYNC_CATCHUP_ACCEL up to ELS_SYNC_CATCHUP_MAX_SPS, held to the speed
+// that still stops in what is left. Returns signed steps due now.
+int32_t ElsCore::catchupAdvance(uint32_t t_us) {
+	uint32_t dt_us = t_us - catchup_last_us;
+	catchup_last_us = t_us;
+	if (catchup_left == 0) return 0;
+	if (dt_us > 10000) dt_us = 10000;
+
+	const int32_t left = (catchup_left < 0) ? -catchup_left : catchup_left;
+	int32_t dv = (int32_t)(((int64_t)ELS_SYNC_CATCHUP_ACCEL * dt_us) / 1000000);
+	if (dv < 1) dv = 1;
+	// What is left net of the part step already accumulated, and the speed
+	// that brakes to rest over it with the speed applied a cycle at a time
+	// (v^2 / 2a + v dv / 2a = left). Braking on left alone lands the last
+	// step still at speed and stops dead.
+	const int64_t rem = (int64_t)left * 1000000 - catchup_acc;
+	const float stop_sq = 2.0f * (float)ELS_SYNC_CATCHUP_ACCEL * (float)rem / 1e6f + 0.25f * (float)dv * (float)dv;
+	int32_t v_stop = (int32_t)(sqrtf(stop_sq) - 0.5f * (float)dv);
+	if (v_stop < dv) v_stop = dv;  // Creep in rather than stall
+	const int32_t v_cmd = (v_stop < ELS_SYNC_CATCHUP_MAX_SPS) ? v_stop : ELS_SYNC_CATCHUP_MAX_SPS;
+	if (catchup_sps < v_cmd) catchup_sps = (v_cmd - catchup_sps > dv) ? catchup_sps + dv : v_cmd;
+	else if (catchup_sps > v_cmd) catchup_sps = (catchup_sps - v_cmd > dv) ? catchup_sps - dv : v_cmd;
+
+	// Step-microseconds, so slow speeds still accumulate to whole steps
+	catchup_acc += (int64_t)catchup_sps * dt_us;
+	int32_t n = (int32_t)(catchup_acc / 1000000);
+	if (n > left) n = left;
+	catchup_acc -= (int64_t)n * 1000000;
+	if (n == left) {
+		catchup_sps = 0;
+		catchup_acc = 0;
+	}
+	const int32_t steps = (catchup_left < 0) ? -n : n;
+	catchup_left -= steps;
+	return steps;
+}
+
+#if ELS_DRIVE_MODE == ELS_DRIVE_EDGE
+// ============================================================================
+// Edge-driven stepping
+// The task arms a window [lo, hi] around the last serviced spindle count from
+// the gear's exact counts-to-next-step. The edge ISR only compares against it,
+// so the task is woken once per Z step rather than once per spindle edge.
+// The ISR sees the 32-bit wrapping count, so the window is kept as offsets
+// from the low word of the 64-bit position it was armed at.
+// ============================================================================
+static inline int32_t clamp_offset(int64_t v) {
+	if (v > INT32_MAX) return INT32_MAX;
+	if (v < INT32_MIN) return INT32_MIN;
+	return (int32_t)v;
+}
+
+void ElsCore::armEdgeWake() {
+	int32_t lo = INT32_MIN;
+	int32_t hi = INT32_MAX;
+	uint32_t ref = edge_wake_ref;
+	if (enabled && state != ST_JOG && (!sync_enabled || sync_in || sync_catchup || sync_detached)) {
+		// The gear runs on led sub-counts, the ISR sees raw counts
+		const int64_t base = last_spindle_pos - spindle_lead;
+		const int64_t base_count = base >> ELS_SUBCOUNT_BITS;
+		const int32_t up = gear.countsToNextStep(true);
+		const int32_t down = gear.countsToNextStep(false);
+		ref = (uint32_t)base_count;
+		if (up != INT32_MAX) {
+			hi = clamp_offset(((base + up + SUBCOUNTS_PER_COUNT - 1) >> ELS_SUBCOUNT_BITS) - base_count);
+		}
+		if (down != INT32_MAX) {
+			lo = clamp_offset(((base - down) >> ELS_SUBCOUNT_BITS) - base_count);
+		}
+	}
+	// Disarmed while the window moves, so the ISR never pairs a new
+	// reference with old bounds
+	edge_wake_lo = INT32_MIN;
+	edge_wake_hi = INT32_MAX;
+	edge_wake_ref = ref;
+	edge_wake_lo = lo;
+	edge_wake_hi = hi;
+}
+
+void IRAM_ATTR ElsCore::onSpindleEdge(int32_t count) {
+	const int32_t d = (int32_t)((uint32_t)count - edge_wake_ref);
+	if (d > edge_wake_lo && d < edge_wake_hi) return;
+
+	// Disarm until the task has serviced this step and re-armed
+	edge_wake_lo = INT32_MIN;
+	edge_wake_hi = INT32_MAX;
+	if (!edge_stamp_pending) {
+		edge_stamp_us = (uint32_t)esp_timer_get_time();
+		edge_stamp_pending = true;
+	}
+
+	const TaskHandle_t task = edge_wake_task;
+	if (task == nullptr) return;
+	BaseType_t woken = pdFALSE;
+	vTaskNotifyGiveFromISR(task, &woken);
+	if (woken == pdTRUE) portYIELD_FROM_ISR();
+}
+#endif
+
+#if SPINDLE_MODE == SPINDLE_MODE_ENCODER
+void ElsCore::rebaseSpindle(int32_t counts) {
+	const int64_t d = (int64_t)counts * SUBCOUNTS_PER_COUNT;
+	last_spindle_pos += d;
+	sync_ref_spindle += d;
+	sync_prev_pos += d;
+	sync_prev_target = -1;
+	track_spindle += d;
+}
+#endif
+
+#if ELS_DRIVE_MODE == ELS_DRIVE_COUPLED
+// ============================================================================
+// Coupled stepping: back from the synthesizer, the gear carries on from
+// where it was run to, and steps it gave that no slot took are owed
+// ============================================================================
+void ElsCore::decouple() {
+	if (!coupled) return;
+	int64_t pos;
+	int32_t owed;
+	SpindleStepper::decouple(pos, owed);
+	coupled = false;
+	step_debt += owed;
+	coupled_hold = (pos > last_spindle_pos) ? 1 : (pos < last_spindle_pos) ? -1 : 0;
+	last_spindle_pos = pos;
+	last_step_us = micros();
+}
+#endif
+
+#if ELS_DRIVE_MODE == ELS_DRIVE_TIMER
+// ============================================================================
+// Timer-driven stepping
+// ============================================================================
+void ElsCore::disarmTick() {
+	portENTER_CRITICAL(&tick_mux);
+	tick_armed = false;
+	portEXIT_CRITICAL(&tick_mux);
+}
+
+void IRAM_ATTR ElsCore::tick() {
+	portENTER_CRITICAL_ISR(&tick_mux);
+	if (tick_armed) {
+		const int64_t pos = spindleFineLead();
+		const int32_t delta = (int32_t)(pos - last_spindle_pos);
+		last_spindle_pos = pos;
+		const int32_t steps = step_debt + gear.advance(delta);
+		if (steps != 0) {
+			int32_t n = steps;
+			if (n > ELS_TIMER_MAX_STEPS_PER_TICK) n = ELS_TIMER_MAX_STEPS_PER_TICK;
+			if (n < -ELS_TIMER_MAX_STEPS_PER_TICK) n = -ELS_TIMER_MAX_STEPS_PER_TICK;
+			step_debt = steps - Stepper::queueFromIsr(n, tick_span_us);
+		}
+	}
+	portEXIT_CRITICAL_ISR(&tick_mux);
+}
+#endif
+
+// ============================================================================
+// Gear ratio: steps per spindle sub-count, as an exact fraction
+// steps = spindle_subcounts * pitch_um * ELS_STEPS_PER_REV * direction_mul
+//         / (SUBCOUNTS_PER_REV * ELS_LEADSCREW_PITCH_UM)
+// ============================================================================
+void ElsCore::updateGearRatio() {
+	gear_dirty = false;
+	const int64_t num = (int64_t)pitch_um * (int64_t)ELS_STEPS_PER_REV * (int64_t)direction_mul;
+	const int64_t den = (int64_t)SUBCOUNTS_PER_REV * (int64_t)ELS_LEADSCREW_PITCH_UM;
+	gear.setRatio(num, den, ELS_SUBCOUNT_BITS);
+}
+
+// ============================================================================
+// Boot-time benchmark (ELS_GEAR_BENCHMARK): legacy 16-bit FP path vs exact
+// gear, fed the same simulated spindle on the sub-count scale ElsCore uses.
+// Reports CPU cycles per update and cumulative step error against the exact
+// closed-form step count. test/test_els_gear checks the gear's exactness on
+// the host over far longer runs.
+// ============================================================================
+void ElsCore::runGearBenchmark() {
+	static constexpr int32_t BENCH_PITCH_UM = 1270;  // 20 TPI, not a power-of-two ratio
+	// 3000 RPM sampled at 1 kHz, sub-counts
+	static constexpr int32_t BENCH_DELTA = (int32_t)((int64_t)3000 * SUBCOUNTS_PER_REV / 60 / 1000);
+	const int64_t num = (int64_t)BENCH_PITCH_UM * (int64_t)ELS_STEPS_PER_REV;
+	const int64_t den = (int64_t)SUBCOUNTS_PER_REV * (int64_t)ELS_LEADSCREW_PITCH_UM;
+	const int64_t updates = (int64_t)ELS_GEAR_BENCH_REVS * SUBCOUNTS_PER_REV / BENCH_DELTA;
+
+	// Read through a volatile so the compiler can't hoist the per-update math
+	volatile int32_t delta_in = BENCH_DELTA;
+
+	// Legacy path (as ElsCore::update did before the gear)
+	int64_t legacy_acc = 0;
+	int64_t legacy_steps = 0;
+	uint32_t t0 = esp_cpu_get_cycle_count();
+	for (int64_t i = 0; i < updates; i++) {
+		const int64_t step_delta_fp = (int64_t)delta_in * num * FP_SCALE / den;
+		legacy_acc += step_delta_fp;
+		const int32_t steps = (int32_t)(legacy_acc / FP_SCALE);
+		legacy_acc -= (int64_t)steps * FP_SCALE;
+		legacy_steps += steps;
+	}
+	const uint32_t legacy_cycles = esp_cpu_get_cycle_count() - t0;
+
+	ElsGear bench;
+	bench.setRatio(num, den, ELS_SUBCOUNT_BITS);
+	int64_t gear_steps = 0;
+	t0 = esp_cpu_get_cycle_count();
+	for (int64_t i = 0; i < updates; i++) {
+		gear_steps += bench.advance(delta_in);
+	}
+	const uint32_t gear_cycles = esp_cpu_get_cycle_count() - t0;
+
+	const int64_t exact_steps = updates * (int64_t)BENCH_DELTA * num / den;
+	Serial.printf("[ELS] Gear bench: %ld revs, %lld updates\n",
+		(long)ELS_GEAR_BENCH_REVS, (long long)updates);
+	Serial.printf("[ELS]   legacy: %lu cyc/update, error %lld steps\n",
+		(unsigned long)(legacy_cycles / (uint32_t)updates), (long long)(legacy_steps - exact_steps));
+	Serial.printf("[ELS]   gear:   %lu cyc/update, error %lld steps\n",
+		(unsigned long)(gear_cycles / (uint32_t)updates), (long long)(gear_steps - exact_steps));
 }
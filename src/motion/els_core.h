@@ -1,6 +1,14 @@
 #pragma once
 
 #include <stdint.h>
+#include "config_motion.h"
+#include "els_gear.h"
+#include "jog_profile.h"
+
+#if ELS_DRIVE_MODE == ELS_DRIVE_EDGE
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#endif
 
 // ============================================================================
 // Electronic Leadscrew Core Logic
@@ -12,38 +20,100 @@ public:
     static void init();
     static void update();  // Called from high-priority motion task
     
-    // Enable/disable ELS
+    // The setters below only latch a request (SPI loop on core 0, or the
+    // motion task ahead of update()); update() applies it, so the gear and
+    // spindle state are only ever written from the motion task.
+
+    // Enable/disable ELS. A change of request is acted on, so a request left
+    // on doesn't re-enable the ELS after it stopped itself (endstop).
     static bool isEnabled() { return enabled; }
-    static void setEnabled(bool on);
+    static void setEnabled(bool on) { enable_req = on; }
     
     // Thread pitch in microns per spindle revolution
-    static void setPitchUm(int32_t pitch);
+    static void setPitchUm(int32_t pitch) { pitch_req = pitch; }
     static int32_t getPitchUm() { return pitch_um; }
     
     // Direction multiplier (+1 normal, -1 reversed for jog)
-    static void setDirectionMul(int8_t mul);
+    static void setDirectionMul(int8_t mul) { direction_req = (mul < 0) ? -1 : 1; }
+    static int8_t getDirectionMul() { return direction_mul; }
 
     // Sync helper (phase-lock to spindle based on Z=0/C=0 reference)
     static void setSync(bool enabled, int32_t z_um, int32_t c_ticks);
     static bool isSyncWaiting() { return sync_waiting; }
     static bool isSyncEnabled() { return sync_enabled; }
     static bool isSyncIn() { return sync_in; }
+    static bool isSyncCatchingUp() { return sync_catchup; }
+    // Time from the start of the last sync wait to lock (ms, saturating)
+    static uint16_t getSyncEngageMs() { return sync_engage_ms; }
 
-	// Jog control (constant feed, ignores spindle)
+	// Jog control (ELS_JOG_MM_PER_MIN through the jog profile, ignores
+	// spindle); on release Z ramps down and the jog ends once stopped
 	static void setJog(int8_t dir, bool active);
 	static bool isJogActive() { return jog_active; }
     
-    // Software endstops (in raw Z encoder microns)
+    // Software endstops (in raw Z encoder microns). Every Z motion source
+    // brakes to land on them: the ELS hands Z to the jog profile once the
+    // stopping distance reaches a limit (and latches the endstop fault),
+    // jogs and MPG moves are bounded by endstopRoom().
     static void setEndstops(int32_t min_um, int32_t max_um, bool min_en, bool max_en);
+    // Steps Z can still go towards the max (forward) or min endstop from
+    // where the steps already queued take it; INT32_MAX if that one is off
+    static int32_t endstopRoom(bool forward);
     
     // Fault/status
     static bool hasFault() { return fault; }
     static bool endstopTriggered() { return endstop_triggered; }
     static void clearFault() { fault = false; endstop_triggered = false; }
+    // Disabled and no longer moving Z (endstop landing, ramp-down done)
+    static bool isStopped() { return !enabled && state != ST_JOG && env_state == ENV_IDLE; }
+
+    // Control state, one handler each (see STATE_TABLE)
+    enum State : uint8_t { ST_IDLE, ST_JOG, ST_WAIT_SYNC, ST_SYNCED, ST_FAULT, ST_COUNT };
+    static State getState() { return state; }
+
+    // Worst-case handler time per state (ELS_WCET_MEASURE), CPU cycles
+    static uint32_t getWcetCycles(State s) { return wcet_cycles[s]; }
+    // Some state has exceeded ELS_WCET_BUDGET_US (latched until resetWcet())
+    static bool isWcetOverBudget() { return wcet_over; }
+    static void resetWcet();
+
+    // Serial reporting (debug counters, WCET), call from loop()
+    static void reportUpdate();
+
+#if ELS_DRIVE_MODE == ELS_DRIVE_EDGE
+	// Edge-driven stepping: spindle edge ISR wakes this task when a step is due
+	static void setEdgeWakeTask(TaskHandle_t task) { edge_wake_task = task; }
+	static void onSpindleEdge(int32_t count);  // ISR context
+
+	// Worst-case spindle edge -> step output latency (us) since last reset
+	static uint32_t getEdgeLatencyMaxUs() { return edge_latency_max_us; }
+	static void resetEdgeLatency() { edge_latency_max_us = 0; }
+#endif
+
+#if ELS_DRIVE_MODE == ELS_DRIVE_TIMER
+	// Timer drive: called from the ElsTimer ISR, advances the gear from the
+	// live spindle count and queues the steps (only while update() allows it)
+	static void tick();
+#endif
     
 private:
     static bool enabled;
     static bool fault;
+
+    // Requests from the setters, applied by applyRequests()
+    static volatile bool enable_req;
+    static bool enable_applied;         // enable_req as last acted on
+    static volatile int32_t pitch_req;
+    static volatile int8_t direction_req;
+    static volatile bool sync_req_pending;
+    static bool sync_req_enabled;       // Under request_mux with the two below
+    static int32_t sync_req_z_um;
+    static int32_t sync_req_c_ticks;
+    static void applyRequests();
+    static void applyEnabled(bool on);
+    static void applyPitchUm(int32_t pitch);
+    static void applyDirectionMul(int8_t mul);
+    static void applySync(bool on, int32_t z_um, int32_t c_ticks);
     static bool endstop_triggered;
     
     static int32_t pitch_um;
@@ -54,8 +124,13 @@ private:
     static bool endstop_min_enabled;
     static bool endstop_max_enabled;
     
-    static int32_t last_spindle_count;
-    static int64_t step_accumulator;  // Fixed-point accumulator for sub-step precision
+    static int64_t last_spindle_pos;    // Sub-counts, ELS_LEAD_US ahead
+    static int64_t spindle_lead;        // Lead distance at the last process()
+    static ElsGear gear;                // Exact spindle->step ratio + sub-step phase
+    static volatile bool gear_dirty;    // Pitch/direction changed, re-reduce ratio
+    static int32_t step_debt;           // Gear steps the step queue hasn't taken yet
+    static uint32_t last_step_us;       // Start of the span the next batch covers
+    static void resetGearPhase() { gear.reset(); step_debt = 0; sync_prev_target = -1; }
 
     static bool sync_enabled;
     static bool sync_waiting;
@@ -64,13 +139,122 @@ private:
     static int32_t sync_phase_ticks;  // Reference C0 (raw ticks)
     static int32_t sync_tolerance_out_um;
     static int32_t sync_ref_z_um;
-    static int32_t sync_ref_spindle;
+    static int64_t sync_ref_spindle;  // Sub-counts, at the crossing point
+    static int32_t sync_prev_err;     // Last phase error sample while waiting
+    static int32_t sync_prev_target;  // Its target phase (-1 = no sample)
+    static int64_t sync_prev_pos;
+    static uint32_t sync_wait_start_ms;
+    static uint16_t sync_engage_ms;
+    static volatile bool sync_catchup;  // Fast engage: gear locked, catch-up move running
+    static int32_t catchup_left;        // Signed steps still to add
+    static int32_t catchup_sps;         // Current catch-up speed, steps/s
+    static int64_t catchup_acc;         // Step-microseconds not yet output
+    static uint32_t catchup_last_us;
+    static void beginSyncWait();
+    static void recordSyncEngage();
+    static int32_t catchupAdvance(uint32_t t_us);
+
+    // Thread model kept across jogs, MPG moves and direction reversals: a
+    // point on the helix Z was last locked to, as commanded stepper steps
+    // (+ track_frac / TRACK_DEN) at led spindle sub-counts. Z moves made in
+    // between are all in Stepper::getCommanded(), so re-engaging is exact.
+    static bool track_valid;
+    static int8_t track_dir;          // direction_mul the helix was cut with
+    static int32_t track_pitch_um;
+    static int64_t track_spindle;
+    static int32_t track_steps;
+    static int64_t track_frac;
+    static bool sync_detached;        // Running reversed, model kept
+    static void snapshotTrack();
+    static bool engageFromTrack(uint32_t t_us, int64_t spindle_now, int64_t spindle_led, int32_t z_um);
+#if SPINDLE_MODE == SPINDLE_MODE_ENCODER
+    static void rebaseSpindle(int32_t counts);  // Index re-home: same angle, new count
+#endif
+
+    // Engage/disengage envelope between the gear and the stepper
+    enum EnvState : uint8_t { ENV_IDLE, ENV_RAMP_UP, ENV_LOCKED, ENV_RAMP_DOWN };
+    static EnvState env_state;
+    static int32_t env_sps;             // Envelope output speed, steps/s
+    static int64_t env_acc;             // Step-microseconds not yet output
+    static uint32_t env_last_us;
+    static int32_t gearRateSps();       // Spindle-locked Z speed, steps/s
+    static void beginRampUp(uint32_t t_us);
+    static void beginRampDown();
+    static int32_t rampUpSteps(int32_t owed, uint32_t t_us);
+    static int32_t rampDownSteps(uint32_t t_us);
+    static void faultStop();
 	static int32_t last_z_um;
 	static volatile bool jog_active;
 	static volatile int8_t jog_dir;
-	static bool jog_prev_active;
 	static uint32_t jog_last_us;
-	static int64_t jog_step_accumulator;
+	static JogProfile jog_profile;  // Z off the gear: jogs, endstop landing
+	static int32_t land_sps;        // Endstop landing speed, 0 = none
+
+#if SPINDLE_MODE == SPINDLE_MODE_STEPPER
+	static bool thread_end;         // Spindle ramping down onto the Z limit, or held there
+	static volatile bool thread_end_report;  // Stop taken, for reportUpdate()
+	static int64_t thread_end_pos;           // Spindle step it stops on
+	static int8_t thread_end_dir;            // The way the spindle ran into it
+	static bool threadEndStop(int32_t room);
+#endif
+
+#if ELS_DRIVE_MODE == ELS_DRIVE_EDGE
+	static TaskHandle_t edge_wake_task;
+	static volatile uint32_t edge_wake_ref;    // Raw count the window is relative to
+	static volatile int32_t edge_wake_lo;      // Wake when count - ref <= lo or >= hi
+	static volatile int32_t edge_wake_hi;
+	static volatile bool edge_stamp_pending;
+	static volatile uint32_t edge_stamp_us;    // Time of the edge that woke us
+	static uint32_t edge_latency_max_us;
+	static void armEdgeWake();
+#endif
+
+#if ELS_DRIVE_MODE == ELS_DRIVE_COUPLED
+	static bool coupled;              // Gear owned by the spindle synthesizer
+	static int8_t coupled_hold;       // Spindle direction until it reaches last_spindle_pos
+	static void decouple();
+#endif
+
+#if ELS_DRIVE_MODE == ELS_DRIVE_TIMER
+	static volatile bool tick_armed;  // Gear + last_spindle_pos owned by tick()
+	static uint32_t tick_span_us;     // Step spread per timer tick
+	static void disarmTick();
+#endif
+
+    // Per-cycle state machine: process() picks the state, runs the
+    // transition work when it changes, then the state's handler
+    struct Sample {
+        uint32_t t_us;
+        int64_t spindle_now;  // Sub-counts at t_us
+        int64_t spindle_led;  // Sub-counts ELS_LEAD_US ahead
+        int32_t z_um;
+    };
+    struct StateInfo {
+        const char *name;
+        void (*handler)();
+    };
+    static const StateInfo STATE_TABLE[ST_COUNT];
+    static State state;
+    static uint32_t wcet_cycles[ST_COUNT];  // Max handler cycles per state
+    static volatile bool wcet_over;
+#if DEBUG_SPI_LOGGING
+    static volatile int32_t dbg_spindle_delta;  // Summed for reportUpdate()
+    static volatile int32_t dbg_steps_output;
+#endif
+    static State selectState();
+    static void enterState(State next);
+    static void handleIdle();
+    static void handleJog();
+    static void handleWaitSync();
+    static void handleSynced();
+    static void handleFault();
+    static Sample takeSample();
+    static void holdForSync(const Sample &s);
+    static void driveGear(const Sample &s);
 
-    static bool checkEndstops(int32_t z_um);
+    static void process();
+    static bool checkEndstops(int32_t z_um, int32_t sps);
+    static int32_t envSps();
+    static void updateGearRatio();
+    static void runGearBenchmark();
 };
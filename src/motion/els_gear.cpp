@@ -0,0 +1,121 @@
+#include "els_gear.h"
+#include "esp_attr.h"
+
+static int64_t gcd64(int64_t a, int64_t b) {
+    if (a < 0) a = -a;
+    if (b < 0) b = -b;
+    while (b != 0) {
+        const int64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Floor division so the remainder is always non-negative
+static void floor_divmod(int64_t n, int64_t d, int64_t &q, int64_t &r) {
+    q = n / d;
+    r = n % d;
+    if (r < 0) {
+        r += d;
+        q -= 1;
+    }
+}
+
+void ElsGear::setRatio(int64_t num, int64_t den_in, int32_t bits) {
+    sub_bits = (bits < 0) ? 0 : (bits > 16) ? 16 : bits;
+    if (den_in <= 0) {
+        whole = 0;
+        frac = 0;
+        count_whole = 0;
+        count_frac = 0;
+        den = 1;
+        recip = 0xFFFFFFFFu;
+        acc = 0;
+        mag = 0;
+        negative = false;
+        fast_counts = INT32_MAX >> sub_bits;
+        return;
+    }
+
+    const int64_t g = gcd64(num, den_in);
+    if (g > 1) {
+        num /= g;
+        den_in /= g;
+    }
+
+    int64_t q, r;
+    floor_divmod(num, den_in, q, r);
+    int64_t cq, cr;
+    floor_divmod(num * ((int64_t)1 << sub_bits), den_in, cq, cr);
+
+    // Rescale the held phase so a pitch change doesn't jump by a step
+    const int64_t new_acc = ((int64_t)acc * den_in) / (int64_t)den;
+
+    const int64_t abs_num = (num < 0) ? -num : num;
+
+    whole = (int32_t)q;
+    frac = (int32_t)r;
+    count_whole = (int32_t)cq;
+    count_frac = (int32_t)cr;
+    den = (int32_t)den_in;
+    recip = 0xFFFFFFFFu / (uint32_t)den;
+    acc = (int32_t)new_acc;
+    mag = (int32_t)((abs_num < den_in) ? abs_num : den_in);
+    negative = (num < 0);
+
+    // acc + counts * count_frac + sub * frac is below
+    // (counts + 2^sub_bits + 1) * den and must fit in int32
+    fast_counts = (int32_t)((int64_t)INT32_MAX / den_in - (1 << sub_bits) - 1);
+    if (fast_counts < -1) fast_counts = -1;
+}
+
+int32_t ElsGear::countsToNextStep(bool forward) const {
+    if (mag == 0) return INT32_MAX;
+    if (mag >= den) return 1;
+
+    // |ratio| < 1: a positive ratio carries up as acc crosses den, a negative
+    // one (whole = -1, frac = den - mag) borrows as acc drops below mag * n.
+    // Reversing the spindle swaps the two cases.
+    if (forward != negative) {
+        return (den - acc + mag - 1) / mag;
+    }
+    return acc / mag + 1;
+}
+
+// recip is short of 2^32 / den by less than one, so for a < 2^31 the
+// estimate is short of the quotient by at most one
+uint32_t IRAM_ATTR ElsGear::divDen(uint32_t a) const {
+    uint32_t q = (uint32_t)(((uint64_t)a * recip) >> 32);
+    if (a - q * (uint32_t)den >= (uint32_t)den) q++;
+    return q;
+}
+
+int32_t IRAM_ATTR ElsGear::advance(int32_t spindle_delta) {
+    if (spindle_delta == 0) return 0;
+
+    if (!isFastPath(spindle_delta)) {
+        int64_t carry, rem;
+        floor_divmod((int64_t)acc + (int64_t)spindle_delta * (int64_t)frac, den, carry, rem);
+        acc = (int32_t)rem;
+        return spindle_delta * whole + (int32_t)carry;
+    }
+
+    // Whole counts (floor) and the sub-counts left over, in [0, 2^sub_bits)
+    const int32_t counts = spindle_delta >> sub_bits;
+    const int32_t sub = spindle_delta & ((1 << sub_bits) - 1);
+    int32_t steps = counts * count_whole + sub * whole;
+    const int32_t a = acc + counts * count_frac + sub * frac;
+    if (a >= 0) {
+        const uint32_t q = divDen((uint32_t)a);
+        acc = a - (int32_t)(q * (uint32_t)den);
+        steps += (int32_t)q;
+    } else {
+        // floor(a / den) = -(floor((-a - 1) / den)) - 1
+        const uint32_t b = (uint32_t)(-(a + 1));
+        const uint32_t q = divDen(b);
+        acc = den - 1 - (int32_t)(b - q * (uint32_t)den);
+        steps -= (int32_t)q + 1;
+    }
+    return steps;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+
+// ============================================================================
+// Exact rational gear: spindle sub-counts -> stepper steps
+// The ratio is reduced to lowest terms once, when it changes, and split into
+// whole and fractional steps per count and per sub-count. advance() takes a
+// delta as whole counts plus a sub-count part, adds the increments for each
+// and carries the remainder with a reciprocal multiply: O(1), no divide, and
+// no fraction of a step is ever dropped, so there is no long-run drift.
+// ============================================================================
+
+class ElsGear {
+public:
+    // Set ratio as num / den steps per sub-count (den must be > 0), with
+    // 2^sub_bits sub-counts per count. The current sub-step phase is
+    // carried over to the new denominator.
+    void setRatio(int64_t num, int64_t den, int32_t sub_bits = 0);
+
+    // Advance by a signed spindle delta (sub-counts), returns whole steps to output
+    int32_t advance(int32_t spindle_delta);
+
+    // advance() takes the 32-bit divide-free path for this delta; larger ones
+    // (a stalled task catching up) take one exact 64-bit divide instead
+    bool isFastPath(int32_t spindle_delta) const {
+        const int32_t counts = spindle_delta >> sub_bits;
+        return counts <= fast_counts && counts >= -fast_counts;
+    }
+
+    // Sub-counts (>= 1) in the given direction until advance() next
+    // returns a non-zero step count. INT32_MAX if the gear is stopped.
+    int32_t countsToNextStep(bool forward) const;
+
+    // Drop any fractional step (phase = 0)
+    void reset() { acc = 0; }
+
+    // Set the fractional step held, in [0, getDenominator())
+    void setPhase(int32_t phase) { acc = (phase < 0) ? 0 : (phase >= den) ? den - 1 : phase; }
+
+    // Fractional step currently held is getRemainder() / getDenominator()
+    int32_t getRemainder() const { return acc; }
+    int32_t getDenominator() const { return den; }
+
+    // Ratio below zero: steps run against the spindle
+    bool isNegative() const { return negative; }
+
+private:
+    // floor(a / den) for 0 <= a <= INT32_MAX, by the reciprocal
+    uint32_t divDen(uint32_t a) const;
+
+    int32_t whole = 0;        // floor(num / den), steps per sub-count
+    int32_t frac = 0;         // num - whole * den, in [0, den)
+    int32_t count_whole = 0;  // The same per whole count
+    int32_t count_frac = 0;
+    int32_t den = 1;
+    uint32_t recip = 0xFFFFFFFFu;  // floor((2^32 - 1) / den)
+    int32_t acc = 0;          // Sub-step phase, in [0, den)
+    int32_t mag = 0;          // |num| in lowest terms, clamped to den (>= den: every sub-count steps)
+    bool negative = false;
+    int32_t sub_bits = 0;
+    int32_t fast_counts = -1; // Largest |whole counts| for the 32-bit path
+};
@@ -0,0 +1,155 @@
+#include "els_timer.h"
+#include "config_motion.h"
+#include "els_core.h"
+#include "stepper.h"
+#include <Arduino.h>
+
+#if ELS_DRIVE_MODE == ELS_DRIVE_TIMER
+#include "driver/gptimer.h"
+#include "esp_cpu.h"
+
+// Static member initialization
+uint32_t ElsTimer::rate_hz = 0;
+uint32_t ElsTimer::nominal_cycles = 0;
+uint32_t ElsTimer::last_entry_cycles = 0;
+ElsTimer::Stats ElsTimer::stats = {};
+volatile bool ElsTimer::stats_reset = true;
+
+static gptimer_handle_t els_timer = nullptr;
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// ============================================================================
+// Alarm ISR: ELS gear tick into the step queue, with cycle-accurate bookkeeping
+// ============================================================================
+static bool IRAM_ATTR els_timer_on_alarm(gptimer_handle_t timer,
+                                         const gptimer_alarm_event_data_t *edata,
+                                         void *user_ctx) {
+    (void)timer;
+    (void)edata;
+    (void)user_ctx;
+    ElsTimer::onTick();
+    return false;
+}
+
+void IRAM_ATTR ElsTimer::onTick() {
+    const uint32_t entry = esp_cpu_get_cycle_count();
+
+    ElsCore::tick();
+
+    const uint32_t isr_cycles = esp_cpu_get_cycle_count() - entry;
+    const int32_t backlog = Stepper::getBacklog();
+
+    portENTER_CRITICAL_ISR(&stats_mux);
+    if (stats_reset) {
+        stats = {};
+        stats_reset = false;
+    } else {
+        const uint32_t period = entry - last_entry_cycles;
+        const uint32_t jitter = (period > nominal_cycles) ? (period - nominal_cycles)
+                                                          : (nominal_cycles - period);
+        if (jitter > stats.jitter_max_cycles) stats.jitter_max_cycles = jitter;
+        stats.jitter_sum_cycles += jitter;
+        stats.ticks++;
+    }
+    if (isr_cycles > stats.isr_max_cycles) stats.isr_max_cycles = isr_cycles;
+    stats.isr_sum_cycles += isr_cycles;
+    if (backlog > stats.backlog_max) stats.backlog_max = backlog;
+    portEXIT_CRITICAL_ISR(&stats_mux);
+
+    last_entry_cycles = entry;
+}
+
+// ============================================================================
+// Initialization
+// ============================================================================
+bool ElsTimer::init(uint32_t rate) {
+    gptimer_config_t timer_config = {};
+    timer_config.clk_src = GPTIMER_CLK_SRC_DEFAULT;
+    timer_config.direction = GPTIMER_COUNT_UP;
+    timer_config.resolution_hz = ELS_TIMER_RES_HZ;
+
+    esp_err_t err = gptimer_new_timer(&timer_config, &els_timer);
+    if (err != ESP_OK) return false;
+
+    // The interrupt is allocated on the calling core
+    gptimer_event_callbacks_t cbs = {};
+    cbs.on_alarm = els_timer_on_alarm;
+    err = gptimer_register_event_callbacks(els_timer, &cbs, nullptr);
+    if (err != ESP_OK) return false;
+
+    err = gptimer_enable(els_timer);
+    if (err != ESP_OK) return false;
+
+    if (!setRate(rate)) return false;
+
+    err = gptimer_start(els_timer);
+    if (err != ESP_OK) return false;
+
+    Serial.printf("[ElsTimer] %lu Hz on core %d\n", (unsigned long)rate_hz, (int)xPortGetCoreID());
+    return true;
+}
+
+bool ElsTimer::setRate(uint32_t rate) {
+    if (els_timer == nullptr || rate == 0) return false;
+
+    gptimer_alarm_config_t alarm_config = {};
+    alarm_config.alarm_count = ELS_TIMER_RES_HZ / rate;
+    alarm_config.reload_count = 0;
+    alarm_config.flags.auto_reload_on_alarm = 1;
+    if (gptimer_set_alarm_action(els_timer, &alarm_config) != ESP_OK) return false;
+
+    rate_hz = rate;
+    nominal_cycles = (uint32_t)((uint64_t)getCpuFrequencyMhz() * 1000000ULL / rate);
+    stats_reset = true;
+    return true;
+}
+
+// ============================================================================
+// Measurement mode
+// ============================================================================
+void ElsTimer::measureUpdate() {
+    static uint32_t window_start_ms = 0;
+    static int64_t window_start_us = 0;
+    static size_t sweep_index = 0;
+
+    const uint32_t now_ms = millis();
+    if (window_start_ms == 0) {
+        setRate(ELS_TIMER_SWEEP_HZ[0]);
+        window_start_ms = now_ms;
+        window_start_us = esp_timer_get_time();
+        stats_reset = true;
+        return;
+    }
+    if (now_ms - window_start_ms < ELS_TIMER_MEASURE_MS) return;
+
+    Stats snap;
+    portENTER_CRITICAL(&stats_mux);
+    snap = stats;
+    portEXIT_CRITICAL(&stats_mux);
+    const int64_t elapsed_us = esp_timer_get_time() - window_start_us;
+
+    const uint32_t mhz = getCpuFrequencyMhz();
+    const float achieved_hz = (elapsed_us > 0) ? (float)snap.ticks * 1e6f / (float)elapsed_us : 0.0f;
+    const uint32_t ticks = (snap.ticks > 0) ? snap.ticks : 1;
+    const float jitter_avg_ns = (float)snap.jitter_sum_cycles * 1000.0f / ((float)ticks * (float)mhz);
+    const float jitter_max_ns = (float)snap.jitter_max_cycles * 1000.0f / (float)mhz;
+    const float isr_avg_us = (float)snap.isr_sum_cycles / ((float)ticks * (float)mhz);
+    const float isr_max_us = (float)snap.isr_max_cycles / (float)mhz;
+    // ISR body only; interrupt entry/exit adds roughly another 1 us per tick
+    const float load_pct = (float)snap.isr_sum_cycles * 100.0f / ((float)elapsed_us * (float)mhz);
+
+    Serial.printf("[ElsTimer] %lu Hz: achieved %.1f Hz, jitter avg %.0f ns max %.0f ns, "
+                  "ISR avg %.2f us max %.2f us, load %.2f%%, backlog max %ld\n",
+        (unsigned long)rate_hz, achieved_hz, jitter_avg_ns, jitter_max_ns,
+        isr_avg_us, isr_max_us, load_pct, (long)snap.backlog_max);
+
+    // Next rate in the sweep
+    static constexpr size_t SWEEP_COUNT = sizeof(ELS_TIMER_SWEEP_HZ) / sizeof(ELS_TIMER_SWEEP_HZ[0]);
+    sweep_index = (sweep_index + 1) % SWEEP_COUNT;
+    setRate(ELS_TIMER_SWEEP_HZ[sweep_index]);
+
+    window_start_ms = millis();
+    window_start_us = esp_timer_get_time();
+}
+
+#endif // ELS_DRIVE_TIMER
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+
+// ============================================================================
+// ELS Timer: dedicated gptimer ISR that services the gear and paces Z steps
+// (ELS_DRIVE_MODE == ELS_DRIVE_TIMER). Independent of the 1 kHz FreeRTOS tick.
+// ============================================================================
+
+class ElsTimer {
+public:
+    // Call from the motion task so the ISR is allocated on core 1
+    static bool init(uint32_t rate_hz);
+
+    static bool setRate(uint32_t rate_hz);
+    static uint32_t getRateHz() { return rate_hz; }
+
+    // Measurement mode (ELS_TIMER_MEASURE): call from loop(); prints achieved
+    // rate, period jitter and ISR load, then steps through ELS_TIMER_SWEEP_HZ
+    static void measureUpdate();
+
+    // Alarm ISR body (gear tick, bookkeeping)
+    static void onTick();
+
+private:
+    struct Stats {
+        uint32_t ticks;
+        uint32_t jitter_max_cycles;   // Worst |period - nominal|
+        uint64_t jitter_sum_cycles;
+        uint32_t isr_max_cycles;      // Worst ISR body time
+        uint64_t isr_sum_cycles;
+        int32_t  backlog_max;         // Worst queued step count
+    };
+
+    static uint32_t rate_hz;
+    static uint32_t nominal_cycles;   // CPU cycles per timer period
+    static uint32_t last_entry_cycles;
+    static Stats stats;
+    static volatile bool stats_reset;
+};
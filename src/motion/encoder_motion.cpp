@@ -2,23 +2,54 @@
 #include "config_motion.h"
 #include <Arduino.h>
 #include "driver/gpio.h"
-
-#if SPINDLE_MODE == SPINDLE_MODE_ENCODER
-#include "driver/pulse_cnt.h"
-#endif
+#include "driver/ledc.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
+#include "pcnt_count.h"
 
 // Static member initialization
-EncoderMotion::QuadAxis EncoderMotion::x_axis = {0, 0, 0, 0, 1};
-EncoderMotion::QuadAxis EncoderMotion::z_axis = {0, 0, 0, 0, 1};
+EncoderMotion::QuadAxis EncoderMotion::x_axis = {0, 0, 0, 0, 1, nullptr, 0, 0, 0, 0, 0, 0};
+EncoderMotion::QuadAxis EncoderMotion::z_axis = {0, 0, 0, 0, 1, nullptr, 0, 0, 0, 0, 0, 0};
+
+// X/Z decode and spindle event interrupt time (ENC_ISR_MEASURE)
+static volatile uint32_t scale_isr_calls = 0;
+static volatile uint32_t scale_isr_cycles = 0;
+static volatile uint32_t spindle_isr_calls = 0;
+static volatile uint32_t spindle_isr_cycles = 0;
 
 #if SPINDLE_MODE == SPINDLE_MODE_ENCODER
-pcnt_unit_handle_t pcnt_unit = nullptr;
-pcnt_channel_handle_t pcnt_chan_a = nullptr;
-pcnt_channel_handle_t pcnt_chan_b = nullptr;
-volatile int32_t EncoderMotion::c_pcnt_accum = 0;
+EncoderMotion::QuadAxis EncoderMotion::c_axis = {0, 0, 0, 0, 1, nullptr, 0, 0, 0, 0, 0, 0};
+EncoderMotion::QuadAxis EncoderMotion::c_rate_axis = {0, 0, 0, 0, 1, nullptr, 0, 0, 0, 0, 0, 0};
 
 int16_t EncoderMotion::rpm_signed = 0;
 int16_t EncoderMotion::rpm_abs = 0;
+SpindleTracker EncoderMotion::spindle_tracker;
+SpindleRate EncoderMotion::spindle_rate;
+volatile EncoderMotion::SpindleEdgeHook EncoderMotion::spindle_edge_hook = nullptr;
+
+// Newest timestamped spindle event, written by onSpindleReach
+static portMUX_TYPE edge_mux = portMUX_INITIALIZER_UNLOCKED;
+static int32_t edge_count = 0;
+static uint32_t edge_us = 0;
+static bool edge_seen = false;
+static uint32_t edge_events = 0;  // For getStats()
+
+// Spindle index (C_PIN_INDEX): PCNT counts at both edges of the newest
+// pulse, written by spindleIndexIsr and taken by updateIndex
+bool EncoderMotion::index_home_allowed = false;
+static portMUX_TYPE index_mux = portMUX_INITIALIZER_UNLOCKED;
+static int32_t index_rise_raw = 0;    // ISR only
+static bool index_rise_seen = false;  // ISR only
+static int32_t index_ev_rise = 0;
+static int32_t index_ev_fall = 0;
+static uint32_t index_ev_seq = 0;
+static uint32_t index_rejected = 0;
+static SpindleIndex spindle_index;  // Stats read from loop() too
+
+// Motion task only, except index_shift, which the edge ISR reads
+static volatile int32_t index_shift = 0;  // Added to the PCNT count
+static uint32_t index_seq_seen = 0;
+static int32_t index_rehome = 0;   // For takeIndexRehome()
 #endif
 
 // ============================================================================
@@ -32,6 +63,7 @@ static inline uint8_t read_ab(uint8_t pin_a, uint8_t pin_b) {
 }
 
 void IRAM_ATTR EncoderMotion::quadIsr(void *arg) {
+    const uint32_t start = ENC_ISR_MEASURE ? esp_cpu_get_cycle_count() : 0;
     QuadAxis *axis = (QuadAxis *)arg;
 
     // Quadrature state machine transition table
@@ -50,82 +82,118 @@ void IRAM_ATTR EncoderMotion::quadIsr(void *arg) {
     const int8_t d = delta_tbl[idx];
     if (d != 0) {
         axis->count += (int32_t)d * (int32_t)axis->dir;
+    } else if ((old_state ^ new_state) == 0x3) {
+        // Both lines changed since the last ISR: an edge was missed and the
+        // direction is unknown, so the count is now off by two
+        axis->illegal++;
+    }
+    if (ENC_ISR_MEASURE) {
+        scale_isr_cycles += esp_cpu_get_cycle_count() - start;
+        scale_isr_calls++;
     }
 }
 
-void EncoderMotion::initLinearAxis(QuadAxis &axis) {
-    pinMode(axis.pin_a, INPUT_PULLUP);
-    pinMode(axis.pin_b, INPUT_PULLUP);
+// ============================================================================
+// PCNT overflow callback (extends 16-bit counter to 32-bit)
+// user_ctx is the QuadAxis whose accumulator the unit's count is folded into.
+// The unit has reset itself; clearing it here would drop the edges since.
+// ============================================================================
 
-    axis.state = read_ab(axis.pin_a, axis.pin_b);
+bool IRAM_ATTR EncoderMotion::onPcntReach(pcnt_unit_handle_t unit,
+                                          const pcnt_watch_event_data_t *edata,
+                                          void *user_ctx) {
+    QuadAxis *axis = (QuadAxis *)user_ctx;
+    axis->count = PcntCount::fold(axis->count, edata->watch_point_value);
+    axis->overflows++;
+    (void)unit;
+    return true;
+}
 
-    attachInterruptArg((int)axis.pin_a, quadIsr, (void *)&axis, CHANGE);
-    attachInterruptArg((int)axis.pin_b, quadIsr, (void *)&axis, CHANGE);
+bool IRAM_ATTR EncoderMotion::onScaleReach(pcnt_unit_handle_t unit,
+                                           const pcnt_watch_event_data_t *edata,
+                                           void *user_ctx) {
+    const uint32_t start = ENC_ISR_MEASURE ? esp_cpu_get_cycle_count() : 0;
+    const bool yield = onPcntReach(unit, edata, user_ctx);
+    if (ENC_ISR_MEASURE) {
+        scale_isr_cycles += esp_cpu_get_cycle_count() - start;
+        scale_isr_calls++;
+    }
+    return yield;
 }
 
 #if SPINDLE_MODE == SPINDLE_MODE_ENCODER
 // ============================================================================
-// PCNT overflow callback (extends 16-bit counter to 32-bit)
+// Spindle speed events: a second PCNT unit on the C pins, its limits
+// +/-SPINDLE_RATE_EVENT_COUNTS, so it reaches one every N counts. Its
+// accumulator after the fold is the count at the event, exactly; it is
+// stamped with the time for SpindleRate. The position stays on c_axis with
+// the wide limits, so this unit's resets never touch it.
 // ============================================================================
 
-static bool IRAM_ATTR pcnt_on_reach(pcnt_unit_handle_t unit,
-                                    const pcnt_watch_event_data_t *edata,
-                                    void *user_ctx) {
-    (void)user_ctx;
-    EncoderMotion::c_pcnt_accum += edata->watch_point_value;
-    pcnt_unit_clear_count(unit);
+bool IRAM_ATTR EncoderMotion::onSpindleReach(pcnt_unit_handle_t unit,
+                                             const pcnt_watch_event_data_t *edata,
+                                             void *user_ctx) {
+    const uint32_t start = ENC_ISR_MEASURE ? esp_cpu_get_cycle_count() : 0;
+    const uint32_t t_us = (uint32_t)esp_timer_get_time();
+    QuadAxis *axis = (QuadAxis *)user_ctx;
+    axis->count = PcntCount::fold(axis->count, edata->watch_point_value);
+    (void)unit;
+    portENTER_CRITICAL_ISR(&edge_mux);
+    edge_count = axis->count;
+    edge_us = t_us;
+    edge_seen = true;
+    edge_events++;
+    portEXIT_CRITICAL_ISR(&edge_mux);
+    if (ENC_ISR_MEASURE) {
+        spindle_isr_cycles += esp_cpu_get_cycle_count() - start;
+        spindle_isr_calls++;
+    }
     return true;
 }
 #endif
 
 // ============================================================================
-// Initialization
+// PCNT x4 quadrature unit: edges on A count by B level, edges on B by A level
+// (inverted mapping), +/- the watch points at the limits for overflow
 // ============================================================================
 
-bool EncoderMotion::init() {
-    // Initialize X axis encoder
-    x_axis.pin_a = X_PINA;
-    x_axis.pin_b = X_PINB;
-    x_axis.count = 0;
-    x_axis.dir = X_INVERT_DIR ? -1 : 1;
-    initLinearAxis(x_axis);
-
-    // Initialize Z axis encoder
-    z_axis.pin_a = Z_PINA;
-    z_axis.pin_b = Z_PINB;
-    z_axis.count = 0;
-    z_axis.dir = Z_INVERT_DIR ? -1 : 1;
-    initLinearAxis(z_axis);
+bool EncoderMotion::initQuadPcnt(QuadAxis &axis, uint32_t glitch_ns, bool scale, bool pullup) {
+    return initQuadUnit(axis, glitch_ns, PCNT_H_LIM, scale ? onScaleReach : onPcntReach, pullup);
+}
 
-#if SPINDLE_MODE == SPINDLE_MODE_ENCODER
-	// Initialize spindle encoder using PCNT hardware
-    pinMode(C_PINA, INPUT_PULLUP);
-    pinMode(C_PINB, INPUT_PULLUP);
+bool EncoderMotion::initQuadUnit(QuadAxis &axis, uint32_t glitch_ns, int16_t limit,
+                                 pcnt_watch_cb_t on_reach, bool pullup) {
+    const int pin_a = axis.pin_a;
+    const int pin_b = axis.pin_b;
+    pinMode(pin_a, pullup ? INPUT_PULLUP : INPUT);
+    pinMode(pin_b, pullup ? INPUT_PULLUP : INPUT);
 
     pcnt_unit_config_t unit_config = {};
-    unit_config.high_limit = PCNT_H_LIM;
-    unit_config.low_limit  = PCNT_L_LIM;
+    unit_config.high_limit = limit;
+    unit_config.low_limit  = -limit;
 
-    esp_err_t err = pcnt_new_unit(&unit_config, &pcnt_unit);
+    pcnt_unit_handle_t unit = nullptr;
+    esp_err_t err = pcnt_new_unit(&unit_config, &unit);
     if (err != ESP_OK) return false;
 
     // Channel A: edges on A, direction from B level
     pcnt_chan_config_t chan_a_config = {};
-    chan_a_config.edge_gpio_num = C_PINA;
-    chan_a_config.level_gpio_num = C_PINB;
+    chan_a_config.edge_gpio_num = pin_a;
+    chan_a_config.level_gpio_num = pin_b;
 
-    err = pcnt_new_channel(pcnt_unit, &chan_a_config, &pcnt_chan_a);
+    pcnt_channel_handle_t chan_a = nullptr;
+    err = pcnt_new_channel(unit, &chan_a_config, &chan_a);
     if (err != ESP_OK) return false;
 
     err = pcnt_channel_set_edge_action(
-        pcnt_chan_a,
+        chan_a,
         PCNT_CHANNEL_EDGE_ACTION_INCREASE,
         PCNT_CHANNEL_EDGE_ACTION_DECREASE
     );
     if (err != ESP_OK) return false;
 
     err = pcnt_channel_set_level_action(
-        pcnt_chan_a,
+        chan_a,
         PCNT_CHANNEL_LEVEL_ACTION_KEEP,
         PCNT_CHANNEL_LEVEL_ACTION_INVERSE
     );
@@ -133,21 +201,22 @@ bool EncoderMotion::init() {
 
     // Channel B: edges on B, direction from A level (inverted mapping)
     pcnt_chan_config_t chan_b_config = {};
-    chan_b_config.edge_gpio_num = C_PINB;
-    chan_b_config.level_gpio_num = C_PINA;
+    chan_b_config.edge_gpio_num = pin_b;
+    chan_b_config.level_gpio_num = pin_a;
 
-    err = pcnt_new_channel(pcnt_unit, &chan_b_config, &pcnt_chan_b);
+    pcnt_channel_handle_t chan_b = nullptr;
+    err = pcnt_new_channel(unit, &chan_b_config, &chan_b);
     if (err != ESP_OK) return false;
 
     err = pcnt_channel_set_edge_action(
-        pcnt_chan_b,
+        chan_b,
         PCNT_CHANNEL_EDGE_ACTION_INCREASE,
         PCNT_CHANNEL_EDGE_ACTION_DECREASE
     );
     if (err != ESP_OK) return false;
 
     err = pcnt_channel_set_level_action(
-        pcnt_chan_b,
+        chan_b,
         PCNT_CHANNEL_LEVEL_ACTION_INVERSE,
         PCNT_CHANNEL_LEVEL_ACTION_KEEP
     );
@@ -155,29 +224,190 @@ bool EncoderMotion::init() {
 
     // Glitch filter
     pcnt_glitch_filter_config_t filter_config = {};
-    filter_config.max_glitch_ns = 2000;
-    (void)pcnt_unit_set_glitch_filter(pcnt_unit, &filter_config);
+    filter_config.max_glitch_ns = glitch_ns;
+    (void)pcnt_unit_set_glitch_filter(unit, &filter_config);
 
     // Watch points for overflow handling
-    (void)pcnt_unit_add_watch_point(pcnt_unit, PCNT_H_LIM);
-    (void)pcnt_unit_add_watch_point(pcnt_unit, PCNT_L_LIM);
+    (void)pcnt_unit_add_watch_point(unit, limit);
+    (void)pcnt_unit_add_watch_point(unit, -limit);
 
     // Overflow callback
     pcnt_event_callbacks_t cbs = {};
-    cbs.on_reach = pcnt_on_reach;
-    err = pcnt_unit_register_event_callbacks(pcnt_unit, &cbs, nullptr);
+    cbs.on_reach = on_reach;
+    err = pcnt_unit_register_event_callbacks(unit, &cbs, (void *)&axis);
     if (err != ESP_OK) return false;
 
     // Enable and start
-    err = pcnt_unit_enable(pcnt_unit);
+    err = pcnt_unit_enable(unit);
     if (err != ESP_OK) return false;
 
-    err = pcnt_unit_clear_count(pcnt_unit);
+    err = pcnt_unit_clear_count(unit);
     if (err != ESP_OK) return false;
 
-    c_pcnt_accum = 0;
-    err = pcnt_unit_start(pcnt_unit);
+    axis.count = 0;
+    axis.last = 0;
+    err = pcnt_unit_start(unit);
     if (err != ESP_OK) return false;
+
+    axis.unit = unit;
+    return true;
+}
+
+// Extended count (see PcntCount)
+int32_t EncoderMotion::readQuadPcnt(const QuadAxis &axis) {
+    return PcntCount::read(axis.count, axis.last, PCNT_H_LIM, [&axis] {
+        int count = 0;
+        pcnt_unit_get_count(axis.unit, &count);
+        return (int32_t)count;
+    });
+}
+
+int32_t EncoderMotion::updateQuadPcnt(QuadAxis &axis) {
+    const int32_t count = readQuadPcnt(axis);
+    axis.last = count;
+    return count;
+}
+
+bool EncoderMotion::initLinearAxis(QuadAxis &axis) {
+    if (LINEAR_SCALE_PCNT) return initQuadPcnt(axis, LINEAR_SCALE_GLITCH_NS, true);
+
+    pinMode(axis.pin_a, INPUT_PULLUP);
+    pinMode(axis.pin_b, INPUT_PULLUP);
+
+    axis.state = read_ab(axis.pin_a, axis.pin_b);
+
+    attachInterruptArg((int)axis.pin_a, quadIsr, (void *)&axis, CHANGE);
+    attachInterruptArg((int)axis.pin_b, quadIsr, (void *)&axis, CHANGE);
+    return true;
+}
+
+int32_t EncoderMotion::readLinearAxis(const QuadAxis &axis) {
+    if (axis.unit != nullptr) {
+        return readQuadPcnt(axis) * (int32_t)axis.dir;
+    }
+    int32_t v;
+    noInterrupts();
+    v = axis.count;
+    interrupts();
+    return v;
+}
+
+// ============================================================================
+// Measurement test signal: quadrature at hz from two LEDC channels on one
+// timer, B a quarter period behind A (X counts up). The pins stay inputs as
+// well, so PCNT or the GPIO ISR sees the signal through the GPIO matrix.
+// ============================================================================
+
+bool EncoderMotion::startTestSignal(int pin_a, int pin_b, uint32_t hz) {
+    ledc_timer_config_t timer_config = {};
+    timer_config.speed_mode = LEDC_HIGH_SPEED_MODE;
+    timer_config.duty_resolution = LEDC_TIMER_8_BIT;
+    timer_config.timer_num = LEDC_TIMER_3;
+    timer_config.freq_hz = hz;
+    timer_config.clk_cfg = LEDC_AUTO_CLK;
+    if (ledc_timer_config(&timer_config) != ESP_OK) return false;
+
+    const int pins[2] = { pin_a, pin_b };
+    for (int i = 0; i < 2; i++) {
+        ledc_channel_config_t chan_config = {};
+        chan_config.gpio_num = pins[i];
+        chan_config.speed_mode = LEDC_HIGH_SPEED_MODE;
+        chan_config.channel = (i == 0) ? LEDC_CHANNEL_6 : LEDC_CHANNEL_7;
+        chan_config.intr_type = LEDC_INTR_DISABLE;
+        chan_config.timer_sel = LEDC_TIMER_3;
+        chan_config.duty = 128;          // Half of 8 bits
+        chan_config.hpoint = i * 64;     // A quarter period
+        if (ledc_channel_config(&chan_config) != ESP_OK) return false;
+        // The channel made the pin output only
+        gpio_set_direction((gpio_num_t)pins[i], GPIO_MODE_INPUT_OUTPUT);
+    }
+    return true;
+}
+
+#if SPINDLE_MODE == SPINDLE_MODE_ENCODER
+// ============================================================================
+// Spindle A-channel edge ISR (ELS_DRIVE_EDGE only): PCNT still does the
+// counting; every edge hands the fresh count to the ELS so it can wake on
+// the exact edge a Z step becomes due instead of waiting for the next 1 ms
+// tick. The speed events come from the PCNT unit either way.
+// ============================================================================
+
+void IRAM_ATTR EncoderMotion::spindleEdgeIsr() {
+    const SpindleEdgeHook hook = spindle_edge_hook;
+    if (hook) hook((int32_t)((uint32_t)readQuadPcnt(c_axis) + (uint32_t)index_shift));
+}
+
+// ============================================================================
+// Spindle index ISR (C_PIN_INDEX, both edges, pulse active high): latches
+// the PCNT count at the rising edge and hands both edges over at the
+// falling one. The pulse is a few counts wide, so its middle is the same
+// spindle angle whichever way the spindle turns.
+// ============================================================================
+
+void IRAM_ATTR EncoderMotion::spindleIndexIsr() {
+    const int32_t raw = readQuadPcnt(c_axis);
+    if (gpio_get_level((gpio_num_t)C_PIN_INDEX)) {
+        index_rise_raw = raw;
+        index_rise_seen = true;
+        return;
+    }
+    if (!index_rise_seen) return;
+    index_rise_seen = false;
+    const int32_t width = (int32_t)((uint32_t)raw - (uint32_t)index_rise_raw);
+    portENTER_CRITICAL_ISR(&index_mux);
+    if (width > SPINDLE_INDEX_MAX_WIDTH || width < -SPINDLE_INDEX_MAX_WIDTH) {
+        index_rejected++;
+    } else {
+        index_ev_rise = index_rise_raw;
+        index_ev_fall = raw;
+        index_ev_seq++;
+    }
+    portEXIT_CRITICAL_ISR(&index_mux);
+}
+#endif
+
+// ============================================================================
+// Initialization
+// ============================================================================
+
+bool EncoderMotion::init() {
+    // Initialize X axis encoder
+    x_axis.pin_a = X_PINA;
+    x_axis.pin_b = X_PINB;
+    x_axis.count = 0;
+    x_axis.dir = X_INVERT_DIR ? -1 : 1;
+    if (!initLinearAxis(x_axis)) return false;
+
+    // Initialize Z axis encoder
+    z_axis.pin_a = Z_PINA;
+    z_axis.pin_b = Z_PINB;
+    z_axis.count = 0;
+    z_axis.dir = Z_INVERT_DIR ? -1 : 1;
+    if (!initLinearAxis(z_axis)) return false;
+
+    if (ENC_ISR_MEASURE && ENC_ISR_MEASURE_TEST_HZ > 0 &&
+        !startTestSignal(X_PINA, X_PINB, ENC_ISR_MEASURE_TEST_HZ)) return false;
+
+#if SPINDLE_MODE == SPINDLE_MODE_ENCODER
+	// Initialize spindle encoder using PCNT hardware
+    c_axis.pin_a = C_PINA;
+    c_axis.pin_b = C_PINB;
+    if (!initQuadUnit(c_axis, 2000, PCNT_H_LIM, onPcntReach, true)) return false;
+    // Same pins, narrow limits: the speed events
+    c_rate_axis.pin_a = C_PINA;
+    c_rate_axis.pin_b = C_PINB;
+    if (!initQuadUnit(c_rate_axis, 2000, SPINDLE_RATE_EVENT_COUNTS, onSpindleReach, true)) return false;
+
+#if ELS_DRIVE_MODE == ELS_DRIVE_EDGE
+    // A-channel edges only: half the quadrature rate, still one wake
+    // opportunity every 2 counts
+    attachInterrupt(C_PINA, spindleEdgeIsr, CHANGE);
+#endif
+
+    if (C_PIN_INDEX >= 0) {
+        pinMode(C_PIN_INDEX, INPUT_PULLUP);
+        attachInterrupt(C_PIN_INDEX, spindleIndexIsr, CHANGE);
+    }
 #endif // SPINDLE_MODE_ENCODER
 
 	return true;
@@ -188,61 +418,237 @@ bool EncoderMotion::init() {
 // ============================================================================
 
 void EncoderMotion::update() {
+	// Every tick, for the fold check (PcntCount::read)
+	if (x_axis.unit != nullptr) updateQuadPcnt(x_axis);
+	if (z_axis.unit != nullptr) updateQuadPcnt(z_axis);
 #if SPINDLE_MODE == SPINDLE_MODE_ENCODER
-	// RPM calculation (run at lower rate) - only for encoder mode
-	static uint32_t last_ms = 0;
-    static int32_t last_total = 0;
+	updateQuadPcnt(c_axis);
+#endif
 
-    const uint32_t now = millis();
-    const uint32_t dt_ms = now - last_ms;
-    if (dt_ms < 100) return;  // 10 Hz RPM update
+	// Edge rates for the integrity counters
+	static uint32_t rate_last_ms = 0;
+	const uint32_t rate_now_ms = millis();
+	const uint32_t rate_dt_ms = rate_now_ms - rate_last_ms;
+	if (rate_dt_ms >= ENC_RATE_WINDOW_MS) {
+		rate_last_ms = rate_now_ms;
+		updateRate(x_axis, getXCount(), rate_dt_ms);
+		updateRate(z_axis, getZCount(), rate_dt_ms);
+#if SPINDLE_MODE == SPINDLE_MODE_ENCODER
+		updateRate(c_axis, readQuadPcnt(c_axis), rate_dt_ms);
+#endif
+	}
 
-    int32_t total = getTotalSpindleCount();
-    int32_t delta = total - last_total;
+#if SPINDLE_MODE == SPINDLE_MODE_ENCODER
+	// Newest edge first, so it can never be later than now_us
+	portENTER_CRITICAL(&edge_mux);
+	const bool seen = edge_seen;
+	const int32_t count = edge_count;
+	const uint32_t t_us = edge_us;
+	portEXIT_CRITICAL(&edge_mux);
+	const uint32_t now_us = (uint32_t)esp_timer_get_time();
 
-    last_total = total;
-    last_ms = now;
+	// Tracking filter gets every tick
+	spindle_tracker.update(getTotalSpindleCount(), now_us);
 
-    // Calculate RPM
-    float dt_s = (float)dt_ms / 1000.0f;
-    float revs = (float)delta / (float)C_COUNTS_PER_REV;
-    float rps = revs / dt_s;
-    float rpmf = rps * 60.0f;
+	// Speed from the edge timestamps (adaptive window, see SpindleRate)
+	if (seen) spindle_rate.update(count, t_us, now_us);
 
-    rpm_signed = (int16_t)lroundf(rpmf);
-    rpm_abs = (int16_t)lroundf(fabsf(rpmf));
+	if (C_PIN_INDEX >= 0) updateIndex();
+
+	const int32_t mrpm = spindle_rate.getMilliRpm();
+	rpm_signed = (int16_t)((mrpm + ((mrpm < 0) ? -500 : 500)) / 1000);
+	rpm_abs = (rpm_signed < 0) ? -rpm_signed : rpm_signed;
 #endif
 	// In stepper mode, RPM comes from SpindleStepper class
 }
 
+void EncoderMotion::updateRate(QuadAxis &axis, int32_t count, uint32_t dt_ms) {
+	const int32_t delta = (int32_t)((uint32_t)count - (uint32_t)axis.rate_last);
+	axis.rate_last = count;
+	const uint32_t edges = (uint32_t)((delta < 0) ? -delta : delta);
+	axis.edges_per_s = (uint32_t)(((uint64_t)edges * 1000) / dt_ms);
+	if (axis.edges_per_s > axis.peak_edges_per_s) axis.peak_edges_per_s = axis.edges_per_s;
+}
+
 // ============================================================================
 // Getters
 // ============================================================================
 
+EncoderStats EncoderMotion::getStats(EncoderId id) {
+	EncoderStats st = {};
+	const QuadAxis *axis = nullptr;
+	if (id == ENC_X) axis = &x_axis;
+	else if (id == ENC_Z) axis = &z_axis;
+#if SPINDLE_MODE == SPINDLE_MODE_ENCODER
+	else if (id == ENC_C) axis = &c_axis;
+#endif
+	if (axis == nullptr) return st;
+	st.gpio_decoded = (axis->unit == nullptr);
+	st.illegal = axis->illegal;
+	st.overflows = axis->overflows;
+#if SPINDLE_MODE == SPINDLE_MODE_ENCODER
+	if (id == ENC_C) {
+		portENTER_CRITICAL(&edge_mux);
+		st.speed_events = edge_events;
+		portEXIT_CRITICAL(&edge_mux);
+	}
+#endif
+	st.edges_per_s = axis->edges_per_s;
+	st.peak_edges_per_s = axis->peak_edges_per_s;
+	return st;
+}
+
 int32_t EncoderMotion::getXCount() {
-    int32_t v;
-    noInterrupts();
-    v = x_axis.count;
-    interrupts();
-    return v;
+    return readLinearAxis(x_axis);
 }
 
 int32_t EncoderMotion::getZCount() {
-    int32_t v;
-    noInterrupts();
-    v = z_axis.count;
-    interrupts();
-    return v;
+    return readLinearAxis(z_axis);
 }
 
 #if SPINDLE_MODE == SPINDLE_MODE_ENCODER
 int32_t EncoderMotion::getTotalSpindleCount() {
-    int count = 0;
-    pcnt_unit_get_count(pcnt_unit, &count);
-    return (int32_t)c_pcnt_accum + (int32_t)count;
+    return (int32_t)((uint32_t)readQuadPcnt(c_axis) + (uint32_t)index_shift);
+}
+
+int64_t EncoderMotion::getSpindleCount() {
+    return spindle_tracker.unwrap(getTotalSpindleCount());
+}
+
+// ============================================================================
+// Spindle index: SpindleIndex checks each pulse middle and says what to add
+// to index_shift. The re-home is a new reference, not lost counts, so the
+// tracker and takeIndexRehome() move with it.
+// ============================================================================
+void EncoderMotion::updateIndex() {
+	portENTER_CRITICAL(&index_mux);
+	const uint32_t seq = index_ev_seq;
+	const int32_t rise = index_ev_rise;
+	const int32_t fall = index_ev_fall;
+	portEXIT_CRITICAL(&index_mux);
+	if (seq == index_seq_seen) return;
+	index_seq_seen = seq;
+
+	const int32_t shift = index_shift;
+	const int64_t c2 = spindle_tracker.unwrap((int32_t)((uint32_t)rise + (uint32_t)shift)) +
+					   spindle_tracker.unwrap((int32_t)((uint32_t)fall + (uint32_t)shift));
+
+	portENTER_CRITICAL(&index_mux);
+	const SpindleIndex::Correction fix = spindle_index.take(c2, index_home_allowed);
+	portEXIT_CRITICAL(&index_mux);
+	if (fix.counts != 0) index_shift = (int32_t)((uint32_t)shift + (uint32_t)fix.counts);
+	if (fix.home) {
+		spindle_tracker.shift(fix.counts);
+		index_rehome += fix.counts;
+	}
 }
 
-int32_t EncoderMotion::getSpindleCount() {
-    return getTotalSpindleCount();
+SpindleIndexStats EncoderMotion::getIndexStats() {
+	portENTER_CRITICAL(&index_mux);
+	SpindleIndexStats st = spindle_index.stats();
+	st.rejected = index_rejected;
+	portEXIT_CRITICAL(&index_mux);
+	return st;
 }
+
+int32_t EncoderMotion::takeIndexRehome() {
+	const int32_t r = index_rehome;
+	index_rehome = 0;
+	return r;
+}
+
+// ============================================================================
+// Calibration mode: counts per revolution between index pulses, averaged
+// over every whole revolution since boot
+// ============================================================================
+void EncoderMotion::indexCalUpdate() {
+	if (!SPINDLE_INDEX_CAL || C_PIN_INDEX < 0) return;
+	static uint32_t last_ms = 0;
+	const uint32_t now_ms = millis();
+	if (now_ms - last_ms < SPINDLE_INDEX_CAL_MS) return;
+	last_ms = now_ms;
+
+	portENTER_CRITICAL(&index_mux);
+	const int64_t c2 = spindle_index.calC2();
+	const int64_t revs = spindle_index.calRevs();
+	portEXIT_CRITICAL(&index_mux);
+	const SpindleIndexStats st = getIndexStats();
+
+	if (revs == 0) {
+		Serial.printf("[Encoder] Index: no whole revolution yet (%lu pulses, %lu rejected)\n",
+			(unsigned long)st.pulses, (unsigned long)st.rejected);
+		return;
+	}
+	Serial.printf("[Encoder] Index: %.3f counts/rev over %ld revs (C_COUNTS_PER_REV %ld), "
+		"last rev %+ld, peak %ld, %lu slips, %+ld corrected%s\n",
+		(double)c2 / (2.0 * (double)revs), (long)revs, (long)C_COUNTS_PER_REV,
+		(long)st.rev_error, (long)st.peak_rev_error, (unsigned long)st.slips,
+		(long)st.corrected, st.homed ? "" : ", not homed");
+}
+#endif
+
+// ============================================================================
+// Measurement mode: X/Z decode interrupt load. With GPIO decoding that is one
+// ISR per scale edge; with PCNT only the overflow callback every
+// PCNT_H_LIM counts. In encoder spindle mode also the spindle speed events,
+// one every SPINDLE_RATE_EVENT_COUNTS counts. With ENC_ISR_MEASURE_TEST_HZ
+// the edge rate printed should read 4x it: fewer means edges were lost.
+// ============================================================================
+void EncoderMotion::measureUpdate() {
+    if (!ENC_ISR_MEASURE) return;
+    static uint32_t window_start_ms = 0;
+    static int32_t last_x = 0;
+    static int32_t last_z = 0;
+
+    const uint32_t now_ms = millis();
+    if (window_start_ms == 0) {
+        window_start_ms = now_ms;
+        last_x = getXCount();
+        last_z = getZCount();
+        scale_isr_calls = 0;
+        scale_isr_cycles = 0;
+        spindle_isr_calls = 0;
+        spindle_isr_cycles = 0;
+        return;
+    }
+    const uint32_t elapsed_ms = now_ms - window_start_ms;
+    if (elapsed_ms < ENC_ISR_MEASURE_MS) return;
+
+    noInterrupts();
+    const uint32_t calls = scale_isr_calls;
+    const uint32_t cycles = scale_isr_cycles;
+    scale_isr_calls = 0;
+    scale_isr_cycles = 0;
+    const uint32_t c_calls = spindle_isr_calls;
+    const uint32_t c_cycles = spindle_isr_cycles;
+    spindle_isr_calls = 0;
+    spindle_isr_cycles = 0;
+    interrupts();
+
+    const int32_t x = getXCount();
+    const int32_t z = getZCount();
+    const uint32_t edges = (uint32_t)abs(x - last_x) + (uint32_t)abs(z - last_z);
+    last_x = x;
+    last_z = z;
+    window_start_ms = now_ms;
+
+    const uint32_t mhz = getCpuFrequencyMhz();
+    const float edge_rate = (float)edges * 1000.0f / (float)elapsed_ms;
+    const float isr_rate = (float)calls * 1000.0f / (float)elapsed_ms;
+    const float avg_us = (calls > 0) ? (float)cycles / ((float)calls * (float)mhz) : 0.0f;
+    const float load_pct = (float)cycles * 100.0f / ((float)elapsed_ms * 1000.0f * (float)mhz);
+
+    Serial.printf("[Encoder] X/Z %s: %.0f edges/s (test signal %lu), %.0f ISR/s, avg %.2f us, load %.3f%%\n",
+        LINEAR_SCALE_PCNT ? "PCNT" : "GPIO", edge_rate, (unsigned long)(ENC_ISR_MEASURE_TEST_HZ * 4),
+        isr_rate, avg_us, load_pct);
+#if SPINDLE_MODE == SPINDLE_MODE_ENCODER
+    const float c_rate = (float)c_calls * 1000.0f / (float)elapsed_ms;
+    const float c_avg_us = (c_calls > 0) ? (float)c_cycles / ((float)c_calls * (float)mhz) : 0.0f;
+    const float c_load_pct = (float)c_cycles * 100.0f / ((float)elapsed_ms * 1000.0f * (float)mhz);
+    Serial.printf("[Encoder] C speed events: %.0f ISR/s, avg %.2f us, load %.3f%%\n",
+        c_rate, c_avg_us, c_load_pct);
+#else
+    (void)c_calls;
+    (void)c_cycles;
 #endif
+}
@@ -3,10 +3,24 @@
 #include <stdint.h>
 #include <Arduino.h>  // For IRAM_ATTR
 #include "config_motion.h"
+#include "spindle_tracker.h"
+#include "spindle_rate.h"
+#include "spindle_index.h"
+#include "driver/pulse_cnt.h"
+
+// Decoder integrity counters for one encoder
+struct EncoderStats {
+    bool gpio_decoded;          // false: PCNT, which can't see illegal transitions
+    uint32_t illegal;           // A and B changed together: an edge was missed (GPIO decoding)
+    uint32_t overflows;         // PCNT position unit folds into the 32-bit count
+    uint32_t speed_events;      // Spindle (encoder mode): timestamped speed events
+    uint32_t edges_per_s;       // Over the last ENC_RATE_WINDOW_MS
+    uint32_t peak_edges_per_s;  // Highest since boot
+};
 
 // ============================================================================
 // Encoder handling for Motion board (ESP32)
-// Reads X, Z linear encoders
+// Reads X, Z linear encoders via PCNT (or GPIO interrupts, LINEAR_SCALE_PCNT)
 // In ENCODER mode: also reads C spindle encoder via PCNT
 // In STEPPER mode: spindle data comes from SpindleStepper class
 // ============================================================================
@@ -20,37 +34,99 @@ public:
 	static int32_t getXCount();
     static int32_t getZCount();
 
+    // ENC_ISR_MEASURE: call from loop(), prints X/Z decode and spindle
+    // event ISR load (X driven by ENC_ISR_MEASURE_TEST_HZ if set)
+    static void measureUpdate();
+
+    // Integrity counters (spindle: zeros in stepper mode)
+    enum EncoderId : uint8_t { ENC_X, ENC_Z, ENC_C, ENC_COUNT };
+    static EncoderStats getStats(EncoderId id);
+
 #if SPINDLE_MODE == SPINDLE_MODE_ENCODER
 	// Spindle encoder functions (only in encoder mode)
-	static int32_t getSpindleCount();  // Extended count (beyond PCNT limits)
+	static int64_t getSpindleCount();  // 64-bit count, never wraps
     
-    // RPM (updated periodically)
+    // Interpolated position/velocity, fed from update()
+    static SpindleTracker &getSpindleTracker() { return spindle_tracker; }
+
+    // Edge-timestamp speed measurement, fed from update()
+    static SpindleRate &getSpindleRate() { return spindle_rate; }
+
+    // RPM (every tick, from spindle_rate)
     static int16_t getRpmSigned() { return rpm_signed; }
     static int16_t getRpmAbs() { return rpm_abs; }
-    
-    // Allow PCNT callback to access accumulator
-    static volatile int32_t c_pcnt_accum;
+    static int32_t getMilliRpm() { return spindle_rate.getMilliRpm(); }
+    static int32_t getRpmPerSec() { return spindle_rate.getRpmPerSec(); }
+
+	// Spindle edge hook (ELS_DRIVE_EDGE): called from the A-channel edge ISR
+	// with the current 32-bit (wrapping) count. Must be IRAM-safe and short.
+	typedef void (*SpindleEdgeHook)(int32_t count);
+	static void setSpindleEdgeHook(SpindleEdgeHook hook) { spindle_edge_hook = hook; }
+
+	// Spindle index (C_PIN_INDEX). Large corrections, the first re-home
+	// included, wait until the ELS isn't following the spindle; the motion
+	// task says when that is, every tick.
+	static void setIndexHomeAllowed(bool allowed) { index_home_allowed = allowed; }
+	static SpindleIndexStats getIndexStats();
+	// Counts the index re-homed the spindle by since the last call, without
+	// the spindle moving: whoever keeps spindle positions shifts them too
+	static int32_t takeIndexRehome();
+	// SPINDLE_INDEX_CAL: call from loop(), prints measured counts/rev
+	static void indexCalUpdate();
 #endif
 
-private:
+    // One quadrature input. PCNT decoding (initQuadPcnt / readQuadPcnt) is
+    // shared with MpgEncoder.
     struct QuadAxis {
         uint8_t pin_a;
         uint8_t pin_b;
-        volatile int32_t count;
+        volatile int32_t count;  // GPIO: position; PCNT: overflow accumulator
         volatile uint8_t state;
         int8_t dir;
+        pcnt_unit_handle_t unit; // PCNT unit, nullptr when decoded by GPIO
+        volatile int32_t last;   // PCNT: count at the last updateQuadPcnt()
+        volatile uint32_t illegal;
+        volatile uint32_t overflows;
+        int32_t rate_last;       // Count at the start of the rate window
+        uint32_t edges_per_s;
+        uint32_t peak_edges_per_s;
     };
-    
+	// pullup = false for input-only pins (GPIO34-39 have none)
+	static bool initQuadPcnt(QuadAxis &axis, uint32_t glitch_ns, bool scale, bool pullup = true);
+	static int32_t readQuadPcnt(const QuadAxis &axis);  // 32-bit, wraps
+	// readQuadPcnt() for the unit's owner, once every motion tick: keeps the
+	// count for the fold check (PcntCount::read)
+	static int32_t updateQuadPcnt(QuadAxis &axis);
+
+private:
     static QuadAxis x_axis;
     static QuadAxis z_axis;
 
 #if SPINDLE_MODE == SPINDLE_MODE_ENCODER
+    static QuadAxis c_axis;       // Position
+    static QuadAxis c_rate_axis;  // Speed events (onSpindleReach)
 	static int16_t rpm_signed;
     static int16_t rpm_abs;
+    static SpindleTracker spindle_tracker;
+    static SpindleRate spindle_rate;
+
+	static int32_t getTotalSpindleCount();  // PCNT-extended + index shift, wraps at 32 bits
+
+	static volatile SpindleEdgeHook spindle_edge_hook;
+	static void IRAM_ATTR spindleEdgeIsr();
+	static bool IRAM_ATTR onSpindleReach(pcnt_unit_handle_t unit, const pcnt_watch_event_data_t *edata, void *user_ctx);
 
-	static int32_t getTotalSpindleCount();
+	static bool index_home_allowed;
+	static void IRAM_ATTR spindleIndexIsr();
+	static void updateIndex();
 #endif
 
-	static void initLinearAxis(QuadAxis &axis);
+	static bool initLinearAxis(QuadAxis &axis);
+	static int32_t readLinearAxis(const QuadAxis &axis);
+	static bool startTestSignal(int pin_a, int pin_b, uint32_t hz);
 	static void IRAM_ATTR quadIsr(void *arg);
+	static bool IRAM_ATTR onPcntReach(pcnt_unit_handle_t unit, const pcnt_watch_event_data_t *edata, void *user_ctx);
+	static bool IRAM_ATTR onScaleReach(pcnt_unit_handle_t unit, const pcnt_watch_event_data_t *edata, void *user_ctx);
+	static bool initQuadUnit(QuadAxis &axis, uint32_t glitch_ns, int16_t limit, pcnt_watch_cb_t on_reach, bool pullup);
+	static void updateRate(QuadAxis &axis, int32_t count, uint32_t dt_ms);
 };
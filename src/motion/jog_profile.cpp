@@ -0,0 +1,159 @@
+#include "jog_profile.h"
+#include <math.h>
+
+void JogProfile::stop() {
+    v = 0.0f;
+    a = 0.0f;
+    acc_us = 0;
+}
+
+void JogProfile::start(int32_t sps) {
+    stop();
+    v = (float)sps;
+    if (v > v_max) v = v_max;
+    if (v < -v_max) v = -v_max;
+}
+
+// Same shape as the spindle pulse synthesizer's ramp: without jerk the
+// acceleration is simply +-accel; with it the acceleration ramps at jerk and
+// is held to what ramps out to zero just as the speed reaches the target.
+// Ramping out in ticks of jerk * dt takes a^2 / (2 jerk) + a * dt / 2 of
+// speed error (sqrt(2 * jerk * error) is the continuous limit, which at
+// 1 kHz lands with a sizeable acceleration still in hand).
+void JogProfile::advance(float v_target, float dt) {
+    const float dv = v_target - v;
+    if (jerk <= 0.0f) {
+        a = (dv > 0.0f) ? accel : (dv < 0.0f) ? -accel : 0.0f;
+    } else {
+        const float da = jerk * dt;
+        float a_lim = sqrtf(2.0f * jerk * fabsf(dv) + 0.25f * da * da) - 0.5f * da;
+        if (a_lim > accel) a_lim = accel;
+        const float a_des = (dv < 0.0f) ? -a_lim : a_lim;
+        if (a < a_des) a = (a_des - a > da) ? a + da : a_des;
+        else if (a > a_des) a = (a - a_des > da) ? a - da : a_des;
+    }
+    if (a == 0.0f) return;
+
+    // Reaching the target with the acceleration towards it: land on it.
+    // Following a target that keeps moving (toTarget() braking) the
+    // acceleration is still needed, so it only drops out once one jerk
+    // step can take it.
+    if (dv != 0.0f && (a > 0.0f) == (dv > 0.0f) && fabsf(a * dt) >= fabsf(dv)) {
+        v = v_target;
+        if (jerk <= 0.0f || fabsf(a) <= jerk * dt) a = 0.0f;
+        return;
+    }
+    v += a * dt;
+    if (v > v_max) v = v_max;
+    if (v < -v_max) v = -v_max;
+}
+
+int32_t JogProfile::emit(uint32_t dt_us) {
+    acc_us += (int64_t)(v * (float)dt_us);
+    const int32_t n = (int32_t)(acc_us / 1000000);
+    acc_us -= (int64_t)n * 1000000;
+    return n;
+}
+
+// A stop from v with the acceleration ramped in and out at jerk covers
+// v^2 / (2 accel) + v * accel / (2 jerk) (exact once v >= accel^2 / jerk,
+// more than needed below); this solves that for v
+float JogProfile::stopSpeed(float d) const {
+    if (d <= 0.0f) return 0.0f;
+    if (jerk <= 0.0f) return sqrtf(2.0f * accel * d);
+    const float k = accel * accel / jerk;
+    return 0.5f * (sqrtf(k * k + 8.0f * accel * d) - k);
+}
+
+int32_t JogProfile::stopSteps(int32_t sps) const {
+    const float sv = fabsf((float)sps);
+    float d = sv * sv / (2.0f * accel);
+    // Ramping the deceleration in, and the look-ahead reach() brakes with
+    if (jerk > 0.0f) d += sv * accel / jerk;
+    return (int32_t)d + 1;
+}
+
+// Fastest speed towards a point `left` steps away (signed) that still stops
+// on it: the distance left once this tick has run and any acceleration
+// still towards it has been ramped out, through stopSpeed()
+float JogProfile::reach(int32_t left, float dt) const {
+    if (left == 0) return 0.0f;
+    const float sgn = (left < 0) ? -1.0f : 1.0f;
+    const float toward = v * sgn;
+    const float a_toward = a * sgn;
+    // left counts from the last whole step output; the profile is already
+    // the fraction of a step in acc_us further on
+    float d = fabsf((float)left) - sgn * (float)acc_us * 1e-6f;
+    if (toward > 0.0f) {
+        d -= toward * dt;
+        if (jerk > 0.0f) {
+            // Following a falling speed the jerk limit runs about
+            // accel / (2 jerk) behind it; look that far ahead
+            d -= toward * accel / (2.0f * jerk);
+            if (a_toward > 0.0f) {
+                const float t = a_toward / jerk;
+                d -= toward * t + a_toward * t * t / 3.0f;
+            }
+        }
+    }
+    const float close = stopSpeed((d > 1.0f) ? d : 1.0f);
+    return (close > v_max) ? v_max : close;
+}
+
+// Never past the room either way: a move that would cross it ends on it
+// (gently when reach() has been braking for it, at once if a limit
+// appeared closer than the axis could stop)
+int32_t JogProfile::bound(int32_t n, int32_t room_fwd, int32_t room_rev) {
+    if (n > 0 && n >= room_fwd) {
+        n = (room_fwd > 0) ? room_fwd : 0;
+        stop();
+    } else if (n < 0 && -n >= room_rev) {
+        n = (room_rev > 0) ? -room_rev : 0;
+        stop();
+    }
+    return n;
+}
+
+int32_t JogProfile::toSpeed(int32_t v_target, uint32_t dt_us, int32_t room_fwd, int32_t room_rev) {
+    if (dt_us > 10000) dt_us = 10000;
+    const float dt = (float)dt_us * 1e-6f;
+    float vt = (float)v_target;
+    if (room_fwd != INT32_MAX) {
+        const float cap = (room_fwd > 0) ? reach(room_fwd, dt) : 0.0f;
+        if (vt > cap) vt = cap;
+    }
+    if (room_rev != INT32_MAX) {
+        const float cap = (room_rev > 0) ? reach(-room_rev, dt) : 0.0f;
+        if (vt < -cap) vt = -cap;
+    }
+    advance(vt, dt);
+    const int32_t n = bound(emit(dt_us), room_fwd, room_rev);
+    if (isStopped()) acc_us = 0;
+    return n;
+}
+
+int32_t JogProfile::toTarget(int32_t left, uint32_t dt_us, int32_t room_fwd, int32_t room_rev) {
+    if (dt_us > 10000) dt_us = 10000;
+    const float dt = (float)dt_us * 1e-6f;
+    if (left > room_fwd) left = (room_fwd > 0) ? room_fwd : 0;
+    if (left < -room_rev) left = (room_rev > 0) ? -room_rev : 0;
+    if (left == 0 && isStopped()) {
+        acc_us = 0;
+        return 0;
+    }
+
+    const float close = reach(left, dt);
+    advance((left < 0) ? -close : close, dt);
+
+    int32_t n = emit(dt_us);
+    // Reaching the target: stop on it if the steps left are enough to brake
+    // in, otherwise (the target moved onto the axis) run through and come back
+    if ((left >= 0 && n >= left) || (left <= 0 && n <= left)) {
+        const float room = (left != 0) ? fabsf((float)left) : 1.0f;
+        if (v * v <= 2.0f * accel * room) {
+            n = left;
+            stop();
+        }
+    }
+    return bound(n, room_fwd, room_rev);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+#include <limits.h>
+
+// ============================================================================
+// Jerk-limited jog profile (S-curve), run once per motion tick
+// Speed changes at no more than the acceleration limit, and the acceleration
+// itself ramps in and out at the jerk limit, so a jog can run well above the
+// speed a stepper would start or stop at dead. Two ways to drive it:
+//   toSpeed()  - run up/down to a signed speed (long-press jog; 0 = stop)
+//   toTarget() - run to a position given as steps still to go, braking so
+//                it stops on it (MPG jog; the target may move under it)
+// Both return the whole steps due this tick. Either can be bounded by the
+// room the axis has each way (endstops): speed is held to what still stops
+// within it, so a move runs at full speed up to a limit and lands on it.
+// Floats: motion task only.
+// ============================================================================
+
+class JogProfile {
+public:
+    // Limits in steps/s, steps/s^2 and steps/s^3; jerk <= 0 gives a plain
+    // trapezoidal ramp at accel
+    constexpr JogProfile(int32_t v_max_sps, int32_t accel_sps2, int32_t jerk_sps3)
+        : v_max((float)v_max_sps), accel((float)accel_sps2), jerk((float)jerk_sps3) {}
+
+    // room_fwd / room_rev: steps the axis may still go forward / back,
+    // INT32_MAX without a limit
+    int32_t toSpeed(int32_t v_target, uint32_t dt_us,
+                    int32_t room_fwd = INT32_MAX, int32_t room_rev = INT32_MAX);
+    int32_t toTarget(int32_t left, uint32_t dt_us,
+                     int32_t room_fwd = INT32_MAX, int32_t room_rev = INT32_MAX);
+
+    // Steps a bounded move at sps needs to brake onto a limit, not counting
+    // the tick in progress
+    int32_t stopSteps(int32_t sps) const;
+
+    // Steps returned but not output (step queue full): owed on the next tick
+    void giveBack(int32_t steps) { acc_us += (int64_t)steps * 1000000; }
+
+    // At rest from now on, any fraction of a step dropped
+    void stop();
+    // Carry on from a speed something else left the axis at
+    void start(int32_t sps);
+
+    bool isStopped() const { return v == 0.0f && a == 0.0f; }
+    int32_t getSps() const { return (int32_t)v; }
+
+private:
+    // Move speed (and acceleration) one tick towards v_target
+    void advance(float v_target, float dt);
+    // Whole steps travelled this tick at the new speed
+    int32_t emit(uint32_t dt_us);
+    // Fastest speed a jerk-limited stop still fits into d steps from
+    float stopSpeed(float d) const;
+    // Speed to run at towards a point left steps away, to stop on it
+    float reach(int32_t left, float dt) const;
+    // Clip steps to the room, stopping there
+    int32_t bound(int32_t n, int32_t room_fwd, int32_t room_rev);
+
+    float v_max;
+    float accel;
+    float jerk;
+    float v = 0.0f;       // Signed speed, steps/s
+    float a = 0.0f;       // Signed acceleration, steps/s^2
+    int64_t acc_us = 0;   // Step-microseconds not yet output
+};
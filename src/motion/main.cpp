@@ -10,11 +10,19 @@
 #include "encoder_motion.h"
 #include "stepper.h"
 #include "els_core.h"
+#include "thread_cycle.h"
+#include "z_move.h"
+#include "c_move.h"
 #include "ota_motion.h"
 
+#if ELS_DRIVE_MODE == ELS_DRIVE_TIMER
+#include "els_timer.h"
+#endif
+
 #if SPINDLE_MODE == SPINDLE_MODE_STEPPER
 #include "spindle_stepper.h"
 #include "mpg_encoder.h"
+#include "mpg_jog.h"
 #endif
 
 // ============================================================================
@@ -22,12 +30,54 @@
 // ============================================================================
 static TaskHandle_t motion_task_handle = nullptr;
 
+#if SPINDLE_MODE == SPINDLE_MODE_STEPPER
+// ============================================================================
+// MPG Z jog (MpgJog): Z follows the wheel's target, steps through the queue
+// ============================================================================
+static MpgJog mpg_z_jog(ELS_STEPPER_MAX_SPS, ELS_JOG_ACCEL, ELS_JOG_JERK);
+static uint32_t mpg_z_last_us = 0;
+
+static void mpgJogZ(int32_t delta, bool wheel) {
+	const uint32_t now_us = micros();
+	const uint32_t dt_us = now_us - mpg_z_last_us;
+	mpg_z_last_us = now_us;
+
+	if (!wheel && mpg_z_jog.isStopped()) {
+		mpg_z_jog.update(0, false, dt_us);
+		return;
+	}
+	const int32_t n = mpg_z_jog.update(delta, wheel, dt_us,
+									   ElsCore::endstopRoom(true), ElsCore::endstopRoom(false));
+	if (n != 0) {
+		// Steps the queue can't take stay owed (and are flagged)
+		mpg_z_jog.taken(n, Stepper::step(n, Stepper::spanUs(dt_us)));
+	}
+}
+#endif
+
 static void motionTask(void *param) {
     (void)param;
     
     TickType_t last_wake = xTaskGetTickCount();
+
+#if ELS_DRIVE_MODE == ELS_DRIVE_EDGE
+	ElsCore::setEdgeWakeTask(xTaskGetCurrentTaskHandle());
+#elif ELS_DRIVE_MODE == ELS_DRIVE_TIMER
+	// Started from here so the timer ISR lands on core 1 with this task
+	if (!ElsTimer::init(ELS_TIMER_RATE_HZ)) {
+		Serial.println("[Motion] ELS timer init FAILED");
+	}
+#endif
     
     while (true) {
+#if SPINDLE_MODE == SPINDLE_MODE_ENCODER
+		// The index may move the spindle count a long way only while the
+		// ELS isn't following the spindle
+		const ElsCore::State els_state = ElsCore::getState();
+		EncoderMotion::setIndexHomeAllowed(els_state == ElsCore::ST_IDLE ||
+										   els_state == ElsCore::ST_JOG ||
+										   els_state == ElsCore::ST_FAULT);
+#endif
 		// Update encoders (X, Z always; spindle only in encoder mode)
 		EncoderMotion::update();
 
@@ -35,38 +85,52 @@ static void motionTask(void *param) {
 		// Update MPG encoder
 		MpgEncoder::update();
 
-		// Handle MPG jog modes
-		MpgMode mpg_mode = MpgEncoder::getMode();
-		if (mpg_mode == MpgMode::JOG_Z)
-		{
-			// Route MPG delta to Z stepper
-			// Scale: 1 MPG count = 1 Z step (direct 1:1 for fine control)
-			int32_t delta = MpgEncoder::getDelta();
-			if (delta != 0 && !ElsCore::isEnabled())
-			{
-				Stepper::step(delta);
-			}
-		}
-		else if (mpg_mode == MpgMode::JOG_C)
-		{
-			// Route MPG delta to spindle position
-			// Scale: 1 MPG count = 2 spindle steps (1600 steps/rev, so 800 counts = 1 rev)
-			int32_t delta = MpgEncoder::getDelta();
-			if (delta != 0)
-			{
-				SpindleStepper::position += delta * 2;
-			}
-		}
+		// Handle MPG jog modes (counts already scaled x1/x10/x100 by wheel speed)
+		const MpgMode mpg_mode = MpgEncoder::getMode();
+		const int32_t mpg_delta = MpgEncoder::getDelta();
+		// Route MPG delta to the Z stepper, 1 scaled count = 1 Z step
+		const bool jog_z = (mpg_mode == MpgMode::JOG_Z && !ElsCore::isEnabled() &&
+							!ThreadCycle::isActive() && !ZMove::isActive());
+		mpgJogZ(jog_z ? mpg_delta : 0, jog_z);
+		// Route MPG delta to real spindle moves (C axis, switch off)
+		const bool jog_c = (mpg_mode == MpgMode::JOG_C && !ElsCore::isEnabled() &&
+							!ThreadCycle::isActive());
+		if (jog_c) CMove::jog(mpg_delta * SPINDLE_C_JOG_STEPS_PER_COUNT);
+		CMove::update();
 
 		// Update spindle stepper (read switch, generate steps)
 		SpindleStepper::update();
 #endif
 
+		// Threading cycle: passes, and the rapid return between them
+		ThreadCycle::update();
+		// Z move-to (the UI's, or the cycle's return)
+		ZMove::update();
+#if SPINDLE_MODE == SPINDLE_MODE_ENCODER
+		CMove::update();  // Refuses: no spindle drive
+#endif
+
 		// Run ELS core logic (calculates and outputs steps)
         ElsCore::update();
 
+#if ELS_DRIVE_MODE == ELS_DRIVE_EDGE
+		// Sleep until the next 1 ms tick, but let spindle edges wake us early
+		// when a Z step is due. Early wakes only service the ELS.
+		const TickType_t period = pdMS_TO_TICKS(1);
+		while (true) {
+			const TickType_t elapsed = xTaskGetTickCount() - last_wake;
+			if (elapsed >= period) {
+				last_wake += period;
+				break;
+			}
+			if (ulTaskNotifyTake(pdTRUE, period - elapsed) != 0) {
+				ElsCore::update();
+			}
+		}
+#else
 		// Run at ~1kHz for responsive MPG control
 		vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(1));
+#endif
     }
 }
 
@@ -145,6 +209,56 @@ void setup() {
     Serial.println("[Motion] Boot complete");
 }
 
+// ============================================================================
+// Encoder integrity telemetry, refreshed at 10 Hz for SpiSlave to rotate through
+// ============================================================================
+static void setEncoderTelemetry(EncoderIdProto id, const EncoderStats &st, int16_t rpm_accel = 0) {
+	TelemetryPacket t = {};
+	t.encoder = id;
+	t.gpio_decoded = st.gpio_decoded ? 1 : 0;
+	t.illegal = st.illegal;
+	t.overflows = st.overflows;
+	t.speed_events = st.speed_events;
+	t.edges_per_s = st.edges_per_s;
+	t.peak_edges_per_s = st.peak_edges_per_s;
+	t.rpm_accel = rpm_accel;
+#if SPINDLE_MODE == SPINDLE_MODE_ENCODER
+	if (id == EncoderIdProto::C && C_PIN_INDEX >= 0) {
+		const SpindleIndexStats ix = EncoderMotion::getIndexStats();
+		int32_t err = ix.rev_error;
+		if (err > INT16_MAX) err = INT16_MAX;
+		if (err < INT16_MIN) err = INT16_MIN;
+		t.index_rev_error = (int16_t)err;
+		t.index_slips = (ix.slips > UINT16_MAX) ? UINT16_MAX : (uint16_t)ix.slips;
+		t.index_state = ix.homed ? 2 : 1;
+	}
+#endif
+	SpiSlave::setTelemetry(t);
+}
+
+static void updateTelemetry() {
+	static uint32_t last_ms = 0;
+	const uint32_t now = millis();
+	if (now - last_ms < 100) return;
+	last_ms = now;
+
+	setEncoderTelemetry(EncoderIdProto::X, EncoderMotion::getStats(EncoderMotion::ENC_X));
+	setEncoderTelemetry(EncoderIdProto::Z, EncoderMotion::getStats(EncoderMotion::ENC_Z));
+#if SPINDLE_MODE == SPINDLE_MODE_ENCODER
+	int32_t rpm_accel = EncoderMotion::getRpmPerSec();
+	if (rpm_accel > INT16_MAX) rpm_accel = INT16_MAX;
+	if (rpm_accel < INT16_MIN) rpm_accel = INT16_MIN;
+	setEncoderTelemetry(EncoderIdProto::C, EncoderMotion::getStats(EncoderMotion::ENC_C), (int16_t)rpm_accel);
+#else
+	setEncoderTelemetry(EncoderIdProto::C, EncoderMotion::getStats(EncoderMotion::ENC_C));
+#endif
+#if SPINDLE_MODE == SPINDLE_MODE_STEPPER
+	setEncoderTelemetry(EncoderIdProto::MPG, MpgEncoder::getStats());
+#else
+	setEncoderTelemetry(EncoderIdProto::MPG, EncoderStats{});
+#endif
+}
+
 // ============================================================================
 // Main loop (Core 0) - handles SPI communication
 // ============================================================================
@@ -163,6 +277,17 @@ static int32_t prev_sync_z = 0;
 void loop() {
 	OtaMotion::handle();
 
+#if ELS_DRIVE_MODE == ELS_DRIVE_TIMER
+	if (ELS_TIMER_MEASURE) ElsTimer::measureUpdate();
+#endif
+	if (ELS_STEP_TRACE) Stepper::traceUpdate();
+	if (ENC_ISR_MEASURE) EncoderMotion::measureUpdate();
+#if SPINDLE_MODE == SPINDLE_MODE_ENCODER
+	if (SPINDLE_INDEX_CAL) EncoderMotion::indexCalUpdate();
+#endif
+	ElsCore::reportUpdate();
+	ThreadCycle::reportUpdate();
+
     // Build status packet FIRST (before processing SPI)
     // This ensures TX buffer has fresh data when master initiates transaction
     StatusPacket status = {};
@@ -173,12 +298,15 @@ void loop() {
 
 	// Spindle data comes from different sources depending on mode
 #if SPINDLE_MODE == SPINDLE_MODE_ENCODER
-	status.c_count = EncoderMotion::getSpindleCount();
-	status.rpm_signed = EncoderMotion::getRpmSigned();
+	protocolSetSpindleCount(status, EncoderMotion::getSpindleCount());
+	// Whole RPM plus the hundredths the edge-timed measurement resolves
+	const int32_t mrpm = EncoderMotion::getMilliRpm();
+	status.rpm_signed = (int16_t)((mrpm + ((mrpm < 0) ? -500 : 500)) / 1000);
+	status.rpm_centi = (int8_t)((mrpm - (int32_t)status.rpm_signed * 1000) / 10);
 	status.target_rpm = 0;	   // N/A in encoder mode
 	status.flags.mpg_mode = 0; // N/A in encoder mode
 #else
-	status.c_count = SpindleStepper::getPosition();
+	protocolSetSpindleCount(status, SpindleStepper::getPosition());
 	status.rpm_signed = SpindleStepper::getRpmSigned();
 	status.target_rpm = MpgEncoder::getRpmSetting();
 	status.flags.mpg_mode = static_cast<uint8_t>(MpgEncoder::getMode());
@@ -191,8 +319,27 @@ void loop() {
     status.flags.spindle_moving = (abs(status.rpm_signed) > 10);
     status.flags.comms_ok = SpiSlave::isConnected();
 	status.flags.sync_waiting = ElsCore::isSyncWaiting();
-	status.ota_active = OtaMotion::isActive() ? 1 : 0;
-	status.wifi_connected = OtaMotion::isWifiConnected() ? 1 : 0;
+
+	// Hold the overload flag long enough for the UI's status poll to see it
+	static uint32_t last_overload_count = 0;
+	static uint32_t last_overload_ms = 0;
+	const uint32_t overload_count = Stepper::getOverloadCount();
+	if (overload_count != last_overload_count) {
+		last_overload_count = overload_count;
+		last_overload_ms = millis();
+	}
+	status.flags2.step_overload = (last_overload_ms != 0 &&
+								   millis() - last_overload_ms < STEP_OVERLOAD_HOLD_MS) ? 1 : 0;
+	status.flags2.wcet_over = ElsCore::isWcetOverBudget() ? 1 : 0;
+	status.sync_engage_ms = ElsCore::getSyncEngageMs();
+	status.flags2.ota_active = OtaMotion::isActive() ? 1 : 0;
+	status.flags2.wifi_connected = OtaMotion::isWifiConnected() ? 1 : 0;
+	status.flags2.thread_cycle = ThreadCycle::isActive() ? 1 : 0;
+	status.flags2.thread_pass = ThreadCycle::getPass() & 0x7;
+	status.z_move = static_cast<MoveResultProto>(ZMove::getResult());
+	status.z_move_seq = ZMove::getSeq();
+	status.c_move = static_cast<MoveResultProto>(CMove::getResult());
+	status.c_move_seq = CMove::getSeq();
 	status.sync_state = SyncStateProto::SYNC_DISABLED;
 	if (ElsCore::isSyncEnabled()) {
 		if (!ElsCore::isEnabled()) status.sync_state = SyncStateProto::SYNC_OUT_OF_SYNC;
@@ -203,6 +350,7 @@ void loop() {
     
     // Update TX buffer immediately so it's ready when master polls
     SpiSlave::setStatus(status);
+	updateTelemetry();
     
     // Now process any completed SPI transactions
     SpiSlave::process();
@@ -210,16 +358,16 @@ void loop() {
     // If we have a valid command from UI, update ELS settings
     if (SpiSlave::isConnected()) {
         const CommandPacket& cmd = SpiSlave::getCommand();
-		if (cmd.ota_request != 0)
+		if (cmd.flags & CMD_FLAG_OTA)
 		{
 			OtaMotion::start();
 		}
-		if (cmd.reboot_request != 0)
+		if (cmd.flags & CMD_FLAG_REBOOT)
 		{
 			ESP.restart();
 		}
         
-        bool els_en = (cmd.flags & 0x01);
+        bool els_en = (cmd.flags & CMD_FLAG_ELS_ENABLE);
         bool endstop_min_en = (cmd.endstop_min_enabled != 0);
         bool endstop_max_en = (cmd.endstop_max_enabled != 0);
         
@@ -262,15 +410,29 @@ void loop() {
         // Update ELS state from command
 		if (OtaMotion::isActive())
 		{
-			ElsCore::setEnabled(false);
+			ThreadCycle::request(false, 0);
+			ZMove::request(false, 0, 0, 0, 0);
+			CMove::request(false, 0, 0, 0);
+			if (!ThreadCycle::isActive() && !ZMove::isActive() && !CMove::isActive()) {
+				ElsCore::setEnabled(false);
+			}
 			ElsCore::setJog(0, false);
 		}
 		else
 		{
-			ElsCore::setEnabled(els_en);
+			// A running threading cycle or Z/C move owns the ELS enable (and Z)
+			ThreadCycle::request((cmd.flags & CMD_FLAG_THREAD_CYCLE) != 0, cmd.thread_passes);
+			if (!ThreadCycle::isActive()) {
+				ZMove::request(cmd.cmd == MotionCommand::MOVE_Z_TO, cmd.move_seq, cmd.move_target,
+							   cmd.move_speed, cmd.move_accel);
+				CMove::request(cmd.cmd == MotionCommand::MOVE_C_TO, cmd.move_seq, cmd.move_target,
+							   cmd.move_speed);
+			}
+			const bool owned = ThreadCycle::isActive() || ZMove::isActive() || CMove::isActive();
+			if (!owned) ElsCore::setEnabled(els_en);
 			ElsCore::setPitchUm(cmd.pitch_um);
 			ElsCore::setDirectionMul(cmd.direction_mul);
-			ElsCore::setJog(cmd.jog_dir, cmd.jog_active != 0);
+			ElsCore::setJog(owned ? 0 : cmd.jog_dir, !owned && cmd.jog_active != 0);
 		}
 		ElsCore::setSync(cmd.sync_enabled != 0, cmd.sync_z_um, cmd.sync_c_ticks);
         ElsCore::setEndstops(
@@ -290,7 +452,12 @@ void loop() {
 #endif
 	} else {
         // No communication - disable ELS for safety
-        ElsCore::setEnabled(false);
+		ThreadCycle::request(false, 0);
+		ZMove::request(false, 0, 0, 0, 0);
+		CMove::request(false, 0, 0, 0);
+		if (!ThreadCycle::isActive() && !ZMove::isActive() && !CMove::isActive()) {
+			ElsCore::setEnabled(false);
+		}
 		ElsCore::setJog(0, false);
     }
     
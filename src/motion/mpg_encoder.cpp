@@ -5,11 +5,20 @@
 // ============================================================================
 // Static member initialization
 // ============================================================================
-volatile int32_t MpgEncoder::position = 0;
-volatile int32_t MpgEncoder::delta_accum = 0;
+int32_t MpgEncoder::position = 0;
+int32_t MpgEncoder::delta_accum = 0;
+EncoderMotion::QuadAxis MpgEncoder::pcnt_axis = {0, 0, 0, 0, 1, nullptr, 0, 0, 0, 0, 0, 0};
+volatile int32_t MpgEncoder::isr_count = 0;
 volatile uint8_t MpgEncoder::last_state = 0;
+volatile uint32_t MpgEncoder::illegal = 0;
+int32_t MpgEncoder::last_raw = 0;
+uint32_t MpgEncoder::edges = 0;
+uint32_t MpgEncoder::edges_per_s = 0;
+uint32_t MpgEncoder::peak_edges_per_s = 0;
+MpgScale MpgEncoder::scale;
 int16_t MpgEncoder::rpm_setting = 0;
-MpgMode MpgEncoder::mode = MpgMode::RPM_CONTROL;
+volatile MpgMode MpgEncoder::mode = MpgMode::RPM_CONTROL;
+MpgMode MpgEncoder::last_mode = MpgMode::RPM_CONTROL;
 
 // Quadrature state table for decoding
 // Index = (old_state << 2) | new_state
@@ -21,22 +30,22 @@ static const int8_t QUAD_TABLE[16] = {
 };
 
 // ============================================================================
-// ISR handlers
+// ISR handlers (GPIO decoding, MPG_PCNT = false)
 // ============================================================================
 void IRAM_ATTR MpgEncoder::processQuadrature() {
     uint8_t a = digitalRead(MPG_PINA) ? 1 : 0;
     uint8_t b = digitalRead(MPG_PINB) ? 1 : 0;
     uint8_t new_state = (a << 1) | b;
-    
+
     uint8_t idx = (last_state << 2) | new_state;
     int8_t delta = QUAD_TABLE[idx];
-    
+
     if (delta != 0) {
-        if (MPG_INVERT_DIR) delta = -delta;
-        position += delta;
-        delta_accum += delta;
+        isr_count += delta;
+    } else if ((last_state ^ new_state) == 0x3) {
+        illegal++;  // Missed an edge, direction unknown
     }
-    
+
     last_state = new_state;
 }
 
@@ -52,60 +61,100 @@ void IRAM_ATTR MpgEncoder::isrB() {
 // Initialization
 // ============================================================================
 bool MpgEncoder::init() {
-    // Configure pins as inputs
     // Note: GPIO 34, 35 are input-only and don't have internal pullups.
     // External pullups required.
-    pinMode(MPG_PINA, INPUT);
-    pinMode(MPG_PINB, INPUT);
-    
-    // Read initial state
-    uint8_t a = digitalRead(MPG_PINA) ? 1 : 0;
-    uint8_t b = digitalRead(MPG_PINB) ? 1 : 0;
-    last_state = (a << 1) | b;
-    
-    // Attach interrupts
-    attachInterrupt(MPG_PINA, isrA, CHANGE);
-    attachInterrupt(MPG_PINB, isrB, CHANGE);
-    
+    if (MPG_PCNT) {
+        pcnt_axis.pin_a = MPG_PINA;
+        pcnt_axis.pin_b = MPG_PINB;
+        if (!EncoderMotion::initQuadPcnt(pcnt_axis, MPG_GLITCH_NS, false, false)) {
+            Serial.println("[MPG] PCNT init FAILED");
+            return false;
+        }
+    } else {
+        pinMode(MPG_PINA, INPUT);
+        pinMode(MPG_PINB, INPUT);
+
+        // Read initial state
+        uint8_t a = digitalRead(MPG_PINA) ? 1 : 0;
+        uint8_t b = digitalRead(MPG_PINB) ? 1 : 0;
+        last_state = (a << 1) | b;
+
+        // Attach interrupts
+        attachInterrupt(MPG_PINA, isrA, CHANGE);
+        attachInterrupt(MPG_PINB, isrB, CHANGE);
+    }
+
     position = 0;
     delta_accum = 0;
+    last_raw = 0;
     rpm_setting = 0;
     mode = MpgMode::RPM_CONTROL;
-    
-    Serial.printf("[MPG] Initialized: A=%d, B=%d, %ld counts = %ld RPM max\n",
-        MPG_PINA, MPG_PINB, MPG_COUNTS_TO_MAX_RPM, SPINDLE_MAX_RPM);
-    
+    last_mode = MpgMode::RPM_CONTROL;
+
+    Serial.printf("[MPG] Initialized (%s): A=%d, B=%d, %ld counts = %ld RPM max\n",
+        MPG_PCNT ? "PCNT" : "GPIO", MPG_PINA, MPG_PINB, MPG_COUNTS_TO_MAX_RPM, SPINDLE_MAX_RPM);
+
     return true;
 }
 
 // ============================================================================
-// Get delta counts since last call (atomically)
+// Get scaled jog counts since last call
 // ============================================================================
 int32_t MpgEncoder::getDelta() {
-    noInterrupts();
     int32_t d = delta_accum;
     delta_accum = 0;
-    interrupts();
     return d;
 }
 
 // ============================================================================
-// Update - process position for RPM control
+// Update - take the new counts: RPM setting or scaled jog counts
 // ============================================================================
 void MpgEncoder::update() {
-    // In RPM control mode, map position to RPM
-    if (mode == MpgMode::RPM_CONTROL) {
+    static uint32_t last_ms = 0;
+    const uint32_t now_ms = millis();
+    const uint32_t tick_ms = now_ms - last_ms;
+    last_ms = now_ms;
+
+    // Counts since the last update, from the PCNT unit or the ISR total
+    const int32_t raw = MPG_PCNT ? EncoderMotion::updateQuadPcnt(pcnt_axis) : isr_count;
+    int32_t delta = (int32_t)((uint32_t)raw - (uint32_t)last_raw);
+    last_raw = raw;
+    if (MPG_INVERT_DIR) delta = -delta;
+    edges += (uint32_t)((delta < 0) ? -delta : delta);
+
+    // Edge rate for the integrity counters
+    static uint32_t rate_last_ms = 0;
+    static uint32_t rate_last_edges = 0;
+    const uint32_t dt_ms = now_ms - rate_last_ms;
+    if (dt_ms >= ENC_RATE_WINDOW_MS) {
+        const uint32_t e = edges;
+        edges_per_s = (uint32_t)(((uint64_t)(e - rate_last_edges) * 1000) / dt_ms);
+        if (edges_per_s > peak_edges_per_s) peak_edges_per_s = edges_per_s;
+        rate_last_edges = e;
+        rate_last_ms = now_ms;
+    }
+
+    // A new mode starts from nothing owed and the wheel at rest
+    const MpgMode m = mode;
+    if (m != last_mode) {
+        last_mode = m;
+        delta_accum = 0;
+        scale.reset();
+    }
+    const int32_t jog_scale = scale.update(delta, tick_ms);
+
+    if (m == MpgMode::RPM_CONTROL) {
         // Clamp position to valid range (0 to MPG_COUNTS_TO_MAX_RPM)
-        noInterrupts();
+        position += delta;
         if (position < 0) position = 0;
         if (position > MPG_COUNTS_TO_MAX_RPM) position = MPG_COUNTS_TO_MAX_RPM;
-        int32_t pos = position;
-        interrupts();
-        
+
         // Linear mapping: 0-200 counts -> 0-3000 RPM
-        rpm_setting = (int16_t)((pos * SPINDLE_MAX_RPM) / MPG_COUNTS_TO_MAX_RPM);
+        rpm_setting = (int16_t)((position * SPINDLE_MAX_RPM) / MPG_COUNTS_TO_MAX_RPM);
+    } else {
+        // Jog modes: position (and the RPM setting) stays where it was
+        delta_accum += delta * jog_scale;
     }
-    // In jog modes, position is unbounded and delta is consumed by stepper
 }
 
 // ============================================================================
@@ -113,15 +162,17 @@ void MpgEncoder::update() {
 // ============================================================================
 void MpgEncoder::setMode(MpgMode m) {
     if (m != mode) {
-        // When switching modes, reset delta but preserve position for RPM
-        noInterrupts();
-        delta_accum = 0;
-        if (m != MpgMode::RPM_CONTROL) {
-            // Entering jog mode - don't reset RPM position
-        }
-        interrupts();
         mode = m;
-        
         Serial.printf("[MPG] Mode changed to %d\n", (int)m);
     }
 }
+
+EncoderStats MpgEncoder::getStats() {
+    EncoderStats st = {};
+    st.gpio_decoded = !MPG_PCNT;
+    st.illegal = illegal;
+    st.overflows = pcnt_axis.overflows;
+    st.edges_per_s = edges_per_s;
+    st.peak_edges_per_s = peak_edges_per_s;
+    return st;
+}
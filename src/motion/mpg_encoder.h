@@ -2,16 +2,20 @@
 
 #include <Arduino.h>
 #include <stdint.h>
+#include "encoder_motion.h"  // EncoderStats
+#include "mpg_scale.h"
 
 // ============================================================================
 // MPG Encoder: Manual Pulse Generator for speed control and axis jogging
-// Uses GPIO ISR for quadrature decoding (input-only pins don't support PCNT)
+// Decoded on a PCNT unit (MPG_PCNT) or by GPIO ISR. update() takes the new
+// counts each motion tick: in RPM_CONTROL they move the RPM setting, in
+// the jog modes they are scaled x1/x10/x100 by wheel speed for getDelta().
 // ============================================================================
 
 // MPG operating modes
 enum class MpgMode : uint8_t {
     RPM_CONTROL = 0,  // Default: controls spindle RPM (0-200 counts = 0-3000 RPM)
-    JOG_Z,            // Jog Z axis (each pulse = step)
+    JOG_Z,            // Jog Z axis (each scaled pulse = step)
     JOG_C,            // Jog C axis / spindle position
 };
 
@@ -19,11 +23,15 @@ class MpgEncoder {
 public:
     static bool init();
     
-    // Call from main loop to process accumulated counts
+    // Call from the motion task to process new counts
     static void update();
     
-    // Get accumulated counts since last read (resets accumulator)
+    // Jog counts since last read, scaled by wheel speed (resets accumulator).
+    // Motion task only, like update().
     static int32_t getDelta();
+
+    // Current jog scale (1, 10 or 100)
+    static int32_t getJogScale() { return scale.get(); }
     
     // Get current RPM setting (0-3000 based on position)
     static int16_t getRpmSetting() { return rpm_setting; }
@@ -33,17 +41,30 @@ public:
     
     // Mode control
     static MpgMode getMode() { return mode; }
-    static void setMode(MpgMode m);
+    static void setMode(MpgMode m);  // Takes effect at the next update()
     
     // Reset position to zero (e.g., when changing modes)
     static void resetPosition() { position = 0; delta_accum = 0; }
+
+    // Decoder integrity counters (illegal: GPIO decoding only; overflows:
+    // PCNT only)
+    static EncoderStats getStats();
     
 private:
-    static volatile int32_t position;     // Total accumulated position
-    static volatile int32_t delta_accum;  // Accumulated delta since last getDelta()
+    static int32_t position;              // RPM_CONTROL position, clamped
+    static int32_t delta_accum;           // Scaled jog counts since last getDelta()
+    static EncoderMotion::QuadAxis pcnt_axis;  // MPG_PCNT
+    static volatile int32_t isr_count;    // GPIO decoding: running count
     static volatile uint8_t last_state;
+    static volatile uint32_t illegal;     // Both lines changed between ISRs
+    static int32_t last_raw;              // Count at the last update()
+    static uint32_t edges;                // Counts seen, for the edge rate
+    static uint32_t edges_per_s;
+    static uint32_t peak_edges_per_s;
+    static MpgScale scale;                // Jog scale from wheel speed
     static int16_t rpm_setting;           // Current RPM derived from position
-    static MpgMode mode;
+    static volatile MpgMode mode;         // Written from the SPI loop
+    static MpgMode last_mode;             // Mode update() last ran in
     
     static void IRAM_ATTR isrA();
     static void IRAM_ATTR isrB();
@@ -0,0 +1,24 @@
+#include "mpg_jog.h"
+#include "config_motion.h"
+
+int32_t MpgJog::update(int32_t delta, bool wheel, uint32_t dt_us,
+                       int32_t room_fwd, int32_t room_rev) {
+    following = wheel;
+    if (!wheel) {
+        left = 0;
+        if (profile.isStopped()) return 0;
+        return profile.toSpeed(0, dt_us, room_fwd, room_rev);
+    }
+    int32_t l = left + delta;
+    if (l > MPG_JOG_MAX_LAG_STEPS) l = MPG_JOG_MAX_LAG_STEPS;
+    if (l < -MPG_JOG_MAX_LAG_STEPS) l = -MPG_JOG_MAX_LAG_STEPS;
+    if (l > room_fwd) l = (room_fwd > 0) ? room_fwd : 0;
+    if (l < -room_rev) l = (room_rev > 0) ? -room_rev : 0;
+    left = l;
+    return profile.toTarget(left, dt_us, room_fwd, room_rev);
+}
+
+void MpgJog::taken(int32_t n, int32_t accepted) {
+    if (following) left -= accepted;
+    else profile.giveBack(n - accepted);
+}
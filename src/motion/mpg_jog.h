@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+#include <limits.h>
+#include "jog_profile.h"
+
+// ============================================================================
+// MPG Z jog: the wheel moves a target, Z runs to it through the jog profile
+// and stops on it. Wheel motion more than MPG_JOG_MAX_LAG_STEPS ahead of Z,
+// or past an endstop, is dropped. With the wheel not routed to Z, Z only
+// ramps down to a stop (short of the endstops too). One update() per motion
+// tick, then taken() with what the step queue accepted; no driver types
+// here, so the logic builds on the host.
+// ============================================================================
+
+class MpgJog {
+public:
+    constexpr MpgJog(int32_t v_max_sps, int32_t accel_sps2, int32_t jerk_sps3)
+        : profile(v_max_sps, accel_sps2, jerk_sps3) {}
+
+    // delta: scaled wheel counts this tick (1 count = 1 step). wheel: the
+    // wheel is routed to Z. Returns the steps due this tick.
+    int32_t update(int32_t delta, bool wheel, uint32_t dt_us,
+                   int32_t room_fwd = INT32_MAX, int32_t room_rev = INT32_MAX);
+
+    // n: what update() returned; accepted: what the step queue took of it.
+    // Following the wheel the rest stays owed to the target; ramping down
+    // it is owed to the profile.
+    void taken(int32_t n, int32_t accepted);
+
+    bool isStopped() const { return profile.isStopped(); }
+    int32_t getSps() const { return profile.getSps(); }
+    // Signed steps to the target
+    int32_t getLeft() const { return left; }
+
+private:
+    JogProfile profile;
+    int32_t left = 0;
+    bool following = false;
+};
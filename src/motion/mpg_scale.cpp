@@ -0,0 +1,23 @@
+#include "mpg_scale.h"
+#include "config_motion.h"
+
+// ============================================================================
+// First-order smoothing over MPG_SPEED_TAU_MS, then thresholds with
+// hysteresis so the scale doesn't flicker at one
+// ============================================================================
+int32_t MpgScale::update(int32_t counts, uint32_t dt_ms) {
+    if (dt_ms == 0) return scale;
+    if (dt_ms > MPG_SPEED_TAU_MS) dt_ms = MPG_SPEED_TAU_MS;
+    const int32_t abs_counts = (counts < 0) ? -counts : counts;
+    const int64_t inst_q8 = ((int64_t)abs_counts * 1000 << 8) / dt_ms;
+    speed_q8 += (int32_t)(((inst_q8 - speed_q8) * (int64_t)dt_ms) / (int64_t)MPG_SPEED_TAU_MS);
+
+    const int32_t cps = speed_q8 >> 8;
+    const int32_t keep = 100 - MPG_SCALE_HYST_PCT;
+    if (cps > MPG_X100_CPS) scale = 100;
+    else if (scale == 100 && cps * 100 >= MPG_X100_CPS * keep) scale = 100;
+    else if (cps > MPG_X10_CPS) scale = 10;
+    else if (scale >= 10 && cps * 100 >= MPG_X10_CPS * keep) scale = 10;
+    else scale = 1;
+    return scale;
+}
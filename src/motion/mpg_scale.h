@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+
+// ============================================================================
+// MPG jog scale (x1/x10/x100) from wheel speed, one update() per motion
+// tick with the counts since the last. MpgEncoder runs it; no driver types
+// here, so the logic builds on the host.
+// ============================================================================
+
+class MpgScale {
+public:
+    // Takes the tick's counts and returns the scale they go out at
+    int32_t update(int32_t counts, uint32_t dt_ms);
+
+    // Wheel at rest, x1
+    void reset() { speed_q8 = 0; scale = 1; }
+
+    int32_t get() const { return scale; }
+    // Smoothed wheel speed, counts/s
+    int32_t getCps() const { return speed_q8 >> 8; }
+
+private:
+    int32_t speed_q8 = 0;  // Counts/s << 8
+    int32_t scale = 1;
+};
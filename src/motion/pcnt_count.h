@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+
+// ============================================================================
+// PCNT count extension, shared by the encoder units and the spindle STEP
+// counter. A unit only counts between its limits: on reaching one the
+// hardware resets it to 0 and counts on, and the watch point callback folds
+// the limit into a 32-bit accumulator, so the accumulator plus the unit's
+// count is the extended count. The callback must not clear the unit: edges
+// between the reset and the callback are already in it. It wraps at 32 bits
+// by design (SpindleTracker unwraps the spindle count downstream).
+// No driver types here, so the logic builds on the host.
+// ============================================================================
+
+class PcntCount {
+public:
+    // Watch point callback: the unit reached watch_value and has reset itself.
+    // Always inlined, so it is in IRAM with the callback.
+    __attribute__((always_inline)) static inline int32_t fold(int32_t accum, int32_t watch_value) {
+        return (int32_t)((uint32_t)accum + (uint32_t)watch_value);
+    }
+
+    // Extended count; read_unit() returns the unit's count. The callback may
+    // fold the unit between the two reads, so retry until the accumulator
+    // holds. Between the hardware reset and the callback (a few us, longer
+    // from the other core or an ISR) the unit reads near 0 with the old
+    // accumulator, a whole limit off: last, a count read since the unit last
+    // moved limit / 2, says which side of the reset the count is on. The
+    // owner reads the count every motion tick and keeps it as last.
+    template <typename ReadUnit>
+    static int32_t read(const volatile int32_t &accum, int32_t last, int32_t limit, ReadUnit read_unit) {
+        int32_t base;
+        int32_t count;
+        do {
+            base = accum;
+            count = read_unit();
+        } while (base != accum);
+        uint32_t c = (uint32_t)base + (uint32_t)count;
+        const int32_t d = (int32_t)(c - (uint32_t)last);
+        if (d < -limit / 2) c += (uint32_t)limit;
+        else if (d > limit / 2) c -= (uint32_t)limit;
+        return (int32_t)c;
+    }
+};
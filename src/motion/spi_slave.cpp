@@ -7,6 +7,8 @@
 // Static member initialization
 CommandPacket SpiSlave::last_command = {};
 StatusPacket SpiSlave::current_status = {};
+TelemetryPacket SpiSlave::telemetry[(size_t)EncoderIdProto::COUNT] = {};
+bool SpiSlave::tx_telemetry = false;
 volatile bool SpiSlave::transaction_pending = false;
 bool SpiSlave::connected = false;
 uint32_t SpiSlave::last_rx_ms = 0;
@@ -120,9 +122,21 @@ void SpiSlave::process() {
         }
     }
     
-    // Prepare next transaction with updated status
-    memcpy(tx_buffer, &current_status, sizeof(current_status));
-    protocolSign(tx_buffer, sizeof(current_status));
+    // Prepare next transaction: updated status, or now and then telemetry
+    static uint32_t tx_count = 0;
+    static uint8_t telemetry_index = 0;
+    tx_telemetry = (SPI_TELEMETRY_EVERY > 0 && ++tx_count % SPI_TELEMETRY_EVERY == 0);
+    if (tx_telemetry) {
+        TelemetryPacket &t = telemetry[telemetry_index];
+        telemetry_index = (uint8_t)((telemetry_index + 1) % (uint8_t)EncoderIdProto::COUNT);
+        t.version = PROTOCOL_VERSION | PROTOCOL_TELEMETRY;
+        t.sequence = current_status.sequence;
+        memcpy(tx_buffer, &t, sizeof(t));
+        protocolSign(tx_buffer, sizeof(t));
+    } else {
+        memcpy(tx_buffer, &current_status, sizeof(current_status));
+        protocolSign(tx_buffer, sizeof(current_status));
+    }
     
     // Re-queue for next transaction
     memset(&slave_trans, 0, sizeof(slave_trans));
@@ -139,6 +153,13 @@ void SpiSlave::setStatus(const StatusPacket& status) {
     
     // Also update the TX buffer immediately so it's ready for the next transaction
     // This helps ensure the slave always has valid data to send
+    if (tx_telemetry) return;  // Telemetry queued; status goes out next time
     memcpy(tx_buffer, &current_status, sizeof(current_status));
     protocolSign(tx_buffer, sizeof(current_status));
 }
+
+void SpiSlave::setTelemetry(const TelemetryPacket& t) {
+    const size_t i = (size_t)t.encoder;
+    if (i >= (size_t)EncoderIdProto::COUNT) return;
+    telemetry[i] = t;
+}
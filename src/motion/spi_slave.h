@@ -19,6 +19,10 @@ public:
     
     // Update status to be sent on next transaction
     static void setStatus(const StatusPacket& status);
+
+    // Update one encoder's telemetry; every SPI_TELEMETRY_EVERY transactions
+    // the next encoder's packet goes out instead of the status
+    static void setTelemetry(const TelemetryPacket& telemetry);
     
     // Check if we have valid communication
     static bool isConnected() { return connected; }
@@ -29,6 +33,8 @@ public:
 private:
     static CommandPacket last_command;
     static StatusPacket current_status;
+    static TelemetryPacket telemetry[(size_t)EncoderIdProto::COUNT];
+    static bool tx_telemetry;       // tx_buffer holds telemetry, not status
     static bool connected;
     static uint32_t last_rx_ms;
 };
@@ -0,0 +1,72 @@
+#include "spindle_index.h"
+#include "config_motion.h"
+
+// ============================================================================
+// Each pulse middle is checked twice.
+// - Against the previous pulse: the counts in between, less
+//   C_COUNTS_PER_REV per whole revolution, is the per-revolution error
+//   (a reversal that crosses the same pulse again is no revolution).
+// - Against SPINDLE_INDEX_PHASE: how far the count has drifted. Two pulses
+//   in a row that agree make a correction. The first one re-homes the
+//   count; that one is a new reference, not lost counts.
+// Counts are in half counts (x2) until the end: an odd pulse width puts
+// the middle between two counts.
+// ============================================================================
+SpindleIndex::Correction SpindleIndex::take(int64_t c2, bool home_allowed) {
+    static constexpr int64_t REV2 = 2 * (int64_t)C_COUNTS_PER_REV;
+    const bool have_prev = have_last;
+
+    int64_t revs = 0;
+    int64_t abs_d2 = 0;
+    if (have_last) {
+        const int64_t d2 = c2 - last_c2;
+        abs_d2 = (d2 < 0) ? -d2 : d2;
+        revs = (abs_d2 + REV2 / 2) / REV2;
+    }
+    last_c2 = c2;
+    have_last = true;
+
+    int64_t e2 = (c2 - 2 * (int64_t)SPINDLE_INDEX_PHASE) % REV2;
+    if (e2 >= C_COUNTS_PER_REV) e2 -= REV2;
+    else if (e2 < -C_COUNTS_PER_REV) e2 += REV2;
+    const int64_t agree = e2 - last_e2;
+    const bool confirmed = have_prev && agree <= 1 && agree >= -1;
+    last_e2 = e2;
+    // Whole counts from where the re-home left it; a half count either way
+    // is the pulse edges, not lost counts
+    const int32_t fix = (int32_t)(-(e2 - home_e2) / 2);
+    const int32_t abs_fix = (fix < 0) ? -fix : fix;
+
+    const bool homed = st.homed;
+    bool home = false;
+    bool correct = false;
+    if (SPINDLE_INDEX_REHOME && confirmed) {
+        if (!homed) home = home_allowed;
+        else correct = (fix != 0 && (abs_fix <= SPINDLE_INDEX_MAX_CORRECT || home_allowed));
+    }
+    if (home || correct) {
+        last_c2 += 2 * (int64_t)fix;
+        last_e2 += 2 * (int64_t)fix;
+        if (home) home_e2 = e2 + 2 * (int64_t)fix;
+    }
+    const bool slipped = (homed && fix != 0 && last_fix == 0);
+    last_fix = (home || correct) ? 0 : fix;
+
+    st.pulses++;
+    if (revs > 0) {
+        const int32_t err = (int32_t)((abs_d2 - revs * REV2) / (2 * revs));
+        const int32_t abs_err = (err < 0) ? -err : err;
+        st.rev_error = err;
+        if (abs_err > st.peak_rev_error) st.peak_rev_error = abs_err;
+        cal_c2 += abs_d2;
+        cal_revs += revs;
+    }
+    if (slipped) st.slips++;
+    if (home) st.homed = true;
+    if (correct) st.corrected += fix;
+
+    Correction c;
+    c.counts = (home || correct) ? fix : 0;
+    c.home = home;
+    return c;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+
+// Spindle index (Z channel) checks, encoder mode with C_PIN_INDEX
+struct SpindleIndexStats {
+    bool homed;                 // Count re-homed to the index since boot
+    uint32_t pulses;            // Index pulses taken
+    uint32_t rejected;          // Wider than SPINDLE_INDEX_MAX_WIDTH
+    int32_t rev_error;          // Counts in the last revolution minus C_COUNTS_PER_REV
+    int32_t peak_rev_error;     // Largest |rev_error| since boot
+    uint32_t slips;             // Times the index found the count off phase
+    int32_t corrected;          // Counts put back since homing (signed sum)
+};
+
+// ============================================================================
+// Spindle index checks and count corrections, one call per index pulse with
+// the pulse's middle as the spindle count had it. EncoderMotion latches the
+// pulses and applies the corrections; no driver types here, so the logic
+// builds on the host.
+// ============================================================================
+
+class SpindleIndex {
+public:
+    struct Correction {
+        int32_t counts;  // To add to the spindle count (0: none)
+        bool home;       // The re-home: a new reference, not lost counts
+    };
+
+    // c2: twice the count at the middle of the pulse (rise + fall edge
+    // counts, unwrapped, with every correction so far applied).
+    // home_allowed: the ELS isn't following the spindle, so the first
+    // re-home and corrections above SPINDLE_INDEX_MAX_CORRECT may be made.
+    Correction take(int64_t c2, bool home_allowed);
+
+    // rejected is the ISR's to fill in
+    const SpindleIndexStats &stats() const { return st; }
+
+    // Calibration: twice the counts over cal_revs whole revolutions
+    int64_t calC2() const { return cal_c2; }
+    int64_t calRevs() const { return cal_revs; }
+
+private:
+    SpindleIndexStats st = {};
+    int64_t cal_c2 = 0;
+    int64_t cal_revs = 0;
+    bool have_last = false;
+    int64_t last_c2 = 0;  // Twice the count at the middle of the last pulse
+    int64_t last_e2 = 0;  // Its phase error, half counts
+    int64_t home_e2 = 0;  // Phase error left by the re-home (-1..1)
+    int32_t last_fix = 0;
+};
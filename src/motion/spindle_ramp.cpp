@@ -0,0 +1,115 @@
+#include "spindle_ramp.h"
+#include "esp_attr.h"
+
+static uint32_t IRAM_ATTR isqrt64(uint64_t x) {
+    uint64_t r = 0;
+    uint64_t bit = 1ULL << 62;
+    while (bit > x) bit >>= 2;
+    while (bit != 0) {
+        if (x >= r + bit) {
+            x -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)r;
+}
+
+void SpindleRamp::start() {
+    v_q8 = V_MIN_Q8;
+    a_q8 = 0;
+    v_carry = 0;
+    a_carry = 0;
+    frac = 0;
+}
+
+uint32_t IRAM_ATTR SpindleRamp::next(uint32_t t_q8) {
+    // At constant speed the 64-bit divide is skipped
+    if (v_q8 != period_v) {
+        period_v = v_q8;
+        period_q16 = (uint32_t)(TICKS_Q16_PER_SEC * 256 / v_q8);
+    }
+    const uint32_t acc = frac + period_q16;
+    uint32_t period = acc >> 16;
+    frac = acc & 0xFFFF;
+    if (period < MIN_PERIOD_TICKS) period = MIN_PERIOD_TICKS;
+    if (period > MAX_PERIOD_TICKS) period = MAX_PERIOD_TICKS;
+
+    advance(t_q8, period_q16);
+    if (v_q8 < V_MIN_Q8) v_q8 = V_MIN_Q8;
+    return period;
+}
+
+// Advance speed and acceleration over one step period towards t_q8. Without
+// jerk the acceleration is simply +-accel; with it the acceleration ramps at
+// jerk and is held to sqrt(2 * jerk * speed error) so it reaches zero just
+// as the speed reaches the target (S-curve).
+void IRAM_ATTR SpindleRamp::advance(uint32_t t_q8, uint32_t period_q16) {
+    const int64_t dv = (int64_t)t_q8 - (int64_t)v_q8;
+    if (dv == 0) {
+        a_q8 = 0;
+        return;
+    }
+    const uint64_t dv_abs = (dv < 0) ? (uint64_t)-dv : (uint64_t)dv;
+
+    int64_t a;
+    if (jerk_q8 <= 0) {
+        a = accel_q8;
+    } else {
+        int64_t a_lim = (int64_t)isqrt64(2 * (uint64_t)jerk_q8 * dv_abs);
+        if (a_lim > accel_q8) a_lim = accel_q8;
+        const int64_t a_des = (dv < 0) ? -a_lim : a_lim;
+        const uint64_t da_num = (uint64_t)jerk_q8 * period_q16 + a_carry;
+        const int64_t da = (int64_t)(da_num / TICKS_Q16_PER_SEC);
+        a_carry = da_num % TICKS_Q16_PER_SEC;
+        a = a_q8;
+        if (a < a_des) a = (a_des - a > da) ? a + da : a_des;
+        else if (a > a_des) a = (a - a_des > da) ? a - da : a_des;
+        a_q8 = a;
+        if (a == 0) return;
+        if ((a < 0) != (dv < 0)) {
+            // Still shedding acceleration from the other way
+            const uint64_t num = (uint64_t)(a < 0 ? -a : a) * period_q16 + v_carry;
+            const int64_t step = (int64_t)(num / TICKS_Q16_PER_SEC);
+            v_carry = num % TICKS_Q16_PER_SEC;
+            const int64_t v = (int64_t)v_q8 + ((a < 0) ? -step : step);
+            v_q8 = (uint32_t)((v < 0) ? 0 : (v > (int64_t)V_MAX_Q8 ? (int64_t)V_MAX_Q8 : v));
+            return;
+        }
+        if (a < 0) a = -a;
+    }
+
+    const uint64_t num = (uint64_t)a * period_q16 + v_carry;
+    const uint64_t step = num / TICKS_Q16_PER_SEC;
+    v_carry = num % TICKS_Q16_PER_SEC;
+    if (step >= dv_abs) {
+        v_q8 = t_q8;
+        a_q8 = 0;
+        v_carry = 0;
+    } else {
+        v_q8 = (dv < 0) ? v_q8 - (uint32_t)step : v_q8 + (uint32_t)step;
+    }
+}
+
+// v^2 / (2 a), with jerk v^2 / (2 a) + v a / (2 j) plus the v a / (2 j) the
+// S-curve runs behind a falling target
+uint32_t IRAM_ATTR SpindleRamp::stopSpeed(uint32_t left) const {
+    if (left >= stop_full_steps) return V_MAX_Q8;
+    uint64_t d = left;
+    if (jerk_q8 <= 0) return isqrt64(2 * (uint64_t)accel_q8 * d * 256);
+    const uint64_t lag = (uint64_t)v_q8 * (uint64_t)accel_q8 / (512 * jerk_div_q8);
+    d = (d > lag + 1) ? d - lag : 1;
+    const uint64_t k = (uint64_t)accel_q8 * (uint64_t)accel_q8 / jerk_div_q8;
+    return (isqrt64(k * k + 8 * (uint64_t)accel_q8 * d * 256) - (uint32_t)k) / 2;
+}
+
+// v^2 / (2 a) (+ v a / (2 j) with jerk), and the few steps more the ramp
+// takes moving on one whole step at a time (up to 4 without jerk)
+uint32_t SpindleRamp::rampDownSteps(uint32_t from_q8) const {
+    const uint64_t v = from_q8;
+    uint64_t d = v * v / (512 * (uint64_t)accel_q8);
+    if (jerk_q8 > 0) d += v * (uint64_t)accel_q8 / (256 * jerk_div_q8);
+    return (uint32_t)d + 5;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+#include "config_motion.h"
+
+// ============================================================================
+// Spindle pulse synthesizer ramp: one step at a time, the period of the
+// step at the speed reached so far, then the speed (and acceleration) moved
+// on over that period towards the target. Speeds are steps/s in Q8,
+// accelerations steps/s^2 in Q8, jerk steps/s^3 in Q8; periods are RMT
+// ticks in Q16, dithered to whole ticks with the fraction carried so the
+// average rate is exact. Fixed point, no RMT types: SpindleStepper's
+// encoder runs it from the TX ISR, and it also builds on the host.
+// ============================================================================
+
+class SpindleRamp {
+public:
+    static constexpr uint32_t RES_HZ = SPINDLE_RMT_RES_HZ;
+    static constexpr uint32_t MIN_PERIOD_TICKS = (uint32_t)((uint64_t)SPINDLE_MIN_STEP_PERIOD_US * RES_HZ / 1000000);
+    static constexpr uint32_t MAX_PERIOD_TICKS = (uint32_t)((uint64_t)SPINDLE_MAX_STEP_PERIOD_US * RES_HZ / 1000000);
+    static constexpr uint32_t V_MAX_Q8 = (uint32_t)(((uint64_t)RES_HZ << 8) / MIN_PERIOD_TICKS);
+    static constexpr uint32_t V_MIN_Q8 = (uint32_t)(((uint64_t)RES_HZ << 8) / MAX_PERIOD_TICKS);
+
+    // Limits in RPM/s and RPM/s^2; jerk 0 gives a plain trapezoidal ramp
+    constexpr SpindleRamp(int32_t accel_rpm_per_sec, int32_t jerk_rpm_per_sec2)
+        : accel_q8(((int64_t)accel_rpm_per_sec * SPINDLE_STEPS_PER_REV << 8) / 60),
+          jerk_q8(((int64_t)jerk_rpm_per_sec2 * SPINDLE_STEPS_PER_REV << 8) / 60),
+          jerk_div_q8((jerk_q8 > 0) ? (uint64_t)jerk_q8 : 1),
+          stop_full_steps(stopFullSteps(accel_q8, jerk_q8, jerk_div_q8)) {}
+
+    // New stream: at V_MIN_Q8, no acceleration, no carries
+    void start();
+
+    // Period of the next step, whole ticks in [MIN_PERIOD_TICKS,
+    // MAX_PERIOD_TICKS]; the ramp then moves on over it towards t_q8
+    // (0 ramps down to V_MIN_Q8)
+    uint32_t next(uint32_t t_q8);
+
+    // Fastest speed that still ramps down within left steps from the
+    // current one (V_MAX_Q8 when further than a stop from full speed)
+    uint32_t stopSpeed(uint32_t left) const;
+
+    // Steps a ramp down from from_q8 takes at these limits
+    uint32_t rampDownSteps(uint32_t from_q8) const;
+
+    uint32_t speed() const { return v_q8; }
+
+private:
+    static constexpr uint64_t TICKS_Q16_PER_SEC = (uint64_t)RES_HZ << 16;
+
+    // Past it stopSpeed() is V_MAX_Q8, which also keeps its products in range
+    static constexpr uint64_t stopFullSteps(int64_t accel, int64_t jerk, uint64_t jerk_div) {
+        return (uint64_t)V_MAX_Q8 * V_MAX_Q8 / (512 * (uint64_t)accel) +
+               ((jerk > 0) ? (uint64_t)V_MAX_Q8 * (uint64_t)accel / (256 * jerk_div) : 0) + 1;
+    }
+
+    void advance(uint32_t t_q8, uint32_t period_q16);
+
+    int64_t accel_q8;
+    int64_t jerk_q8;
+    uint64_t jerk_div_q8;  // Divisor for the jerk terms, only used when jerk_q8 > 0
+    uint64_t stop_full_steps;
+
+    uint32_t v_q8 = 0;
+    int64_t a_q8 = 0;
+    uint64_t v_carry = 0;  // Division remainders, so small
+    uint64_t a_carry = 0;  // per-step changes still add up
+    uint32_t frac = 0;     // Dither carry, Q16 ticks
+    uint32_t period_v = 0; // Speed period_q16 is for
+    uint32_t period_q16 = 0;
+};
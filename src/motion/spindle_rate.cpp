@@ -0,0 +1,127 @@
+#include "spindle_rate.h"
+#include "config_motion.h"
+#include <Arduino.h>
+
+// Written by the motion task, read from the SPI loop on the other core and
+// from the ELS; the lock keeps speed, acceleration and their time together
+static portMUX_TYPE rate_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static constexpr uint8_t MASK = 63;
+// Edges are the speed event unit's limits: SPINDLE_RATE_EVENT_COUNTS apart
+static constexpr int64_t COUNTS_PER_EDGE = SPINDLE_RATE_EVENT_COUNTS;
+
+void SpindleRate::reset() {
+    portENTER_CRITICAL_SAFE(&rate_mux);
+    head = 0;
+    filled = 0;
+    vel_mcps = 0;
+    acc_cps2 = 0;
+    window_us = 0;
+    acc_ref_valid = false;
+    portEXIT_CRITICAL_SAFE(&rate_mux);
+}
+
+void SpindleRate::update(int32_t edge_count, uint32_t edge_us, uint32_t now_us) {
+    static_assert((HISTORY & (HISTORY - 1)) == 0 && HISTORY - 1 == MASK, "HISTORY must be 64");
+
+    if (filled == 0 || edge_us != edges[(uint8_t)(head - 1) & MASK].t_us) {
+        edges[head].count = edge_count;
+        edges[head].t_us = edge_us;
+        head = (head + 1) & MASK;
+        if (filled < HISTORY) filled++;
+    }
+
+    // Walk back from the newest edge until the window is long enough and
+    // spans enough counts; otherwise take the oldest edge inside MAX_US
+    const Edge &n = edges[(uint8_t)(head - 1) & MASK];
+    const Edge *ref = nullptr;
+    for (int k = 1; k < filled; k++) {
+        const Edge &e = edges[(uint8_t)(head - 1 - k) & MASK];
+        const uint32_t dt = n.t_us - e.t_us;
+        if (dt > SPINDLE_RATE_MAX_US || dt == 0) break;
+        ref = &e;
+        const int32_t dc = (int32_t)((uint32_t)n.count - (uint32_t)e.count);
+        if (dt >= SPINDLE_RATE_MIN_US && (dc >= SPINDLE_RATE_MIN_COUNTS || dc <= -SPINDLE_RATE_MIN_COUNTS)) break;
+    }
+
+    const uint32_t since_us = now_us - n.t_us;
+    const bool measured = (ref != nullptr && since_us <= SPINDLE_RATE_MAX_US);
+    int32_t vel = 0;
+    uint32_t t_mid = now_us;
+    uint32_t span = 0;
+    if (measured) {
+        span = n.t_us - ref->t_us;
+        const int32_t dc = (int32_t)((uint32_t)n.count - (uint32_t)ref->count);
+        vel = (int32_t)(((int64_t)dc * 1000000000LL) / (int64_t)span);
+        t_mid = ref->t_us + span / 2;
+        // No edge for longer than one edge at this speed: slower than that
+        const int64_t bound = (since_us > 0) ? (COUNTS_PER_EDGE * 1000000000LL) / since_us : INT32_MAX;
+        if ((int64_t)vel > bound || (int64_t)vel < -bound) {
+            vel = (vel < 0) ? -(int32_t)bound : (int32_t)bound;
+            t_mid = now_us;
+        }
+    }
+
+    int32_t acc = acc_cps2;
+    bool acc_valid = acc_ref_valid;
+    if (!measured) {
+        acc = 0;
+        acc_valid = false;
+    } else if (!acc_valid) {
+        acc_ref_mcps = vel;
+        acc_ref_t = t_mid;
+        acc_valid = true;
+    } else if ((int32_t)(t_mid - acc_ref_t) >= (int32_t)SPINDLE_RATE_ACCEL_US) {
+        acc = (int32_t)(((int64_t)(vel - acc_ref_mcps) * 1000) / (int32_t)(t_mid - acc_ref_t));
+        acc_ref_mcps = vel;
+        acc_ref_t = t_mid;
+    }
+
+    portENTER_CRITICAL_SAFE(&rate_mux);
+    vel_mcps = vel;
+    acc_cps2 = acc;
+    acc_ref_valid = acc_valid;
+    t_est = t_mid;
+    window_us = span;
+    portEXIT_CRITICAL_SAFE(&rate_mux);
+}
+
+int32_t SpindleRate::getMilliCountsPerSec() {
+    portENTER_CRITICAL_SAFE(&rate_mux);
+    const int32_t v = vel_mcps;
+    portEXIT_CRITICAL_SAFE(&rate_mux);
+    return v;
+}
+
+int32_t SpindleRate::getCountsPerSecAt(uint32_t t_us) {
+    portENTER_CRITICAL_SAFE(&rate_mux);
+    const int32_t v = vel_mcps;
+    const int32_t a = acc_cps2;
+    int32_t dt = (int32_t)(t_us - t_est);
+    portEXIT_CRITICAL_SAFE(&rate_mux);
+
+    if (dt < 0) dt = 0;
+    if (dt > (int32_t)SPINDLE_RATE_ACCEL_US) dt = (int32_t)SPINDLE_RATE_ACCEL_US;
+    const int64_t p = (int64_t)v + ((int64_t)a * dt) / 1000;
+    // Extrapolation never turns the spindle around
+    if ((v > 0 && p < 0) || (v < 0 && p > 0)) return 0;
+    return (int32_t)(p / 1000);
+}
+
+int32_t SpindleRate::getMilliRpm() {
+    return (int32_t)(((int64_t)getMilliCountsPerSec() * 60) / C_COUNTS_PER_REV);
+}
+
+int32_t SpindleRate::getRpmPerSec() {
+    portENTER_CRITICAL_SAFE(&rate_mux);
+    const int32_t a = acc_cps2;
+    portEXIT_CRITICAL_SAFE(&rate_mux);
+    return (int32_t)(((int64_t)a * 60) / C_COUNTS_PER_REV);
+}
+
+uint32_t SpindleRate::getWindowUs() {
+    portENTER_CRITICAL_SAFE(&rate_mux);
+    const uint32_t w = window_us;
+    portEXIT_CRITICAL_SAFE(&rate_mux);
+    return w;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+
+// ============================================================================
+// Spindle speed from edge timestamps (period measurement)
+// Fed once per motion tick with the newest timestamped encoder edge; speed is
+// the count difference to an older edge over their exact time apart, so its
+// precision is set by the edge timestamps, not the tick. The window adapts
+// (SPINDLE_RATE_*): short at speed, long enough below ~60 RPM to hold
+// SPINDLE_RATE_MIN_COUNTS. Fixed point so the ELS can read it anywhere.
+// No driver types here, so the logic builds on the host.
+// ============================================================================
+
+class SpindleRate {
+public:
+    // Forget all edges, speed zero
+    void reset();
+
+    // Motion task, every tick: newest edge (count at the edge, esp_timer us)
+    // and the current time, which bounds the speed while no edge comes
+    void update(int32_t edge_count, uint32_t edge_us, uint32_t now_us);
+
+    // Counts per second x1000, signed
+    int32_t getMilliCountsPerSec();
+    // Speed extrapolated with the acceleration to t_us, counts per second
+    int32_t getCountsPerSecAt(uint32_t t_us);
+    // RPM x1000, signed
+    int32_t getMilliRpm();
+    // RPM per second, signed (positive = speeding up in the + direction)
+    int32_t getRpmPerSec();
+    // Length of the window behind the current estimate
+    uint32_t getWindowUs();
+
+private:
+    static constexpr int HISTORY = 64;  // Power of two
+
+    struct Edge {
+        int32_t count;
+        uint32_t t_us;
+    };
+    Edge edges[HISTORY] = {};
+    uint8_t head = 0;       // Next slot
+    uint8_t filled = 0;
+
+    int32_t vel_mcps = 0;   // Counts/s x1000
+    int32_t acc_cps2 = 0;   // Counts/s^2
+    uint32_t t_est = 0;     // Middle of the window vel_mcps was measured over
+    uint32_t window_us = 0;
+    int32_t acc_ref_mcps = 0;
+    uint32_t acc_ref_t = 0;
+    bool acc_ref_valid = false;
+};
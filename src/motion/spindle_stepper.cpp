@@ -2,32 +2,305 @@
 #include "config_motion.h"
 #include "mpg_encoder.h"
 #include <Arduino.h>
-#include "esp32-hal-rmt.h"
+#include "esp_timer.h"
+#include "driver/pulse_cnt.h"
+#include "driver/gpio.h"
+#include "driver/rmt_tx.h"
+#include "pcnt_count.h"
+#include "spindle_ramp.h"
+#include "spindle_synth.h"
+#include "step_slots.h"
+
+#if ELS_DRIVE_MODE == ELS_DRIVE_COUPLED
+#include "els_gear.h"
+#include "stepper.h"
+#endif
 
 // ============================================================================
 // Static member initialization
 // ============================================================================
-volatile int32_t SpindleStepper::position = 0;
 int16_t SpindleStepper::rpm_signed = 0;
 int16_t SpindleStepper::rpm_abs = 0;
 int16_t SpindleStepper::target_rpm = 0;
-int16_t SpindleStepper::current_rpm = 0;
 int8_t SpindleStepper::direction = 0;
+int8_t SpindleStepper::stop_hold_dir = 0;
 bool SpindleStepper::running = false;
+volatile bool SpindleStepper::c_move = false;
+int64_t SpindleStepper::c_goal = 0;
+int32_t SpindleStepper::c_speed_q8 = 0;
 
-uint32_t SpindleStepper::last_update_us = 0;
-uint32_t SpindleStepper::last_dt_us = 0;
-uint32_t SpindleStepper::step_period_us = 0;
-int32_t SpindleStepper::steps_per_sec = 0;
-int64_t SpindleStepper::step_accumulator_fp = 0;
 bool SpindleStepper::rmt_ready = false;
+SpindleTracker SpindleStepper::tracker;
+
+// ============================================================================
+// Frequency synthesizer state. Speeds are steps/s in Q8 (see SpindleRamp).
+// The motion task writes the signed target; everything else belongs to the
+// encoder callback while tx_busy.
+// ============================================================================
+static constexpr uint32_t RES_HZ = SpindleRamp::RES_HZ;
+static constexpr uint32_t PULSE_TICKS =
+    ((uint64_t)SPINDLE_PULSE_US * RES_HZ / 1000000) > 0 ? (uint32_t)((uint64_t)SPINDLE_PULSE_US * RES_HZ / 1000000) : 1;
+static constexpr uint32_t MIN_PERIOD_TICKS = SpindleRamp::MIN_PERIOD_TICKS;
+static constexpr uint32_t MAX_PERIOD_TICKS = SpindleRamp::MAX_PERIOD_TICKS;
+static constexpr uint32_t MAX_LOW_TICKS = 0x7FFF;  // 15-bit symbol duration
+static_assert(MIN_PERIOD_TICKS > PULSE_TICKS, "SPINDLE_MIN_STEP_PERIOD_US too short for the pulse");
+static_assert(MAX_PERIOD_TICKS - PULSE_TICKS <= MAX_LOW_TICKS, "SPINDLE_MAX_STEP_PERIOD_US does not fit one RMT symbol");
+static_assert(MAX_PERIOD_TICKS <= 0xFFFF, "SPINDLE_MAX_STEP_PERIOD_US does not fit a step slot");
+
+static constexpr uint32_t V_MAX_Q8 = SpindleRamp::V_MAX_Q8;
+static constexpr uint32_t V_MIN_Q8 = SpindleRamp::V_MIN_Q8;
+
+static volatile int32_t synth_target_q8 = 0;  // Signed, 0 = ramp down and stop
+static volatile uint32_t synth_speed_q8 = 0;  // Speed of the last encoded step
+static volatile uint32_t synth_encoded = 0;   // Signed pulses encoded, wraps
+static volatile bool tx_busy = false;
+static volatile bool tx_forward = true;
+static SpindleSynth synth(SPINDLE_ACCEL_RPM_PER_SEC, SPINDLE_JERK_RPM_PER_SEC2);
+
+static rmt_channel_handle_t step_chan = nullptr;
+static rmt_encoder_handle_t step_encoder = nullptr;
+
+// ============================================================================
+// Step slots (StepSlots): a slot is generated when the first stream needs
+// it, so the spindle and a coupled Z stream read one timeline each at their
+// own pace. Generator, slots and cursors are all under synth_mux.
+// ============================================================================
+static StepSlots slots;
+static portMUX_TYPE synth_mux = portMUX_INITIALIZER_UNLOCKED;
+
+#if ELS_DRIVE_MODE == ELS_DRIVE_COUPLED
+static constexpr uint32_t Z_TICKS_PER_TICK = ELS_RMT_RES_HZ / SPINDLE_RMT_RES_HZ;
+#endif
+
+// Next slot from the ramp; false once the stream has ended
+static bool IRAM_ATTR synth_generate() {
+    if (synth.ended()) return false;
+    const bool stop_armed = synth.stopArmed();
+    const uint32_t period = synth.next(synth_target_q8, tx_forward);
+    // Stopped on its step (stopAt(), C move): held at rest, nothing
+    // restarts it until updateSpeed() says so
+    if (period == 0 && stop_armed) synth_target_q8 = 0;
+    slots.generate((uint16_t)period, tx_forward);
+    return true;
+}
+
+// ============================================================================
+// RMT streaming encoder: called on rmt_transmit() and then from the TX ISR
+// whenever channel memory frees up. One symbol per slot, PULSE_TICKS high
+// and the rest of the period low; the period comes from the speed the ramp
+// has reached at that step, with its fraction carried into the next one.
+// Ends the transmission at the end slot, which the generator writes once
+// the ramp is down to the minimum speed and the target is zero or the other
+// way round.
+// ============================================================================
+static size_t IRAM_ATTR encode_spindle(const void *data, size_t data_size,
+                                       size_t symbols_written, size_t symbols_free,
+                                       rmt_symbol_word_t *symbols, bool *done, void *arg) {
+    (void)data;
+    (void)data_size;
+    (void)arg;
+
+    rmt_symbol_word_t pulse = {};
+    pulse.level0 = 1;
+    pulse.duration0 = PULSE_TICKS;
+    pulse.level1 = 0;
+    pulse.duration1 = PULSE_TICKS;
+
+    size_t n = 0;
+    if (symbols_written == 0) {
+        // DIR was switched just before rmt_transmit(): hold STEP low first
+        symbols[n] = pulse;
+        symbols[n].level0 = 0;
+        n++;
+    }
+
+    uint32_t emitted = 0;
+    while (n < symbols_free) {
+        portENTER_CRITICAL_SAFE(&synth_mux);
+        uint32_t period = 0;
+        if (slots.spindleReady() || synth_generate()) period = slots.takeSpindle();
+        portEXIT_CRITICAL_SAFE(&synth_mux);
+        if (period == 0) {
+            *done = true;
+            break;
+        }
+
+        symbols[n] = pulse;
+        symbols[n].duration1 = period - PULSE_TICKS;
+        n++;
+        emitted++;
+    }
+
+    if (emitted != 0) {
+        synth_encoded = tx_forward ? synth_encoded + emitted : synth_encoded - emitted;
+    }
+    synth_speed_q8 = synth.speed();
+    return n;
+}
+
+static bool IRAM_ATTR on_tx_done(rmt_channel_handle_t channel,
+                                 const rmt_tx_done_event_data_t *edata,
+                                 void *user_ctx) {
+    (void)channel;
+    (void)edata;
+    (void)user_ctx;
+    tx_busy = false;
+    synth_speed_q8 = 0;
+    return false;
+}
+
+#if ELS_DRIVE_MODE == ELS_DRIVE_COUPLED
+// Z stream source (Stepper's encoder, TX ISR): the same slots, in Z ticks.
+// Generates ahead only while the spindle stream runs; ends at the end slot
+// or where the ELS decoupled.
+static bool IRAM_ATTR coupled_segment(int32_t &steps, uint32_t &span_ticks) {
+    bool ok = false;
+    uint32_t period = 0;
+    portENTER_CRITICAL_SAFE(&synth_mux);
+    if (!slots.zEnded() && (slots.zReady() || (tx_busy && synth_generate()))) {
+        ok = slots.takeZ(steps, period);
+    }
+    portEXIT_CRITICAL_SAFE(&synth_mux);
+    span_ticks = period * Z_TICKS_PER_TICK;
+    return ok;
+}
+#endif
+
+// Emitted-pulse counter (SPINDLE_STEP_PCNT)
+static pcnt_unit_handle_t step_unit = nullptr;
+static volatile int32_t step_accum = 0;  // Overflow folds, wraps at 32 bits
+static int32_t step_last = 0;            // Count at the last update() (PcntCount::read)
+
+// The unit has reset itself; clearing it here would drop the pulses since
+static bool IRAM_ATTR onStepReach(pcnt_unit_handle_t unit,
+                                  const pcnt_watch_event_data_t *edata,
+                                  void *user_ctx) {
+    (void)unit;
+    (void)user_ctx;
+    step_accum = PcntCount::fold(step_accum, edata->watch_point_value);
+    return true;
+}
+
+// ============================================================================
+// STEP pulse counter: a PCNT unit counting rising STEP edges, up or down by
+// the DIR level. It has to be set up before the pins are made outputs: the
+// PCNT driver configures its GPIOs as inputs (dropping the RMT/GPIO output
+// routing), and the output setup then turns the input buffers off again, so
+// those are re-enabled last. The PCNT input matrix routing survives both,
+// which leaves the unit reading back the pins' own output.
+// ============================================================================
+bool SpindleStepper::initStepCounter() {
+    pcnt_unit_config_t unit_config = {};
+    unit_config.high_limit = PCNT_H_LIM;
+    unit_config.low_limit  = PCNT_L_LIM;
+
+    pcnt_unit_handle_t unit = nullptr;
+    esp_err_t err = pcnt_new_unit(&unit_config, &unit);
+    if (err != ESP_OK) return false;
+
+    pcnt_chan_config_t chan_config = {};
+    chan_config.edge_gpio_num = SPINDLE_STEP_PIN;
+    chan_config.level_gpio_num = SPINDLE_DIR_PIN;
+
+    pcnt_channel_handle_t chan = nullptr;
+    err = pcnt_new_channel(unit, &chan_config, &chan);
+    if (err != ESP_OK) return false;
+
+    // One count per rising STEP edge (the RMT symbol starts high)
+    err = pcnt_channel_set_edge_action(
+        chan,
+        PCNT_CHANNEL_EDGE_ACTION_INCREASE,
+        PCNT_CHANNEL_EDGE_ACTION_HOLD
+    );
+    if (err != ESP_OK) return false;
+
+    // DIR at its forward level keeps the count direction
+    err = pcnt_channel_set_level_action(
+        chan,
+        SPINDLE_INVERT_DIR ? PCNT_CHANNEL_LEVEL_ACTION_INVERSE : PCNT_CHANNEL_LEVEL_ACTION_KEEP,
+        SPINDLE_INVERT_DIR ? PCNT_CHANNEL_LEVEL_ACTION_KEEP : PCNT_CHANNEL_LEVEL_ACTION_INVERSE
+    );
+    if (err != ESP_OK) return false;
 
-static constexpr int64_t FP_SCALE = 65536;
+    (void)pcnt_unit_add_watch_point(unit, PCNT_H_LIM);
+    (void)pcnt_unit_add_watch_point(unit, PCNT_L_LIM);
+
+    pcnt_event_callbacks_t cbs = {};
+    cbs.on_reach = onStepReach;
+    err = pcnt_unit_register_event_callbacks(unit, &cbs, nullptr);
+    if (err != ESP_OK) return false;
+
+    err = pcnt_unit_enable(unit);
+    if (err != ESP_OK) return false;
+    err = pcnt_unit_clear_count(unit);
+    if (err != ESP_OK) return false;
+    step_accum = 0;
+    step_last = 0;
+    err = pcnt_unit_start(unit);
+    if (err != ESP_OK) return false;
+
+    step_unit = unit;
+    return true;
+}
+
+// Pulses counted on the STEP pin, signed, wraps
+static uint32_t readCounted() {
+    return (uint32_t)PcntCount::read(step_accum, step_last, PCNT_H_LIM, [] {
+        int count = 0;
+        pcnt_unit_get_count(step_unit, &count);
+        return (int32_t)count;
+    });
+}
+
+uint32_t SpindleStepper::readRaw() {
+    if (step_unit == nullptr) return synth_encoded;
+    return readCounted();
+}
+
+// ============================================================================
+// RMT TX channel with the streaming encoder; the channel and its interrupt
+// live on the calling core (core 1)
+// ============================================================================
+bool SpindleStepper::initSynth() {
+    rmt_tx_channel_config_t tx_config = {};
+    tx_config.gpio_num = SPINDLE_STEP_PIN;
+    tx_config.clk_src = RMT_CLK_SRC_DEFAULT;
+    tx_config.resolution_hz = SPINDLE_RMT_RES_HZ;
+    tx_config.mem_block_symbols = SPINDLE_RMT_MEM_SYMBOLS;
+    tx_config.trans_queue_depth = 2;
+    esp_err_t err = rmt_new_tx_channel(&tx_config, &step_chan);
+
+    if (err == ESP_OK) {
+        rmt_simple_encoder_config_t enc_config = {};
+        enc_config.callback = encode_spindle;
+        enc_config.arg = nullptr;
+        enc_config.min_chunk_size = 1;
+        err = rmt_new_simple_encoder(&enc_config, &step_encoder);
+    }
+    if (err == ESP_OK) {
+        rmt_tx_event_callbacks_t cbs = {};
+        cbs.on_trans_done = on_tx_done;
+        err = rmt_tx_register_event_callbacks(step_chan, &cbs, nullptr);
+    }
+    if (err == ESP_OK) {
+        err = rmt_enable(step_chan);
+    }
+    if (err != ESP_OK) {
+        Serial.printf("[SpindleStepper] RMT init failed (%d)\n", (int)err);
+        return false;
+    }
+    return true;
+}
 
 // ============================================================================
 // Initialization
 // ============================================================================
 bool SpindleStepper::init() {
+    // Pulse counter first, see initStepCounter()
+    if (SPINDLE_STEP_PCNT && !initStepCounter()) {
+        Serial.println("[SpindleStepper] Step counter init failed, counting encoded pulses");
+    }
+
     // Configure GPIO pins
     pinMode(SPINDLE_STEP_PIN, OUTPUT);
     pinMode(SPINDLE_DIR_PIN, OUTPUT);
@@ -47,15 +320,15 @@ bool SpindleStepper::init() {
     // Note: MPG encoder is initialized separately in main.cpp
     
     // Initialize RMT for step generation
-    rmt_ready = rmtInit(SPINDLE_STEP_PIN, RMT_TX_MODE, RMT_MEM_NUM_BLOCKS_1, SPINDLE_RMT_RES_HZ);
-    if (!rmt_ready) {
-        Serial.println("[SpindleStepper] RMT init failed");
-        return false;
+    rmt_ready = initSynth();
+    if (!rmt_ready) return false;
+
+    if (step_unit != nullptr) {
+        // Output setup disabled the inputs the PCNT unit reads
+        gpio_input_enable((gpio_num_t)SPINDLE_STEP_PIN);
+        gpio_input_enable((gpio_num_t)SPINDLE_DIR_PIN);
     }
-    rmtSetEOT(SPINDLE_STEP_PIN, 0);
 
-    last_update_us = micros();
-    
     Serial.printf("[SpindleStepper] Initialized: %ld steps/rev, max %ld RPM\n",
         SPINDLE_STEPS_PER_REV, SPINDLE_MAX_RPM);
     
@@ -93,131 +366,117 @@ void SpindleStepper::readControls() {
 }
 
 // ============================================================================
-// Update speed with acceleration limiting
+// Speed: the synthesizer ramps to the target step by step (SPINDLE_ACCEL_*,
+// SPINDLE_JERK_*), through zero on a direction change; the RPM reported is
+// the speed it has reached. With the switch off a C move sets the target.
 // ============================================================================
 void SpindleStepper::updateSpeed() {
-    uint32_t now_us = micros();
-    uint32_t dt_us = now_us - last_update_us;
-    last_update_us = now_us;
-	last_dt_us = dt_us;
-    
-    // Calculate max RPM change for this update interval
-    int32_t max_delta = (SPINDLE_ACCEL_RPM_PER_SEC * (int32_t)dt_us) / 1000000;
-    if (max_delta < 1) max_delta = 1;
-    
-    // Apply acceleration limiting
-    int16_t rpm_target = (direction == 0) ? 0 : target_rpm;
-    
-    if (current_rpm < rpm_target) {
-        current_rpm += max_delta;
-        if (current_rpm > rpm_target) current_rpm = rpm_target;
-    } else if (current_rpm > rpm_target) {
-        current_rpm -= max_delta;
-        if (current_rpm < rpm_target) current_rpm = rpm_target;
-    }
-    
-    // Calculate step period from RPM
-    // steps_per_sec = (RPM / 60) * STEPS_PER_REV
-    // period_us = 1000000 / steps_per_sec
-    
-    if (current_rpm < SPINDLE_MIN_RPM) {
-        // Stopped or too slow
-        step_period_us = 0;
-        steps_per_sec = 0;
-        running = false;
-        step_accumulator_fp = 0;
-    } else {
-        steps_per_sec = ((int32_t)current_rpm * SPINDLE_STEPS_PER_REV) / 60;
-        if (steps_per_sec <= 0) {
-            step_period_us = 0;
-            running = false;
-        } else {
-            uint32_t unclamped_period_us = 1000000UL / (uint32_t)steps_per_sec;
-            step_period_us = unclamped_period_us;
-            if (step_period_us < SPINDLE_MIN_STEP_PERIOD_US)
-                step_period_us = SPINDLE_MIN_STEP_PERIOD_US;
-            if (step_period_us > SPINDLE_MAX_STEP_PERIOD_US)
-                step_period_us = SPINDLE_MAX_STEP_PERIOD_US;
-            if (step_period_us != unclamped_period_us) {
-                steps_per_sec = (int32_t)(1000000UL / step_period_us);
-            }
-            running = true;
-        }
+    // A thread-end stop holds the spindle, once down, until the switch moves
+    if (stop_hold_dir != 0 && direction != stop_hold_dir) stop_hold_dir = 0;
+    const bool held = (stop_hold_dir != 0) && !synth.stopArmed();
+
+    // The switch takes the spindle back from a C move
+    if (c_move && direction != 0) cancelMove();
+
+    int32_t target_q8 = 0;
+    if (c_move) {
+        target_q8 = moveTarget();
+    } else if (direction != 0 && !held && target_rpm >= SPINDLE_MIN_RPM) {
+        int64_t q8 = ((int64_t)target_rpm * SPINDLE_STEPS_PER_REV << 8) / 60;
+        if (q8 > (int64_t)V_MAX_Q8) q8 = V_MAX_Q8;
+        target_q8 = (direction > 0) ? (int32_t)q8 : -(int32_t)q8;
     }
+    synth_target_q8 = target_q8;
 
-    // Update public RPM based on actual step rate
-    if (steps_per_sec > 0) {
-        int16_t actual_rpm = (int16_t)((steps_per_sec * 60) / SPINDLE_STEPS_PER_REV);
-        rpm_abs = actual_rpm;
-        rpm_signed = actual_rpm * direction;
+    const uint32_t v_q8 = synth_speed_q8;
+    running = tx_busy;
+    if (running && v_q8 > 0) {
+        const int32_t rpm = (int32_t)(((uint64_t)v_q8 * 60 + ((uint64_t)SPINDLE_STEPS_PER_REV << 7)) /
+                                      ((uint64_t)SPINDLE_STEPS_PER_REV << 8));
+        rpm_abs = (int16_t)rpm;
+        rpm_signed = tx_forward ? rpm_abs : -rpm_abs;
     } else {
         rpm_abs = 0;
         rpm_signed = 0;
     }
 }
 
-void SpindleStepper::updateRmtLoop() {
-	static uint32_t prev_period_us = 0;
-	static bool loop_active = false;
-
-	const bool want_run = rmt_ready && running && direction != 0 && step_period_us > 0;
-
-	if (want_run) {
-		if (step_period_us != prev_period_us || !loop_active) {
-			const uint32_t tick_us = 1000000UL / SPINDLE_RMT_RES_HZ;
-			uint32_t high_us = SPINDLE_PULSE_US;
-			if (high_us < tick_us) high_us = tick_us;
-			if (high_us >= step_period_us) high_us = step_period_us - tick_us;
-			uint32_t low_us = step_period_us - high_us;
-
-			uint32_t high_ticks = (high_us + tick_us - 1) / tick_us;
-			uint32_t low_ticks = (low_us + tick_us - 1) / tick_us;
-			if (high_ticks < 1) high_ticks = 1;
-			if (low_ticks < 1) low_ticks = 1;
-			if (high_ticks > 32767) high_ticks = 32767;
-			if (low_ticks > 32767) low_ticks = 32767;
-
-			rmt_data_t symbol = {};
-			symbol.level0 = 1;
-			symbol.duration0 = (uint16_t)high_ticks;
-			symbol.level1 = 0;
-			symbol.duration1 = (uint16_t)low_ticks;
-
-			rmtWriteLooping(SPINDLE_STEP_PIN, &symbol, 1);
-			loop_active = true;
-			prev_period_us = step_period_us;
-		}
-
-		if (SPINDLE_EN_PIN >= 0) {
-			digitalWrite(SPINDLE_EN_PIN, LOW);  // Active low enable
-		}
-	} else {
-		if (loop_active) {
-			rmtWriteLooping(SPINDLE_STEP_PIN, nullptr, 0);
-			loop_active = false;
-			prev_period_us = 0;
-		}
-
-		if (SPINDLE_EN_PIN >= 0) {
-			digitalWrite(SPINDLE_EN_PIN, HIGH);  // Disabled
-		}
-	}
+void SpindleStepper::kick() {
+    const int32_t target = synth_target_q8;
+    // A C move's stream stops on its goal, counted from the position at
+    // rest (all pulses out); none starts the wrong way or onto the goal
+    uint32_t move_left = 0;
+    bool start = rmt_ready && !tx_busy && target != 0;
+    if (start && c_move) {
+        const int64_t d = c_goal - getPosition();
+        const int64_t n = (d < 0) ? -d : d;
+        move_left = (uint32_t)((n > INT32_MAX) ? INT32_MAX : n);
+        start = (d != 0) && ((d > 0) == (target > 0));
+    }
+    if (start) {
+        // Idle, so DIR can change: it is held for the leading low symbol
+        tx_forward = (target > 0);
+        bool dir_level = tx_forward;
+        if (SPINDLE_INVERT_DIR) dir_level = !dir_level;
+        gpio_set_level((gpio_num_t)SPINDLE_DIR_PIN, dir_level ? 1 : 0);
+
+        // Idle, so every pulse of the last stream is counted (only a
+        // coupled Z stream needs it)
+        uint32_t counted = 0;
+#if ELS_DRIVE_MODE == ELS_DRIVE_COUPLED
+        if (step_unit != nullptr) counted = readCounted();
+#endif
+        portENTER_CRITICAL(&synth_mux);
+        synth.start(move_left);
+        slots.startStream(counted);
+        tx_busy = true;
+        portEXIT_CRITICAL(&synth_mux);
+
+        static const uint8_t token = 0;
+        rmt_transmit_config_t tx_cfg = {};
+        tx_cfg.loop_count = 0;
+        tx_cfg.flags.eot_level = 0;
+        if (rmt_transmit(step_chan, step_encoder, &token, sizeof(token), &tx_cfg) != ESP_OK) {
+            tx_busy = false;
+        }
+    }
+
+    if (SPINDLE_EN_PIN >= 0) {
+        // Active low; stays enabled until the ramp down has finished
+        digitalWrite(SPINDLE_EN_PIN, (tx_busy || target != 0) ? LOW : HIGH);
+    }
 }
 
-void SpindleStepper::accumulatePosition() {
-	if (!rmt_ready || direction == 0 || steps_per_sec <= 0 || last_dt_us == 0) {
-		step_accumulator_fp = 0;
-		return;
-	}
+// ============================================================================
+// Measurement mode: pulses counted on the STEP pin vs pulses encoded. The
+// difference is what is still queued in RMT memory, so it stays within
+// SPINDLE_RMT_MEM_SYMBOLS while running and returns to zero at rest, however
+// long it runs.
+// ============================================================================
+void SpindleStepper::verifyUpdate() {
+	static bool started = false;
+	static uint32_t start_counted = 0;
+	static uint32_t start_encoded = 0;
+	static uint32_t last_report_ms = 0;
 
-	int64_t delta_fp = (int64_t)steps_per_sec * (int64_t)last_dt_us * FP_SCALE / 1000000;
-	step_accumulator_fp += delta_fp;
+	if (step_unit == nullptr) return;  // Nothing to compare against
 
-	int32_t steps = (int32_t)(step_accumulator_fp / FP_SCALE);
-	if (steps != 0) {
-		step_accumulator_fp -= (int64_t)steps * FP_SCALE;
-		position += (direction > 0) ? steps : -steps;
+	const uint32_t counted_raw = readRaw();
+	const uint32_t encoded_raw = synth_encoded;
+	if (!started) {
+		started = true;
+		start_counted = counted_raw;
+		start_encoded = encoded_raw;
+		last_report_ms = millis();
+		return;
 	}
+
+	if (millis() - last_report_ms < SPINDLE_STEP_VERIFY_MS) return;
+	last_report_ms = millis();
+	const int32_t counted = (int32_t)(counted_raw - start_counted);
+	const int32_t encoded = (int32_t)(encoded_raw - start_encoded);
+	Serial.printf("[SpindleStepper] Pulses: counted %ld, encoded %ld (in flight %ld)\n",
+		(long)counted, (long)encoded, (long)(encoded - counted));
 }
 
 // ============================================================================
@@ -227,16 +486,16 @@ void SpindleStepper::update() {
     // Read control inputs
     readControls();
     
-    // Update speed with acceleration
+    // New target for the ramp
     updateSpeed();
-    
-    // Set direction pin
-    bool dir_level = (direction >= 0);
-    if (SPINDLE_INVERT_DIR) dir_level = !dir_level;
-    digitalWrite(SPINDLE_DIR_PIN, dir_level ? HIGH : LOW);
+    kick();
 
-    updateRmtLoop();
-    accumulatePosition();
+    if (SPINDLE_STEP_VERIFY) verifyUpdate();
+
+    // Kept for the counter's fold check (PcntCount::read)
+    const uint32_t raw = readRaw();
+    step_last = (int32_t)raw;
+    tracker.update((int32_t)raw, (uint32_t)esp_timer_get_time());
 }
 
 // ============================================================================
@@ -244,15 +503,25 @@ void SpindleStepper::update() {
 // ============================================================================
 void SpindleStepper::stop() {
     running = false;
-    current_rpm = 0;
     rpm_signed = 0;
     rpm_abs = 0;
     target_rpm = 0;
     direction = 0;
-	step_period_us = 0;
-	steps_per_sec = 0;
-	step_accumulator_fp = 0;
-	updateRmtLoop();
+    synth_target_q8 = 0;
+    stop_hold_dir = 0;
+
+    if (rmt_ready) {
+        // Disabling the channel aborts the transmission in progress
+        rmt_disable(step_chan);
+        rmt_enable(step_chan);
+        portENTER_CRITICAL(&synth_mux);
+        tx_busy = false;
+        synth.end();
+        // A coupled Z stream runs out at the last slot generated
+        slots.endCoupled();
+        portEXIT_CRITICAL(&synth_mux);
+        synth_speed_q8 = 0;
+    }
     
     if (SPINDLE_EN_PIN >= 0) {
         digitalWrite(SPINDLE_EN_PIN, HIGH);  // Disabled
@@ -260,3 +529,152 @@ void SpindleStepper::stop() {
     
     Serial.println("[SpindleStepper] Emergency stop");
 }
+
+// ============================================================================
+// Thread-end stop
+// Counted in the generator's own steps: the raw position of everything
+// generated so far is what has been encoded plus the slots generated ahead
+// of the spindle stream (ELS_DRIVE_COUPLED), so from there the generator
+// only counts down to its end slot.
+// ============================================================================
+static inline uint32_t generated_raw() {
+    const uint32_t ahead = slots.ahead();
+    return synth_encoded + (tx_forward ? ahead : (uint32_t)-ahead);
+}
+
+int32_t SpindleStepper::brakeSteps() {
+    portENTER_CRITICAL(&synth_mux);
+    const uint32_t gen = generated_raw();
+    const uint32_t ramp_down = synth.rampDownSteps();
+    const bool busy = tx_busy;
+    portEXIT_CRITICAL(&synth_mux);
+    if (!busy) return 0;
+    const int32_t ahead = (int32_t)(gen - readRaw());
+    return ((ahead < 0) ? -ahead : ahead) + (int32_t)ramp_down;
+}
+
+bool SpindleStepper::stopAt(int64_t stop_pos) {
+    bool ok = false;
+    portENTER_CRITICAL(&synth_mux);
+    if (tx_busy) {
+        const int64_t gen_pos = tracker.unwrap((int32_t)generated_raw());
+        ok = synth.stopAt(tx_forward ? stop_pos - gen_pos : gen_pos - stop_pos);
+    }
+    portEXIT_CRITICAL(&synth_mux);
+    if (ok) stop_hold_dir = direction;
+    return ok;
+}
+
+bool SpindleStepper::isStopping() {
+    return (synth.stopArmed() || (tx_busy && synth.stoppedOnStep())) && !c_move;
+}
+
+// ============================================================================
+// C axis moves
+// A move is a stream armed like a thread-end stop from its first pulse, so
+// the generator lands it on the goal at the ramp limits. Retargeting moves
+// that stop while it can still be made; otherwise the stream lands where it
+// was going and the next one (kick()) starts from there, so the position is
+// always the pulses that went out.
+// ============================================================================
+bool SpindleStepper::moveTo(int64_t pos, int32_t rpm) {
+    // At rest or already moving: never taken over from a switch ramp down
+    if (!rmt_ready || direction != 0 || (tx_busy && !c_move)) return false;
+    if (rpm < SPINDLE_MIN_RPM) rpm = SPINDLE_MIN_RPM;
+    if (rpm > SPINDLE_MAX_RPM) rpm = SPINDLE_MAX_RPM;
+    int64_t q8 = ((int64_t)rpm * SPINDLE_STEPS_PER_REV << 8) / 60;
+    if (q8 > (int64_t)V_MAX_Q8) q8 = V_MAX_Q8;
+    if (q8 < (int64_t)V_MIN_Q8) q8 = V_MIN_Q8;
+    c_speed_q8 = (int32_t)q8;
+    c_goal = pos;
+    c_move = true;
+    return true;
+}
+
+void SpindleStepper::cancelMove() {
+    if (!c_move) return;
+    portENTER_CRITICAL(&synth_mux);
+    // The stream ramps down from wherever it is
+    synth.disarm();
+    portEXIT_CRITICAL(&synth_mux);
+    synth_target_q8 = 0;
+    c_move = false;
+}
+
+int32_t SpindleStepper::moveTarget() {
+    if (!tx_busy) {
+        const int64_t d = c_goal - getPosition();
+        if (d == 0) {
+            c_move = false;  // On the goal
+            return 0;
+        }
+        return (d > 0) ? c_speed_q8 : -c_speed_q8;
+    }
+    portENTER_CRITICAL(&synth_mux);
+    if (synth.stopArmed()) {
+        const int64_t gen_pos = tracker.unwrap((int32_t)generated_raw());
+        synth.moveStop(tx_forward ? c_goal - gen_pos : gen_pos - c_goal);
+    }
+    const bool forward = tx_forward;
+    portEXIT_CRITICAL(&synth_mux);
+    return forward ? c_speed_q8 : -c_speed_q8;
+}
+
+#if ELS_DRIVE_MODE == ELS_DRIVE_COUPLED
+// ============================================================================
+// Coupled Z (ELS_DRIVE_COUPLED)
+// The Z stream starts on the slot whose pulse the spindle is sending now
+// (found from the pulse counter), so it trails the spindle by at most the
+// part of that step already out. From there both replay the same periods on
+// the same clock.
+// ============================================================================
+bool SpindleStepper::couple(ElsGear *gear, int64_t gear_pos) {
+    if (step_unit == nullptr || gear == nullptr) return false;
+
+    // Pulses already out; any that follow are still generated-only below
+    const uint32_t counted = readCounted();
+    const int64_t count_now = tracker.unwrap((int32_t)counted);
+
+    portENTER_CRITICAL(&synth_mux);
+    const bool ok = tx_busy && !synth.ended() && !slots.isCoupled();
+    const bool forward = tx_forward;
+    if (ok) slots.couple(gear, gear_pos, counted, count_now, forward);
+    portEXIT_CRITICAL(&synth_mux);
+    if (!ok) return false;
+
+    // Z runs the way the gear turns spindle motion in this direction
+    if (!Stepper::startCoupled(coupled_segment, forward != gear->isNegative())) {
+        int64_t pos;
+        int32_t owed;
+        decouple(pos, owed);
+        return false;
+    }
+    return true;
+}
+
+void SpindleStepper::decouple(int64_t &gear_pos, int32_t &owed) {
+    portENTER_CRITICAL(&synth_mux);
+    slots.decouple(gear_pos, owed);
+    portEXIT_CRITICAL(&synth_mux);
+}
+
+// The Z channel is stopped before the pulse count is read, so no slot past
+// the one the spindle is sending made it out on Z either; of those, the
+// ones already encoded were counted as emitted
+void SpindleStepper::abortCoupled(int32_t &owed) {
+    owed = 0;
+    if (!Stepper::isCoupled()) return;
+    const int32_t unencoded = Stepper::abortCoupled();
+    const uint32_t counted = (step_unit != nullptr) ? readCounted() : 0;
+
+    portENTER_CRITICAL(&synth_mux);
+    const int32_t unsent = slots.abortZ(counted, tx_forward, unencoded, owed);
+    portEXIT_CRITICAL(&synth_mux);
+
+    if (unsent != 0) Stepper::dropEmitted(unsent);
+}
+
+bool SpindleStepper::isCoupled() {
+    return slots.isCoupled();
+}
+#endif
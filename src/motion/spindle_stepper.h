@@ -2,11 +2,19 @@
 
 #include <stdint.h>
 #include <Arduino.h>  // For IRAM_ATTR
+#include "spindle_tracker.h"
+#include "config_motion.h"
+
+class ElsGear;
 
 // ============================================================================
 // Spindle Stepper Driver
 // Generates step pulses to drive spindle motor, with position/RPM tracking
 // Used when SPINDLE_MODE == SPINDLE_MODE_STEPPER
+// Pulses are synthesized by a streaming RMT encoder, one symbol per step:
+// the speed ramp is integrated step by step on the pulse timeline and each
+// period is dithered to 1/65536 tick, so rate changes never restart the
+// output and the average rate is exact.
 // ============================================================================
 
 class SpindleStepper {
@@ -17,9 +25,13 @@ public:
     // Call from main loop to read controls and update speed
     static void update();
     
-    // Get current spindle position in steps (used by ELS as source of truth)
-    static int32_t getPosition() { return position; }
+    // Current spindle position in steps, 64-bit (unwrapped by the tracker).
+    // With SPINDLE_STEP_PCNT these are the pulses actually emitted.
+    static int64_t getPosition() { return tracker.unwrap((int32_t)readRaw()); }
     
+    // Interpolated position/velocity, fed from update()
+    static SpindleTracker &getTracker() { return tracker; }
+
     // Get current actual RPM (may differ from target during accel)
     static int16_t getRpmSigned() { return rpm_signed; }
     static int16_t getRpmAbs() { return rpm_abs; }
@@ -30,39 +42,81 @@ public:
     // Get direction: +1 forward, -1 reverse, 0 stopped
     static int8_t getDirection() { return direction; }
     
-    // Reset position counter (e.g., for zeroing)
-    static void resetPosition() { position = 0; }
-    
-    // Emergency stop - immediately stops output
+    // Emergency stop - aborts the pulse stream without a ramp
     static void stop();
+
+    // Thread end: ramp down so the stream's last pulse brings getPosition()
+    // to stop_pos, then hold until the direction switch changes. False (and
+    // nothing changes) if not running towards it with room to ramp down.
+    static bool stopAt(int64_t stop_pos);
+    // Steps still to come if the ramp down started now: those already
+    // generated, then the ramp from the speed reached
+    static int32_t brakeSteps();
+    // A stopAt() stop is still ramping down, or its last pulses are still
+    // going out
+    static bool isStopping();
+    // Let a spindle held by stopAt() run again without the switch changing
+    static void releaseHold() { stop_hold_dir = 0; }
+
+    // C axis: run the spindle to pos (getPosition() steps) at up to rpm and
+    // stop on it. A move in progress is retargeted: onward it just runs on,
+    // back past where it can stop it lands first and then returns. False if
+    // the direction switch is running the spindle (which also ends a move).
+    static bool moveTo(int64_t pos, int32_t rpm);
+    // Ramp a move down short of its target
+    static void cancelMove();
+    static bool isMoving() { return c_move; }
+    static int64_t getMoveTarget() { return c_goal; }
     
     // Check if spindle is running
     static bool isRunning() { return running; }
-    
-    // Position is public so ISR can access it
-    static volatile int32_t position;
+
+#if ELS_DRIVE_MODE == ELS_DRIVE_COUPLED
+    // Hand the ELS gear to the synthesizer: from the next step generated it
+    // advances the gear itself (from gear_pos, spindle sub-counts) and a
+    // coupled Z stream replays the steps on the spindle's timeline. Needs
+    // the spindle running and Z idle.
+    static bool couple(ElsGear *gear, int64_t gear_pos);
+    // Take the gear back: where it was run to and steps it gave that no
+    // slot holds yet. Slots already generated still go out on Z.
+    static void decouple(int64_t &gear_pos, int32_t &owed);
+    // Once decoupled: end the Z stream now instead. Steps it counted as
+    // emitted that never went out come off Stepper's position; owed is all
+    // the Z steps of slots the spindle had not reached.
+    static void abortCoupled(int32_t &owed);
+    // Coupled, and not ended by a spindle stop
+    static bool isCoupled();
+#endif
     
 private:
     static int16_t rpm_signed;          // Current RPM with sign
     static int16_t rpm_abs;             // Current RPM absolute
     static int16_t target_rpm;          // Target RPM from pot
-    static int16_t current_rpm;         // Actual RPM (after accel limiting)
     static int8_t direction;            // +1, -1, or 0
+    static int8_t stop_hold_dir;        // Switch setting a stopAt() holds, 0 = none
     static bool running;
+    static volatile bool c_move;        // C move in progress (the switch is off)
+    static int64_t c_goal;
+    static int32_t c_speed_q8;
     
-    static uint32_t last_update_us;
-    static uint32_t last_dt_us;
-    static uint32_t step_period_us;   // Microseconds per step
-    static int32_t steps_per_sec;
-    static int64_t step_accumulator_fp;
     static bool rmt_ready;
+    static SpindleTracker tracker;
+
+    // Raw (wrapping) position: counted pulses (or, without the counter,
+    // the pulses encoded)
+    static uint32_t readRaw();
+    static bool initStepCounter();
+    static bool initSynth();
+    static void verifyUpdate();
     
     // Read analog potentiometer and direction switch
     static void readControls();
     
-    // Apply acceleration limiting
+    // Hand the signed target rate to the synthesizer, which ramps to it
     static void updateSpeed();
+    // Target rate for a C move, keeping its stop on the goal
+    static int32_t moveTarget();
 
-    static void updateRmtLoop();
-    static void accumulatePosition();
+    // Start the pulse stream when idle and a target is set (DIR first)
+    static void kick();
 };
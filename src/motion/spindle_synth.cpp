@@ -0,0 +1,58 @@
+#include "spindle_synth.h"
+#include "esp_attr.h"
+
+void SpindleSynth::start(uint32_t left) {
+    ramp.start();
+    done = false;
+    stop_left = left;
+    stop_armed = (left != 0);
+    stopped = false;
+}
+
+uint32_t IRAM_ATTR SpindleSynth::next(int32_t target_q8, bool forward) {
+    if (done) return 0;
+
+    uint32_t t_q8 = 0;
+    if (target_q8 != 0 && (target_q8 > 0) == forward) {
+        t_q8 = (uint32_t)((target_q8 < 0) ? -target_q8 : target_q8);
+        if (t_q8 < SpindleRamp::V_MIN_Q8) t_q8 = SpindleRamp::V_MIN_Q8;
+        if (t_q8 > SpindleRamp::V_MAX_Q8) t_q8 = SpindleRamp::V_MAX_Q8;
+    }
+    const bool armed = stop_armed;
+    if (armed && t_q8 != 0) {
+        // No faster than still ramps down onto the last step
+        uint32_t cap = ramp.stopSpeed(stop_left);
+        if (cap < SpindleRamp::V_MIN_Q8) cap = SpindleRamp::V_MIN_Q8;
+        if (t_q8 > cap) t_q8 = cap;
+    }
+    if ((t_q8 == 0 && ramp.speed() <= SpindleRamp::V_MIN_Q8) || (armed && stop_left == 0)) {
+        done = true;
+        stopped = armed;
+        stop_armed = false;
+        return 0;
+    }
+
+    const uint32_t period = ramp.next(t_q8);
+    if (armed) stop_left--;
+    return period;
+}
+
+bool SpindleSynth::stopAt(int64_t left) {
+    if (done || stop_armed) return false;
+    if (left < (int64_t)rampDownSteps() || left > INT32_MAX) return false;
+    stop_left = (uint32_t)left;
+    stop_armed = true;
+    return true;
+}
+
+void SpindleSynth::moveStop(int64_t left) {
+    if (!stop_armed) return;
+    if (left >= (int64_t)stop_left || left >= (int64_t)rampDownSteps()) {
+        stop_left = (uint32_t)((left > INT32_MAX) ? INT32_MAX : left);
+    }
+}
+
+void SpindleSynth::end() {
+    done = true;
+    stop_armed = false;
+}
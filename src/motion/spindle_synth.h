@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include "spindle_ramp.h"
+
+// ============================================================================
+// Spindle pulse synthesizer stream, for SpindleStepper: the next step's
+// period from the SpindleRamp towards the target, and where the stream
+// ends. Either the ramp is down at the minimum speed with nothing to run
+// towards, or an armed stop (thread end, C move) has counted down its
+// steps: the speed is then capped to what still ramps down onto the last
+// one. Not locked itself: SpindleStepper holds synth_mux around every call
+// except stopArmed().
+// No driver types here, so the logic builds on the host.
+// ============================================================================
+
+class SpindleSynth {
+public:
+    constexpr SpindleSynth(int32_t accel_rpm_per_sec, int32_t jerk_rpm_per_sec2)
+        : ramp(accel_rpm_per_sec, jerk_rpm_per_sec2) {}
+
+    // New stream from rest, stopping after stop_left steps (0: no stop armed)
+    void start(uint32_t stop_left);
+
+    // Period (ticks) of the next step towards target_q8 (signed, 0 = ramp
+    // down and end), the stream running forward or back; 0 ends it, and
+    // every call after returns 0 until start(). A target the other way
+    // ramps down and ends too.
+    uint32_t next(int32_t target_q8, bool forward);
+    bool ended() const { return done; }
+
+    // Arm a stop left steps after the last one generated. False (and
+    // nothing changes) once ended or armed, or with left short of a ramp
+    // down from the speed reached.
+    bool stopAt(int64_t left);
+    // Move the armed stop to left steps on: further on always, nearer only
+    // with room to ramp down
+    void moveStop(int64_t left);
+    void disarm() { stop_armed = false; }
+    // Stopped dead (the channel aborted): ended, nothing armed
+    void end();
+
+    bool stopArmed() const { return stop_armed; }
+    // The stream ended on an armed stop (its last steps may still be
+    // going out)
+    bool stoppedOnStep() const { return stopped; }
+    uint32_t stopLeft() const { return stop_left; }
+    uint32_t speed() const { return ramp.speed(); }
+    uint32_t rampDownSteps() const { return ramp.rampDownSteps(ramp.speed()); }
+
+private:
+    SpindleRamp ramp;
+    bool done = true;
+    volatile bool stop_armed = false;  // Read without the lock (isStopping())
+    volatile bool stopped = false;     // So is this
+    uint32_t stop_left = 0;            // Steps before its end slot
+};
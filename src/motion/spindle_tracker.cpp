@@ -0,0 +1,81 @@
+#include "spindle_tracker.h"
+#include "config_motion.h"
+#include <Arduino.h>
+
+// Samples arrive from the motion task and are read from the ELS timer ISR on
+// the same core (and unwrap() from the SPI loop on the other); the lock keeps
+// each position/velocity pair and the unwrap base consistent
+static portMUX_TYPE tracker_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static constexpr int64_t RESET_Q16 = (int64_t)SPINDLE_TRACK_RESET_COUNTS << 16;
+
+// Raw counters wrap at 32 bits; the difference is taken modulo 2^32
+static inline int32_t raw_delta(int32_t raw, int32_t last) {
+    return (int32_t)((uint32_t)raw - (uint32_t)last);
+}
+
+void SpindleTracker::reset(int64_t count, uint32_t t_us) {
+    pos_q16 = (count << 16) + 32768;
+    vel_q32 = 0;
+    t_last = t_us;
+    valid = true;
+}
+
+void SpindleTracker::update(int32_t raw, uint32_t t_us) {
+    const int64_t count = last_count + raw_delta(raw, last_raw);
+    const int32_t dt = (int32_t)(t_us - t_last);
+
+    portENTER_CRITICAL_SAFE(&tracker_mux);
+    if (!valid) {
+        reset(count, t_us);
+    } else if (dt > 0) {
+        const int64_t pred = pos_q16 + ((vel_q32 * dt) >> 16);
+        // A count only says the spindle is somewhere in [count, count + 1),
+        // so measure against the middle of that interval
+        const int64_t resid = (count << 16) + 32768 - pred;
+        if (resid > RESET_Q16 || resid < -RESET_Q16 || dt > SPINDLE_TRACK_MAX_EXTRAP_US) {
+            // Lost track: take the raw counts and their average rate
+            pos_q16 = (count << 16) + 32768;
+            vel_q32 = ((count - last_count) << 32) / dt;
+        } else {
+            pos_q16 = pred + ((resid * SPINDLE_TRACK_ALPHA_Q16) >> 16);
+            vel_q32 += (resid * SPINDLE_TRACK_BETA_Q16) / dt;
+        }
+        t_last = t_us;
+    }
+    last_count = count;
+    last_raw = raw;
+    portEXIT_CRITICAL_SAFE(&tracker_mux);
+}
+
+int64_t SpindleTracker::unwrap(int32_t raw) {
+    portENTER_CRITICAL_SAFE(&tracker_mux);
+    const int64_t count = last_count + raw_delta(raw, last_raw);
+    portEXIT_CRITICAL_SAFE(&tracker_mux);
+    return count;
+}
+
+void SpindleTracker::shift(int32_t counts) {
+    portENTER_CRITICAL_SAFE(&tracker_mux);
+    pos_q16 += (int64_t)counts << 16;
+    last_count += counts;
+    last_raw = (int32_t)((uint32_t)last_raw + (uint32_t)counts);
+    portEXIT_CRITICAL_SAFE(&tracker_mux);
+}
+
+int64_t IRAM_ATTR SpindleTracker::positionAt(uint32_t t_us) {
+    portENTER_CRITICAL_SAFE(&tracker_mux);
+    int32_t dt = (int32_t)(t_us - t_last);
+    if (dt > SPINDLE_TRACK_MAX_EXTRAP_US) dt = SPINDLE_TRACK_MAX_EXTRAP_US;
+    if (dt < -SPINDLE_TRACK_MAX_EXTRAP_US) dt = -SPINDLE_TRACK_MAX_EXTRAP_US;
+    const int64_t p = pos_q16 + ((vel_q32 * dt) >> 16);
+    portEXIT_CRITICAL_SAFE(&tracker_mux);
+    return p;
+}
+
+int32_t SpindleTracker::getCountsPerSec() {
+    portENTER_CRITICAL_SAFE(&tracker_mux);
+    const int64_t v = vel_q32;
+    portEXIT_CRITICAL_SAFE(&tracker_mux);
+    return (int32_t)((v * 1000000) >> 32);
+}
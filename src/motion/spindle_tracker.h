@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+
+// ============================================================================
+// Spindle tracking filter (alpha-beta) over timestamped spindle counts
+// The spindle source feeds it once per motion tick; it then gives a position
+// interpolated between (and a little beyond) samples, plus a velocity, at any
+// instant. Fixed point throughout so the ELS timer ISR can read it too.
+// Spindle sources are 32-bit counters that wrap; the tracker unwraps them
+// into a 64-bit count (one tick never moves anywhere near 2^31 counts), so
+// everything downstream of it sees a position that never wraps.
+// ============================================================================
+
+class SpindleTracker {
+public:
+    // New sample of the raw (wrapping) counter, motion task. Jumps larger
+    // than SPINDLE_TRACK_RESET_COUNTS (MPG C jog) restart the filter from
+    // the unwrapped count.
+    void update(int32_t raw, uint32_t t_us);
+
+    // 64-bit count for a raw counter value read after the last update()
+    int64_t unwrap(int32_t raw);
+
+    // The source moved its count by `counts` without the spindle moving
+    // (index re-home): move the filter with it, no speed or position step
+    void shift(int32_t counts);
+
+    // Position at t_us (esp_timer clock) in counts << 16; t_us may be ahead
+    // of the last sample, up to SPINDLE_TRACK_MAX_EXTRAP_US
+    int64_t positionAt(uint32_t t_us);
+
+    // Filtered velocity, counts per second
+    int32_t getCountsPerSec();
+
+private:
+    // Start over at a known count, velocity zero (lock held)
+    void reset(int64_t count, uint32_t t_us);
+
+    int64_t pos_q16 = 0;  // Position at t_last, counts << 16
+    int64_t vel_q32 = 0;  // Counts per us << 32
+    uint32_t t_last = 0;
+    int64_t last_count = 0;
+    int32_t last_raw = 0;
+    bool valid = false;
+};
@@ -0,0 +1,55 @@
+#include "step_queue.h"
+#include "esp_attr.h"
+
+int32_t IRAM_ATTR StepQueue::push(int32_t count, uint32_t span_ticks) {
+    const int32_t want = (count < 0) ? -count : count;
+    int32_t n = want;
+    const int32_t room = ELS_STEP_QUEUE_MAX_STEPS - backlog_steps;
+    if (n > room) n = room;
+    if (tail - head >= ELS_STEP_QUEUE_LEN) n = 0;
+    if (n > 0) {
+        Segment &seg = ring[tail & MASK];
+        seg.steps = (count < 0) ? -n : n;
+        seg.span_ticks = (uint32_t)(((uint64_t)span_ticks * (uint32_t)n) / (uint32_t)want);
+        tail = tail + 1;
+        backlog_steps = backlog_steps + n;
+    } else {
+        n = 0;
+    }
+    if (n != want) overload_count = overload_count + 1;
+    return (count < 0) ? -n : n;
+}
+
+void StepQueue::begin() {
+    held_first = 0;
+    held_count = 0;
+}
+
+// The oldest symbols went out: their steps leave the backlog
+uint32_t IRAM_ATTR StepQueue::retire(uint32_t symbols) {
+    uint32_t steps = 0;
+    for (; symbols > 0 && held_count > 0; symbols--) {
+        if (held[held_first]) steps++;
+        held_first = (held_first + 1) % MEM;
+        held_count--;
+    }
+    backlog_steps = backlog_steps - (int32_t)steps;
+    return steps;
+}
+
+uint32_t IRAM_ATTR StepQueue::sent(uint32_t symbols_free) {
+    const uint32_t still = (symbols_free < MEM) ? MEM - symbols_free : 0;
+    return (held_count > still) ? retire(held_count - still) : 0;
+}
+
+// Encoder only, so no lock: the backlog is left alone. sent() made the room
+// (the encoder writes no more than symbols_free).
+void IRAM_ATTR StepQueue::written(bool step) {
+    if (held_count == MEM) return;
+    held[(held_first + held_count) % MEM] = step;
+    held_count++;
+}
+
+uint32_t IRAM_ATTR StepQueue::done() {
+    return retire(held_count);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+#include "config_motion.h"
+
+// ============================================================================
+// Z step queue and its accounting, for Stepper: signed segments, one per
+// accepted step() call, each spread over its span; and which symbols in the
+// RMT channel memory are steps, so the backlog drops as steps go out rather
+// than as they are encoded. Not locked itself: Stepper serializes producers
+// and the accounting on queue_mux, and the one consumer pops without it.
+// No RMT types here, so the logic builds on the host.
+// ============================================================================
+
+class StepQueue {
+public:
+    struct Segment {
+        int32_t steps;        // Signed step count
+        uint32_t span_ticks;  // Time to spread them over (0 = back to back)
+    };
+
+    // Producers: takes up to ELS_STEP_QUEUE_MAX_STEPS less the backlog, as
+    // one segment, and nothing with the ring full. A partial accept keeps
+    // the per-step spacing of span_ticks over count. Returns the signed
+    // steps taken; anything short is counted as an overload.
+    int32_t push(int32_t count, uint32_t span_ticks);
+
+    // Consumer (the RMT encoder)
+    bool empty() const { return head == tail; }
+    const Segment &front() const { return ring[head & MASK]; }
+    void pop() { head = head + 1; }
+
+    // Channel memory. A transmission starts with it empty. Before each
+    // refill the encoder says how many of its symbols are free: what it held
+    // beyond the rest has gone out. Then it reports each symbol it writes.
+    // Once the transmission is done, everything still held has gone out.
+    // sent() and done() change the backlog (call them under the producers'
+    // lock) and return the steps that went out; written() only touches what
+    // the encoder owns.
+    void begin();
+    uint32_t sent(uint32_t symbols_free);
+    void written(bool step);
+    uint32_t done();
+
+    int32_t backlog() const { return backlog_steps; }  // Accepted, not out yet
+    uint32_t overloads() const { return overload_count; }
+
+private:
+    static constexpr uint32_t MASK = ELS_STEP_QUEUE_LEN - 1;
+    static_assert((ELS_STEP_QUEUE_LEN & MASK) == 0, "ELS_STEP_QUEUE_LEN must be a power of two");
+    static constexpr uint32_t MEM = ELS_RMT_MEM_SYMBOLS;
+
+    Segment ring[ELS_STEP_QUEUE_LEN] = {};
+    volatile uint32_t head = 0;  // Consumer
+    volatile uint32_t tail = 0;  // Producers
+    volatile int32_t backlog_steps = 0;
+    volatile uint32_t overload_count = 0;
+
+    // Symbols in channel memory, oldest first: true for a step
+    bool held[MEM] = {};
+    uint32_t held_first = 0;
+    uint32_t held_count = 0;
+
+    uint32_t retire(uint32_t symbols);
+};
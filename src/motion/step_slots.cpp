@@ -0,0 +1,96 @@
+#include "step_slots.h"
+#include "els_gear.h"
+#include "esp_attr.h"
+
+// Only forward of where the ELS left the gear: behind it, it already ran
+int16_t IRAM_ATTR StepSlots::coupledSteps(bool forward) {
+    frame += forward ? SUBCOUNTS_PER_STEP : -SUBCOUNTS_PER_STEP;
+    const int64_t d = frame - gear_pos;
+    if (d != 0 && (d > 0) == forward) {
+        owed += gear->advance((int32_t)d);
+        gear_pos = frame;
+    }
+    int32_t n = owed;
+    if (n > ELS_COUPLED_MAX_STEPS_PER_SLOT) n = ELS_COUPLED_MAX_STEPS_PER_SLOT;
+    if (n < -ELS_COUPLED_MAX_STEPS_PER_SLOT) n = -ELS_COUPLED_MAX_STEPS_PER_SLOT;
+    owed -= n;
+    return (int16_t)n;
+}
+
+void IRAM_ATTR StepSlots::generate(uint16_t period, bool forward) {
+    Slot &slot = ring[gen & MASK];
+    slot.period = period;
+    slot.z = 0;
+    if (period == 0) {
+        endCoupled();
+    } else if (coupled) {
+        slot.z = coupledSteps(forward);
+    }
+    gen++;
+}
+
+void StepSlots::startStream(uint32_t counted) {
+    spindle = gen;
+    start_slot = gen;
+    start_counted = counted;
+}
+
+void StepSlots::couple(ElsGear *g, int64_t pos, uint32_t counted, int64_t count_now, bool forward) {
+    const uint32_t after = slotAfter(counted, forward);
+    uint32_t wire = after;
+    const int32_t pending = (int32_t)(gen - wire);
+    if (after != start_slot) wire--;  // Its pulse is out, its low is going out now
+    if ((int32_t)(spindle - wire) < 0) wire = spindle;
+    frame = (count_now + (forward ? pending : -pending)) * SUBCOUNTS_PER_STEP;
+    gear = g;
+    gear_pos = pos;
+    owed = 0;
+    z = wire;
+    z_bounded = false;
+    coupled = true;
+}
+
+void StepSlots::decouple(int64_t &pos, int32_t &steps) {
+    endCoupled();
+    pos = gear_pos;
+    steps = owed;
+    owed = 0;
+    gear = nullptr;
+}
+
+void IRAM_ATTR StepSlots::endCoupled() {
+    if (!coupled) return;
+    coupled = false;
+    z_end = gen;
+    z_bounded = true;
+}
+
+bool IRAM_ATTR StepSlots::takeZ(int32_t &steps, uint32_t &period) {
+    const Slot &slot = ring[z & MASK];
+    if (slot.period == 0) return false;
+    steps = slot.z;
+    period = slot.period;
+    z++;
+    return true;
+}
+
+int32_t StepSlots::abortZ(uint32_t counted, bool forward, int32_t unencoded, int32_t &steps) {
+    steps = 0;
+    int32_t unsent = 0;
+    uint32_t next = slotAfter(counted, forward);
+    const uint32_t end = z_bounded ? z_end : gen;
+    if ((int32_t)(end - next) > (int32_t)ELS_COUPLED_SLOTS) next = end - ELS_COUPLED_SLOTS;
+    for (uint32_t i = next; (int32_t)(end - i) > 0; i++) {
+        const int32_t n = ring[i & MASK].z;
+        steps += n;
+        if ((int32_t)(z - i) > 0) unsent += n;
+    }
+    // unencoded is what the slot before z still had to encode
+    if ((int32_t)(z - 1 - next) >= 0) {
+        unsent -= unencoded;
+    } else {
+        steps += unencoded;
+    }
+    z = end;
+    return unsent;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdint.h>
+#include "config_motion.h"
+
+class ElsGear;
+
+// ============================================================================
+// Step slots, for SpindleStepper: the synthesizer's output, one per spindle
+// step (its period, and while coupled the Z steps the ELS gear gives over
+// it). The spindle stream and a coupled Z stream each read the slots with
+// their own cursor, so both replay one timeline at their own pace. Not
+// locked itself: SpindleStepper holds synth_mux around every call.
+// No driver types here, so the logic builds on the host.
+// ============================================================================
+
+class StepSlots {
+public:
+    // Generator: the next slot; period 0 ends the stream, and a coupled Z
+    // stream with it. While coupled, the step advances the gear by one
+    // count, and the steps it gives ride in the slot (at most
+    // ELS_COUPLED_MAX_STEPS_PER_SLOT; the rest are owed to the next ones).
+    void generate(uint16_t period, bool forward);
+
+    // Spindle stream. counted is the pulse counter when it starts.
+    void startStream(uint32_t counted);
+    bool spindleReady() const { return spindle != gen; }
+    uint16_t takeSpindle() { return ring[spindle++ & MASK].period; }
+    uint32_t ahead() const { return gen - spindle; }  // Generated, not encoded
+
+    // Hand the gear to the generator (from gear_pos, spindle sub-counts),
+    // the spindle stream running: counted pulses are out, count_now is
+    // their unwrapped position. The Z stream starts on the slot whose pulse
+    // is going out, so it trails the spindle by at most that step.
+    void couple(ElsGear *gear, int64_t gear_pos, uint32_t counted, int64_t count_now, bool forward);
+    // Take the gear back: where it was run to, and the steps it gave that
+    // no slot holds yet. Slots already generated still go out on Z.
+    void decouple(int64_t &gear_pos, int32_t &owed);
+    // The generator stops advancing the gear, and Z ends at the last slot
+    // generated
+    void endCoupled();
+    bool isCoupled() const { return coupled; }
+
+    // Z stream: it has ended, or it has caught up with the generator
+    bool zEnded() const { return z_bounded && z == z_end; }
+    bool zReady() const { return z != gen; }
+    // The next slot's steps and period; false at the end slot
+    bool takeZ(int32_t &steps, uint32_t &period);
+
+    // The Z channel has been stopped, unencoded of its last slot's steps
+    // still to encode, and counted spindle pulses are out. Slots past the
+    // one going out never went out on Z: returns those steps it already
+    // encoded (the Z position has to drop them), and owed is every step of
+    // those slots. The slot going out is taken as sent.
+    int32_t abortZ(uint32_t counted, bool forward, int32_t unencoded, int32_t &owed);
+
+private:
+    struct Slot {
+        uint16_t period;  // Spindle RMT ticks, 0 = end of the stream
+        int16_t z;        // Z steps over this period (coupled)
+    };
+
+    static constexpr uint32_t MASK = ELS_COUPLED_SLOTS - 1;
+    static_assert((ELS_COUPLED_SLOTS & MASK) == 0, "ELS_COUPLED_SLOTS must be a power of two");
+    static constexpr int64_t SUBCOUNTS_PER_STEP = 1 << ELS_SUBCOUNT_BITS;
+
+    Slot ring[ELS_COUPLED_SLOTS] = {};
+    uint32_t gen = 0;          // Next slot to generate
+    uint32_t spindle = 0;      // Next slot for the spindle stream
+    uint32_t z = 0;            // Next slot for the Z stream
+    uint32_t z_end = 0;        // Z stops here once decoupled
+    bool z_bounded = false;
+    uint32_t start_slot = 0;     // First slot of this spindle stream
+    uint32_t start_counted = 0;  // Pulse count when it started
+
+    volatile bool coupled = false;
+    ElsGear *gear = nullptr;
+    int64_t frame = 0;     // Sub-counts after the last generated step
+    int64_t gear_pos = 0;  // Sub-counts the gear has been run to
+    int32_t owed = 0;      // Gear steps not yet in a slot
+
+    int16_t coupledSteps(bool forward);
+    // First slot whose pulse has not gone out
+    uint32_t slotAfter(uint32_t counted, bool forward) const {
+        return start_slot + (forward ? counted - start_counted : start_counted - counted);
+    }
+};
@@ -0,0 +1,62 @@
+#include "step_symbols.h"
+#include "esp_attr.h"
+
+void StepSymbols::begin() {
+    hold = true;
+    seg_left = 0;
+    low_left = 0;
+}
+
+void IRAM_ATTR StepSymbols::segment(uint32_t steps, uint32_t span_ticks) {
+    if (steps == 0) {
+        low_left = (span_ticks < 2) ? 2 : span_ticks;  // Both symbol halves need a tick
+        return;
+    }
+    seg_left = steps;
+    seg_n = steps;
+    seg_q = span_ticks / steps;
+    seg_r = span_ticks % steps;
+    seg_acc = 0;
+}
+
+bool IRAM_ATTR StepSymbols::next(Symbol &sym) {
+    if (hold) {
+        hold = false;
+        sym.step = false;
+        sym.d0 = PULSE_TICKS;
+        sym.d1 = PULSE_TICKS;
+        return true;
+    }
+
+    if (low_left != 0) {
+        uint32_t t = low_left;
+        if (t > 2 * MAX_DURATION) t = 2 * MAX_DURATION;
+        if (low_left - t == 1) t--;  // Never leave a 1-tick chunk behind
+        sym.step = false;
+        sym.d0 = (uint16_t)(t - t / 2);
+        sym.d1 = (uint16_t)(t / 2);
+        low_left -= t;
+        return true;
+    }
+
+    if (seg_left == 0) return false;
+
+    uint32_t period = seg_q;
+    seg_acc += seg_r;
+    if (seg_acc >= seg_n) {
+        seg_acc -= seg_n;
+        period++;
+    }
+    if (period < MIN_PERIOD_TICKS) period = MIN_PERIOD_TICKS;
+    uint32_t low = period - PULSE_TICKS;
+    if (low > MAX_DURATION) {
+        low_left = low - MAX_DURATION;
+        if (low_left < 2) low_left = 2;
+        low -= low_left;
+    }
+    sym.step = true;
+    sym.d0 = PULSE_TICKS;
+    sym.d1 = (uint16_t)low;
+    seg_left--;
+    return true;
+}
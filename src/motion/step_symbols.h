@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include "config_motion.h"
+
+// ============================================================================
+// Z step symbols: turns step segments into the two-half symbols Stepper's
+// RMT encoder writes, with no RMT types so it also builds on the host.
+// Each step is one symbol: PULSE_TICKS high, then low for the rest of its
+// period. Periods split the segment span Bresenham-style so they sum to it;
+// lows too long for one symbol carry on in all-low symbols, as do the spans
+// of delays (zero-step coupled segments), so no time is dropped.
+// ============================================================================
+
+class StepSymbols {
+public:
+    static constexpr uint32_t TICKS_PER_US = ELS_RMT_RES_HZ / 1000000;
+    static constexpr uint32_t PULSE_TICKS = (uint32_t)ELS_PULSE_US * TICKS_PER_US;
+    static constexpr uint32_t MIN_PERIOD_TICKS = 2 * PULSE_TICKS;
+    static constexpr uint32_t MAX_DURATION = 0x7FFF;  // 15-bit symbol duration
+
+    // One symbol: d0 ticks high for a step (low otherwise), then d1 low
+    struct Symbol {
+        bool step;
+        uint16_t d0;
+        uint16_t d1;
+    };
+
+    // New transmission: STEP is held low first (DIR was just switched), and
+    // whatever was left of the last segment is dropped
+    void begin();
+
+    // Next segment, once next() asks for one: steps (> 0) over span_ticks,
+    // or with no steps a delay of span_ticks
+    void segment(uint32_t steps, uint32_t span_ticks);
+
+    // Next symbol; false when the segment is done and another is needed
+    bool next(Symbol &sym);
+
+    // Steps of the current segment not yet out of next()
+    uint32_t stepsLeft() const { return seg_left; }
+
+private:
+    bool hold = false;
+    uint32_t seg_left = 0;  // Steps left of the segment
+    uint32_t seg_n = 1;     // Its step count
+    uint32_t seg_q = 0;     // Step period: seg_q ticks, +1 for seg_r of seg_n steps
+    uint32_t seg_r = 0;
+    uint32_t seg_acc = 0;
+    uint32_t low_left = 0;  // Low time still owed before the next step
+};
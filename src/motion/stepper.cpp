@@ -1,82 +1,404 @@
 #include "stepper.h"
 #include "config_motion.h"
+#include "step_symbols.h"
+#include "step_queue.h"
 #include <Arduino.h>
-#include "esp32-hal-rmt.h"
+#include "driver/gpio.h"
+#include "driver/rmt_tx.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 // Static member initialization
-int32_t Stepper::position = 0;
+volatile int32_t Stepper::position = 0;
+volatile int32_t Stepper::commanded = 0;
 bool Stepper::rmt_ready = false;
 
+// ============================================================================
+// Step queue (StepQueue): producers (motion task, ELS timer ISR) serialize
+// on queue_mux, and so does the backlog accounting; the single consumer is
+// the RMT encoder callback, which pops without locking.
+// ============================================================================
+static StepQueue queue;
+static portMUX_TYPE queue_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Transmission state (owned by the encoder while tx_busy)
+static volatile bool tx_busy = false;
+static bool tx_forward = true;
+static StepSymbols step_gen;
+static Stepper::SegmentSource coupled_source = nullptr;  // Set: coupled stream
+
+static rmt_channel_handle_t step_chan = nullptr;
+static rmt_encoder_handle_t step_encoder = nullptr;
+static TaskHandle_t feeder_task = nullptr;
+
+static constexpr uint32_t TICKS_PER_US = StepSymbols::TICKS_PER_US;
+
+// Last step periods as encoded, dumped by Stepper::traceUpdate()
+static uint32_t trace_buf[ELS_STEP_TRACE ? ELS_STEP_TRACE_LEN : 1];
+static volatile uint32_t trace_count = 0;
+
+// ============================================================================
+// RMT streaming encoder: called on rmt_transmit() and then from the TX ISR
+// whenever channel memory frees up. Fills it with step_gen's symbols, feeding
+// it the next segment from the queue (or the coupled source) as each one is
+// done. Ends the transmission when they run dry or the next segment needs
+// the other direction.
+// ============================================================================
+static bool IRAM_ATTR next_segment() {
+    if (coupled_source != nullptr) {
+        int32_t steps = 0;
+        uint32_t span = 0;
+        if (!coupled_source(steps, span) || (steps != 0 && (steps > 0) != tx_forward)) return false;
+        step_gen.segment((uint32_t)((steps < 0) ? -steps : steps), span);
+        return true;
+    }
+
+    if (queue.empty()) return false;
+    const StepQueue::Segment &seg = queue.front();
+    if ((seg.steps > 0) != tx_forward) return false;
+    step_gen.segment((uint32_t)((seg.steps < 0) ? -seg.steps : seg.steps), seg.span_ticks);
+    queue.pop();
+    return true;
+}
+
+static size_t IRAM_ATTR encode_steps(const void *data, size_t data_size,
+                                     size_t symbols_written, size_t symbols_free,
+                                     rmt_symbol_word_t *symbols, bool *done, void *arg) {
+    (void)data;
+    (void)data_size;
+    (void)symbols_written;
+    (void)arg;
+
+    // The free part of channel memory is what went out since the last refill
+    const bool queued = (coupled_source == nullptr);
+    if (queued) {
+        portENTER_CRITICAL_SAFE(&queue_mux);
+        queue.sent((uint32_t)symbols_free);
+        portEXIT_CRITICAL_SAFE(&queue_mux);
+    }
+
+    size_t n = 0;
+    int32_t emitted = 0;
+    StepSymbols::Symbol sym;
+    while (n < symbols_free) {
+        if (!step_gen.next(sym)) {
+            if (!next_segment()) {
+                *done = true;
+                break;
+            }
+            continue;
+        }
+        symbols[n].level0 = sym.step ? 1 : 0;
+        symbols[n].duration0 = sym.d0;
+        symbols[n].level1 = 0;
+        symbols[n].duration1 = sym.d1;
+        n++;
+        if (queued) queue.written(sym.step);
+        if (!sym.step) continue;
+        emitted++;
+
+        if (ELS_STEP_TRACE) {
+            const uint32_t t = trace_count;
+            if (t < ELS_STEP_TRACE_LEN) {
+                trace_buf[t] = (uint32_t)sym.d0 + sym.d1;
+                trace_count = t + 1;
+            }
+        }
+    }
+
+    if (emitted != 0) {
+        portENTER_CRITICAL_SAFE(&queue_mux);
+        if (!queued) Stepper::onCoupledEmitted(tx_forward ? emitted : -emitted);
+        else Stepper::onEmitted(tx_forward ? emitted : -emitted);
+        portEXIT_CRITICAL_SAFE(&queue_mux);
+    }
+    return n;
+}
+
+static bool IRAM_ATTR on_tx_done(rmt_channel_handle_t channel,
+                                 const rmt_tx_done_event_data_t *edata,
+                                 void *user_ctx) {
+    (void)channel;
+    (void)edata;
+    (void)user_ctx;
+
+    portENTER_CRITICAL_ISR(&queue_mux);
+    queue.done();
+    tx_busy = false;
+    coupled_source = nullptr;
+    const bool more = !queue.empty();
+    portEXIT_CRITICAL_ISR(&queue_mux);
+
+    if (!more || feeder_task == nullptr) return false;
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(feeder_task, &woken);
+    return woken == pdTRUE;
+}
+
+// Restarts transmission after a direction change or a refill from ISR context
+static void stepper_feed_task(void *param) {
+    (void)param;
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        Stepper::kick();
+    }
+}
+
 bool Stepper::init() {
     // Configure GPIO pins
     pinMode(ELS_STEP_PIN, OUTPUT);
     pinMode(ELS_DIR_PIN, OUTPUT);
     digitalWrite(ELS_STEP_PIN, LOW);
     digitalWrite(ELS_DIR_PIN, LOW);
-    
+
     if (ELS_EN_PIN >= 0) {
         pinMode(ELS_EN_PIN, OUTPUT);
         digitalWrite(ELS_EN_PIN, ELS_EN_ACTIVE_LOW ? HIGH : LOW);  // Disabled
     }
-    
-    rmt_ready = rmtInit(ELS_STEP_PIN, RMT_TX_MODE, RMT_MEM_NUM_BLOCKS_1, ELS_RMT_RES_HZ);
-    if (!rmt_ready) {
-        Serial.println("[Stepper] RMT init failed");
+
+    if (!ELS_USE_RMT) {
+        Serial.println("[Stepper] GPIO mode initialized");
+        return true;
+    }
+
+    // TX channel and its interrupt live on the calling core (core 1)
+    rmt_tx_channel_config_t tx_config = {};
+    tx_config.gpio_num = ELS_STEP_PIN;
+    tx_config.clk_src = RMT_CLK_SRC_DEFAULT;
+    tx_config.resolution_hz = ELS_RMT_RES_HZ;
+    tx_config.mem_block_symbols = ELS_RMT_MEM_SYMBOLS;
+    tx_config.trans_queue_depth = 2;
+    esp_err_t err = rmt_new_tx_channel(&tx_config, &step_chan);
+
+    if (err == ESP_OK) {
+        rmt_simple_encoder_config_t enc_config = {};
+        enc_config.callback = encode_steps;
+        enc_config.arg = nullptr;
+        enc_config.min_chunk_size = 1;
+        err = rmt_new_simple_encoder(&enc_config, &step_encoder);
+    }
+    if (err == ESP_OK) {
+        rmt_tx_event_callbacks_t cbs = {};
+        cbs.on_trans_done = on_tx_done;
+        err = rmt_tx_register_event_callbacks(step_chan, &cbs, nullptr);
+    }
+    if (err == ESP_OK) {
+        err = rmt_enable(step_chan);
+    }
+    if (err != ESP_OK) {
+        Serial.printf("[Stepper] RMT init failed (%d)\n", (int)err);
+        return false;
+    }
+
+    // Just below the motion task so a restart never preempts the ELS update
+    if (xTaskCreatePinnedToCore(stepper_feed_task, "stepfeed", 2048, nullptr,
+                                23, &feeder_task, 1) != pdPASS) {
+        Serial.println("[Stepper] Feed task create failed");
         return false;
     }
-    rmtSetEOT(ELS_STEP_PIN, 0);
 
-    Serial.println("[Stepper] RMT mode initialized");
+    rmt_ready = true;
+    Serial.println("[Stepper] RMT streaming mode initialized");
     return true;
 }
 
 void Stepper::setDirection(bool forward) {
     bool dir_level = forward;
     if (ELS_INVERT_DIR) dir_level = !dir_level;
-    digitalWrite(ELS_DIR_PIN, dir_level ? HIGH : LOW);
-}
-
-void Stepper::step(int32_t count) {
-    if (count == 0) return;
-    
-    // Set direction
-    bool forward = (count > 0);
-    setDirection(forward);
-    
-    // Allow direction settle time
-    delayMicroseconds(2);
-    
-    int32_t steps = abs(count);
-    
-    // Limit steps per call to prevent blocking too long
-    if (steps > ELS_MAX_STEPS_PER_CYCLE) {
-        steps = ELS_MAX_STEPS_PER_CYCLE;
-    }
+    gpio_set_level((gpio_num_t)ELS_DIR_PIN, dir_level ? 1 : 0);
+}
+
+void IRAM_ATTR Stepper::onEmitted(int32_t steps) {
+    position += steps;
+}
+
+void IRAM_ATTR Stepper::onCoupledEmitted(int32_t steps) {
+    position += steps;
+    commanded += steps;
+}
 
+int32_t IRAM_ATTR Stepper::enqueue(int32_t count, uint32_t span_us) {
+    portENTER_CRITICAL_SAFE(&queue_mux);
+    const int32_t accepted = queue.push(count, span_us * TICKS_PER_US);
+    commanded += accepted;
+    portEXIT_CRITICAL_SAFE(&queue_mux);
+    return accepted;
+}
+
+void Stepper::kick() {
     if (!rmt_ready) return;
 
-    static rmt_data_t rmt_buf[ELS_RMT_CHUNK_STEPS];
-    static bool rmt_buf_init = false;
-    if (!rmt_buf_init) {
-        rmt_data_t pulse = {};
-        pulse.level0 = 1;
-        pulse.duration0 = ELS_PULSE_US;
-        pulse.level1 = 0;
-        pulse.duration1 = ELS_PULSE_US;
-        for (int32_t i = 0; i < ELS_RMT_CHUNK_STEPS; i++) {
-            rmt_buf[i] = pulse;
+    portENTER_CRITICAL(&queue_mux);
+    const bool start = !tx_busy && !queue.empty();
+    int32_t seg = 0;
+    if (start) {
+        tx_busy = true;
+        seg = queue.front().steps;
+    }
+    portEXIT_CRITICAL(&queue_mux);
+    if (!start) return;
+
+    transmit(seg > 0);
+}
+
+bool Stepper::startCoupled(SegmentSource source, bool forward) {
+    if (!rmt_ready || source == nullptr) return false;
+
+    portENTER_CRITICAL(&queue_mux);
+    const bool start = !tx_busy && queue.empty();
+    if (start) {
+        tx_busy = true;
+        coupled_source = source;
+    }
+    portEXIT_CRITICAL(&queue_mux);
+    if (!start) return false;
+
+    return transmit(forward);
+}
+
+int32_t Stepper::abortCoupled() {
+    if (coupled_source == nullptr) return 0;
+    // Disabling the channel drops whatever it still had to send
+    rmt_disable(step_chan);
+    rmt_enable(step_chan);
+    const int32_t left = (int32_t)step_gen.stepsLeft();
+    const int32_t unencoded = tx_forward ? left : -left;
+    portENTER_CRITICAL(&queue_mux);
+    tx_busy = false;
+    coupled_source = nullptr;
+    step_gen.begin();
+    portEXIT_CRITICAL(&queue_mux);
+    kick();
+    return unencoded;
+}
+
+void Stepper::dropEmitted(int32_t steps) {
+    portENTER_CRITICAL(&queue_mux);
+    position -= steps;
+    commanded -= steps;
+    portEXIT_CRITICAL(&queue_mux);
+}
+
+bool Stepper::isCoupled() {
+    return coupled_source != nullptr;
+}
+
+bool Stepper::isIdle() {
+    portENTER_CRITICAL(&queue_mux);
+    const bool idle = !tx_busy && queue.empty();
+    portEXIT_CRITICAL(&queue_mux);
+    return idle;
+}
+
+// Channel is idle and tx_busy is ours, so the encoder state is too until
+// rmt_transmit()
+bool Stepper::transmit(bool forward) {
+    tx_forward = forward;
+    step_gen.begin();
+    portENTER_CRITICAL(&queue_mux);
+    queue.begin();
+    portEXIT_CRITICAL(&queue_mux);
+    setDirection(tx_forward);
+
+    static const uint8_t token = 0;  // Encoder pulls from the ring, not from here
+    rmt_transmit_config_t tx_config = {};
+    tx_config.loop_count = 0;
+    tx_config.flags.eot_level = 0;
+    if (rmt_transmit(step_chan, step_encoder, &token, sizeof(token), &tx_config) != ESP_OK) {
+        portENTER_CRITICAL(&queue_mux);
+        tx_busy = false;
+        coupled_source = nullptr;
+        portEXIT_CRITICAL(&queue_mux);
+        return false;
+    }
+    return true;
+}
+
+uint32_t Stepper::spanUs(uint32_t dt_us) {
+    if (dt_us > ELS_STEP_SPAN_MAX_US) dt_us = ELS_STEP_SPAN_MAX_US;
+    uint32_t span = (dt_us * ELS_STEP_SPREAD_PCT) / 100;
+    // Previous batch still going out: catch up instead of adding lag
+    if (queue.backlog() > 0) span /= 2;
+    return span;
+}
+
+int32_t Stepper::step(int32_t count, uint32_t span_us) {
+    if (count == 0) return 0;
+
+    if (!ELS_USE_RMT) {
+        // Plain GPIO pulses (ELS_USE_RMT = false), blocking
+        const bool forward = (count > 0);
+        setDirection(forward);
+        delayMicroseconds(ELS_PULSE_US);
+
+        int32_t steps = abs(count);
+        if (steps > ELS_MAX_STEPS_PER_CYCLE) steps = ELS_MAX_STEPS_PER_CYCLE;
+        for (int32_t i = 0; i < steps; i++) {
+            digitalWrite(ELS_STEP_PIN, HIGH);
+            delayMicroseconds(ELS_PULSE_US);
+            digitalWrite(ELS_STEP_PIN, LOW);
+            delayMicroseconds(ELS_PULSE_US);
         }
-        rmt_buf_init = true;
+        const int32_t moved = forward ? steps : -steps;
+        position += moved;
+        commanded += moved;
+        return moved;
+    }
+
+    if (!rmt_ready) return 0;
+
+    const int32_t accepted = enqueue(count, span_us);
+    if (accepted != 0) kick();
+    return accepted;
+}
+
+int32_t IRAM_ATTR Stepper::queueFromIsr(int32_t count, uint32_t span_us) {
+    if (count == 0 || !rmt_ready) return 0;
+
+    const int32_t accepted = enqueue(count, span_us);
+    if (accepted != 0 && !tx_busy && feeder_task != nullptr) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(feeder_task, &woken);
+        if (woken == pdTRUE) portYIELD_FROM_ISR();
     }
+    return accepted;
+}
 
-    int32_t remaining = steps;
-    while (remaining > 0) {
-        int32_t chunk = remaining;
-        if (chunk > ELS_RMT_CHUNK_STEPS) chunk = ELS_RMT_CHUNK_STEPS;
-        (void)rmtWrite(ELS_STEP_PIN, rmt_buf, (size_t)chunk, RMT_WAIT_FOR_EVER);
-        remaining -= chunk;
+int32_t Stepper::getBacklog() {
+    return queue.backlog();
+}
+
+uint32_t Stepper::getOverloadCount() {
+    return queue.overloads();
+}
+
+// ============================================================================
+// Step timing trace: once ELS_STEP_TRACE_LEN periods have been captured, print
+// them with min/max/mean so spacing can be checked from the serial log
+// without a scope. Then start the next capture.
+// ============================================================================
+void Stepper::traceUpdate() {
+    if (!ELS_STEP_TRACE || trace_count < ELS_STEP_TRACE_LEN) return;
+
+    uint32_t min_t = UINT32_MAX;
+    uint32_t max_t = 0;
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < ELS_STEP_TRACE_LEN; i++) {
+        const uint32_t t = trace_buf[i];
+        if (t < min_t) min_t = t;
+        if (t > max_t) max_t = t;
+        sum += t;
     }
-    
-    // Update position
-    position += forward ? steps : -steps;
+    Serial.printf("[Stepper] step periods (ticks @ %lu Hz): min %lu max %lu mean %.2f\n",
+                  (unsigned long)ELS_RMT_RES_HZ, (unsigned long)min_t, (unsigned long)max_t,
+                  (double)sum / (double)ELS_STEP_TRACE_LEN);
+    for (uint32_t i = 0; i < ELS_STEP_TRACE_LEN; i += 16) {
+        Serial.print("[Stepper]");
+        for (uint32_t j = i; j < i + 16 && j < ELS_STEP_TRACE_LEN; j++) {
+            Serial.printf(" %lu", (unsigned long)trace_buf[j]);
+        }
+        Serial.println();
+    }
+
+    trace_count = 0;
 }
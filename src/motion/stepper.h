@@ -1,30 +1,85 @@
 #pragma once
 
 #include <stdint.h>
+#include "config_motion.h"
 
 // ============================================================================
 // Stepper motor driver for ELS Z-axis
-// Uses RMT peripheral for precise pulse timing
+// step() never blocks: signed step counts go into a ring (StepQueue) that
+// the producers share under a short spinlock, and the RMT TX interrupt
+// streams them out (one symbol per step) as channel memory frees up. Each
+// batch is spread evenly over the span it was produced in, so the pulse rate
+// follows the spindle instead of bursting at the pulse width. A direction
+// change ends the current transmission; the next one is started from task
+// context with DIR already switched.
 // ============================================================================
 
 class Stepper {
 public:
     static bool init();
-    
-    // Output N steps in the given direction
-    // Positive = forward, negative = reverse
-    static void step(int32_t count);
-    
-    // Get current position in steps
+
+    // Queue N steps, positive = forward, negative = reverse, evenly spaced
+    // over span_us (0 = as fast as the pulse width allows).
+    // Returns the signed number of steps accepted; the rest is the caller's
+    // to keep and retry (the queue is full, see getOverloadCount()).
+    static int32_t step(int32_t count, uint32_t span_us = 0);
+
+    // Span to spread steps produced over the last dt_us across: capped,
+    // scaled by ELS_STEP_SPREAD_PCT, and shortened while a backlog exists
+    static uint32_t spanUs(uint32_t dt_us);
+
+    // Same as step() from ISR context; transmission is restarted by the
+    // feeder task instead of inline
+    static int32_t queueFromIsr(int32_t count, uint32_t span_us = 0);
+
+    // Get current position in steps (steps handed to the RMT channel)
     static int32_t getPosition() { return position; }
-    
+
     // Reset position counter (doesn't move motor)
     static void resetPosition() { position = 0; }
-    
+
     // Set direction for next steps
     static void setDirection(bool forward);
-    
+
+    // All steps ever accepted (ELS, jog, MPG), signed; emitted or still queued
+    static int32_t getCommanded() { return commanded; }
+
+    // Steps accepted but not yet out of the channel (see StepQueue)
+    static int32_t getBacklog();
+    // Number of step()/queueFromIsr() calls that could not queue everything
+    static uint32_t getOverloadCount();
+
+    // Start a transmission if idle and steps are waiting (task context)
+    static void kick();
+
+    // Coupled stream (ELS_DRIVE_COUPLED): the encoder pulls segments from
+    // source instead of the queue, each spread over span_ticks (RMT ticks);
+    // zero-step segments are pure delays, so the stream keeps the source's
+    // timeline. The source returns false to end the stream. Only starts when
+    // idle (nothing queued, nothing going out).
+    typedef bool (*SegmentSource)(int32_t &steps, uint32_t &span_ticks);
+    static bool startCoupled(SegmentSource source, bool forward);
+    // Stop a coupled stream at once, dropping what the channel still holds.
+    // Returns the signed steps of the segment in progress not yet encoded
+    // (never counted); the source works out the rest that never went out.
+    static int32_t abortCoupled();
+    // Steps counted by onCoupledEmitted() that abortCoupled() dropped
+    static void dropEmitted(int32_t steps);
+    static bool isCoupled();
+    static bool isIdle();
+
+    // RMT encoder only: steps just written to channel memory
+    static void onEmitted(int32_t steps);
+    static void onCoupledEmitted(int32_t steps);  // Not queued: also commanded
+
+    // ELS_STEP_TRACE: call from loop(), prints captured step periods
+    static void traceUpdate();
+
 private:
-    static int32_t position;
+    static volatile int32_t position;
+    static volatile int32_t commanded;
     static bool rmt_ready;
+
+    static int32_t enqueue(int32_t count, uint32_t span_us);  // Task or ISR context
+    static bool transmit(bool forward);                         // tx_busy already set
 };
@@ -0,0 +1,223 @@
+#include "thread_cycle.h"
+#include "config_motion.h"
+#include "els_core.h"
+#include "encoder_motion.h"
+#include "stepper.h"
+#include "z_move.h"
+#include <Arduino.h>
+
+#if SPINDLE_MODE == SPINDLE_MODE_STEPPER
+#include "spindle_stepper.h"
+#endif
+
+// Return speed, steps/s
+static constexpr int32_t RAPID_SPS_RAW = (int32_t)(
+	(int64_t)ELS_THREAD_RAPID_MM_PER_MIN * 1000LL * (int64_t)ELS_STEPS_PER_REV /
+	(60LL * (int64_t)ELS_LEADSCREW_PITCH_UM));
+static constexpr int32_t RAPID_SPS =
+	(RAPID_SPS_RAW > ELS_STEPPER_MAX_SPS) ? ELS_STEPPER_MAX_SPS : RAPID_SPS_RAW;
+
+// ============================================================================
+// Static member initialization
+// ============================================================================
+volatile bool ThreadCycle::active = false;
+bool ThreadCycle::abort_req = false;
+bool ThreadCycle::last_run = false;
+ThreadCycle::Phase ThreadCycle::phase = ThreadCycle::PH_START;
+uint8_t ThreadCycle::passes = 0;
+uint8_t ThreadCycle::pass = 0;
+int32_t ThreadCycle::start_um = 0;
+volatile ThreadCycle::Outcome ThreadCycle::outcome = ThreadCycle::OUT_NONE;
+volatile bool ThreadCycle::start_req = false;
+volatile bool ThreadCycle::stop_req = false;
+uint8_t ThreadCycle::req_passes = 0;
+static portMUX_TYPE request_mux = portMUX_INITIALIZER_UNLOCKED;
+
+const char *const ThreadCycle::OUTCOME_TEXT[OUT_COUNT] = {
+	"",
+	"done",
+	"stopped",
+	"stopped (ELS disabled)",
+	"stopped (return refused)",
+	"stopped (return missed the start)",
+	"refused (needs sync on and a pitch)",
+	"refused (spindle not turning)",
+	"refused (no endstop in the direction of travel)",
+	"refused (Z outside the limits)",
+};
+
+// ============================================================================
+// Request from the UI (SPI loop): latched, applied in update(), as ZMove
+// does. A latched start already counts as active, so the loop never hands
+// the ELS enable back to the UI under a cycle starting up.
+// ============================================================================
+void ThreadCycle::request(bool run, uint8_t n) {
+	if (run && !last_run && !isActive() && !ZMove::isActive() && n > 0) {
+		portENTER_CRITICAL(&request_mux);
+		req_passes = n;
+		stop_req = false;
+		start_req = true;
+		portEXIT_CRITICAL(&request_mux);
+	} else if (!run && last_run && isActive()) {
+		portENTER_CRITICAL(&request_mux);
+		stop_req = true;
+		portEXIT_CRITICAL(&request_mux);
+	}
+	last_run = run;
+}
+
+bool ThreadCycle::isActive() {
+	portENTER_CRITICAL_SAFE(&request_mux);
+	const bool a = active || start_req;
+	portEXIT_CRITICAL_SAFE(&request_mux);
+	return a;
+}
+
+void ThreadCycle::applyRequest() {
+	if (!start_req && !stop_req) return;
+	portENTER_CRITICAL(&request_mux);
+	const bool start = start_req;
+	const bool stop = stop_req;
+	if (start) {
+		passes = req_passes;
+		pass = 0;
+		abort_req = false;
+		phase = PH_START;
+		active = true;
+	}
+	start_req = false;
+	stop_req = false;
+	portEXIT_CRITICAL(&request_mux);
+	if (stop && active) abort_req = true;
+}
+
+// Direction the spindle runs (or is switched to run) in: +1, -1, 0 = stopped
+static int8_t spindleDir() {
+#if SPINDLE_MODE == SPINDLE_MODE_STEPPER
+	return SpindleStepper::getDirection();
+#else
+	const int16_t rpm = EncoderMotion::getRpmSigned();
+	return (rpm > 0) ? 1 : (rpm < 0) ? -1 : 0;
+#endif
+}
+
+// Sync gives the phase to come back to; an enabled endstop in the direction
+// Z will travel ends each pass, and Z has to be inside the limits for either
+// to mean anything
+ThreadCycle::Outcome ThreadCycle::canStart() {
+	const int32_t pitch = ElsCore::getPitchUm();
+	if (!ElsCore::isSyncEnabled() || pitch == 0) return OUT_NO_SYNC;
+	if (ElsCore::endstopRoom(true) < 0 || ElsCore::endstopRoom(false) < 0) return OUT_OUTSIDE;
+	// Z runs with the gear: pitch sign, ELS direction and spindle direction
+	const int8_t spindle = spindleDir();
+	if (spindle == 0) return OUT_NO_SPINDLE;
+	const bool forward = ((pitch > 0) == (ElsCore::getDirectionMul() > 0)) == (spindle > 0);
+	if (ElsCore::endstopRoom(forward) == INT32_MAX) return OUT_NO_ENDSTOP;
+	return OUT_NONE;
+}
+
+// ELS off and nothing left moving Z (landing, ramp-down, queued steps)
+bool ThreadCycle::zAtRest() {
+#if SPINDLE_MODE == SPINDLE_MODE_STEPPER
+	if (SpindleStepper::isStopping()) return false;
+#endif
+	return ElsCore::isStopped() && Stepper::isIdle();
+}
+
+void ThreadCycle::beginPass() {
+	pass++;
+#if SPINDLE_MODE == SPINDLE_MODE_STEPPER
+	// A thread-end stop left the spindle held: the next pass runs it again
+	SpindleStepper::releaseHold();
+#endif
+	ElsCore::clearFault();
+	ElsCore::setEnabled(true);
+	phase = PH_CUT;
+}
+
+void ThreadCycle::finish(Outcome why) {
+	ElsCore::setEnabled(false);
+	outcome = why;
+	active = false;
+}
+
+// ============================================================================
+// Reporting (loop(), core 0)
+// ============================================================================
+void ThreadCycle::reportUpdate() {
+	static uint8_t last_pass = 0;
+	const uint8_t p = pass;
+	if (active && p != last_pass && p != 0) {
+		Serial.printf("[Thread] Pass %u/%u\n", (unsigned)p, (unsigned)passes);
+	}
+	last_pass = p;
+
+	const Outcome why = outcome;
+	if (why == OUT_NONE || active) return;
+	Serial.printf("[Thread] Cycle %s after %u/%u passes\n", OUTCOME_TEXT[why], (unsigned)p, (unsigned)passes);
+	outcome = OUT_NONE;
+}
+
+// ============================================================================
+// Update - motion task
+// ============================================================================
+void ThreadCycle::update() {
+	applyRequest();
+	if (!active) return;
+
+	if (abort_req && phase != PH_ABORT) {
+		// The ELS ramps itself down; a return in progress brakes to rest
+		ElsCore::setEnabled(false);
+		if (ZMove::isActive()) ZMove::stop();
+		phase = PH_ABORT;
+	}
+
+	switch (phase) {
+	case PH_START:
+		ElsCore::setEnabled(false);
+		{
+			const Outcome refused = canStart();
+			if (refused != OUT_NONE) {
+				finish(refused);
+				return;
+			}
+		}
+		if (!zAtRest()) return;
+		start_um = EncoderMotion::getZCount() * Z_UM_PER_COUNT;
+		beginPass();
+		break;
+
+	case PH_CUT:
+		if (ElsCore::endstopTriggered()) {
+			// Pass done; a Z landing still running finishes in ElsCore
+			ElsCore::setEnabled(false);
+			ElsCore::clearFault();
+			phase = PH_STOP;
+		} else if (!ElsCore::isEnabled()) {
+			finish(OUT_DISABLED);
+		}
+		break;
+
+	case PH_STOP:
+		if (!zAtRest()) return;
+		if (!ZMove::moveTo(start_um, RAPID_SPS, ELS_JOG_ACCEL)) {
+			finish(OUT_RETURN_REFUSED);
+			return;
+		}
+		phase = PH_RETURN;
+		break;
+
+	case PH_RETURN:
+		// ZMove ends at rest on the start by the scale, which is what the
+		// sync wait goes by
+		if (ZMove::isActive()) return;
+		if (ZMove::getResult() != ZMove::MR_DONE) finish(OUT_RETURN_MISSED);
+		else if (pass >= passes) finish(OUT_DONE);
+		else beginPass();
+		break;
+
+	case PH_ABORT:
+		if (!ZMove::isActive() && zAtRest()) finish(OUT_STOPPED);
+		break;
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+
+// ============================================================================
+// Threading cycle: repeats a threading pass without the UI in the loop.
+// Each pass enables the ELS from the start position and threads until it
+// stops at the soft endstop ahead (the Z landing, or the stepper spindle's
+// thread-end stop). Z then returns to the start at ELS_THREAD_RAPID_MM_PER_MIN
+// (a ZMove, so it ends on the start by the scale), and the next pass
+// re-enables the ELS, whose sync wait puts it back on the same helix.
+// Needs sync on (the helix reference) and an endstop in the direction of
+// travel to run into. The UI starts and stops it, and only watches it
+// otherwise. Infeed between passes is still the operator's (X has no drive).
+// ============================================================================
+
+class ThreadCycle {
+public:
+    // SPI loop (core 0): the UI's run request and pass count. A cycle starts
+    // on run going true, and stops (Z brought to rest) on it going false.
+    // Latched, and taken by update().
+    static void request(bool run, uint8_t passes);
+
+    // Motion task, ahead of ElsCore::update(): runs the cycle
+    static void update();
+
+    // While active the cycle owns ElsCore::setEnabled() and Z; a cycle the
+    // SPI loop has asked for and update() not yet taken counts
+    static bool isActive();
+    static uint8_t getPass() { return pass; }
+
+    // SPI loop (core 0): logs the passes and how the cycle ended, which
+    // the motion task only latches
+    static void reportUpdate();
+
+private:
+    enum Phase : uint8_t {
+        PH_START,   // Waiting for Z to be at rest to take the start position
+        PH_CUT,     // ELS threading towards the endstop
+        PH_STOP,    // Pass ended: waiting for Z (and the spindle) to stop
+        PH_RETURN,  // ZMove back to the start position
+        PH_ABORT,   // Stopped by the UI: Z brought to rest
+    };
+
+    // How a cycle ended (or why it never started)
+    enum Outcome : uint8_t {
+        OUT_NONE,
+        OUT_DONE,
+        OUT_STOPPED,         // By the UI
+        OUT_DISABLED,        // ELS disabled under the pass
+        OUT_RETURN_REFUSED,
+        OUT_RETURN_MISSED,
+        OUT_NO_SYNC,         // Refused: sync off or no pitch
+        OUT_NO_SPINDLE,      // Refused: spindle not turning, no direction of travel
+        OUT_NO_ENDSTOP,      // Refused: no endstop ahead
+        OUT_OUTSIDE,         // Refused: Z outside the limits
+        OUT_COUNT
+    };
+    static const char *const OUTCOME_TEXT[OUT_COUNT];
+
+    static volatile bool active;
+    static bool abort_req;
+    static bool last_run;
+    static Phase phase;
+    static uint8_t passes;
+    static uint8_t pass;           // Pass in progress, 1-based
+    static int32_t start_um;       // Start position, machine (scale)
+    static volatile Outcome outcome;  // Latched for reportUpdate()
+
+    // The SPI loop's request, under request_mux until applyRequest()
+    static volatile bool start_req;
+    static volatile bool stop_req;
+    static uint8_t req_passes;
+
+    static void applyRequest();
+    static Outcome canStart();
+    static bool zAtRest();
+    static void beginPass();
+    static void finish(Outcome why);
+};
@@ -0,0 +1,255 @@
+#include "z_move.h"
+#include "config_motion.h"
+#include "els_core.h"
+#include "encoder_motion.h"
+#include "stepper.h"
+#include <Arduino.h>
+
+// Final approach speed, steps/s
+static constexpr int32_t CREEP_SPS = (int32_t)(
+	(int64_t)ELS_MOVE_CREEP_MM_PER_MIN * 1000LL * (int64_t)ELS_STEPS_PER_REV /
+	(60LL * (int64_t)ELS_LEADSCREW_PITCH_UM));
+
+// ============================================================================
+// Static member initialization
+// ============================================================================
+volatile bool ZMove::active = false;
+bool ZMove::abort_req = false;
+volatile ZMove::Result ZMove::result = ZMove::MR_IDLE;
+ZMove::Phase ZMove::phase = ZMove::PH_PENDING;
+uint8_t ZMove::last_seq = 0;
+volatile uint8_t ZMove::seq_done = 0;
+uint8_t ZMove::seq_pending = 0;
+int32_t ZMove::target_um = 0;
+int32_t ZMove::target_steps = 0;
+int32_t ZMove::v_sps = 0;
+int32_t ZMove::accel_sps2 = 0;
+int32_t ZMove::corrections = 0;
+uint32_t ZMove::last_us = 0;
+uint32_t ZMove::rest_ms = 0;
+JogProfile ZMove::profile(ELS_STEPPER_MAX_SPS, ELS_JOG_ACCEL, ELS_JOG_JERK);
+volatile bool ZMove::start_req = false;
+volatile bool ZMove::stop_req = false;
+uint8_t ZMove::req_seq = 0;
+int32_t ZMove::req_target_um = 0;
+int32_t ZMove::req_v_sps = 0;
+int32_t ZMove::req_accel_sps2 = 0;
+static portMUX_TYPE request_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static inline int32_t um_to_steps(int64_t um) {
+	const int64_t n = um * ELS_STEPS_PER_REV;
+	return (int32_t)((n + ((n < 0) ? -ELS_LEADSCREW_PITCH_UM / 2 : ELS_LEADSCREW_PITCH_UM / 2)) /
+					 ELS_LEADSCREW_PITCH_UM);
+}
+
+static inline int32_t mm_to_steps(int64_t mm) {
+	return (int32_t)(mm * 1000 * ELS_STEPS_PER_REV / ELS_LEADSCREW_PITCH_UM);
+}
+
+static inline int32_t scale_um() {
+	return EncoderMotion::getZCount() * Z_UM_PER_COUNT;
+}
+
+// ============================================================================
+// Requests: latched on the SPI loop's core, applied in update(). A latched
+// start already counts as active, so the SPI loop never hands the ELS
+// enable back to the UI under a move starting up.
+// ============================================================================
+void ZMove::request(bool run, uint8_t seq, int32_t um, int32_t mm_per_min, int32_t accel_mm_s2) {
+	if (run && seq != last_seq && !isActive()) {
+		int32_t v = mm_to_steps(mm_per_min) / 60;
+		int32_t a = mm_to_steps(accel_mm_s2);
+		if (v > ELS_STEPPER_MAX_SPS) v = ELS_STEPPER_MAX_SPS;
+		if (v < 1) v = 1;
+		if (a < 1) a = 1;
+		portENTER_CRITICAL(&request_mux);
+		req_seq = seq;
+		req_target_um = um;
+		req_v_sps = v;
+		req_accel_sps2 = a;
+		stop_req = false;
+		start_req = true;
+		portEXIT_CRITICAL(&request_mux);
+	} else if (!run && isActive()) {
+		portENTER_CRITICAL(&request_mux);
+		stop_req = true;
+		portEXIT_CRITICAL(&request_mux);
+	}
+	// Dropping the request re-arms it, so a restarted UI's seq still counts
+	last_seq = run ? seq : 0;
+}
+
+bool ZMove::isActive() {
+	portENTER_CRITICAL_SAFE(&request_mux);
+	const bool a = active || start_req;
+	portEXIT_CRITICAL_SAFE(&request_mux);
+	return a;
+}
+
+// A start and then a stop both latched: the move starts and brakes at once
+void ZMove::applyRequest() {
+	if (!start_req && !stop_req) return;
+	portENTER_CRITICAL(&request_mux);
+	const bool start = start_req;
+	const bool stop = stop_req;
+	if (start) {
+		seq_pending = req_seq;
+		target_um = req_target_um;
+		v_sps = req_v_sps;
+		accel_sps2 = req_accel_sps2;
+		abort_req = false;
+		phase = PH_PENDING;
+		result = MR_MOVING;
+		active = true;
+	}
+	start_req = false;
+	stop_req = false;
+	portEXIT_CRITICAL(&request_mux);
+	if (stop && active) abort_req = true;
+}
+
+bool ZMove::moveTo(int32_t um, int32_t sps, int32_t accel) {
+	if (isActive()) return false;
+	target_um = um;
+	v_sps = (sps > ELS_STEPPER_MAX_SPS) ? ELS_STEPPER_MAX_SPS : sps;
+	accel_sps2 = accel;
+	seq_pending = seq_done;
+	abort_req = false;
+	result = MR_MOVING;
+	active = true;
+	// Z is at rest already (the caller waited for it): start at once
+	if (!begin()) return false;
+	phase = PH_RUN;
+	return true;
+}
+
+// ============================================================================
+// Move
+// ============================================================================
+// Z at rest (nothing queued, the ELS not moving it) for ELS_MOVE_SETTLE_MS,
+// so the scale reading is where it stopped
+bool ZMove::settled() {
+	if (!ElsCore::isStopped() || !Stepper::isIdle()) {
+		rest_ms = 0;
+		return false;
+	}
+	const uint32_t now = millis();
+	if (rest_ms == 0) rest_ms = now | 1;
+	return now - rest_ms >= ELS_MOVE_SETTLE_MS;
+}
+
+// Step target from the scale; false (finished, refused) if ELS is on or the
+// target is past an enabled endstop
+bool ZMove::begin() {
+	if (ElsCore::isEnabled()) {
+		finish(MR_REFUSED);
+		return false;
+	}
+	int32_t d = um_to_steps((int64_t)target_um - scale_um());
+	const int32_t room = ElsCore::endstopRoom(d >= 0);
+	const int32_t dist = (d < 0) ? -d : d;
+	// A target on the endstop itself (GO to it) may read a tolerance past it
+	if (dist > room) {
+		if (room < 0 || dist - room > um_to_steps(ELS_MOVE_TOLERANCE_UM)) {
+			finish(MR_REFUSED);
+			return false;
+		}
+		d = (d < 0) ? -room : room;
+	}
+	corrections = 0;
+	runTo(d, v_sps);
+	return true;
+}
+
+void ZMove::runTo(int32_t steps, int32_t sps) {
+	target_steps = Stepper::getCommanded() + steps;
+	profile = JogProfile(sps, accel_sps2, ELS_JOG_JERK);
+	last_us = micros();
+	rest_ms = 0;
+}
+
+void ZMove::finish(Result r) {
+	profile.stop();
+	seq_done = seq_pending;
+	result = r;
+	active = false;
+}
+
+// ============================================================================
+// Update - motion task
+// ============================================================================
+void ZMove::update() {
+	applyRequest();
+	if (!active) return;
+	const uint32_t now_us = micros();
+	const uint32_t dt_us = now_us - last_us;
+	last_us = now_us;
+
+	if (abort_req && phase != PH_STOP) {
+		if (phase == PH_PENDING) {
+			finish(MR_STOPPED);
+			return;
+		}
+		phase = PH_STOP;
+	}
+
+	int32_t n = 0;
+	switch (phase) {
+	case PH_PENDING:
+		// The SPI loop leaves the enable alone while a move is active
+		if (ElsCore::isEnabled()) {
+			finish(MR_REFUSED);
+			return;
+		}
+		if (!settled()) return;
+		if (!begin()) return;
+		phase = PH_RUN;
+		return;
+
+	case PH_RUN:
+		n = profile.toTarget(target_steps - Stepper::getCommanded(), dt_us,
+							 ElsCore::endstopRoom(true), ElsCore::endstopRoom(false));
+		break;
+
+	case PH_CHECK: {
+		if (!settled()) return;
+		const int32_t err_um = target_um - scale_um();
+		const int32_t abs_err = (err_um < 0) ? -err_um : err_um;
+		const int32_t d = um_to_steps(err_um);
+		if (abs_err <= ELS_MOVE_TOLERANCE_UM || d == 0) {
+			finish(MR_DONE);
+		} else if (corrections >= ELS_MOVE_MAX_CORRECTIONS) {
+			finish(MR_MISSED);
+		} else {
+			// Creep the difference the scale sees
+			corrections++;
+			runTo(d, CREEP_SPS);
+			phase = PH_RUN;
+		}
+		return;
+	}
+
+	case PH_STOP:
+		n = profile.toSpeed(0, dt_us, ElsCore::endstopRoom(true), ElsCore::endstopRoom(false));
+		break;
+	}
+
+	if (n != 0) {
+		int32_t m = n;
+		if (m > ELS_MAX_STEPS_PER_CYCLE) m = ELS_MAX_STEPS_PER_CYCLE;
+		if (m < -ELS_MAX_STEPS_PER_CYCLE) m = -ELS_MAX_STEPS_PER_CYCLE;
+		// What the queue can't take stays owed
+		const int32_t accepted = Stepper::step(m, Stepper::spanUs(dt_us));
+		profile.giveBack(n - accepted);
+	}
+
+	if (!profile.isStopped()) return;
+	if (phase == PH_STOP) {
+		if (Stepper::isIdle()) finish(MR_STOPPED);
+	} else {
+		// On the step target, or held short of it by an endstop: the scale
+		// decides
+		phase = PH_CHECK;
+		rest_ms = 0;
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+#include "jog_profile.h"
+
+// ============================================================================
+// Z move-to: an absolute move to a machine position with the spindle out of
+// it (ELS off). The jog profile runs the move on steps at the speed and
+// acceleration asked for, landing exactly on the step target. Then the Z
+// scale has the final say: once Z is at rest, any error beyond
+// ELS_MOVE_TOLERANCE_UM is crept out (backlash, lost steps). Enabled
+// endstops bound every move; a target past one is refused.
+// Moves come from the UI (MOVE_Z_TO) or from the motion board itself
+// (ThreadCycle's return to start).
+// ============================================================================
+
+class ZMove {
+public:
+    enum Result : uint8_t {
+        MR_IDLE = 0,     // No move yet
+        MR_MOVING,       // Running (or waiting for Z to be at rest to start)
+        MR_DONE,         // At the target, within ELS_MOVE_TOLERANCE_UM
+        MR_MISSED,       // Stopped, still off the target after the corrections
+        MR_REFUSED,      // Not started: ELS on, or target past an endstop
+        MR_STOPPED,      // Stopped before the target (request dropped)
+    };
+
+    // SPI loop (core 0): the UI's move. Run set with a new seq (non-zero)
+    // starts a move to target_um; run going false while it runs brings Z
+    // to rest. Latched, and taken by update().
+    static void request(bool run, uint8_t seq, int32_t target_um, int32_t mm_per_min, int32_t accel_mm_s2);
+
+    // Motion task: a move of the motion board's own, steps/s and steps/s^2.
+    // False (and nothing moves) if it is refused.
+    static bool moveTo(int32_t target_um, int32_t v_sps, int32_t accel_sps2);
+    // Motion task: bring a move to rest short of its target
+    static void stop() { abort_req = true; }
+
+    // Motion task, after anything else that may start a move
+    static void update();
+
+    // While active the move owns Z (and keeps the ELS off); a move the SPI
+    // loop has asked for and update() not yet taken counts
+    static bool isActive();
+    static Result getResult() { return result; }
+    static uint8_t getSeq() { return seq_done; }  // Seq of the move result is for
+
+private:
+    enum Phase : uint8_t {
+        PH_PENDING,  // Requested: waiting for Z to be at rest
+        PH_RUN,      // Profile running to target_steps
+        PH_CHECK,    // At the step target: waiting to read the scale
+        PH_STOP,     // Braking to rest
+    };
+
+    static volatile bool active;
+    static bool abort_req;
+    static volatile Result result;
+    static Phase phase;
+    static uint8_t last_seq;
+    static volatile uint8_t seq_done;
+    static uint8_t seq_pending;
+    static int32_t target_um;
+    static int32_t target_steps;    // Commanded-step count to end on
+    static int32_t v_sps;
+    static int32_t accel_sps2;
+    static int32_t corrections;
+    static uint32_t last_us;
+    static uint32_t rest_ms;        // Z at rest since, 0 = moving
+    static JogProfile profile;
+
+    // The SPI loop's request, under request_mux until applyRequest()
+    static volatile bool start_req;
+    static volatile bool stop_req;
+    static uint8_t req_seq;
+    static int32_t req_target_um;
+    static int32_t req_v_sps;
+    static int32_t req_accel_sps2;
+
+    static void applyRequest();
+    static bool begin();
+    static bool settled();
+    static void runTo(int32_t steps, int32_t sps);
+    static void finish(Result r);
+};
@@ -37,6 +37,10 @@ static constexpr int32_t Z_UM_PER_COUNT = 5;
 // RPM switching thresholds (add hysteresis to avoid flicker)
 static constexpr int RPM_SHOW_RPM_ON  = 60;  // above this -> show RPM on C row
 static constexpr int RPM_SHOW_RPM_OFF = 45;  // below this -> show degrees on C row
+// Below this RPM the C row shows tenths while the speed is steady (under
+// RPM_STEADY_ACCEL RPM/s); only the encoder spindle reports fractions
+static constexpr int RPM_SHOW_DECIMAL_BELOW = 100;
+static constexpr int RPM_STEADY_ACCEL = 20;
 
 // SPI communication settings
 // 64 bytes @ 1 MHz = ~512 µs per transaction, plenty fast for 100 Hz polling
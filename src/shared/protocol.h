@@ -8,10 +8,10 @@
 // ============================================================================
 
 // Fixed packet size for SPI DMA transfers (must match on both sides)
-static constexpr size_t PROTOCOL_PACKET_SIZE = 32;
+static constexpr size_t PROTOCOL_PACKET_SIZE = 40;
 
 // Protocol version for compatibility checking
-static constexpr uint8_t PROTOCOL_VERSION = 9;
+static constexpr uint8_t PROTOCOL_VERSION = 19;
 
 // ============================================================================
 // MPG Mode (Manual Pulse Generator routing)
@@ -38,8 +38,16 @@ enum class MotionCommand : uint8_t
 	CLEAR_ENDSTOPS,	 // Clear endstop limits
 	SYNC_REQUEST,	 // Request full state sync
 	SET_MPG_MODE,	 // Set MPG routing mode (RPM/Z jog/C jog)
+	MOVE_Z_TO,		 // Move Z to move_target (level: held until the result is back)
+	MOVE_C_TO,		 // Move the stepper spindle (C) to move_target, same way
 };
 
+// CommandPacket.flags
+static constexpr uint8_t CMD_FLAG_ELS_ENABLE = 0x01;   // ELS on
+static constexpr uint8_t CMD_FLAG_THREAD_CYCLE = 0x02; // Threading cycle: start on set, stop on clear
+static constexpr uint8_t CMD_FLAG_OTA = 0x04;          // Request OTA mode
+static constexpr uint8_t CMD_FLAG_REBOOT = 0x08;       // Request reboot
+
 // ============================================================================
 // Sync state (Motion -> UI)
 // ============================================================================
@@ -52,6 +60,20 @@ enum class SyncStateProto : uint8_t
 };
 
 
+// ============================================================================
+// Move-to result (Motion -> UI), for the move StatusPacket.z_move_seq
+// (c_move_seq) names
+// ============================================================================
+enum class MoveResultProto : uint8_t
+{
+	IDLE = 0,	 // No move yet
+	MOVING = 1,	 // Running
+	DONE = 2,	 // At the target
+	MISSED = 3,	 // Stopped off the target (scale disagreed after corrections)
+	REFUSED = 4, // ELS on, target past an endstop, spindle switched on
+	STOPPED = 5, // Request dropped while running
+};
+
 // ============================================================================
 // Status flags from Motion → UI
 // ============================================================================
@@ -65,13 +87,22 @@ struct MotionStatusFlags {
 	uint8_t sync_waiting : 1;	  // ELS sync is waiting for phase match
 };
 
+struct MotionStatusFlags2 {
+    uint8_t step_overload   : 1;  // Z step queue refused steps recently
+    uint8_t wcet_over       : 1;  // An ELS state handler exceeded its time budget
+    uint8_t ota_active      : 1;  // OTA mode active
+    uint8_t wifi_connected  : 1;  // WiFi connected
+    uint8_t thread_cycle    : 1;  // Threading cycle running
+    uint8_t thread_pass     : 3;  // Its pass in progress, low 3 bits (unwrap by differences)
+};
+
 // ============================================================================
-// Command packet: UI → Motion (32 bytes)
+// Command packet: UI → Motion (40 bytes)
 // ============================================================================
 struct __attribute__((packed)) CommandPacket {
     uint8_t version;              // Protocol version        [1]
     MotionCommand cmd;            // Command to execute      [1]
-    uint8_t flags;                // Enable flags, direction [1]
+    uint8_t flags;                // CMD_FLAG_*              [1]
     int8_t  direction_mul;        // +1 normal, -1 reverse   [1]
     
     int32_t pitch_um;             // Thread pitch in microns [4]
@@ -87,15 +118,18 @@ struct __attribute__((packed)) CommandPacket {
 	uint8_t sync_enabled;		  // Sync enabled flag       [1]
 	int8_t  jog_dir;			  // Jog direction (-1/0/+1) [1]
 	uint8_t jog_active;			  // Jog active flag         [1]
-	uint8_t ota_request;		  // Request OTA mode        [1]
-	uint8_t reboot_request;		  // Request reboot          [1]
+	uint8_t thread_passes;		  // Threading cycle passes  [1]
+	uint8_t move_seq;			  // Move-to: new value = new move [1]
+	int32_t move_target;		  // Z: machine um, C: counts in the rev [4]
+	uint16_t move_speed;		  // Z: mm/min, C: RPM       [2]
+	uint16_t move_accel;		  // Z: mm/s^2 (C: spindle's own) [2]
 	uint8_t sequence;             // Packet sequence number  [1]
     uint8_t checksum;             // XOR checksum            [1]
-};                                // Total: 32 bytes
+};                                // Total: 40 bytes
 static_assert(sizeof(CommandPacket) == PROTOCOL_PACKET_SIZE, "CommandPacket size mismatch");
 
 // ============================================================================
-// Status packet: Motion → UI (32 bytes)
+// Status packet: Motion → UI (40 bytes)
 // ============================================================================
 struct __attribute__((packed)) StatusPacket {
     uint8_t version;              // Protocol version        [1]
@@ -105,20 +139,77 @@ struct __attribute__((packed)) StatusPacket {
     
     int32_t x_count;              // X encoder raw count     [4]
 	int32_t z_count;              // Z encoder raw count     [4]
-	int32_t c_count;              // Spindle total count     [4]
+	int32_t c_count;              // Spindle count, low 32 bits [4]
 	int32_t z_steps;              // Stepper position        [4]
     
     int16_t rpm_signed;           // Spindle RPM with sign   [2]
 	int16_t target_rpm;			  // Target RPM from MPG     [2]
-	uint8_t ota_active;			  // OTA mode active         [1]
-	uint8_t wifi_connected;		  // WiFi connected          [1]
-	uint8_t reserved2[4];		  // Padding                 [4]
+	uint16_t c_epoch;			  // Spindle count bits 32-47 [2]
+	MotionStatusFlags2 flags2;	  // More status flags       [1]
+	uint16_t sync_engage_ms;	  // Last sync wait -> lock  [2]
+	int8_t rpm_centi;			  // RPM = rpm_signed + this / 100 [1]
+	MoveResultProto z_move;		  // Z move-to result        [1]
+	uint8_t z_move_seq;			  // move_seq the result is for [1]
+	MoveResultProto c_move;		  // C move-to result        [1]
+	uint8_t c_move_seq;			  // move_seq the result is for [1]
+	uint8_t reserved[4];		  // Padding                 [4]
 
 	uint8_t sequence;             // Echo of command seq     [1]
     uint8_t checksum;             // XOR checksum            [1]
-};                                // Total: 32 bytes
+};                                // Total: 40 bytes
 static_assert(sizeof(StatusPacket) == PROTOCOL_PACKET_SIZE, "StatusPacket size mismatch");
 
+// The spindle count is 64-bit on the motion board. c_count carries the low
+// word (so a receiver can also unwrap it by differences) and c_epoch the next
+// 16 bits: 48 bits is over 50 years at 3000 RPM.
+inline int64_t protocolSpindleCount(const StatusPacket& s) {
+    const uint64_t u = ((uint64_t)s.c_epoch << 32) | (uint32_t)s.c_count;
+    return (int64_t)(u << 16) >> 16;  // Sign-extend from 48 bits
+}
+
+inline void protocolSetSpindleCount(StatusPacket& s, int64_t count) {
+    s.c_count = (int32_t)(uint32_t)count;
+    s.c_epoch = (uint16_t)((uint64_t)count >> 32);
+}
+
+// ============================================================================
+// Telemetry packet: Motion → UI (40 bytes)
+// Sent in place of a StatusPacket every few transactions, one encoder per
+// packet in turn. Told apart by version = PROTOCOL_VERSION | PROTOCOL_TELEMETRY.
+// ============================================================================
+static constexpr uint8_t PROTOCOL_TELEMETRY = 0x80;
+
+enum class EncoderIdProto : uint8_t
+{
+	X = 0,
+	Z = 1,
+	C = 2,	 // Spindle encoder (encoder mode)
+	MPG = 3, // Stepper mode
+	COUNT
+};
+
+struct __attribute__((packed)) TelemetryPacket {
+    uint8_t version;              // PROTOCOL_VERSION | PROTOCOL_TELEMETRY [1]
+    EncoderIdProto encoder;       // Which encoder           [1]
+    uint8_t gpio_decoded;         // 1 = GPIO ISR decoder; 0 = PCNT, illegal unavailable [1]
+    uint8_t reserved[1];          // Padding                 [1]
+
+    uint32_t illegal;             // A+B changed together (gpio_decoded only) [4]
+    uint32_t overflows;           // PCNT position unit folds [4]
+    uint32_t edges_per_s;         // Current edge rate       [4]
+    uint32_t peak_edges_per_s;    // Highest since boot      [4]
+    int16_t rpm_accel;            // C only: spindle RPM/s   [2]
+    int16_t index_rev_error;      // C only: last index rev minus counts/rev [2]
+    uint16_t index_slips;         // C only: count found off phase (saturating) [2]
+    uint8_t index_state;          // C only: 0 = no index, 1 = not homed, 2 = homed [1]
+    uint32_t speed_events;        // C only: speed event unit's stamps [4]
+    uint8_t reserved2[7];         // Padding                 [7]
+
+    uint8_t sequence;             // Echo of command seq     [1]
+    uint8_t checksum;             // XOR checksum            [1]
+};                                // Total: 40 bytes
+static_assert(sizeof(TelemetryPacket) == PROTOCOL_PACKET_SIZE, "TelemetryPacket size mismatch");
+
 // ============================================================================
 // Checksum calculation
 // ============================================================================
@@ -41,3 +41,16 @@ static constexpr int SPI_MASTER_CS   = 5;
 // Physical ELS control buttons (active LOW with internal pullups)
 static constexpr int ELS_BTN_LEFT_PIN = 6;	// ELS positive direction
 static constexpr int ELS_BTN_RIGHT_PIN = 7; // ELS negative direction
+
+// Threading cycle (long-press the pitch button): passes per cycle, and how
+// long the motion board gets to show it running before a start is dropped
+static constexpr uint8_t THREAD_CYCLE_PASSES = 6;
+static constexpr uint32_t THREAD_CYCLE_START_MS = 500;
+
+// Z move-to (endstop modal GO): speed and acceleration asked of the motion
+// board, which ends the move on the target by the Z scale
+static constexpr uint16_t Z_MOVE_MM_PER_MIN = 1000;
+static constexpr uint16_t Z_MOVE_ACCEL_MM_S2 = 50;
+// C move-to (C modal GO / DIV, stepper spindle): top speed; the spindle
+// ramps at its own acceleration
+static constexpr uint16_t C_MOVE_RPM = 120;
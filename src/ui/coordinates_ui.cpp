@@ -9,7 +9,7 @@
 // Static member definitions
 int32_t CoordinateSystem::x_raw_um = 0;
 int32_t CoordinateSystem::z_raw_um = 0;
-int32_t CoordinateSystem::c_raw_ticks = 0;
+int64_t CoordinateSystem::c_raw_ticks = 0;
 
 int32_t CoordinateSystem::x_global_um[OFFSET_COUNT][CoordinateSystem::OFFSET_VARIANTS] = {0};
 int32_t CoordinateSystem::z_global_um[OFFSET_COUNT][CoordinateSystem::OFFSET_VARIANTS] = {0};
@@ -67,7 +67,7 @@ int32_t CoordinateSystem::getDisplayZ(int tool_index) {
     return zMachineToUserUm(machine_um);
 }
 
-int32_t CoordinateSystem::getDisplayC(int32_t c_ticks, int tool_index) {
+int32_t CoordinateSystem::getDisplayC(int64_t c_ticks, int tool_index) {
     int off = OffsetManager::getCurrentOffset();
     if (off < 0 || off >= OFFSET_COUNT) off = 0;
     const int off_b = OffsetManager::isOffsetBActive(off) ? 1 : 0;
@@ -106,8 +106,8 @@ bool CoordinateSystem::parseDegToDegX100(const char *s, int32_t *out_deg_x100) {
     return true;
 }
 
-int32_t CoordinateSystem::wrap01599(int32_t t) {
-    int32_t r = t % 1600;
+int32_t CoordinateSystem::wrap01599(int64_t t) {
+    int32_t r = (int32_t)(t % 1600);
     if (r < 0) r += 1600;
     return r;
 }
@@ -11,7 +11,7 @@ public:
     // Raw values from motion board (microns for linear, ticks for rotary)
     static int32_t x_raw_um;
     static int32_t z_raw_um;
-    static int32_t c_raw_ticks;
+    static int64_t c_raw_ticks;     // 64-bit, never wraps
     
     // Work offsets (G54/G55 style), indexed by OffsetManager's current offset
     static int32_t x_global_um[OFFSET_COUNT][OFFSET_VARIANTS];
@@ -48,7 +48,7 @@ public:
     // Coordinate calculations (display = raw - global - tool[current])
     static int32_t getDisplayX(int tool_index);
     static int32_t getDisplayZ(int tool_index);
-    static int32_t getDisplayC(int32_t c_raw_ticks, int tool_index);
+    static int32_t getDisplayC(int64_t c_raw_ticks, int tool_index);
     
     // Unit conversion helpers
     static void formatMm(char *out, size_t n, int32_t um);
@@ -65,7 +65,7 @@ public:
     static void saveToolOffsets();
     
     // Rotation helpers
-    static int32_t wrap01599(int32_t t);
+    static int32_t wrap01599(int64_t t);
     static int32_t ticksToDegX100(int32_t ticks_0_1599);
     static int32_t degX100ToTicks(int32_t deg_x100);
 };
@@ -2,10 +2,12 @@
 #include "coordinates_ui.h"
 
 // Static member definitions
-int32_t EncoderProxy::c_raw_ticks = 0;
-int32_t EncoderProxy::c_total_count = 0;
+int64_t EncoderProxy::c_raw_ticks = 0;
+int64_t EncoderProxy::c_total_count = 0;
 int32_t EncoderProxy::rpm_raw = 0;
 int32_t EncoderProxy::rpm_signed = 0;
+int32_t EncoderProxy::rpm_centi = 0;
+int16_t EncoderProxy::rpm_accel = 0;
 int16_t EncoderProxy::target_rpm = 0;
 MpgModeProto EncoderProxy::mpg_mode = MpgModeProto::RPM_CONTROL;
 bool EncoderProxy::c_show_rpm = false;
@@ -16,13 +18,15 @@ void EncoderProxy::init() {
     c_total_count = 0;
     rpm_raw = 0;
     rpm_signed = 0;
+    rpm_centi = 0;
+    rpm_accel = 0;
 	target_rpm = 0;
 	mpg_mode = MpgModeProto::RPM_CONTROL;
 	c_show_rpm = false;
     c_manual_rpm_mode = false;
 }
 
-void EncoderProxy::updateFromMotion(int32_t c_ticks, int16_t rpm, int16_t tgt_rpm, uint8_t mode)
+void EncoderProxy::updateFromMotion(int64_t c_ticks, int16_t rpm, int8_t centi, int16_t tgt_rpm, uint8_t mode)
 {
 	c_raw_ticks = c_ticks;
     c_total_count = c_ticks;  // Total count for ELS sync
@@ -30,6 +34,7 @@ void EncoderProxy::updateFromMotion(int32_t c_ticks, int16_t rpm, int16_t tgt_rp
     // Handle RPM direction
     rpm_raw = (rpm < 0) ? -rpm : rpm;
     rpm_signed = rpm;
+    rpm_centi = (int32_t)rpm * 100 + centi;
 
 	// Auto-toggle to RPM display mode when target RPM changes (while in RPM_CONTROL mode)
 	MpgModeProto newMode = static_cast<MpgModeProto>(mode);
@@ -62,6 +67,10 @@ void EncoderProxy::updateFromMotion(int32_t c_ticks, int16_t rpm, int16_t tgt_rp
     }
 }
 
+bool EncoderProxy::isRpmSteady() {
+    return rpm_accel > -RPM_STEADY_ACCEL && rpm_accel < RPM_STEADY_ACCEL;
+}
+
 void EncoderProxy::toggleManualRpmMode() {
     if (!canToggleManualMode()) return;
     c_manual_rpm_mode = !c_manual_rpm_mode;
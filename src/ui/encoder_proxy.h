@@ -13,13 +13,18 @@ public:
     static void init();
     
     // Update from motion board status packet
-	static void updateFromMotion(int32_t c_ticks, int16_t rpm, int16_t target_rpm, uint8_t mpg_mode);
+	static void updateFromMotion(int64_t c_ticks, int16_t rpm, int8_t rpm_centi, int16_t target_rpm, uint8_t mpg_mode);
+	// Spindle acceleration from the motion board's C telemetry
+	static void setRpmAccel(int16_t accel) { rpm_accel = accel; }
 
 	// Get cached values (same API as original EncoderManager)
-    static int32_t getRawTicks() { return c_raw_ticks; }
-    static int32_t getSpindleTotalCount() { return c_total_count; }
+    static int64_t getRawTicks() { return c_raw_ticks; }
+    static int64_t getSpindleTotalCount() { return c_total_count; }
     static int32_t getRpm() { return rpm_raw; }
     static int32_t getRpmSigned() { return rpm_signed; }
+    static int32_t getRpmCenti() { return rpm_centi; }     // Signed, 1/100 RPM
+    static int16_t getRpmAccel() { return rpm_accel; }     // RPM/s
+    static bool isRpmSteady();
     static bool shouldShowRpm() { return c_show_rpm; }
 
 	// Target RPM from MPG encoder (stepper spindle mode)
@@ -34,10 +39,12 @@ public:
     static bool canToggleManualMode() { return rpm_raw <= RPM_SHOW_RPM_OFF; }
     
 private:
-    static int32_t c_raw_ticks;
-    static int32_t c_total_count;
+    static int64_t c_raw_ticks;
+    static int64_t c_total_count;
     static int32_t rpm_raw;
     static int32_t rpm_signed;
+    static int32_t rpm_centi;
+    static int16_t rpm_accel;
 	static int16_t target_rpm;
 	static MpgModeProto mpg_mode;
 	static bool c_show_rpm;
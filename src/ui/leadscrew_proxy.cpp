@@ -1,5 +1,6 @@
 #include "leadscrew_proxy.h"
 #include "coordinates_ui.h"
+#include "config_ui.h"
 
 #include <Arduino.h>
 #include <cmath>
@@ -11,6 +12,15 @@ int32_t LeadscrewProxy::pitch_um = 1000; // default: 1.000mm pitch
 int8_t LeadscrewProxy::direction_mul = 1;
 bool LeadscrewProxy::bounds_exceeded = false;
 bool LeadscrewProxy::els_fault = false;
+bool LeadscrewProxy::cycle_requested = false;
+uint32_t LeadscrewProxy::cycle_request_ms = 0;
+uint8_t LeadscrewProxy::thread_passes = THREAD_CYCLE_PASSES;
+bool LeadscrewProxy::cycle_active = false;
+uint32_t LeadscrewProxy::cycle_pass = 0;
+bool LeadscrewProxy::move_pending = false;
+bool LeadscrewProxy::move_c = false;
+uint8_t LeadscrewProxy::move_seq = 0;
+int32_t LeadscrewProxy::move_target = 0;
 
 void LeadscrewProxy::init() {
     // Default pitch depends on unit mode: in -> 20 TPI, mm -> 1.0mm
@@ -26,6 +36,49 @@ void LeadscrewProxy::init() {
     direction_mul = 1;
     bounds_exceeded = false;
     els_fault = false;
+    cycle_requested = false;
+    cycle_active = false;
+    cycle_pass = 0;
+    move_pending = false;
+}
+
+void LeadscrewProxy::toggleThreadCycle() {
+    cycle_requested = !cycle_requested;
+    cycle_request_ms = millis();
+}
+
+// The request stays up while the cycle runs, and drops once it has finished
+// (or the motion board never started it). The pass arrives as its low 3
+// bits; it only ever counts up one at a time.
+void LeadscrewProxy::updateThreadCycle(bool active, uint8_t pass_low) {
+    if (active && !cycle_active) cycle_pass = 0;
+    if (active) cycle_pass += (uint8_t)(pass_low - cycle_pass) & 0x7;
+    if (cycle_requested && !active &&
+        (cycle_active || millis() - cycle_request_ms > THREAD_CYCLE_START_MS)) {
+        cycle_requested = false;
+    }
+    cycle_active = active;
+}
+
+// One move at a time, either axis. Seq 0 is never used: the motion board
+// reads it as no move.
+void LeadscrewProxy::requestMove(bool c, int32_t target) {
+    if (move_pending || enabled || cycle_requested || cycle_active) return;
+    if (++move_seq == 0) move_seq = 1;
+    move_c = c;
+    move_target = target;
+    move_pending = true;
+}
+
+void LeadscrewProxy::requestZMove(int32_t machine_um) { requestMove(false, machine_um); }
+void LeadscrewProxy::requestCMove(int32_t c_ticks) { requestMove(true, c_ticks); }
+
+void LeadscrewProxy::updateMove(uint8_t seq, bool moving, bool reached) {
+    if (!move_pending || seq != move_seq || moving) return;
+    move_pending = false;
+    if (!reached) {
+        Serial.printf("[UI] %c move to %ld did not finish on target\n", move_c ? 'C' : 'Z', (long)move_target);
+    }
 }
 
 void LeadscrewProxy::setPitchUm(int32_t pitch_um_per_rev) {
@@ -40,6 +40,26 @@ public:
     // Track ELS fault from motion board
     static bool hasFault() { return els_fault; }
     static void setFault(bool fault) { els_fault = fault; }
+
+    // Threading cycle run on the motion board: requested here, reported back
+    static bool isThreadCycleRequested() { return cycle_requested; }
+    static void toggleThreadCycle();
+    static uint8_t getThreadPasses() { return thread_passes; }
+    static bool isThreadCycleActive() { return cycle_active; }
+    static uint32_t getThreadPass() { return cycle_pass; }
+    static void updateThreadCycle(bool active, uint8_t pass_low);
+
+    // Z move-to a machine position, or C move-to a raw C angle (ticks in
+    // the rev, stepper spindle), run on the motion board. The request is
+    // held (under its seq) until the result for that seq comes back.
+    static void requestZMove(int32_t machine_um);
+    static void requestCMove(int32_t c_ticks);
+    static void cancelMove() { move_pending = false; }
+    static bool isMovePending() { return move_pending; }
+    static bool isMoveC() { return move_c; }
+    static uint8_t getMoveSeq() { return move_seq; }
+    static int32_t getMoveTarget() { return move_target; }
+    static void updateMove(uint8_t seq, bool moving, bool reached);
     
 private:
     static bool enabled;
@@ -48,4 +68,15 @@ private:
     static int8_t direction_mul;
     static bool bounds_exceeded;
     static bool els_fault;
+    static bool cycle_requested;
+    static uint32_t cycle_request_ms;
+    static uint8_t thread_passes;
+    static bool cycle_active;
+    static uint32_t cycle_pass;
+    static bool move_pending;
+    static bool move_c;
+    static uint8_t move_seq;
+    static int32_t move_target;
+
+    static void requestMove(bool c, int32_t target);
 };
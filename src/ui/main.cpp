@@ -33,17 +33,30 @@ static void updateFromMotionBoard() {
     CoordinateSystem::z_raw_um = status.z_count * Z_UM_PER_COUNT;
 
 	// Update encoder proxy with spindle data and MPG state
-	EncoderProxy::updateFromMotion(status.c_count, status.rpm_signed,
+	EncoderProxy::updateFromMotion(protocolSpindleCount(status), status.rpm_signed, status.rpm_centi,
 								   status.target_rpm, status.flags.mpg_mode);
+	EncoderProxy::setRpmAccel(SpiMaster::getTelemetry(EncoderIdProto::C).rpm_accel);
 
 	const SyncStateProto sync_state = status.sync_state;
 	SyncProxy::setWaiting(sync_state == SyncStateProto::SYNC_WAITING);
 	SyncProxy::setInSync(sync_state == SyncStateProto::SYNC_IN_SYNC);
-	OtaProxy::setMotionWifi(status.wifi_connected != 0);
-	OtaProxy::setMotionOtaActive(status.ota_active != 0);
-
-	// Check for endstop hit flag from motion board
-    if (status.flags.endstop_hit) {
+	OtaProxy::setMotionWifi(status.flags2.wifi_connected != 0);
+	OtaProxy::setMotionOtaActive(status.flags2.ota_active != 0);
+
+	LeadscrewProxy::updateThreadCycle(status.flags2.thread_cycle != 0, status.flags2.thread_pass);
+	// A move doesn't outlive the link (the motion board stops it too)
+	if (SpiMaster::isConnected()) {
+		const bool c = LeadscrewProxy::isMoveC();
+		const MoveResultProto move = c ? status.c_move : status.z_move;
+		LeadscrewProxy::updateMove(c ? status.c_move_seq : status.z_move_seq,
+								   move == MoveResultProto::MOVING, move == MoveResultProto::DONE);
+	} else {
+		LeadscrewProxy::cancelMove();
+	}
+
+	// Check for endstop hit flag from motion board (each pass of a
+	// threading cycle ends on one: the cycle deals with that itself)
+    if (status.flags.endstop_hit && !status.flags2.thread_cycle) {
         LeadscrewProxy::setBoundsExceeded(true);
     }
 }
@@ -57,6 +70,12 @@ static void sendCommandsToMotionBoard() {
 	SpiMaster::setJog(jog_dir != 0, jog_dir);
 	SpiMaster::setOtaRequest(OtaProxy::isActive());
 	SpiMaster::setRebootRequest(OtaProxy::shouldRequestReboot());
+	SpiMaster::setThreadCycle(LeadscrewProxy::isThreadCycleRequested(), LeadscrewProxy::getThreadPasses());
+	MotionCommand move = MotionCommand::NOP;
+	if (LeadscrewProxy::isMovePending()) {
+		move = LeadscrewProxy::isMoveC() ? MotionCommand::MOVE_C_TO : MotionCommand::MOVE_Z_TO;
+	}
+	SpiMaster::setMove(move, LeadscrewProxy::getMoveSeq(), LeadscrewProxy::getMoveTarget());
     SpiMaster::setEndstops(
         EndstopProxy::getMinMachineUm(),
         EndstopProxy::getMaxMachineUm(),
@@ -409,6 +409,27 @@ void ModalManager::showOffsetModal(AxisSel axis) {
     lv_obj_center(lblg);
     apply_modal_button_common_style(btn_g);
 
+    if (axis == AXIS_C) {
+        // GO: turn the spindle to the angle entered. DIV: the entry is a
+        // number of divisions, and the spindle indexes on to the next one.
+        // Stepper spindle only (the motion board refuses otherwise).
+        const bool c_busy = LeadscrewProxy::isEnabled() || LeadscrewProxy::isThreadCycleActive();
+        static const char *const c_labels[] = {"GO", "DIV"};
+        const lv_event_cb_t c_cbs[] = {onCGo, onCDiv};
+        for (int i = 0; i < 2; i++) {
+            lv_obj_t *btn = lv_btn_create(row);
+            lv_obj_set_size(btn, main_g_btn_w, 44);
+            lv_obj_add_event_cb(btn, c_cbs[i], LV_EVENT_CLICKED, nullptr);
+            lv_obj_set_style_bg_color(btn, modal_accent_blue_grey(), LV_PART_MAIN);
+            lv_obj_set_style_text_color(btn, lv_color_white(), LV_PART_MAIN);
+            lv_obj_t *lbl = lv_label_create(btn);
+            lv_label_set_text(lbl, c_labels[i]);
+            lv_obj_center(lbl);
+            apply_modal_button_common_style(btn);
+            if (c_busy) lv_obj_add_state(btn, LV_STATE_DISABLED);
+        }
+    }
+
     // X button
     lv_obj_t *btn_x = lv_btn_create(row);
     lv_obj_set_size(btn_x, main_g_btn_w, 44);
@@ -555,6 +576,20 @@ void ModalManager::showEndstopModal(bool is_max) {
     lv_obj_center(lblo);
     apply_modal_button_common_style(btn_ok);
 
+    // GO: set the endstop, then drive Z onto it (motion board, ELS off)
+    lv_obj_t *btn_go = lv_btn_create(row);
+    lv_obj_set_size(btn_go, btn_w, 44);
+    lv_obj_add_event_cb(btn_go, onEndstopGo, LV_EVENT_CLICKED, nullptr);
+    lv_obj_set_style_bg_color(btn_go, modal_accent_blue_grey(), LV_PART_MAIN);
+    lv_obj_set_style_text_color(btn_go, lv_color_white(), LV_PART_MAIN);
+    lv_obj_t *lblg = lv_label_create(btn_go);
+    lv_label_set_text(lblg, "GO");
+    lv_obj_center(lblg);
+    apply_modal_button_common_style(btn_go);
+    if (LeadscrewProxy::isEnabled() || LeadscrewProxy::isThreadCycleActive()) {
+        lv_obj_add_state(btn_go, LV_STATE_DISABLED);
+    }
+
     lv_obj_t *btn_x = lv_btn_create(row);
     lv_obj_set_size(btn_x, btn_w, 44);
     lv_obj_add_event_cb(btn_x, onCancel, LV_EVENT_CLICKED, nullptr);
@@ -816,6 +851,54 @@ void ModalManager::onNumpadKey(lv_event_t *e) {
 void ModalManager::onSetTool(lv_event_t *e) { (void)e; applyToolOffset(); closeModal(); }
 void ModalManager::onSetGlobal(lv_event_t *e) { (void)e; applyGlobalOffset(); closeModal(); }
 
+// Raw C (what the motion board moves to) for a C shown under the current
+// tool and offset
+static int32_t c_display_to_raw(int32_t display_ticks) {
+    const int tool = ToolManager::getCurrentTool();
+    int off = OffsetManager::getCurrentOffset();
+    if (off < 0 || off >= OFFSET_COUNT) off = 0;
+    const int tool_b = ToolManager::isToolBActive(tool) ? 1 : 0;
+    const int off_b = OffsetManager::isOffsetBActive(off) ? 1 : 0;
+    return CoordinateSystem::wrap01599((int64_t)display_ticks + CoordinateSystem::c_global_ticks[off][off_b] +
+                                       CoordinateSystem::c_tool_ticks[tool][tool_b]);
+}
+
+void ModalManager::onCGo(lv_event_t *e) {
+    (void)e;
+    if (!ta_value) return;
+    const char *txt = lv_textarea_get_text(ta_value);
+    int32_t target_deg_x100 = 0;
+    if (!parse_deg_expression_to_degx100(txt, &target_deg_x100))
+        CoordinateSystem::parseDegToDegX100(txt, &target_deg_x100);
+    LeadscrewProxy::requestCMove(c_display_to_raw(CoordinateSystem::degX100ToTicks(target_deg_x100)));
+    closeModal();
+}
+
+void ModalManager::onCDiv(lv_event_t *e) {
+    (void)e;
+    if (!ta_value) return;
+    const char *txt = lv_textarea_get_text(ta_value);
+    int32_t n_x100 = 0;
+    if (!parse_deg_expression_to_degx100(txt, &n_x100))
+        CoordinateSystem::parseDegToDegX100(txt, &n_x100);
+    const int32_t n = (n_x100 + 50) / 100;
+    if (n < 2 || n > C_COUNTS_PER_REV) return;  // Not a division count: stay open
+
+    // Divisions start at C = 0; the next is the first past where C is now
+    // (after the last one, C = 0 again)
+    const int32_t cur = CoordinateSystem::getDisplayC(EncoderProxy::getRawTicks(), ToolManager::getCurrentTool());
+    int32_t next = 0;
+    for (int32_t k = 1; k < n; k++) {
+        const int32_t t = (int32_t)(((int64_t)k * C_COUNTS_PER_REV * 2 + n) / (2 * n));
+        if (t > cur) {
+            next = t;
+            break;
+        }
+    }
+    LeadscrewProxy::requestCMove(c_display_to_raw(next));
+    closeModal();
+}
+
 void ModalManager::applyPitch() {
     if (!ta_value) return;
     double v_expr = 0.0;
@@ -852,6 +935,14 @@ void ModalManager::applyEndstop() {
 
 void ModalManager::onEndstopOk(lv_event_t *e) { (void)e; applyEndstop(); closeModal(); }
 
+void ModalManager::onEndstopGo(lv_event_t *e) {
+    (void)e;
+    applyEndstop();
+    LeadscrewProxy::requestZMove(endstop_is_max ? EndstopProxy::getMaxMachineUm()
+                                                : EndstopProxy::getMinMachineUm());
+    closeModal();
+}
+
 void ModalManager::onEndstopClear(lv_event_t *e) {
     (void)e;
     if (endstop_is_max) EndstopProxy::clearMax();
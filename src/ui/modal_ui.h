@@ -15,9 +15,12 @@ public:
     static void onCancel(lv_event_t *e);
     static void onSetTool(lv_event_t *e);
     static void onSetGlobal(lv_event_t *e);
+    static void onCGo(lv_event_t *e);
+    static void onCDiv(lv_event_t *e);
     static void onPitchOk(lv_event_t *e);
     static void onEndstopOk(lv_event_t *e);
     static void onEndstopClear(lv_event_t *e);
+    static void onEndstopGo(lv_event_t *e);
     static void onSyncOk(lv_event_t *e);
     static void onNumpadKey(lv_event_t *e);
     static void onNumpadClear(lv_event_t *e);
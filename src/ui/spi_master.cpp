@@ -5,6 +5,7 @@
 
 // Static member initialization
 StatusPacket SpiMaster::last_status = {};
+TelemetryPacket SpiMaster::telemetry[(size_t)EncoderIdProto::COUNT] = {};
 bool SpiMaster::connected = false;
 uint32_t SpiMaster::last_success_ms = 0;
 uint8_t SpiMaster::sequence = 0;
@@ -24,6 +25,11 @@ bool SpiMaster::jog_active = false;
 int8_t SpiMaster::jog_dir = 0;
 bool SpiMaster::ota_request = false;
 bool SpiMaster::reboot_request = false;
+bool SpiMaster::thread_cycle = false;
+uint8_t SpiMaster::thread_passes = 0;
+MotionCommand SpiMaster::move_cmd = MotionCommand::NOP;
+uint8_t SpiMaster::move_seq = 0;
+int32_t SpiMaster::move_target = 0;
 
 // Use HSPI for communication with motion board
 static SPIClass hspi(HSPI);
@@ -77,6 +83,15 @@ bool SpiMaster::transact(const CommandPacket& cmd, StatusPacket& status) {
         return false;
     }
     
+    if (status.version == (PROTOCOL_VERSION | PROTOCOL_TELEMETRY)) {
+        // Telemetry instead of status this time: keep the last status
+        TelemetryPacket t;
+        memcpy(&t, &status, sizeof(t));
+        storeTelemetry(t);
+        status = last_status;
+        return true;
+    }
+
     if (status.version != PROTOCOL_VERSION) {
         static uint32_t last_ver_err = 0;
         if (millis() - last_ver_err > 1000) {
@@ -93,11 +108,33 @@ bool SpiMaster::transact(const CommandPacket& cmd, StatusPacket& status) {
     return true;
 }
 
+void SpiMaster::storeTelemetry(const TelemetryPacket& t) {
+    const size_t i = (size_t)t.encoder;
+    if (i >= (size_t)EncoderIdProto::COUNT) return;
+#if DEBUG_SPI_LOGGING
+    static const char *const names[] = {"X", "Z", "C", "MPG"};
+    // PCNT decoding can't see illegal transitions: nothing to report
+    if (t.gpio_decoded && t.illegal != telemetry[i].illegal) {
+        Serial.printf("[Motion->UI] %s encoder: %lu illegal transitions (peak %lu edges/s)\n",
+            names[i], (unsigned long)t.illegal, (unsigned long)t.peak_edges_per_s);
+    }
+    if (t.index_slips != telemetry[i].index_slips || t.index_state != telemetry[i].index_state) {
+        Serial.printf("[Motion->UI] %s index: %s, %u slips (last rev %+d counts)\n",
+            names[i], (t.index_state == 2) ? "homed" : "not homed",
+            (unsigned)t.index_slips, (int)t.index_rev_error);
+    }
+#endif
+    telemetry[i] = t;
+}
+
 void SpiMaster::buildCommand(CommandPacket& cmd) {
     memset(&cmd, 0, sizeof(cmd));
     cmd.version = PROTOCOL_VERSION;
-    cmd.cmd = MotionCommand::NOP;
-    cmd.flags = els_enabled ? 1 : 0;
+    cmd.cmd = move_cmd;
+    cmd.flags = (els_enabled ? CMD_FLAG_ELS_ENABLE : 0) |
+                (thread_cycle ? CMD_FLAG_THREAD_CYCLE : 0) |
+                (ota_request ? CMD_FLAG_OTA : 0) |
+                (reboot_request ? CMD_FLAG_REBOOT : 0);
     cmd.direction_mul = direction_mul;
     cmd.pitch_um = pitch_um;
     cmd.endstop_min_um = endstop_min_um;
@@ -110,8 +147,15 @@ void SpiMaster::buildCommand(CommandPacket& cmd) {
 	cmd.sync_enabled = sync_enabled ? 1 : 0;
 	cmd.jog_dir = jog_active ? jog_dir : 0;
 	cmd.jog_active = jog_active ? 1 : 0;
-	cmd.ota_request = ota_request ? 1 : 0;
-	cmd.reboot_request = reboot_request ? 1 : 0;
+	cmd.thread_passes = thread_passes;
+	cmd.move_seq = move_seq;
+	cmd.move_target = move_target;
+	if (move_cmd == MotionCommand::MOVE_C_TO) {
+		cmd.move_speed = C_MOVE_RPM;
+	} else {
+		cmd.move_speed = Z_MOVE_MM_PER_MIN;
+		cmd.move_accel = Z_MOVE_ACCEL_MM_S2;
+	}
 	cmd.sequence = sequence++;
 }
 
@@ -128,6 +172,9 @@ bool SpiMaster::poll() {
         static bool prev_els_enabled = false;
         static bool prev_els_fault = false;
         static bool prev_endstop_hit = false;
+        static bool prev_step_overload = false;
+        static bool prev_wcet_over = false;
+        static SyncStateProto prev_sync_state = SyncStateProto::SYNC_DISABLED;
         
         if (status.flags.els_enabled != prev_els_enabled) {
             Serial.printf("[Motion->UI] ELS is %s\n", 
@@ -143,6 +190,22 @@ bool SpiMaster::poll() {
             Serial.println("[Motion->UI] ENDSTOP HIT!");
         }
         prev_endstop_hit = status.flags.endstop_hit;
+
+        if (status.flags2.step_overload && !prev_step_overload) {
+            Serial.println("[Motion->UI] Z step queue overload");
+        }
+        prev_step_overload = status.flags2.step_overload;
+
+        if (status.flags2.wcet_over && !prev_wcet_over) {
+            Serial.println("[Motion->UI] ELS cycle over its time budget");
+        }
+        prev_wcet_over = status.flags2.wcet_over;
+
+        if (status.sync_state == SyncStateProto::SYNC_IN_SYNC &&
+            prev_sync_state != SyncStateProto::SYNC_IN_SYNC) {
+            Serial.printf("[Motion->UI] Sync locked in %u ms\n", (unsigned)status.sync_engage_ms);
+        }
+        prev_sync_state = status.sync_state;
 #endif
         last_status = status;
         last_success_ms = millis();
@@ -267,3 +330,29 @@ void SpiMaster::setRebootRequest(bool active)
 #endif
 	reboot_request = active;
 }
+
+void SpiMaster::setThreadCycle(bool run, uint8_t passes)
+{
+#if DEBUG_SPI_LOGGING
+	if (run != thread_cycle)
+	{
+		Serial.printf("[UI->Motion] Thread cycle: %s (%u passes)\n", run ? "RUN" : "STOP", (unsigned)passes);
+	}
+#endif
+	thread_cycle = run;
+	thread_passes = passes;
+}
+
+void SpiMaster::setMove(MotionCommand move, uint8_t seq, int32_t target)
+{
+#if DEBUG_SPI_LOGGING
+	if (move != MotionCommand::NOP && (move != move_cmd || seq != move_seq))
+	{
+		Serial.printf("[UI->Motion] %c move to %ld (seq %u)\n",
+			(move == MotionCommand::MOVE_C_TO) ? 'C' : 'Z', (long)target, (unsigned)seq);
+	}
+#endif
+	move_cmd = move;
+	move_seq = seq;
+	move_target = target;
+}
@@ -20,6 +20,9 @@ public:
     
     // Get latest received status (updated by poll())
     static const StatusPacket& getStatus() { return last_status; }
+
+    // Latest encoder integrity telemetry from the motion board
+    static const TelemetryPacket& getTelemetry(EncoderIdProto id) { return telemetry[(size_t)id]; }
     
     // Check communication health
     static bool isConnected() { return connected; }
@@ -39,9 +42,16 @@ public:
 	static void setJog(bool active, int8_t dir);
 	static void setOtaRequest(bool active);
 	static void setRebootRequest(bool active);
+	// Threading cycle on the motion board: run starts it, clearing it stops it
+	static void setThreadCycle(bool run, uint8_t passes);
+	// Move-to (MOVE_Z_TO / MOVE_C_TO, NOP = none): held with the same seq
+	// until its result is back
+	static void setMove(MotionCommand move, uint8_t seq, int32_t target);
 
 private:
     static StatusPacket last_status;
+    static TelemetryPacket telemetry[(size_t)EncoderIdProto::COUNT];
+    static void storeTelemetry(const TelemetryPacket& t);
     static bool connected;
     static uint32_t last_success_ms;
     static uint8_t sequence;
@@ -62,4 +72,9 @@ private:
 	static int8_t jog_dir;
 	static bool ota_request;
 	static bool reboot_request;
+	static bool thread_cycle;
+	static uint8_t thread_passes;
+	static MotionCommand move_cmd;
+	static uint8_t move_seq;
+	static int32_t move_target;
 };
@@ -287,7 +287,8 @@ void UIManager::createUI() {
     lv_obj_set_height(btn_pitch, LV_PCT(100));
     lv_obj_set_flex_grow(btn_pitch, 1);
     lv_obj_clear_flag(btn_pitch, LV_OBJ_FLAG_SCROLLABLE);
-    lv_obj_add_event_cb(btn_pitch, onEditPitch, LV_EVENT_CLICKED, nullptr);
+    lv_obj_add_event_cb(btn_pitch, onEditPitch, LV_EVENT_SHORT_CLICKED, nullptr);
+	lv_obj_add_event_cb(btn_pitch, onLongPressPitch, LV_EVENT_LONG_PRESSED, nullptr);
     lv_obj_set_style_bg_opa(btn_pitch, LV_OPA_TRANSP, LV_PART_MAIN);
     lv_obj_set_style_border_width(btn_pitch, 1, LV_PART_MAIN);
     lv_obj_set_style_border_color(btn_pitch, lv_palette_main(LV_PALETTE_GREY), LV_PART_MAIN);
@@ -656,8 +657,18 @@ void UIManager::update() {
 		// Normal RPM display (not in jog mode)
 		if (spindleMoving)
 		{
-			// Show actual RPM in white when spinning
-			snprintf(buf, sizeof(buf), "%ld", (long)EncoderProxy::getRpmSigned());
+			// Show actual RPM in white when spinning; tenths when slow and steady
+			if (abs(EncoderProxy::getRpmSigned()) < RPM_SHOW_DECIMAL_BELOW && EncoderProxy::isRpmSteady())
+			{
+				const int32_t centi = EncoderProxy::getRpmCenti();
+				const int32_t tenths = (centi + ((centi < 0) ? -5 : 5)) / 10;
+				snprintf(buf, sizeof(buf), "%s%ld.%ld", (tenths < 0) ? "-" : "",
+						 (long)(abs(tenths) / 10), (long)(abs(tenths) % 10));
+			}
+			else
+			{
+				snprintf(buf, sizeof(buf), "%ld", (long)EncoderProxy::getRpmSigned());
+			}
 			lv_label_set_text(lbl_c, buf);
 			lv_obj_set_style_text_color(lbl_c, lv_color_white(), LV_PART_MAIN);
 		}
@@ -699,7 +710,14 @@ void UIManager::update() {
 	if (lbl_units_mode) lv_label_set_text(lbl_units_mode, CoordinateSystem::isLinearInchMode() ? "INCH" : "MM");
 
     if (lbl_pitch) {
-        char pbuf[32]; LeadscrewProxy::formatPitchLabel(pbuf, sizeof(pbuf));
+        char pbuf[32];
+		if (LeadscrewProxy::isThreadCycleActive()) {
+			// Threading cycle running: pass in progress instead of the pitch
+			snprintf(pbuf, sizeof(pbuf), "%lu/%u", (unsigned long)LeadscrewProxy::getThreadPass(),
+					 (unsigned)LeadscrewProxy::getThreadPasses());
+		} else {
+			LeadscrewProxy::formatPitchLabel(pbuf, sizeof(pbuf));
+		}
         lv_label_set_text(lbl_pitch, pbuf);
     }
 
@@ -715,10 +733,19 @@ void UIManager::onToggleUnits(lv_event_t *e) {
 }
 
 void UIManager::onEditPitch(lv_event_t *e) {
-    if (lv_event_get_code(e) != LV_EVENT_CLICKED) return;
+    if (lv_event_get_code(e) != LV_EVENT_SHORT_CLICKED) return;
     ModalManager::showPitchModal();
 }
 
+void UIManager::onLongPressPitch(lv_event_t *e)
+{
+	(void)e;
+	// Start/stop the threading cycle; it runs the ELS itself
+	forceElsOff();
+	LeadscrewProxy::toggleThreadCycle();
+	Serial.printf("[UI] Thread cycle -> %s\n", LeadscrewProxy::isThreadCycleRequested() ? "RUN" : "STOP");
+}
+
 void UIManager::onEditSync(lv_event_t *e)
 {
 	if (lv_event_get_code(e) != LV_EVENT_SHORT_CLICKED)
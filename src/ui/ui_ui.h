@@ -17,6 +17,7 @@ public:
     static void onToggleCMode(lv_event_t *e);
     static void onToggleUnits(lv_event_t *e);
     static void onEditPitch(lv_event_t *e);
+    static void onLongPressPitch(lv_event_t *e);
     static void onTogglePitchMode(lv_event_t *e);
     static void onEditSync(lv_event_t *e);
     static void onLongPressSync(lv_event_t *e);
@@ -0,0 +1,27 @@
+#pragma once
+
+// Host build: the few parts of the Arduino core the motion units use
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <math.h>
+#include "esp_attr.h"
+#include "freertos/FreeRTOS.h"
+
+// The suite that needs the clock defines these
+uint32_t micros();
+uint32_t millis();
+uint32_t getCpuFrequencyMhz();
+
+// Serial output goes to stdout
+struct HostSerial {
+    int printf(const char *fmt, ...) __attribute__((format(printf, 2, 3))) {
+        va_list args;
+        va_start(args, fmt);
+        const int n = vprintf(fmt, args);
+        va_end(args);
+        return n;
+    }
+};
+inline HostSerial Serial;
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stdint.h>
+
+// Host build: only the types the encoder headers name
+typedef struct pcnt_unit_t *pcnt_unit_handle_t;
+typedef struct {
+    int watch_point_value;
+    int zero_cross_mode;
+} pcnt_watch_event_data_t;
+typedef bool (*pcnt_watch_cb_t)(pcnt_unit_handle_t unit, const pcnt_watch_event_data_t *edata, void *user_ctx);
@@ -0,0 +1,5 @@
+#pragma once
+
+// Host build: no IRAM/DRAM placement
+#define IRAM_ATTR
+#define DRAM_ATTR
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+// Host build: the suite that needs a cycle count defines it
+uint32_t esp_cpu_get_cycle_count();
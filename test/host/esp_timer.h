@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+// Host build: the suite that needs the clock defines it
+int64_t esp_timer_get_time();
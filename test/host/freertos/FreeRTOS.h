@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+
+// Host build: single threaded, so critical sections are no-ops
+typedef struct { int unused; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+
+inline void portENTER_CRITICAL(portMUX_TYPE *) {}
+inline void portEXIT_CRITICAL(portMUX_TYPE *) {}
+inline void portENTER_CRITICAL_ISR(portMUX_TYPE *) {}
+inline void portEXIT_CRITICAL_ISR(portMUX_TYPE *) {}
+inline void portENTER_CRITICAL_SAFE(portMUX_TYPE *) {}
+inline void portEXIT_CRITICAL_SAFE(portMUX_TYPE *) {}
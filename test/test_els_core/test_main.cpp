@@ -0,0 +1,613 @@
+#include <unity.h>
+#include <math.h>
+#include "els_core.h"
+#include "config_motion.h"
+#include "encoder_motion.h"
+#include "spindle_stepper.h"
+#include "stepper.h"
+#include "spindle_synth.h"
+#include "esp_cpu.h"
+#include "esp_timer.h"
+
+// ============================================================================
+// ElsCore in the machine around it, at the motion task's 1 kHz tick: a
+// stepper spindle at a set speed feeding the tracker, a Z stepper that takes
+// every step it is given, and a Z scale that reads where those steps put it.
+// Speeds are checked from the steps each WINDOW_TICKS window takes, which
+// the envelope's acceleration limit bounds to within the window's step
+// quantization. The thread-end tests run the spindle from the pulse
+// synthesizer itself instead.
+// ============================================================================
+
+static constexpr uint32_t TICK_US = 1000;
+static constexpr int WINDOW_TICKS = 10;
+
+// ============================================================================
+// The machine (fakes of the hardware units ElsCore talks to)
+// ============================================================================
+static uint64_t now_us = 1000000;    // Never goes back, across tests too
+static double spindle_counts = 0.0;  // True spindle position
+static double spindle_cps = 0.0;
+static int32_t tick_steps = 0;       // Z steps the last update() gave
+
+volatile int32_t Stepper::position = 0;
+volatile int32_t Stepper::commanded = 0;
+
+int32_t Stepper::step(int32_t count, uint32_t) {
+    position += count;
+    commanded += count;
+    tick_steps += count;
+    return count;
+}
+
+uint32_t Stepper::spanUs(uint32_t dt_us) { return dt_us; }
+bool Stepper::isIdle() { return true; }
+
+int32_t EncoderMotion::getZCount() {
+    const int64_t um = (int64_t)Stepper::getPosition() * ELS_LEADSCREW_PITCH_UM / ELS_STEPS_PER_REV;
+    return (int32_t)((um >= 0) ? um / Z_UM_PER_COUNT : -((-um + Z_UM_PER_COUNT - 1) / Z_UM_PER_COUNT));
+}
+
+// The stepper spindle as SpindleStepper runs it, for the thread-end tests
+// (synth_on): SpindleSynth's steps on the pulse timeline, a channel's worth
+// generated ahead of the pulses out, as the RMT encoder does
+static SpindleSynth synth(SPINDLE_ACCEL_RPM_PER_SEC, SPINDLE_JERK_RPM_PER_SEC2);
+static bool synth_on = false;
+static int32_t synth_target_q8 = 0;       // Signed; a stop sets it to 0
+static bool synth_busy = false;           // tx_busy
+static bool synth_forward = true;
+static bool synth_gen_done = false;       // End slot generated
+static uint32_t synth_ring[SPINDLE_RMT_MEM_SYMBOLS];
+static uint32_t synth_first = 0;
+static uint32_t synth_ahead = 0;          // Generated, not out
+static int64_t synth_out = 0;             // Pulses out: the spindle count
+static uint64_t synth_next_tick = 0;      // RMT tick of the next pulse
+static int64_t stop_at_pos = INT64_MIN;   // Last stopAt() taken
+
+SpindleTracker SpindleStepper::tracker;
+
+static int64_t synthGenerated() {
+    return synth_out + (synth_forward ? (int64_t)synth_ahead : -(int64_t)synth_ahead);
+}
+
+int32_t SpindleStepper::brakeSteps() {
+    if (!synth_on || !synth_busy) return 0;
+    return (int32_t)synth_ahead + (int32_t)synth.rampDownSteps();
+}
+
+bool SpindleStepper::stopAt(int64_t stop_pos) {
+    if (!synth_on || !synth_busy) return false;
+    const int64_t gen = synthGenerated();
+    if (!synth.stopAt(synth_forward ? stop_pos - gen : gen - stop_pos)) return false;
+    stop_at_pos = stop_pos;
+    return true;
+}
+
+bool SpindleStepper::isStopping() {
+    return synth_on && (synth.stopArmed() || (synth_busy && synth.stoppedOnStep()));
+}
+
+int64_t esp_timer_get_time() { return (int64_t)now_us; }
+uint32_t micros() { return (uint32_t)now_us; }
+uint32_t millis() { return (uint32_t)(now_us / 1000); }
+uint32_t getCpuFrequencyMhz() { return 240; }
+
+// CCOUNT on the host: basic blocks run. [env:native_els] builds with
+// -fsanitize-coverage=trace-pc, which calls this on entry to every block,
+// so the handler times ElsCore keeps are a count of the blocks (branches
+// taken and loop iterations) the handler went through, its callees and
+// the fakes here included.
+static uint32_t blocks = 0;
+#if defined(__clang__)
+#define NO_COVERAGE __attribute__((no_sanitize("coverage")))
+#else
+#define NO_COVERAGE __attribute__((no_sanitize_coverage))
+#endif
+extern "C" NO_COVERAGE void __sanitizer_cov_trace_pc(void) { blocks++; }
+uint32_t esp_cpu_get_cycle_count() { return blocks; }
+
+static uint32_t rng = 1;
+static uint32_t nextRand(uint32_t lo, uint32_t hi) {
+    rng = rng * 1664525u + 1013904223u;
+    return lo + (rng >> 8) % (hi - lo + 1);
+}
+
+static void synthFill() {
+    while (!synth_gen_done && synth_ahead < SPINDLE_RMT_MEM_SYMBOLS) {
+        const bool armed = synth.stopArmed();
+        const uint32_t period = synth.next(synth_target_q8, synth_forward);
+        if (period == 0) {
+            synth_gen_done = true;
+            if (armed) synth_target_q8 = 0;  // Held at rest
+            return;
+        }
+        synth_ring[(synth_first + synth_ahead) % SPINDLE_RMT_MEM_SYMBOLS] = period;
+        synth_ahead++;
+    }
+}
+
+// Pulses out up to now_us; a stream starts from rest on a target
+static void synthRun() {
+    const uint64_t now_tick = now_us * SpindleRamp::RES_HZ / 1000000;
+    if (!synth_busy && synth_target_q8 != 0) {
+        synth_forward = synth_target_q8 > 0;
+        synth.start(0);
+        synth_gen_done = false;
+        synth_first = 0;
+        synth_ahead = 0;
+        synth_busy = true;
+        synth_next_tick = now_tick;
+        synthFill();
+    }
+    while (synth_busy && synth_next_tick <= now_tick) {
+        if (synth_ahead == 0) {
+            synth_busy = false;  // End slot reached
+            break;
+        }
+        synth_next_tick += synth_ring[synth_first];
+        synth_first = (synth_first + 1) % SPINDLE_RMT_MEM_SYMBOLS;
+        synth_ahead--;
+        synth_out += synth_forward ? 1 : -1;
+        synthFill();
+    }
+    spindle_counts = (double)synth_out;
+    const double cps = synth_busy ? synth.speed() / 256.0 : 0.0;
+    spindle_cps = synth_forward ? cps : -cps;
+}
+
+static void tick() {
+    if (synth_on) synthRun();
+    else spindle_counts += spindle_cps * TICK_US * 1e-6;
+    SpindleStepper::getTracker().update((int32_t)(int64_t)floor(spindle_counts), (uint32_t)now_us);
+    tick_steps = 0;
+    ElsCore::update();
+    now_us += TICK_US;
+}
+
+static void runTicks(int n) {
+    for (int i = 0; i < n; i++) tick();
+}
+
+static double cpsFor(double rpm) {
+    return rpm * C_COUNTS_PER_REV / 60.0;
+}
+
+// Z steps per spindle count at a pitch
+static double stepsPerCount(int32_t pitch_um) {
+    return (double)pitch_um * ELS_STEPS_PER_REV / ((double)C_COUNTS_PER_REV * ELS_LEADSCREW_PITCH_UM);
+}
+
+// Off and stopped, 1 mm pitch, nothing else requested; the spindle at rest
+// and the tracker on it
+static void resetMachine() {
+    ElsCore::setEnabled(false);
+    ElsCore::setJog(0, false);
+    synth_target_q8 = 0;
+    for (int i = 0; i < 20000 && synth_busy; i++) tick();
+    synth_on = false;
+    spindle_cps = 0.0;
+    for (int i = 0; i < 5000 && !ElsCore::isStopped(); i++) tick();
+    // init() drops requests not yet applied, so these come after it
+    ElsCore::init();
+    ElsCore::clearFault();
+    ElsCore::setSync(false, 0, 0);
+    ElsCore::setEndstops(0, 0, false, false);
+    ElsCore::setPitchUm(1000);
+    ElsCore::setDirectionMul(1);
+    runTicks(200);
+}
+
+void setUp(void) {
+    rng = 1;
+    resetMachine();
+}
+
+void tearDown(void) {}
+
+// Speed as the steps each window takes: consecutive windows may differ by
+// no more than the acceleration limit (ELS_ENGAGE_ACCEL unless set) allows,
+// plus a step either way for the windows' rounding
+struct EnvelopeCheck {
+    double accel = ELS_ENGAGE_ACCEL;
+    int32_t last = 0;
+    int32_t sum = 0;
+    int ticks = 0;
+    bool first = true;
+
+    void tick(int32_t steps) {
+        sum += steps;
+        if (++ticks < WINDOW_TICKS) return;
+        const double window_s = WINDOW_TICKS * TICK_US * 1e-6;
+        const double bound = accel * window_s * window_s + 2.0;
+        if (!first) TEST_ASSERT_TRUE(fabs((double)(sum - last)) <= bound);
+        first = false;
+        last = sum;
+        sum = 0;
+        ticks = 0;
+    }
+};
+
+static void runChecked(EnvelopeCheck &check, int n) {
+    for (int i = 0; i < n; i++) {
+        tick();
+        check.tick(tick_steps);
+    }
+}
+
+// Enabled onto a running spindle at several speeds, pitches and directions:
+// Z ramps up within the acceleration limit, never gets ahead of the gear,
+// locks, and from then on sits exactly where the gear puts it for the
+// spindle travel since the enable (the steps the ramp held back all made
+// up). Disabled, it ramps down within the limit and stops.
+static void test_envelope_engage(void) {
+    struct Case { double rpm; int32_t pitch_um; };
+    const Case cases[] = { { 20, 100 }, { 300, 1000 }, { 1000, 1500 }, { 3000, 1000 }, { -1000, 1000 }, { 600, -2000 } };
+    for (const Case &c : cases) {
+        resetMachine();
+        ElsCore::setPitchUm(c.pitch_um);
+        spindle_cps = cpsFor(c.rpm);
+        runTicks(500);  // Tracker settled at speed
+
+        // The enable is applied on the next tick, from the spindle then
+        EnvelopeCheck check;
+        ElsCore::setEnabled(true);
+        runChecked(check, 1);
+        TEST_ASSERT_TRUE(ElsCore::isEnabled());
+        const double counts0 = spindle_counts;
+        const int32_t z0 = Stepper::getPosition();
+
+        const double v = fabs(spindle_cps * stepsPerCount(c.pitch_um));
+        // Up to speed, then the deficit that left made up with what room
+        // ELS_STEPPER_MAX_SPS leaves above the gear
+        const double deficit = v * v / (2.0 * ELS_ENGAGE_ACCEL);
+        const double room = ((double)ELS_STEPPER_MAX_SPS - v < v) ? (double)ELS_STEPPER_MAX_SPS - v : v;
+        const int ramp_ticks = (int)((3.0 * v / ELS_ENGAGE_ACCEL + deficit / room) * 1000.0) + 100;
+        const double sgn = (c.rpm * c.pitch_um < 0) ? -1.0 : 1.0;
+        for (int i = 0; i < ramp_ticks; i++) {
+            runChecked(check, 1);
+            const double want = (spindle_counts - counts0) * stepsPerCount(c.pitch_um);
+            const double ahead = ((double)(Stepper::getPosition() - z0) - want) * sgn;
+            TEST_ASSERT_TRUE(ahead <= 2.0);
+        }
+        for (int i = 0; i < 500; i++) {
+            runChecked(check, 1);
+            const double want = (spindle_counts - counts0) * stepsPerCount(c.pitch_um);
+            TEST_ASSERT_TRUE(fabs((double)(Stepper::getPosition() - z0) - want) <= 2.0);
+        }
+
+        ElsCore::setEnabled(false);
+        const int stop_ticks = (int)(v / ELS_ENGAGE_ACCEL * 1000.0) + 2;
+        int ticks = 0;
+        while (!ElsCore::isStopped() && ticks < 10000) {
+            runChecked(check, 1);
+            ticks++;
+        }
+        TEST_ASSERT_TRUE(ElsCore::isStopped());
+        TEST_ASSERT_TRUE(ticks <= stop_ticks);
+        TEST_ASSERT_TRUE(ticks >= stop_ticks * 9 / 10 - 2);
+        runChecked(check, 50);
+        TEST_ASSERT_EQUAL_INT32(0, tick_steps);
+    }
+}
+
+// Re-enabled part way down a ramp-down: Z carries on from the speed it
+// still has rather than dropping to zero, through zero if the spindle was
+// reversed in between, and locks as before
+static void test_envelope_reengage(void) {
+    for (int i = 0; i < 8; i++) {
+        resetMachine();
+        const int32_t pitch_um = (int32_t)nextRand(100, 2500) * ((i & 1) ? -1 : 1);
+        // Up to 2000 RPM, or 90 % of ELS_STEPPER_MAX_SPS at the pitch
+        const double top = 0.9 * ELS_STEPPER_MAX_SPS / stepsPerCount(abs(pitch_um)) * 60.0 / C_COUNTS_PER_REV;
+        const double rpm = nextRand(50, (top < 2000.0) ? (uint32_t)top : 2000);
+        ElsCore::setPitchUm(pitch_um);
+        spindle_cps = cpsFor(rpm);
+        runTicks(500);
+        EnvelopeCheck check;
+        ElsCore::setEnabled(true);
+        runChecked(check, 3000);
+
+        ElsCore::setEnabled(false);
+        runChecked(check, nextRand(1, 300));
+        const bool reversed = (i % 4 >= 2);
+        if (reversed) spindle_cps = -spindle_cps;
+        ElsCore::setEnabled(true);
+        // Locked within the engage test's bound, a reversal taking 2 v / a
+        // more and leaving the deficit of a ramp through zero to -v
+        const double v = fabs(spindle_cps * stepsPerCount(pitch_um));
+        const double deficit = (reversed ? 4.0 : 1.0) * v * v / (2.0 * ELS_ENGAGE_ACCEL);
+        const double room = ((double)ELS_STEPPER_MAX_SPS - v < v) ? (double)ELS_STEPPER_MAX_SPS - v : v;
+        runChecked(check, (int)(((reversed ? 5.0 : 3.0) * v / ELS_ENGAGE_ACCEL + deficit / room) * 1000.0) + 100);
+        // Locked: the gear alone, with nothing left owed from the ramp
+        const double counts0 = spindle_counts;
+        const int32_t z0 = Stepper::getPosition();
+        for (int j = 0; j < 200; j++) {
+            runChecked(check, 1);
+            const double want = (spindle_counts - counts0) * stepsPerCount(pitch_um);
+            TEST_ASSERT_TRUE(fabs((double)(Stepper::getPosition() - z0) - want) <= 2.0);
+        }
+    }
+}
+
+// Z off the helix through z0_um at spindle count c0, in (-pitch/2, pitch/2]
+// um. The fake Z takes its steps at once, so it is compared with the
+// spindle ELS_LEAD_US on, where the real output stage puts them.
+static double helixErrorUm(int32_t pitch_um, int32_t z0_um, int32_t c0) {
+    const double z_um = (double)Stepper::getPosition() * ELS_LEADSCREW_PITCH_UM / ELS_STEPS_PER_REV;
+    const double spindle = spindle_counts + spindle_cps * ELS_LEAD_US * 1e-6;
+    const double want = z0_um + (spindle - c0) * pitch_um / C_COUNTS_PER_REV;
+    const double p = fabs((double)pitch_um);
+    double e = fmod(z_um - want, p);
+    if (e > p / 2) e -= p;
+    else if (e <= -p / 2) e += p;
+    return e;
+}
+
+// Spindle count within the turn, as the sync phase is given
+static int32_t spindlePhase() {
+    const int64_t c = (int64_t)floor(spindle_counts) % C_COUNTS_PER_REV;
+    return (int32_t)((c < 0) ? c + C_COUNTS_PER_REV : c);
+}
+
+// Catch-up moves of various lengths with the spindle at rest, so Z moves by
+// the catch-up alone: within ELS_SYNC_CATCHUP_ACCEL, onto the helix, and
+// with the last step out about when the ideal trapezoid comes to rest
+static void test_catchup_profile(void) {
+    const int32_t lengths[] = { 1, 5, 50, -50, 200, 400, -400, 550 };  // Counts
+    for (int32_t n : lengths) {
+        resetMachine();
+        ElsCore::setPitchUm(2 * ELS_LEADSCREW_PITCH_UM);  // Two steps per count
+        ElsCore::setEnabled(true);
+        runTicks(100);
+        const int32_t z0_um = EncoderMotion::getZCount() * Z_UM_PER_COUNT;
+        const int32_t c0 = (spindlePhase() + n + C_COUNTS_PER_REV) % C_COUNTS_PER_REV;
+        const int32_t z0 = Stepper::getPosition();
+        ElsCore::setSync(true, z0_um, c0);
+
+        EnvelopeCheck check;
+        check.accel = ELS_SYNC_CATCHUP_ACCEL;
+        int ticks = 0;
+        int first = -1;
+        int last = -1;
+        while (!ElsCore::isSyncIn() && ticks < 5000) {
+            runChecked(check, 1);
+            if (first < 0 && ElsCore::isSyncCatchingUp()) first = ticks;
+            if (tick_steps != 0) last = ticks;
+            ticks++;
+        }
+        TEST_ASSERT_TRUE(ElsCore::isSyncIn());
+        TEST_ASSERT_TRUE(fabs(helixErrorUm(2 * ELS_LEADSCREW_PITCH_UM, z0_um, c0)) <= 2.0 * Z_UM_PER_COUNT);
+
+        const double a = ELS_SYNC_CATCHUP_ACCEL;
+        const double vmax = ELS_SYNC_CATCHUP_MAX_SPS;
+        const double d = fabs((double)(Stepper::getPosition() - z0));
+        const double ideal_s = (d <= vmax * vmax / a) ? 2.0 * sqrt(d / a) : d / vmax + vmax / a;
+        const double want_ms = ideal_s * 1000.0;
+        TEST_ASSERT_TRUE(fabs(last - first - want_ms) <= 2.0);
+        runChecked(check, 50);
+        TEST_ASSERT_TRUE(ElsCore::isSyncIn());
+    }
+}
+
+// Sync set and Z enabled onto a running spindle at random speeds, pitches
+// and phases: Z ramps up and catches up within the two limits together, is
+// on the helix once in sync, and stays there (and in sync) from then on
+static void test_catchup_running(void) {
+    for (int i = 0; i < 16; i++) {
+        resetMachine();
+        // The first at the fastest Z of the ranges drawn from
+        const int32_t pitch_um = (i == 0) ? 2500 : (int32_t)nextRand(250, 2500);
+        const double top = 0.9 * ELS_STEPPER_MAX_SPS / stepsPerCount(pitch_um) * 60.0 / C_COUNTS_PER_REV;
+        const uint32_t top_rpm = (top < 2000.0) ? (uint32_t)top : 2000;
+        const double rpm = (i == 0) ? top_rpm : nextRand(20, top_rpm);
+        ElsCore::setPitchUm(pitch_um);
+        spindle_cps = cpsFor(rpm);
+        runTicks(500);
+        const int32_t z0_um = (int32_t)nextRand(0, 100000) - 50000;
+        const int32_t c0 = (int32_t)nextRand(0, C_COUNTS_PER_REV - 1);
+        ElsCore::setSync(true, z0_um, c0);
+        ElsCore::setEnabled(true);
+
+        // The engage test's bound, and the longest catch-up on top
+        const double v = spindle_cps * stepsPerCount(pitch_um);
+        const double deficit = v * v / (2.0 * ELS_ENGAGE_ACCEL);
+        const double room = ((double)ELS_STEPPER_MAX_SPS - v < v) ? (double)ELS_STEPPER_MAX_SPS - v : v;
+        const double catchup = (double)ELS_SYNC_CATCHUP_MAX_UM * ELS_STEPS_PER_REV / ELS_LEADSCREW_PITCH_UM;
+        const double catchup_s = catchup / ELS_SYNC_CATCHUP_MAX_SPS + (double)ELS_SYNC_CATCHUP_MAX_SPS / ELS_SYNC_CATCHUP_ACCEL;
+        const int max_ticks = (int)((3.0 * v / ELS_ENGAGE_ACCEL + deficit / room + catchup_s) * 1000.0) + 100;
+
+        EnvelopeCheck check;
+        check.accel = ELS_ENGAGE_ACCEL + ELS_SYNC_CATCHUP_ACCEL;
+        int ticks = 0;
+        while (!ElsCore::isSyncIn() && ticks < max_ticks) {
+            runChecked(check, 1);
+            ticks++;
+        }
+        TEST_ASSERT_TRUE(ElsCore::isSyncIn());
+        for (int j = 0; j < 1000; j++) {
+            TEST_ASSERT_TRUE(fabs(helixErrorUm(pitch_um, z0_um, c0)) <= 2.0 * Z_UM_PER_COUNT);
+            runChecked(check, 1);
+            TEST_ASSERT_TRUE(ElsCore::isSyncIn());
+        }
+    }
+}
+
+// Z off where the gear puts it for the spindle travel since counts0 (with
+// Z at z0 steps), in steps, the spindle taken ELS_LEAD_US on
+static double gearErrorSteps(int32_t pitch_um, double counts0, int32_t z0) {
+    const double spindle = spindle_counts + spindle_cps * ELS_LEAD_US * 1e-6;
+    return (double)(Stepper::getPosition() - z0) - (spindle - counts0) * stepsPerCount(pitch_um);
+}
+
+// Thread end on the stepper spindle: threading in sync towards an endstop,
+// the spindle ramps down on the synthesizer's own profile onto the step
+// ElsCore asks for, and Z, on the gear all the way, lands just short of
+// the limit: the endstop reported, no fault. Then as the UI does it: ELS
+// off, the spindle reversed, ELS on. Z re-engages from the kept thread
+// model and runs back out on the same helix, at the same ratio.
+static void test_thread_end_stop(void) {
+    struct Case { int32_t rpm; int32_t pitch_um; };
+    const Case cases[] = { { 300, 1000 }, { 600, -1500 }, { -450, 2000 }, { 1000, 750 }, { -120, -500 } };
+    for (const Case &c : cases) {
+        resetMachine();
+        synth_on = true;
+        stop_at_pos = INT64_MIN;
+        ElsCore::setPitchUm(c.pitch_um);
+        const int32_t q8 = (int32_t)(((int64_t)(c.rpm < 0 ? -c.rpm : c.rpm) * SPINDLE_STEPS_PER_REV << 8) / 60);
+        synth_target_q8 = (c.rpm < 0) ? -q8 : q8;
+        runTicks(abs(c.rpm) * 1000 / SPINDLE_ACCEL_RPM_PER_SEC + 500);
+
+        const int32_t z0_um = (int32_t)nextRand(0, 20000) - 10000;
+        const int32_t c0 = (int32_t)nextRand(0, C_COUNTS_PER_REV - 1);
+        ElsCore::setSync(true, z0_um, c0);
+        ElsCore::setEnabled(true);
+        for (int i = 0; i < 20000 && !ElsCore::isSyncIn(); i++) tick();
+        TEST_ASSERT_TRUE(ElsCore::isSyncIn());
+        runTicks(200);
+        const double counts0 = spindle_counts + spindle_cps * ELS_LEAD_US * 1e-6;
+        const int32_t z0 = Stepper::getPosition();
+
+        // The limit a spindle ramp down and a few mm on, the way Z runs
+        const double v = fabs(spindle_cps);
+        const double a = (double)SPINDLE_ACCEL_RPM_PER_SEC * SPINDLE_STEPS_PER_REV / 60.0;
+        const double brake_um = v * v / (2.0 * a) * fabs((double)c.pitch_um) / C_COUNTS_PER_REV;
+        const int32_t z_dir = ((c.rpm < 0) != (c.pitch_um < 0)) ? -1 : 1;
+        const int32_t z_um = EncoderMotion::getZCount() * Z_UM_PER_COUNT;
+        const int32_t limit_um = z_um + z_dir * (int32_t)(brake_um + nextRand(2000, 6000));
+        if (z_dir > 0) ElsCore::setEndstops(0, limit_um, false, true);
+        else ElsCore::setEndstops(limit_um, 0, true, false);
+
+        int ticks = 0;
+        while ((synth_busy || stop_at_pos == INT64_MIN) && ticks < 60000) {
+            tick();
+            ticks++;
+            TEST_ASSERT_FALSE(ElsCore::hasFault());
+            TEST_ASSERT_TRUE(fabs(gearErrorSteps(c.pitch_um, counts0, z0)) <= 2.0);
+        }
+        runTicks(100);
+
+        // The spindle on the step it was stopped on, Z on the gear for it
+        // and on the limit, short of it by no more than a spindle step and
+        // the scale's count
+        TEST_ASSERT_FALSE(synth_busy);
+        TEST_ASSERT_TRUE(stop_at_pos != INT64_MIN);
+        TEST_ASSERT_EQUAL_INT64(stop_at_pos, synth_out);
+        TEST_ASSERT_TRUE(ElsCore::endstopTriggered());
+        TEST_ASSERT_FALSE(ElsCore::hasFault());
+        TEST_ASSERT_TRUE(fabs(gearErrorSteps(c.pitch_um, counts0, z0)) <= 1.0);
+        const double z_end_um = (double)Stepper::getPosition() * ELS_LEADSCREW_PITCH_UM / ELS_STEPS_PER_REV;
+        const double short_um = (limit_um - z_end_um) * z_dir;
+        const double step_um = (double)ELS_LEADSCREW_PITCH_UM / ELS_STEPS_PER_REV;
+        TEST_ASSERT_TRUE(short_um >= -Z_UM_PER_COUNT);
+        TEST_ASSERT_TRUE(short_um <= fabs((double)c.pitch_um) / C_COUNTS_PER_REV + Z_UM_PER_COUNT + 2.0 * step_um);
+
+        // Back out: off, the switch the other way, on
+        ElsCore::setEnabled(false);
+        runTicks(50);
+        synth_target_q8 = (c.rpm < 0) ? q8 : -q8;
+        ElsCore::setEnabled(true);
+        for (int i = 0; i < 20000 && !ElsCore::isSyncIn(); i++) tick();
+        TEST_ASSERT_TRUE(ElsCore::isSyncIn());
+        TEST_ASSERT_FALSE(ElsCore::hasFault());
+        // On the helix while the spindle ramps back up, and on the gear at
+        // speed (the tracker lags while it accelerates)
+        const int ramp_ticks = abs(c.rpm) * 1000 / SPINDLE_ACCEL_RPM_PER_SEC + 200;
+        for (int i = 0; i < ramp_ticks + 500; i++) {
+            tick();
+            TEST_ASSERT_TRUE(fabs(helixErrorUm(c.pitch_um, z0_um, c0)) <= 2.0 * Z_UM_PER_COUNT);
+            if (i >= ramp_ticks) TEST_ASSERT_TRUE(fabs(gearErrorSteps(c.pitch_um, counts0, z0)) <= 2.0);
+        }
+        TEST_ASSERT_TRUE(spindle_counts < stop_at_pos - 100 || spindle_counts > stop_at_pos + 100);
+    }
+}
+
+// Most blocks a handler may run in one cycle. The worst cases below come
+// to about three quarters of these at -O0, where nothing is inlined away
+// (optimised, about half). A change that needs more has added a loop or a
+// path to the motion cycle and should be looked at on target (the WCET
+// report) before a bound is raised.
+static const uint32_t BLOCK_BOUND[ElsCore::ST_COUNT] = {
+    /* IDLE */ 60, /* JOG */ 170, /* WAIT_SYNC */ 230, /* SYNCED */ 210, /* FAULT */ 8,
+};
+
+static void jogTo(int8_t dir, int ticks) {
+    ElsCore::setJog(dir, true);
+    runTicks(ticks);
+}
+
+// Each handler through the inputs that make it work hardest, its most
+// blocks in any one cycle kept under BLOCK_BOUND: jogs at full speed each
+// way, reversed, and landing on the endstops; the ELS engaging at the
+// stepper's top speed and braking back down, catching up the longest way
+// each way, changing pitch and reversing under the gear, and running into
+// an endstop, which latches the fault
+static void test_handler_bounds(void) {
+    const int32_t z_um = EncoderMotion::getZCount() * Z_UM_PER_COUNT;
+    ElsCore::resetWcet();
+
+    // Jogs, from rest and from the other way at speed, onto both endstops
+    ElsCore::setEndstops(z_um - 20000, z_um + 20000, true, true);
+    jogTo(1, 1000);
+    jogTo(-1, 4000);
+    jogTo(1, 6000);
+    ElsCore::setJog(0, false);
+    runTicks(1000);
+    ElsCore::setEndstops(0, 0, false, false);
+
+    // The ELS at the top of the stepper's range, both ways, odd pitches
+    const int32_t pitches[] = { 2500, -1270, 127 };
+    for (int32_t pitch_um : pitches) {
+        resetMachine();
+        const double top = 0.9 * ELS_STEPPER_MAX_SPS / stepsPerCount(abs(pitch_um)) * 60.0 / C_COUNTS_PER_REV;
+        ElsCore::setPitchUm(pitch_um);
+        spindle_cps = cpsFor((top < SPINDLE_MAX_RPM) ? top : SPINDLE_MAX_RPM);
+        runTicks(500);
+        // Sync half a turn off, so the catch-up runs its longest
+        ElsCore::setSync(true, EncoderMotion::getZCount() * Z_UM_PER_COUNT,
+                         (spindlePhase() + C_COUNTS_PER_REV / 2) % C_COUNTS_PER_REV);
+        ElsCore::setEnabled(true);
+        for (int i = 0; i < 20000 && !ElsCore::isSyncIn(); i++) tick();
+        TEST_ASSERT_TRUE(ElsCore::isSyncIn());
+        // Pitch changed and the spindle reversed under the gear
+        ElsCore::setPitchUm(pitch_um * 7 / 9);
+        runTicks(500);
+        spindle_cps = -spindle_cps;
+        runTicks(3000);
+        // A jog takes Z over from the running gear
+        jogTo((pitch_um > 0) ? -1 : 1, 300);
+        ElsCore::setJog(0, false);
+        runTicks(2000);
+        ElsCore::setEnabled(false);
+        runTicks(2000);
+        TEST_ASSERT_TRUE(ElsCore::isStopped());
+    }
+
+    // Into an endstop at speed: handed to the jog profile, then the fault
+    resetMachine();
+    ElsCore::setPitchUm(2500);
+    spindle_cps = cpsFor(1000);
+    runTicks(500);
+    ElsCore::setEndstops(0, EncoderMotion::getZCount() * Z_UM_PER_COUNT + 30000, false, true);
+    ElsCore::setEnabled(true);
+    runTicks(5000);
+    TEST_ASSERT_TRUE(ElsCore::hasFault());
+    TEST_ASSERT_EQUAL_INT(ElsCore::ST_FAULT, ElsCore::getState());
+
+    for (int i = 0; i < ElsCore::ST_COUNT; i++) {
+        const uint32_t n = ElsCore::getWcetCycles((ElsCore::State)i);
+        // Zero: not reached, or the build isn't counting blocks
+        TEST_ASSERT_TRUE(n > 0);
+        TEST_ASSERT_TRUE(n <= BLOCK_BOUND[i]);
+    }
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_envelope_engage);
+    RUN_TEST(test_envelope_reengage);
+    RUN_TEST(test_catchup_profile);
+    RUN_TEST(test_catchup_running);
+    RUN_TEST(test_thread_end_stop);
+    RUN_TEST(test_handler_bounds);
+    return UNITY_END();
+}
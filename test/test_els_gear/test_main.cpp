@@ -0,0 +1,141 @@
+#include <unity.h>
+#include "els_gear.h"
+#include "config_motion.h"
+
+// ============================================================================
+// ElsGear against the exact step count floor(pos * num / den), on the
+// sub-count scale ElsCore feeds it (ELS_SUBCOUNT_BITS per count)
+// ============================================================================
+
+static constexpr int64_t SUBCOUNTS_PER_REV = (int64_t)C_COUNTS_PER_REV << ELS_SUBCOUNT_BITS;
+// 3000 RPM sampled at 1 kHz
+static constexpr int32_t DELTA_3000_RPM = (int32_t)(3000 * SUBCOUNTS_PER_REV / 60 / 1000);
+
+// Thread pitches (um): metric, imperial (20 TPI, 11 TPI), fine, odd, coarse
+static const int32_t PITCHES[] = { 1000, 1270, 2309, 200, 1001, 6000 };
+
+static int64_t exactSteps(int64_t pos, int64_t num, int64_t den) {
+    const __int128 p = (__int128)pos * num;
+    __int128 q = p / den;
+    if (p % den != 0 && p < 0) q -= 1;
+    return (int64_t)q;
+}
+
+static int64_t gearNum(int32_t pitch_um, int8_t dir) {
+    return (int64_t)pitch_um * ELS_STEPS_PER_REV * dir;
+}
+
+static constexpr int64_t GEAR_DEN = SUBCOUNTS_PER_REV * ELS_LEADSCREW_PITCH_UM;
+
+// Small deterministic PRNG so runs repeat
+static uint32_t rng = 1;
+static int32_t nextRand(int32_t lo, int32_t hi) {
+    rng = rng * 1664525u + 1013904223u;
+    return lo + (int32_t)((rng >> 8) % (uint32_t)(hi - lo + 1));
+}
+
+void setUp(void) { rng = 1; }
+void tearDown(void) {}
+
+// Millions of spindle revolutions at 1 kHz cycle deltas around 3000 RPM, with
+// the speed wandering: the running total never leaves the exact count
+static void test_gear_exact_long_run(void) {
+    for (int8_t dir = -1; dir <= 1; dir += 2) {
+        for (int32_t pitch : PITCHES) {
+            const int64_t num = gearNum(pitch, dir);
+            ElsGear gear;
+            gear.setRatio(num, GEAR_DEN, ELS_SUBCOUNT_BITS);
+            int64_t pos = 0;
+            int64_t steps = 0;
+            const int64_t end = 2000000LL * SUBCOUNTS_PER_REV;
+            while (pos < end) {
+                const int32_t d = nextRand(DELTA_3000_RPM / 2, DELTA_3000_RPM);
+                pos += d;
+                steps += gear.advance(d);
+                if ((pos & 0xFFFF) < (int64_t)d) {
+                    TEST_ASSERT_EQUAL_INT64(exactSteps(pos, num, GEAR_DEN), steps);
+                }
+            }
+            TEST_ASSERT_EQUAL_INT64(exactSteps(pos, num, GEAR_DEN), steps);
+        }
+    }
+}
+
+// Low speed, reversals and the odd large catch-up delta, both signs
+static void test_gear_exact_reversals(void) {
+    for (int32_t pitch : PITCHES) {
+        const int64_t num = gearNum(pitch, 1);
+        ElsGear gear;
+        gear.setRatio(num, GEAR_DEN, ELS_SUBCOUNT_BITS);
+        int64_t pos = 0;
+        int64_t steps = 0;
+        for (int32_t i = 0; i < 2000000; i++) {
+            int32_t d = nextRand(-DELTA_3000_RPM, DELTA_3000_RPM);
+            if ((i & 0x3FF) == 0) d *= 2000;  // Stalled task catching up (64-bit path)
+            else if ((i & 3) == 0) d /= 256;  // Crawling
+            pos += d;
+            steps += gear.advance(d);
+            TEST_ASSERT_EQUAL_INT64(exactSteps(pos, num, GEAR_DEN), steps);
+        }
+    }
+}
+
+// A pitch change carries the phase over: no step is gained or lost
+static void test_gear_ratio_change_keeps_phase(void) {
+    ElsGear gear;
+    gear.setRatio(gearNum(1270, 1), GEAR_DEN, ELS_SUBCOUNT_BITS);
+    int32_t steps = 0;
+    for (int i = 0; i < 1000; i++) steps += gear.advance(DELTA_3000_RPM / 3);
+    const int64_t phase_before = (int64_t)gear.getRemainder() * 1000000 / gear.getDenominator();
+    gear.setRatio(gearNum(1000, 1), GEAR_DEN, ELS_SUBCOUNT_BITS);
+    const int64_t phase_after = (int64_t)gear.getRemainder() * 1000000 / gear.getDenominator();
+    TEST_ASSERT_INT32_WITHIN(1, phase_before, phase_after);
+    TEST_ASSERT_EQUAL_INT32(exactSteps(1000LL * (DELTA_3000_RPM / 3), gearNum(1270, 1), GEAR_DEN), steps);
+}
+
+// The 1 kHz cycle's delta at full spindle speed takes the divide-free path
+// for every pitch, either way round; only a long stall falls back
+static void test_gear_fast_path_at_3000_rpm(void) {
+    for (int8_t dir = -1; dir <= 1; dir += 2) {
+        for (int32_t pitch : PITCHES) {
+            ElsGear gear;
+            gear.setRatio(gearNum(pitch, dir), GEAR_DEN, ELS_SUBCOUNT_BITS);
+            TEST_ASSERT_TRUE(gear.isFastPath(DELTA_3000_RPM));
+            TEST_ASSERT_TRUE(gear.isFastPath(-DELTA_3000_RPM));
+            TEST_ASSERT_TRUE(gear.isFastPath(DELTA_3000_RPM * 10));
+        }
+    }
+    // Largest reduced denominator (odd pitch): a 2 s stall takes the divide
+    ElsGear gear;
+    gear.setRatio(gearNum(2309, 1), GEAR_DEN, ELS_SUBCOUNT_BITS);
+    TEST_ASSERT_FALSE(gear.isFastPath(DELTA_3000_RPM * 2000));
+}
+
+// Every sub-count delta the cycle can see, on the fast path, against the
+// 64-bit reference from a random phase
+static void test_gear_fast_path_matches_exact(void) {
+    ElsGear gear;
+    gear.setRatio(gearNum(2309, 1), GEAR_DEN, ELS_SUBCOUNT_BITS);
+    const int64_t num = gearNum(2309, 1) / 1600;
+    const int64_t den = GEAR_DEN / 1600;
+    TEST_ASSERT_EQUAL_INT32(den, gear.getDenominator());
+    for (int32_t d = -4 * DELTA_3000_RPM; d <= 4 * DELTA_3000_RPM; d++) {
+        const int32_t phase = nextRand(0, (int32_t)den - 1);
+        gear.setPhase(phase);
+        TEST_ASSERT_TRUE(gear.isFastPath(d));
+        const int64_t total = phase + (int64_t)d * num;
+        const int64_t exact = exactSteps(total, 1, den);
+        TEST_ASSERT_EQUAL_INT64(exact, gear.advance(d));
+        TEST_ASSERT_EQUAL_INT64(total - exact * den, gear.getRemainder());
+    }
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_gear_exact_long_run);
+    RUN_TEST(test_gear_exact_reversals);
+    RUN_TEST(test_gear_ratio_change_keeps_phase);
+    RUN_TEST(test_gear_fast_path_at_3000_rpm);
+    RUN_TEST(test_gear_fast_path_matches_exact);
+    return UNITY_END();
+}
@@ -0,0 +1,306 @@
+#include <unity.h>
+#include <math.h>
+#include "jog_profile.h"
+#include "config_motion.h"
+
+// ============================================================================
+// JogProfile at the motion task's 1 kHz tick, with the jog limits from
+// config_motion.h. Speed moves are checked on a profile with every limit
+// scaled up by LIMIT_SCALE: the profile's shape scales with them, and the
+// whole steps/s getSps() reports are then fine enough to take a second
+// difference of. Position moves are checked at the real limits, step for
+// step.
+// ============================================================================
+
+static constexpr uint32_t TICK_US = 1000;
+static constexpr int32_t LIMIT_SCALE = 100;
+
+static uint32_t rng = 1;
+static int32_t nextRand(int32_t lo, int32_t hi) {
+    rng = rng * 1664525u + 1013904223u;
+    return lo + (int32_t)((rng >> 8) % (uint32_t)(hi - lo + 1));
+}
+
+void setUp(void) { rng = 1; }
+void tearDown(void) {}
+
+static JogProfile realProfile() {
+    return JogProfile(ELS_STEPPER_MAX_SPS, ELS_JOG_ACCEL, ELS_JOG_JERK);
+}
+
+static JogProfile scaledProfile(int32_t jerk) {
+    return JogProfile(ELS_STEPPER_MAX_SPS * LIMIT_SCALE, ELS_JOG_ACCEL * LIMIT_SCALE, jerk * LIMIT_SCALE);
+}
+
+// Acceleration and jerk from the speed after each tick, less what getSps()
+// dropping the fraction can add. A speed ramp lands on its target with up
+// to one jerk step of acceleration left, so the jerk bound is twice the
+// limit; jerk 0 checks the acceleration only.
+struct LimitCheck {
+    double accel;
+    double jerk;
+    double v = 0.0;
+    double a = 0.0;
+
+    LimitCheck(double accel_limit, double jerk_limit) : accel(accel_limit), jerk(jerk_limit) {}
+
+    void tick(const JogProfile &p) {
+        const double dt = TICK_US * 1e-6;
+        const double v_now = p.getSps();
+        const double a_now = (v_now - v) / dt;
+        TEST_ASSERT_TRUE(fabs(a_now) <= accel + 2.0 / dt);
+        if (jerk > 0.0) TEST_ASSERT_TRUE(fabs(a_now - a) / dt <= 2.0 * jerk + 4.0 / (dt * dt));
+        v = v_now;
+        a = a_now;
+    }
+};
+
+static LimitCheck scaledCheck(int32_t jerk) {
+    return LimitCheck((double)ELS_JOG_ACCEL * LIMIT_SCALE, (double)jerk * LIMIT_SCALE);
+}
+
+// Runs toSpeed() until the speed is on target (and stopped, for 0)
+static int runToSpeed(JogProfile &p, LimitCheck &check, int32_t v_target) {
+    for (int ticks = 1; ticks < 100000; ticks++) {
+        p.toSpeed(v_target, TICK_US);
+        check.tick(p);
+        if (p.getSps() == v_target && (v_target != 0 || p.isStopped())) return ticks;
+    }
+    TEST_FAIL_MESSAGE("speed never reached");
+    return 0;
+}
+
+// Full speed each way, reversals and stops, S-curve and trapezoidal: within
+// the acceleration (and jerk) limits, and settled on each target
+static void test_jog_speed_limits(void) {
+    const int32_t jerks[] = { ELS_JOG_JERK, 0 };
+    for (int32_t jerk : jerks) {
+        JogProfile p = scaledProfile(jerk);
+        LimitCheck check = scaledCheck(jerk);
+        const int32_t v_max = ELS_STEPPER_MAX_SPS * LIMIT_SCALE;
+        const int32_t targets[] = { v_max, 0, -v_max, v_max / 7, -v_max / 50, 0 };
+        for (int32_t v_target : targets) {
+            runToSpeed(p, check, v_target);
+            // And holds it
+            for (int i = 0; i < 20; i++) {
+                p.toSpeed(v_target, TICK_US);
+                check.tick(p);
+                TEST_ASSERT_EQUAL_INT32(v_target, p.getSps());
+            }
+        }
+        TEST_ASSERT_TRUE(p.isStopped());
+    }
+}
+
+// Steps refused by the queue and given back come out on later ticks: a jog
+// that gives some back ends up just as far as one that does not
+static void test_jog_give_back(void) {
+    JogProfile straight = realProfile();
+    JogProfile held = realProfile();
+    int64_t straight_pos = 0;
+    int64_t held_pos = 0;
+    int64_t given = 0;
+    for (int i = 0; i < 3000; i++) {
+        const int32_t v = (i < 2000) ? ELS_STEPPER_MAX_SPS / 3 : 0;
+        straight_pos += straight.toSpeed(v, TICK_US);
+        int32_t n = held.toSpeed(v, TICK_US);
+        if (i % 10 == 0 && n != 0) {
+            held.giveBack(n);
+            given += n;
+            n = 0;
+        }
+        held_pos += n;
+    }
+    TEST_ASSERT_TRUE(straight.isStopped() && held.isStopped());
+    TEST_ASSERT_TRUE(given > 0);
+    TEST_ASSERT_EQUAL_INT64(straight_pos, held_pos);
+}
+
+// Runs toTarget() at a fixed target until it stops there; the axis may
+// never pass the target on the way
+static int runToTarget(JogProfile &p, int64_t &pos, int64_t target) {
+    const int64_t start = pos;
+    for (int ticks = 1; ticks < 1000000; ticks++) {
+        pos += p.toTarget((int32_t)(target - pos), TICK_US);
+        if (target >= start) TEST_ASSERT_TRUE(pos <= target);
+        else TEST_ASSERT_TRUE(pos >= target);
+        if (p.isStopped()) return ticks;
+    }
+    TEST_FAIL_MESSAGE("target never reached");
+    return 0;
+}
+
+// Moves from one step to past the distance full speed needs to build up:
+// each ends on the target step, at rest, without overshoot
+static void test_jog_target_lands(void) {
+    const int32_t dists[] = { 1, 2, 3, 10, 100, 1000, 10000, 100000, 1000000 };
+    for (int32_t d : dists) {
+        for (int32_t sgn = -1; sgn <= 1; sgn += 2) {
+            JogProfile p = realProfile();
+            int64_t pos = 0;
+            runToTarget(p, pos, (int64_t)sgn * d);
+            TEST_ASSERT_EQUAL_INT64((int64_t)sgn * d, pos);
+            TEST_ASSERT_EQUAL_INT32(0, p.toTarget(0, TICK_US));
+        }
+    }
+    // Random moves back to back
+    JogProfile p = realProfile();
+    int64_t pos = 0;
+    for (int i = 0; i < 200; i++) {
+        const int64_t target = pos + nextRand(-20000, 20000);
+        runToTarget(p, pos, target);
+        TEST_ASSERT_EQUAL_INT64(target, pos);
+    }
+}
+
+// Following a target that jumps about (the MPG wheel) the acceleration
+// stays within the limit. The tick that lands on the target stops dead from
+// the last step's speed, well under what a stepper starts and stops at, and
+// is not counted; nor is jerk, which the braking look-ahead lets exceed the
+// limit where the speed meets it.
+static void test_jog_target_limits(void) {
+    JogProfile p = realProfile();
+    LimitCheck check(ELS_JOG_ACCEL, 0);
+    int64_t pos = 0;
+    int64_t target = 0;
+    for (int i = 0; i < 200000; i++) {
+        if (i % 300 == 0) target = pos + nextRand(-40000, 40000);
+        pos += p.toTarget((int32_t)(target - pos), TICK_US);
+        if (p.isStopped()) {
+            check = LimitCheck(ELS_JOG_ACCEL, 0);
+            continue;
+        }
+        check.tick(p);
+    }
+}
+
+// The target reversing behind the axis at full speed: it runs through,
+// comes back and still lands on it
+static void test_jog_target_reversal(void) {
+    JogProfile p = realProfile();
+    int64_t pos = 0;
+    while (p.getSps() < ELS_STEPPER_MAX_SPS) pos += p.toTarget(10000000, TICK_US);
+    const int64_t target = pos - 5000;
+    int ticks = 0;
+    int64_t furthest = pos;
+    while (!p.isStopped() && ticks++ < 100000) {
+        pos += p.toTarget((int32_t)(target - pos), TICK_US);
+        if (pos > furthest) furthest = pos;
+    }
+    TEST_ASSERT_EQUAL_INT64(target, pos);
+    // It went on no further than full speed stops in
+    TEST_ASSERT_TRUE(furthest - (target + 5000) <= p.stopSteps(ELS_STEPPER_MAX_SPS));
+}
+
+// A move at sps that ElsCore hands to the profile once the room ahead is
+// down to its trigger (stopping distance plus one cycle), run with the
+// room each tick: ends on the limit step, never past it. Returns the speed
+// of the last tick before the stop.
+static int32_t landOnLimit(JogProfile &p, LimitCheck *check, int32_t sps) {
+    const int32_t abs_sps = (sps < 0) ? -sps : sps;
+    const int32_t room = p.stopSteps(sps) + abs_sps / 1000 + 1;
+    p.start(sps);
+    if (check != nullptr) check->v = sps;
+    int64_t moved = 0;
+    int32_t last_sps = sps;
+    for (int ticks = 0; ticks < 100000; ticks++) {
+        const int32_t left = room - (int32_t)((sps < 0) ? -moved : moved);
+        const int32_t n = (sps > 0) ? p.toSpeed(sps, TICK_US, left, INT32_MAX)
+                                    : p.toSpeed(sps, TICK_US, INT32_MAX, left);
+        moved += n;
+        TEST_ASSERT_TRUE(((sps < 0) ? -moved : moved) <= room);
+        if (p.isStopped()) break;
+        last_sps = p.getSps();
+        if (check != nullptr) check->tick(p);
+    }
+    TEST_ASSERT_TRUE(p.isStopped());
+    TEST_ASSERT_EQUAL_INT64((sps < 0) ? -(int64_t)room : room, moved);
+    return last_sps;
+}
+
+// Every speed up to full, both ways: lands on the limit, the last step
+// slow enough to stop on dead. At the real limits the speeds are coarse,
+// but fine enough to hold the jerk to 2x plus what the rounding adds.
+static void test_jog_room_landing(void) {
+    for (int32_t sps = 500; sps <= ELS_STEPPER_MAX_SPS; sps += 500) {
+        for (int32_t sgn = -1; sgn <= 1; sgn += 2) {
+            JogProfile p = realProfile();
+            LimitCheck check(ELS_JOG_ACCEL, ELS_JOG_JERK);
+            const int32_t last = landOnLimit(p, &check, sgn * sps);
+            TEST_ASSERT_TRUE(last * sgn > 0 && last * sgn <= 200);
+        }
+    }
+}
+
+// Braking onto the limit, finer: within the acceleration and 2x jerk limits
+static void test_jog_room_limits(void) {
+    for (int32_t sps = 500; sps <= ELS_STEPPER_MAX_SPS; sps += 500) {
+        JogProfile p = scaledProfile(ELS_JOG_JERK);
+        LimitCheck check = scaledCheck(ELS_JOG_JERK);
+        landOnLimit(p, &check, sps * LIMIT_SCALE);
+    }
+}
+
+// A limit closer than the axis can stop in (one just set) clips the move
+// there at once
+static void test_jog_room_clips(void) {
+    const int32_t sps = ELS_STEPPER_MAX_SPS;
+    const int32_t rooms[] = { 0, 1, 49, 50, 51, 1000 };
+    for (int32_t room : rooms) {
+        JogProfile p = realProfile();
+        p.start(sps);
+        int64_t moved = 0;
+        for (int ticks = 0; ticks < 1000 && !p.isStopped(); ticks++) {
+            moved += p.toSpeed(sps, TICK_US, room - (int32_t)moved, INT32_MAX);
+            TEST_ASSERT_TRUE(moved <= room);
+        }
+        TEST_ASSERT_TRUE(p.isStopped());
+        TEST_ASSERT_EQUAL_INT64(room, moved);
+    }
+}
+
+// On a limit, the axis can still move away from it, not into it
+static void test_jog_room_away(void) {
+    JogProfile p = realProfile();
+    for (int i = 0; i < 100; i++) TEST_ASSERT_EQUAL_INT32(0, p.toSpeed(ELS_STEPPER_MAX_SPS, TICK_US, 0, INT32_MAX));
+    TEST_ASSERT_TRUE(p.isStopped());
+    int64_t moved = 0;
+    for (int i = 0; i < 100; i++) moved += p.toSpeed(-ELS_STEPPER_MAX_SPS, TICK_US, 0, INT32_MAX);
+    TEST_ASSERT_TRUE(moved < 0);
+    JogProfile q = realProfile();
+    TEST_ASSERT_EQUAL_INT32(0, q.toTarget(1000, TICK_US, 0, INT32_MAX));
+    moved = 0;
+    for (int i = 0; i < 100; i++) moved += q.toTarget(-1000 - (int32_t)moved, TICK_US, 0, INT32_MAX);
+    TEST_ASSERT_TRUE(moved < 0);
+}
+
+// An MPG target past the limit is held to it: the move lands on the limit
+static void test_jog_target_in_room(void) {
+    const int32_t rooms[] = { 1, 100, 5000, 100000 };
+    for (int32_t room : rooms) {
+        JogProfile p = realProfile();
+        int64_t moved = 0;
+        for (int ticks = 0; ticks < 100000; ticks++) {
+            moved += p.toTarget(10000000, TICK_US, room - (int32_t)moved, INT32_MAX);
+            TEST_ASSERT_TRUE(moved <= room);
+            if (p.isStopped()) break;
+        }
+        TEST_ASSERT_TRUE(p.isStopped());
+        TEST_ASSERT_EQUAL_INT64(room, moved);
+    }
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_jog_speed_limits);
+    RUN_TEST(test_jog_give_back);
+    RUN_TEST(test_jog_target_lands);
+    RUN_TEST(test_jog_target_limits);
+    RUN_TEST(test_jog_target_reversal);
+    RUN_TEST(test_jog_room_landing);
+    RUN_TEST(test_jog_room_limits);
+    RUN_TEST(test_jog_room_clips);
+    RUN_TEST(test_jog_room_away);
+    RUN_TEST(test_jog_target_in_room);
+    return UNITY_END();
+}
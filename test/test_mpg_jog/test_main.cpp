@@ -0,0 +1,220 @@
+#include <unity.h>
+#include <math.h>
+#include "mpg_scale.h"
+#include "mpg_jog.h"
+#include "config_motion.h"
+
+// ============================================================================
+// The MPG wheel into Z as the motion task runs it at 1 kHz: the wheel's
+// counts scaled x1/x10/x100 by MpgScale, MpgJog following them through the
+// jog profile, the step queue taking what it returns. The wheel turns at a
+// given counts/s, its fraction of a count carried from tick to tick.
+// ============================================================================
+
+static constexpr uint32_t TICK_US = 1000;
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Acceleration from the speed after each tick, less what getSps() dropping
+// the fraction can add. The tick that lands on the target stops dead from
+// the last step's speed and is not counted (as in test_jog_profile).
+struct LimitCheck {
+    double v = 0.0;
+
+    void tick(const MpgJog &jog) {
+        if (jog.isStopped()) {
+            v = 0.0;
+            return;
+        }
+        const double dt = TICK_US * 1e-6;
+        const double v_now = jog.getSps();
+        TEST_ASSERT_TRUE(fabs(v_now) <= ELS_STEPPER_MAX_SPS);
+        TEST_ASSERT_TRUE(fabs(v_now - v) / dt <= ELS_JOG_ACCEL + 2.0 / dt);
+        v = v_now;
+    }
+};
+
+struct Rig {
+    MpgScale scale;
+    MpgJog jog{ELS_STEPPER_MAX_SPS, ELS_JOG_ACCEL, ELS_JOG_JERK};
+    LimitCheck check;
+    double wheel_acc = 0.0;        // Fraction of a count carried
+    int64_t turned = 0;            // Scaled counts the wheel gave
+    int64_t z = 0;                 // Steps the queue took
+    int64_t limit_fwd = INT64_MAX; // Endstops, in Z steps
+    int64_t limit_rev = INT64_MIN;
+    int32_t queue_max = INT32_MAX; // Steps the queue takes a tick
+
+    // One tick with the wheel turning at cps; returns the scale
+    int32_t tick(double cps, bool wheel = true) {
+        wheel_acc += cps * TICK_US * 1e-6;
+        const int32_t counts = (int32_t)floor(wheel_acc);
+        wheel_acc -= counts;
+        const int32_t s = scale.update(counts, TICK_US / 1000);
+        turned += counts * s;
+        const int32_t room_fwd = (limit_fwd == INT64_MAX) ? INT32_MAX : (int32_t)(limit_fwd - z);
+        const int32_t room_rev = (limit_rev == INT64_MIN) ? INT32_MAX : (int32_t)(z - limit_rev);
+        const int32_t n = jog.update(counts * s, wheel, TICK_US, room_fwd, room_rev);
+        const int32_t accepted = (n > queue_max) ? queue_max : (n < -queue_max) ? -queue_max : n;
+        jog.taken(n, accepted);
+        z += accepted;
+        TEST_ASSERT_TRUE(jog.getLeft() <= MPG_JOG_MAX_LAG_STEPS && jog.getLeft() >= -MPG_JOG_MAX_LAG_STEPS);
+        TEST_ASSERT_TRUE(z <= limit_fwd && z >= limit_rev);
+        check.tick(jog);
+        return s;
+    }
+
+    // Wheel still until Z stops; returns the ticks it took
+    int settle(int max_ticks) {
+        for (int t = 1; t <= max_ticks; t++) {
+            tick(0.0);
+            if (jog.isStopped() && jog.getLeft() == 0) return t;
+        }
+        TEST_FAIL_MESSAGE("Z never stopped");
+        return 0;
+    }
+};
+
+// Turned slowly the scale stays x1, and Z ends on exactly the counts
+// turned, through a step queue that takes only a few steps a tick
+static void test_mpg_slow_turn(void) {
+    const int32_t queues[] = { INT32_MAX, 3 };
+    for (int32_t q : queues) {
+        Rig r;
+        r.queue_max = q;
+        for (int t = 0; t < 2000; t++) {
+            TEST_ASSERT_EQUAL_INT32(1, r.tick((t < 1000) ? 400.0 : -250.0));
+        }
+        r.settle(2000);
+        TEST_ASSERT_TRUE(r.turned >= 149 && r.turned <= 150);
+        TEST_ASSERT_EQUAL_INT64(r.turned, r.z);
+    }
+}
+
+// The scale goes up past each threshold and comes back down only once the
+// wheel is MPG_SCALE_HYST_PCT below it; held at a threshold it changes once
+static void test_mpg_scale_thresholds(void) {
+    MpgScale s;
+    double acc = 0.0;
+    auto run = [&](double cps, int ms) {
+        for (int t = 0; t < ms; t++) {
+            acc += cps * 1e-3;
+            const int32_t counts = (int32_t)floor(acc);
+            acc -= counts;
+            s.update(counts, 1);
+        }
+        return s.get();
+    };
+    const double hyst = (100 - MPG_SCALE_HYST_PCT) / 100.0;
+    TEST_ASSERT_EQUAL_INT32(1, run(MPG_X10_CPS * 0.9, 500));
+    TEST_ASSERT_EQUAL_INT32(10, run(MPG_X10_CPS * 1.2, 500));
+    TEST_ASSERT_EQUAL_INT32(100, run(MPG_X100_CPS * 1.2, 500));
+    TEST_ASSERT_EQUAL_INT32(100, run(MPG_X100_CPS * (hyst + 0.05), 500));
+    TEST_ASSERT_EQUAL_INT32(10, run(MPG_X100_CPS * (hyst - 0.05), 500));
+    TEST_ASSERT_EQUAL_INT32(10, run(MPG_X10_CPS * (hyst + 0.05), 500));
+    TEST_ASSERT_EQUAL_INT32(1, run(MPG_X10_CPS * (hyst - 0.05), 500));
+    // A reversal is no slower a wheel
+    TEST_ASSERT_EQUAL_INT32(10, run(-MPG_X10_CPS * 1.2, 500));
+    s.reset();
+    TEST_ASSERT_EQUAL_INT32(1, s.get());
+
+    // Wavering 5% either side of the x10 threshold: up once, then held
+    s.reset();
+    acc = 0.0;
+    int changes = 0;
+    int32_t last = s.get();
+    for (int i = 0; i < 40; i++) {
+        run(MPG_X10_CPS * ((i % 2) ? 0.95 : 1.05), 100);
+        if (s.get() != last) changes++;
+        last = s.get();
+    }
+    TEST_ASSERT_EQUAL_INT32(1, changes);
+}
+
+// Spun at x100 far faster than Z can go: Z runs within its limits, the
+// target never more than MPG_JOG_MAX_LAG_STEPS ahead, never passed. With
+// the wheel stopped Z goes on no further than the lag and stops on it.
+static void test_mpg_fast_spin_lag_cap(void) {
+    for (int sgn = -1; sgn <= 1; sgn += 2) {
+        Rig r;
+        for (int t = 0; t < 3000; t++) {
+            r.tick(sgn * MPG_X100_CPS * 2.0);
+            if (sgn > 0) TEST_ASSERT_TRUE(r.jog.getLeft() >= 0);
+            else TEST_ASSERT_TRUE(r.jog.getLeft() <= 0);
+        }
+        TEST_ASSERT_EQUAL_INT32(100, r.scale.get());
+        // It got going
+        TEST_ASSERT_TRUE(r.z * sgn > 10000);
+        const int64_t z_stop = r.z;
+        const int64_t target = r.z + r.jog.getLeft();
+        // Wheel stopped within a tick: a count or two more at most
+        r.settle(5000);
+        TEST_ASSERT_TRUE(llabs(r.z - z_stop) <= MPG_JOG_MAX_LAG_STEPS);
+        TEST_ASSERT_TRUE(llabs(r.z - target) <= 2 * 100);
+    }
+}
+
+// Reversed hard at x10 while Z runs: it brakes and comes back within the
+// acceleration limit, and lands on where the wheel ended
+static void test_mpg_hard_reversal(void) {
+    Rig r;
+    for (int t = 0; t < 1000; t++) r.tick(MPG_X10_CPS * 1.5);
+    TEST_ASSERT_EQUAL_INT32(10, r.scale.get());
+    TEST_ASSERT_TRUE(r.jog.getSps() > 0);
+    int64_t target = 0;
+    for (int t = 0; t < 1000; t++) {
+        r.tick(-MPG_X10_CPS * 1.5);
+        target = r.z + r.jog.getLeft();
+    }
+    TEST_ASSERT_TRUE(r.jog.getSps() < 0);
+    // The next tick's counts go out at x1 or x10 as the scale decays
+    const int64_t z0 = r.z;
+    r.settle(5000);
+    TEST_ASSERT_TRUE(llabs(r.z - target) <= 10);
+    TEST_ASSERT_TRUE(r.z <= z0);
+}
+
+// An endstop ahead: the wheel spun on past it moves Z up to it and no
+// further, and what is dropped is not owed on the way back (turned at x1,
+// once the wheel has been still long enough to drop the scale)
+static void test_mpg_endstop(void) {
+    Rig r;
+    r.limit_fwd = 3000;
+    for (int t = 0; t < 2000; t++) r.tick(MPG_X10_CPS * 1.5);
+    r.settle(5000);
+    TEST_ASSERT_TRUE(r.z <= 3000 && r.z >= 2990);
+    for (int t = 0; t < 500; t++) r.tick(0.0);
+    const int64_t at = r.z;
+    for (int t = 0; t < 400; t++) r.tick(-250.0);
+    r.settle(5000);
+    TEST_ASSERT_EQUAL_INT64(at - 100, r.z);
+}
+
+// The wheel taken off Z mid-move: Z brakes to a stop within the limits,
+// nothing owed, and stays put while the wheel turns on
+static void test_mpg_wheel_off(void) {
+    Rig r;
+    for (int t = 0; t < 1000; t++) r.tick(MPG_X10_CPS * 1.5);
+    TEST_ASSERT_TRUE(r.jog.getSps() > 0);
+    int t = 0;
+    while (!r.jog.isStopped()) {
+        r.tick(MPG_X10_CPS * 1.5, false);
+        TEST_ASSERT_TRUE(++t < 2000);
+    }
+    TEST_ASSERT_EQUAL_INT32(0, r.jog.getLeft());
+    const int64_t z = r.z;
+    for (int i = 0; i < 500; i++) r.tick(MPG_X10_CPS * 1.5, false);
+    TEST_ASSERT_EQUAL_INT64(z, r.z);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_mpg_slow_turn);
+    RUN_TEST(test_mpg_scale_thresholds);
+    RUN_TEST(test_mpg_fast_spin_lag_cap);
+    RUN_TEST(test_mpg_hard_reversal);
+    RUN_TEST(test_mpg_endstop);
+    RUN_TEST(test_mpg_wheel_off);
+    return UNITY_END();
+}
@@ -0,0 +1,206 @@
+#include <unity.h>
+#include "pcnt_count.h"
+#include "spindle_ramp.h"
+#include "config_motion.h"
+
+// ============================================================================
+// PcntCount against a model of the PCNT unit: counts between PCNT_L_LIM and
+// PCNT_H_LIM, and on reaching either resets itself to 0 and counts on. The
+// watch point callback (the fold) runs some time later, edges arriving in
+// between. The owner reads the count every tick and keeps it; reads from
+// anywhere else can land at any time, the reset-to-callback gap included.
+// The extended count must follow the true count through every fold, across
+// the 32-bit wrap, and with the callback landing mid-read.
+// ============================================================================
+
+struct ModelUnit {
+    volatile int32_t accum = 0;
+    int32_t count = 0;
+    int32_t pending = 0;  // Limit reached, callback not run yet
+    int32_t last = 0;     // The owner's last read
+
+    void edge(int32_t d) {
+        count += d;
+        if (count == PCNT_H_LIM || count == PCNT_L_LIM) {
+            // The callback comes long before the unit can reach a limit again
+            TEST_ASSERT_EQUAL_INT32(0, pending);
+            pending = count;
+            count = 0;
+        }
+    }
+
+    void callback() {
+        if (pending == 0) return;
+        accum = PcntCount::fold(accum, pending);
+        pending = 0;
+    }
+
+    int32_t read() const {
+        return PcntCount::read(accum, last, PCNT_H_LIM, [this] { return count; });
+    }
+
+    void tick() { last = read(); }
+};
+
+static uint32_t rng = 1;
+static int32_t nextRand(int32_t lo, int32_t hi) {
+    rng = rng * 1664525u + 1013904223u;
+    return lo + (int32_t)((rng >> 8) % (uint32_t)(hi - lo + 1));
+}
+
+void setUp(void) { rng = 1; }
+void tearDown(void) {}
+
+// Runs and reversals over many folds each way, the callback up to 20 edges
+// late and the owner reading every 50: every read, in the gap too, is the
+// true count, and no edge is lost to a fold
+static void test_pcnt_random_walk(void) {
+    ModelUnit unit;
+    int64_t truth = 0;
+    int callback_in = -1;
+    int since_tick = 0;
+    for (int i = 0; i < 3000; i++) {
+        const int32_t run = nextRand(1, 3 * PCNT_H_LIM);
+        const int32_t d = (nextRand(0, 2) == 0) ? -1 : 1;
+        for (int32_t j = 0; j < run; j++) {
+            unit.edge(d);
+            truth += d;
+            if (unit.pending != 0 && callback_in < 0) callback_in = nextRand(0, 20);
+            if (callback_in >= 0 && callback_in-- == 0) unit.callback();
+            if (++since_tick == 50) {
+                unit.tick();
+                since_tick = 0;
+            }
+            TEST_ASSERT_EQUAL_INT32((int32_t)(uint32_t)(uint64_t)truth, unit.read());
+        }
+    }
+}
+
+// Past 2^31 and 2^32 both ways: differences of two reads, as verifyUpdate()
+// and SpindleTracker take them, stay exact through the wrap
+static void test_pcnt_wraps_at_32_bits(void) {
+    const int32_t starts[] = { INT32_MAX - 5 * PCNT_H_LIM, -7 * PCNT_H_LIM };
+    for (int32_t start : starts) {
+        for (int32_t d = -1; d <= 1; d += 2) {
+            ModelUnit unit;
+            unit.accum = (d > 0) ? start : -start;
+            unit.last = unit.accum;
+            const uint32_t first = (uint32_t)unit.read();
+            int32_t moved = 0;
+            for (int32_t j = 0; j < 20 * PCNT_H_LIM; j++) {
+                unit.edge(d);
+                moved += d;
+                if (j % 7 == 3) unit.callback();
+                if (j % 100 == 0) unit.tick();
+                if (j % 97 == 0) TEST_ASSERT_EQUAL_INT32(moved, (int32_t)((uint32_t)unit.read() - first));
+            }
+            unit.callback();
+            TEST_ASSERT_EQUAL_INT32(moved, (int32_t)((uint32_t)unit.read() - first));
+        }
+    }
+}
+
+// The callback runs between the accumulator read and the unit read: the
+// first attempt sees the old accumulator with the unit past its reset, and
+// has to be thrown away. The reset alone (no callback yet) needs no retry.
+static void test_pcnt_fold_during_read(void) {
+    for (int32_t d = -1; d <= 1; d += 2) {
+        ModelUnit unit;
+        const int32_t limit = (d > 0) ? PCNT_H_LIM : PCNT_L_LIM;
+        for (int32_t j = 0; j < limit * d - 1; j++) {
+            unit.edge(d);
+            if (j % 100 == 0) unit.tick();
+        }
+        unit.tick();
+        int attempts = 0;
+        int32_t got = PcntCount::read(unit.accum, unit.last, PCNT_H_LIM, [&] {
+            if (attempts++ == 0) {
+                unit.edge(d);
+                unit.edge(d);
+                unit.callback();
+            }
+            return unit.count;
+        });
+        TEST_ASSERT_EQUAL_INT32(limit + d, got);
+        TEST_ASSERT_EQUAL_INT32(2, attempts);
+
+        for (int32_t j = 0; j < limit * d - 2; j++) {
+            unit.edge(d);
+            if (j % 100 == 0) unit.tick();
+        }
+        unit.tick();
+        attempts = 0;
+        got = PcntCount::read(unit.accum, unit.last, PCNT_H_LIM, [&] {
+            if (attempts++ == 0) unit.edge(d);
+            return unit.count;
+        });
+        TEST_ASSERT_EQUAL_INT32(2 * limit, got);
+        TEST_ASSERT_EQUAL_INT32(1, attempts);
+    }
+}
+
+// The spindle STEP counter over a long run: SpindleRamp's pulse train at
+// random speeds up to the top, stops and reversals, each pulse an edge on
+// the model unit at its time. The callback comes 1-40 us after each reset,
+// the owner reads every 1 ms and other readers at random pulses. Counted
+// equals commanded at every read.
+static void test_pcnt_step_stream(void) {
+    ModelUnit unit;
+    SpindleRamp ramp(SPINDLE_ACCEL_RPM_PER_SEC, 0);
+    int64_t commanded = 0;
+    uint64_t t_us = 0;
+    uint64_t next_tick_us = 1000;
+    uint64_t callback_us = 0;
+    bool callback_due = false;
+    uint64_t pulses = 0;
+    uint32_t folds = 0;
+    for (int run = 0; run < 40; run++) {
+        const int32_t dir = (nextRand(0, 1) == 0) ? -1 : 1;
+        const uint32_t t_q8 = (run % 4 == 0) ? SpindleRamp::V_MAX_Q8
+                                             : (uint32_t)nextRand(SpindleRamp::V_MIN_Q8, SpindleRamp::V_MAX_Q8);
+        ramp.start();
+        // Up to speed, a while there, then down to the start/stop speed
+        const uint64_t hold = (uint64_t)nextRand(10000, 300000);
+        uint64_t held = 0;
+        uint32_t target = t_q8;
+        while (true) {
+            if (ramp.speed() == t_q8 && ++held > hold) target = 0;
+            if (target == 0 && ramp.speed() <= SpindleRamp::V_MIN_Q8) break;
+            const uint32_t period = ramp.next(target);
+            t_us += period * 1000000ull / SpindleRamp::RES_HZ;
+            while (next_tick_us <= t_us || (callback_due && callback_us <= t_us)) {
+                if (callback_due && callback_us <= next_tick_us) {
+                    unit.callback();
+                    callback_due = false;
+                } else {
+                    unit.tick();
+                    TEST_ASSERT_EQUAL_INT32((int32_t)commanded, unit.last);
+                    next_tick_us += 1000;
+                }
+            }
+            unit.edge(dir);
+            commanded += dir;
+            pulses++;
+            if (unit.pending != 0 && !callback_due) {
+                callback_due = true;
+                callback_us = t_us + (uint64_t)nextRand(1, 40);
+                folds++;
+            }
+            if (nextRand(0, 63) == 0) TEST_ASSERT_EQUAL_INT32((int32_t)commanded, unit.read());
+        }
+    }
+    unit.callback();
+    TEST_ASSERT_EQUAL_INT32((int32_t)commanded, unit.read());
+    // Long enough to matter: millions of pulses, hundreds of folds
+    TEST_ASSERT_TRUE(pulses > 2000000);
+    TEST_ASSERT_TRUE(folds > 200);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_pcnt_random_walk);
+    RUN_TEST(test_pcnt_wraps_at_32_bits);
+    RUN_TEST(test_pcnt_fold_during_read);
+    RUN_TEST(test_pcnt_step_stream);
+    return UNITY_END();
+}
@@ -0,0 +1,177 @@
+#include <unity.h>
+#include <math.h>
+#include "spindle_index.h"
+#include "config_motion.h"
+
+// ============================================================================
+// SpindleIndex against a model of the encoder and its index: the spindle at
+// a true angle in counts, the count reading floor(angle) plus whatever the
+// encoder gained or lost, plus the corrections SpindleIndex asked for. The
+// index pulse covers the same true angles every revolution, so its middle
+// is the same angle whichever way the spindle crosses it.
+// ============================================================================
+
+struct Spindle {
+    SpindleIndex index;
+    double rev = C_COUNTS_PER_REV;  // True counts per revolution
+    double index_at = 123.4;        // True angle the pulse starts at
+    int32_t width = 3;              // Odd: the middle is between two counts
+    int64_t offset = 537;           // Boot offset, plus counts gained or lost
+    int64_t shift = 0;              // Corrections applied
+
+    int64_t count(double angle) const { return (int64_t)floor(angle) + offset + shift; }
+
+    // Crosses the pulse of revolution k, as EncoderMotion hands it over
+    SpindleIndex::Correction pulse(int64_t k, bool home_allowed) {
+        const double a0 = index_at + (double)k * rev;
+        const SpindleIndex::Correction c = index.take(count(a0) + count(a0 + width), home_allowed);
+        shift += c.counts;
+        return c;
+    }
+
+    // Where the middle of revolution k's pulse reads now, less
+    // SPINDLE_INDEX_PHASE, in (-rev/2, rev/2] counts
+    double phaseError(int64_t k) const {
+        const double a0 = index_at + (double)k * rev;
+        double e = fmod(0.5 * (double)(count(a0) + count(a0 + width)) - SPINDLE_INDEX_PHASE, C_COUNTS_PER_REV);
+        if (e > C_COUNTS_PER_REV / 2) e -= C_COUNTS_PER_REV;
+        else if (e <= -C_COUNTS_PER_REV / 2) e += C_COUNTS_PER_REV;
+        return e;
+    }
+};
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// The first pulse pair that agrees re-homes the count, once allowed: the
+// index then reads SPINDLE_INDEX_PHASE to within the half count of its
+// middle, and later pulses find nothing to correct
+static void test_index_rehomes_on_first_pair(void) {
+    Spindle s;
+    SpindleIndex::Correction c = s.pulse(0, true);
+    TEST_ASSERT_EQUAL_INT32(0, c.counts);
+    TEST_ASSERT_FALSE(c.home);
+    c = s.pulse(1, true);
+    TEST_ASSERT_TRUE(c.home);
+    TEST_ASSERT_TRUE(c.counts != 0);
+    TEST_ASSERT_TRUE(s.index.stats().homed);
+    TEST_ASSERT_TRUE(fabs(s.phaseError(1)) <= 0.5);
+    for (int64_t k = 2; k < 50; k++) {
+        c = s.pulse(k, true);
+        TEST_ASSERT_EQUAL_INT32(0, c.counts);
+        TEST_ASSERT_FALSE(c.home);
+        TEST_ASSERT_TRUE(fabs(s.phaseError(k)) <= 0.5);
+    }
+    const SpindleIndexStats &st = s.index.stats();
+    TEST_ASSERT_EQUAL_UINT32(50, st.pulses);
+    TEST_ASSERT_EQUAL_INT32(0, st.rev_error);
+    TEST_ASSERT_EQUAL_INT32(0, st.peak_rev_error);
+    TEST_ASSERT_EQUAL_UINT32(0, st.slips);
+    TEST_ASSERT_EQUAL_INT32(0, st.corrected);
+}
+
+// While the ELS follows the spindle the re-home waits, however many pulses
+// agree; allowed again, the next pulse makes it
+static void test_index_rehome_waits(void) {
+    Spindle s;
+    for (int64_t k = 0; k < 10; k++) {
+        const SpindleIndex::Correction c = s.pulse(k, false);
+        TEST_ASSERT_EQUAL_INT32(0, c.counts);
+        TEST_ASSERT_FALSE(c.home);
+    }
+    TEST_ASSERT_FALSE(s.index.stats().homed);
+    const SpindleIndex::Correction c = s.pulse(10, true);
+    TEST_ASSERT_TRUE(c.home);
+    TEST_ASSERT_TRUE(fabs(s.phaseError(10)) <= 0.5);
+}
+
+// Homed, then 5 counts lost while threading: the next pulse reports the
+// revolution short and the slip, the one after confirms it, and the count
+// is put back exactly where it was
+static void test_index_puts_back_lost_counts(void) {
+    Spindle s;
+    s.pulse(0, true);
+    s.pulse(1, true);
+    const int64_t homed_at = s.offset + s.shift;
+    s.offset -= 5;
+    SpindleIndex::Correction c = s.pulse(2, false);
+    TEST_ASSERT_EQUAL_INT32(0, c.counts);
+    TEST_ASSERT_EQUAL_INT32(-5, s.index.stats().rev_error);
+    TEST_ASSERT_EQUAL_UINT32(1, s.index.stats().slips);
+    c = s.pulse(3, false);
+    TEST_ASSERT_EQUAL_INT32(5, c.counts);
+    TEST_ASSERT_FALSE(c.home);
+    TEST_ASSERT_EQUAL_INT64(homed_at, s.offset + s.shift);
+    TEST_ASSERT_EQUAL_INT32(5, s.index.stats().corrected);
+    for (int64_t k = 4; k < 20; k++) {
+        TEST_ASSERT_EQUAL_INT32(0, s.pulse(k, false).counts);
+    }
+    TEST_ASSERT_EQUAL_INT32(0, s.index.stats().rev_error);
+    TEST_ASSERT_EQUAL_INT32(5, s.index.stats().peak_rev_error);
+    TEST_ASSERT_EQUAL_UINT32(1, s.index.stats().slips);
+}
+
+// A gain above SPINDLE_INDEX_MAX_CORRECT is held off while threading, as
+// one slip however many pulses see it, and corrected once allowed
+static void test_index_holds_off_large_correction(void) {
+    Spindle s;
+    s.pulse(0, true);
+    s.pulse(1, true);
+    const int64_t homed_at = s.offset + s.shift;
+    const int32_t gain = SPINDLE_INDEX_MAX_CORRECT + 12;
+    s.offset += gain;
+    for (int64_t k = 2; k < 12; k++) {
+        TEST_ASSERT_EQUAL_INT32(0, s.pulse(k, false).counts);
+    }
+    TEST_ASSERT_EQUAL_UINT32(1, s.index.stats().slips);
+    const SpindleIndex::Correction c = s.pulse(12, true);
+    TEST_ASSERT_EQUAL_INT32(-gain, c.counts);
+    TEST_ASSERT_FALSE(c.home);
+    TEST_ASSERT_EQUAL_INT64(homed_at, s.offset + s.shift);
+    TEST_ASSERT_EQUAL_INT32(-gain, s.index.stats().corrected);
+}
+
+// Reversed back over the same pulse: no revolution, nothing to correct;
+// back over the one before, a whole revolution with no error
+static void test_index_reversal(void) {
+    Spindle s;
+    s.pulse(0, true);
+    s.pulse(1, true);
+    s.pulse(2, true);
+    SpindleIndex::Correction c = s.pulse(2, false);
+    TEST_ASSERT_EQUAL_INT32(0, c.counts);
+    c = s.pulse(1, false);
+    TEST_ASSERT_EQUAL_INT32(0, c.counts);
+    const SpindleIndexStats &st = s.index.stats();
+    TEST_ASSERT_EQUAL_UINT32(5, st.pulses);
+    TEST_ASSERT_EQUAL_INT32(0, st.rev_error);
+    TEST_ASSERT_EQUAL_INT32(0, st.peak_rev_error);
+    TEST_ASSERT_EQUAL_UINT32(0, st.slips);
+    TEST_ASSERT_EQUAL_INT64(3, s.index.calRevs());
+}
+
+// An encoder slightly off C_COUNTS_PER_REV: the calibration reads its true
+// counts per revolution over 3000 of them, through the count corrections
+// the drift makes on the way
+static void test_index_calibration(void) {
+    Spindle s;
+    s.rev = C_COUNTS_PER_REV + 0.005;
+    for (int64_t k = 0; k <= 3000; k++) s.pulse(k, k < 2);
+    TEST_ASSERT_EQUAL_INT64(3000, s.index.calRevs());
+    const double per_rev = (double)s.index.calC2() / (2.0 * (double)s.index.calRevs());
+    TEST_ASSERT_TRUE(fabs(per_rev - s.rev) <= 0.001);
+    // The drift was put back a count at a time as it built up
+    TEST_ASSERT_TRUE(s.index.stats().corrected <= -14 && s.index.stats().corrected >= -16);
+    TEST_ASSERT_TRUE(fabs(s.phaseError(3000)) <= 1.5);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_index_rehomes_on_first_pair);
+    RUN_TEST(test_index_rehome_waits);
+    RUN_TEST(test_index_puts_back_lost_counts);
+    RUN_TEST(test_index_holds_off_large_correction);
+    RUN_TEST(test_index_reversal);
+    RUN_TEST(test_index_calibration);
+    return UNITY_END();
+}
@@ -0,0 +1,203 @@
+#include <unity.h>
+#include <math.h>
+#include "spindle_ramp.h"
+#include "config_motion.h"
+
+// ============================================================================
+// SpindleRamp as the spindle pulse generator runs it: one next() per step,
+// time kept in the RMT ticks of the periods it returns. Checked with the
+// configured limits (trapezoidal by default) and with an S-curve.
+// ============================================================================
+
+static constexpr int32_t S_CURVE_JERK = 2000;  // RPM/s^2
+
+static uint32_t rng = 1;
+static uint32_t nextRand(uint32_t lo, uint32_t hi) {
+    rng = rng * 1664525u + 1013904223u;
+    return lo + (rng >> 8) % (hi - lo + 1);
+}
+
+void setUp(void) { rng = 1; }
+void tearDown(void) {}
+
+static uint32_t rpmQ8(int32_t rpm) {
+    return (uint32_t)(((int64_t)rpm * SPINDLE_STEPS_PER_REV << 8) / 60);
+}
+
+// Acceleration limit in Q8 steps/s^2
+static double accelQ8(int32_t rpm_per_sec) {
+    return (double)rpm_per_sec * SPINDLE_STEPS_PER_REV * 256.0 / 60.0;
+}
+
+// Steps towards t_q8, keeping the time the periods add up to and checking
+// each step's acceleration against the limit. The ramp moves on over the
+// exact period of the speed (the one emitted is dithered to whole ticks), so
+// that is what the acceleration is taken over.
+struct RampRun {
+    SpindleRamp &ramp;
+    double accel;
+    double seconds = 0.0;
+    uint64_t steps = 0;
+
+    RampRun(SpindleRamp &r, int32_t accel_rpm_per_sec) : ramp(r), accel(accelQ8(accel_rpm_per_sec)) {}
+
+    uint32_t step(uint32_t t_q8) {
+        const uint32_t v0 = ramp.speed();
+        const uint32_t period = ramp.next(t_q8);
+        TEST_ASSERT_TRUE(period >= SpindleRamp::MIN_PERIOD_TICKS && period <= SpindleRamp::MAX_PERIOD_TICKS);
+        const double dv = (double)ramp.speed() - (double)v0;
+        TEST_ASSERT_TRUE(fabs(dv) <= accel * 256.0 / v0 + 1.0);
+        seconds += (double)period / SpindleRamp::RES_HZ;
+        steps++;
+        return period;
+    }
+
+    void to(uint32_t t_q8, uint64_t max_steps) {
+        for (uint64_t i = 0; i < max_steps && ramp.speed() != t_q8; i++) step(t_q8);
+    }
+};
+
+// 0 to 3000 RPM takes 3000 / SPINDLE_ACCEL_RPM_PER_SEC seconds, whatever
+// the speed; back down to the start/stop speed as long again
+static void test_ramp_trapezoid_timing(void) {
+    SpindleRamp ramp(SPINDLE_ACCEL_RPM_PER_SEC, 0);
+    ramp.start();
+    RampRun run(ramp, SPINDLE_ACCEL_RPM_PER_SEC);
+    const uint32_t top = rpmQ8(SPINDLE_MAX_RPM);
+    run.to(top, 10000000);
+    TEST_ASSERT_EQUAL_UINT32(top, ramp.speed());
+    const double want = (double)(top - SpindleRamp::V_MIN_Q8) / accelQ8(SPINDLE_ACCEL_RPM_PER_SEC);
+    TEST_ASSERT_TRUE(fabs(run.seconds - want) <= want * 0.005);
+
+    RampRun down(ramp, SPINDLE_ACCEL_RPM_PER_SEC);
+    down.to(SpindleRamp::V_MIN_Q8, 10000000);
+    TEST_ASSERT_EQUAL_UINT32(SpindleRamp::V_MIN_Q8, ramp.speed());
+    TEST_ASSERT_TRUE(fabs(down.seconds - want) <= want * 0.005);
+}
+
+// S-curve: the acceleration builds at the jerk rate rather than at once,
+// stays within the limit, and the speed settles on each target
+static void test_ramp_s_curve(void) {
+    SpindleRamp ramp(SPINDLE_ACCEL_RPM_PER_SEC, S_CURVE_JERK);
+    ramp.start();
+    RampRun run(ramp, SPINDLE_ACCEL_RPM_PER_SEC);
+    run.to(rpmQ8(100), 10000000);
+    const uint32_t targets[] = { rpmQ8(SPINDLE_MAX_RPM), rpmQ8(100), rpmQ8(1500), SpindleRamp::V_MIN_Q8 };
+    for (uint32_t t_q8 : targets) {
+        // The first 20 ms gain about jerk * t^2 / 2, not accel * t
+        const double t0 = run.seconds;
+        const double v0 = ramp.speed();
+        while (run.seconds - t0 < 0.02) run.step(t_q8);
+        const double dt = run.seconds - t0;
+        TEST_ASSERT_TRUE(fabs(ramp.speed() - v0) <= 0.5 * accelQ8(S_CURVE_JERK) * dt * dt * 1.1);
+        run.to(t_q8, 10000000);
+        TEST_ASSERT_EQUAL_UINT32(t_q8, ramp.speed());
+        // And stays there
+        for (int i = 0; i < 100; i++) {
+            run.step(t_q8);
+            TEST_ASSERT_EQUAL_UINT32(t_q8, ramp.speed());
+        }
+    }
+}
+
+// The period's fraction is carried: any speed averages out exact
+static void test_ramp_average_rate(void) {
+    SpindleRamp ramp(SPINDLE_ACCEL_RPM_PER_SEC, 0);
+    const uint32_t targets[] = { 316049 /* 1234.5664 steps/s */, rpmQ8(1), rpmQ8(SPINDLE_MAX_RPM), 0 };
+    for (uint32_t t_q8 : targets) {
+        if (t_q8 == 0) t_q8 = nextRand(SpindleRamp::V_MIN_Q8, SpindleRamp::V_MAX_Q8);
+        ramp.start();
+        RampRun run(ramp, SPINDLE_ACCEL_RPM_PER_SEC);
+        run.to(t_q8, 10000000);
+        uint64_t ticks = 0;
+        const uint64_t steps = (uint64_t)t_q8 * 10 / 256 + 1;  // About 10 s
+        for (uint64_t i = 0; i < steps; i++) ticks += run.step(t_q8);
+        const double rate = (double)steps * SpindleRamp::RES_HZ / (double)ticks;
+        TEST_ASSERT_TRUE(fabs(rate - t_q8 / 256.0) <= t_q8 / 256.0 * 1e-6 + 1.0 / 10.0 / 10.0);
+    }
+}
+
+// rampDownSteps() is what the generator needs to get from a speed back to
+// the start/stop speed; without jerk, not much more (the S-curve term is
+// only exact once the speed is past accel^2 / jerk, and more below)
+static void test_ramp_down_steps(void) {
+    const int32_t jerks[] = { 0, S_CURVE_JERK };
+    for (int32_t jerk : jerks) {
+        for (int32_t rpm = 1; rpm <= SPINDLE_MAX_RPM; rpm += 97) {
+            SpindleRamp ramp(SPINDLE_ACCEL_RPM_PER_SEC, jerk);
+            ramp.start();
+            RampRun run(ramp, SPINDLE_ACCEL_RPM_PER_SEC);
+            run.to(rpmQ8(rpm), 10000000);
+            // Settled (S-curve: no acceleration left in hand)
+            for (int i = 0; i < 10; i++) run.step(rpmQ8(rpm));
+            const uint32_t need = ramp.rampDownSteps(ramp.speed());
+            RampRun down(ramp, SPINDLE_ACCEL_RPM_PER_SEC);
+            down.to(SpindleRamp::V_MIN_Q8, 10000000);
+            TEST_ASSERT_TRUE(down.steps <= need);
+            if (jerk == 0) TEST_ASSERT_TRUE(need <= down.steps + down.steps / 100 + 5);
+        }
+    }
+}
+
+// The generator's thread-end stop: the target held to stopSpeed() of the
+// steps left (never below the start/stop speed), ending after the last
+// one. Armed from any speed with at least rampDownSteps() to go, it brakes
+// within the limits onto the last pulse. Without jerk the per-step ramp
+// trails the stop curve over the very last steps, so that pulse goes out
+// within a few steps' braking of rest (about 12 RPM at the configured
+// limit) rather than at the start/stop speed.
+static void test_ramp_stop_lands_on_last_pulse(void) {
+    const int32_t jerks[] = { 0, S_CURVE_JERK };
+    for (int32_t jerk : jerks) {
+        for (int i = 0; i < 60; i++) {
+            SpindleRamp ramp(SPINDLE_ACCEL_RPM_PER_SEC, jerk);
+            ramp.start();
+            RampRun run(ramp, SPINDLE_ACCEL_RPM_PER_SEC);
+            const uint32_t t_q8 = nextRand(SpindleRamp::V_MIN_Q8, rpmQ8(SPINDLE_MAX_RPM));
+            run.to(t_q8, 10000000);
+            run.step(t_q8);
+            // Anywhere from just enough room to a long way off
+            const uint32_t need = ramp.rampDownSteps(ramp.speed());
+            uint32_t left = need + ((i % 4 == 0) ? 0 : nextRand(0, 4 * need));
+            while (left != 0) {
+                uint32_t cap = ramp.stopSpeed(left);
+                if (cap < SpindleRamp::V_MIN_Q8) cap = SpindleRamp::V_MIN_Q8;
+                run.step((t_q8 > cap) ? cap : t_q8);
+                left--;
+            }
+            TEST_ASSERT_TRUE(ramp.speed() <= ramp.stopSpeed(5));
+        }
+    }
+}
+
+// stopSpeed() and rampDownSteps() agree: the speed for a distance ramps
+// down within it, and a speed's ramp-down distance allows at least that
+// speed. Past a full stop's distance it is full speed.
+static void test_ramp_stop_speed(void) {
+    SpindleRamp ramp(SPINDLE_ACCEL_RPM_PER_SEC, 0);
+    ramp.start();
+    const uint32_t full = ramp.rampDownSteps(SpindleRamp::V_MAX_Q8);
+    TEST_ASSERT_EQUAL_UINT32(SpindleRamp::V_MAX_Q8, ramp.stopSpeed(full));
+    TEST_ASSERT_EQUAL_UINT32(SpindleRamp::V_MAX_Q8, ramp.stopSpeed(UINT32_MAX));
+    uint32_t last = 0;
+    for (uint32_t d = 0; d < full; d += 1 + d / 64) {
+        const uint32_t v = ramp.stopSpeed(d);
+        TEST_ASSERT_TRUE(v >= last);
+        TEST_ASSERT_TRUE(ramp.rampDownSteps(v) <= d + 5);
+        last = v;
+    }
+    for (uint32_t v = SpindleRamp::V_MIN_Q8; v < SpindleRamp::V_MAX_Q8; v += 9973) {
+        TEST_ASSERT_TRUE(ramp.stopSpeed(ramp.rampDownSteps(v)) >= v);
+    }
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_ramp_trapezoid_timing);
+    RUN_TEST(test_ramp_s_curve);
+    RUN_TEST(test_ramp_average_rate);
+    RUN_TEST(test_ramp_down_steps);
+    RUN_TEST(test_ramp_stop_lands_on_last_pulse);
+    RUN_TEST(test_ramp_stop_speed);
+    return UNITY_END();
+}
@@ -0,0 +1,176 @@
+#include <unity.h>
+#include <math.h>
+#include "spindle_rate.h"
+#include "config_motion.h"
+
+// ============================================================================
+// SpindleRate against a synthetic spindle: a true (real-valued) count, the
+// speed event unit reaching +/-SPINDLE_RATE_EVENT_COUNTS from its last event
+// and stamping the exact count with the esp_timer microsecond it happened
+// in. The motion task feeds the newest event every 1 ms tick. The clock
+// and the count start just short of their 32-bit wraps.
+// ============================================================================
+
+static constexpr uint32_t TICK_US = 1000;
+
+static uint32_t rng = 1;
+static uint32_t nextRand(uint32_t lo, uint32_t hi) {
+    rng = rng * 1664525u + 1013904223u;
+    return lo + (rng >> 8) % (hi - lo + 1);
+}
+
+void setUp(void) { rng = 1; }
+void tearDown(void) {}
+
+static double countsPerUs(double rpm) {
+    return rpm * C_COUNTS_PER_REV / 60.0 / 1e6;
+}
+
+struct Spindle {
+    SpindleRate rate;
+    double pos = 0.0;            // True count since the start
+    int32_t count0 = INT32_MAX - 100000;
+    uint32_t t_us = 0xFFFFFFFFu - 3000000;
+    int32_t ev = 0;              // Count of the newest event, from count0
+    uint32_t ev_us = 0;
+    bool seen = false;
+
+    // Runs for ticks motion ticks, the speed (counts/us) a function of the
+    // time since the start of this run; after each tick calls check()
+    template <typename Speed, typename Check>
+    void run(int ticks, Speed cpus, Check check) {
+        uint32_t us = 0;
+        for (int i = 0; i < ticks; i++) {
+            for (uint32_t j = 0; j < TICK_US; j++, us++) {
+                pos += cpus(us);
+                t_us++;
+                // One event per microsecond at most: 16 counts take over
+                // 200 us at 3000 RPM
+                if (pos >= ev + SPINDLE_RATE_EVENT_COUNTS) ev += SPINDLE_RATE_EVENT_COUNTS;
+                else if (pos <= ev - SPINDLE_RATE_EVENT_COUNTS) ev -= SPINDLE_RATE_EVENT_COUNTS;
+                else continue;
+                ev_us = t_us;
+                seen = true;
+            }
+            if (seen) rate.update((int32_t)((uint32_t)count0 + (uint32_t)ev), ev_us, t_us);
+            check(i);
+        }
+    }
+
+    template <typename Speed>
+    void run(int ticks, Speed cpus) {
+        run(ticks, cpus, [](int) {});
+    }
+};
+
+// Constant speed, either way, 2 to 3000 RPM: once the window is full the
+// speed is the true one to within the microsecond stamps over the window,
+// and below 60 RPM the window is long enough to make that 0.01%
+static void test_rate_constant_speed(void) {
+    const double rpms[] = { 2, 10, 30, 60, 300, 1000, 3000 };
+    for (double rpm : rpms) {
+        for (int d = -1; d <= 1; d += 2) {
+            Spindle s;
+            const double v = d * countsPerUs(rpm);
+            s.pos = nextRand(0, 15) + 0.5;
+            s.ev = (int32_t)floor(s.pos);
+            s.run(1500, [v](uint32_t) { return v; });
+            const double want = d * rpm * 1000.0;
+            const double got = s.rate.getMilliRpm();
+            const double tol = (rpm <= 60) ? 1e-4 : 1e-3;
+            TEST_ASSERT_TRUE(fabs(got - want) <= fabs(want) * tol + 1.0);
+            TEST_ASSERT_TRUE(fabs(s.rate.getRpmPerSec()) <= 1);
+        }
+    }
+}
+
+// The window: about SPINDLE_RATE_MIN_US at speed, and grown at low RPM
+// until it spans SPINDLE_RATE_MIN_COUNTS (two events: the first pair to
+// reach 32 counts), never past SPINDLE_RATE_MAX_US: under ~3 RPM it
+// takes the oldest event inside that
+static void test_rate_window_grows(void) {
+    const double rpms[] = { 3000, 300, 30, 5, 2 };
+    uint32_t prev = 0;
+    for (double rpm : rpms) {
+        Spindle s;
+        const double v = countsPerUs(rpm);
+        s.run(2000, [v](uint32_t) { return v; });
+        const uint32_t w = s.rate.getWindowUs();
+        const double event_us = SPINDLE_RATE_EVENT_COUNTS / v;
+        const double want = fmin(fmax(SPINDLE_RATE_MIN_US, SPINDLE_RATE_MIN_COUNTS / v),
+                                 SPINDLE_RATE_MAX_US - event_us);
+        TEST_ASSERT_TRUE(w >= want - 1.0);
+        TEST_ASSERT_TRUE(w <= want + event_us + 1.0);
+        TEST_ASSERT_TRUE(w <= SPINDLE_RATE_MAX_US);
+        TEST_ASSERT_TRUE(w >= prev);
+        prev = w;
+    }
+}
+
+// The spindle stopped dead from 600 RPM: no event comes, and the speed is
+// held to at most one event's counts over the time since the last one, so
+// it falls as 1/t; no event pair inside SPINDLE_RATE_MAX_US reads zero
+static void test_rate_capped_after_last_event(void) {
+    Spindle s;
+    const double v = countsPerUs(600);
+    s.run(500, [v](uint32_t) { return v; });
+    TEST_ASSERT_TRUE(s.rate.getMilliCountsPerSec() > 0);
+    const uint32_t last_us = s.ev_us;
+    s.run(700, [](uint32_t) { return 0.0; }, [&](int) {
+        const uint32_t since = s.t_us - last_us;
+        const int64_t got = s.rate.getMilliCountsPerSec();
+        TEST_ASSERT_TRUE(got >= 0);
+        TEST_ASSERT_TRUE(got <= (int64_t)SPINDLE_RATE_EVENT_COUNTS * 1000000000LL / since + 1);
+        if (since > SPINDLE_RATE_MAX_US) TEST_ASSERT_EQUAL_INT32(0, got);
+    });
+    TEST_ASSERT_EQUAL_INT32(0, s.rate.getMilliRpm());
+    TEST_ASSERT_EQUAL_INT32(0, s.rate.getRpmPerSec());
+}
+
+// The stopped threshold: turning slower than one event pair inside
+// SPINDLE_RATE_MAX_US (under ~1.2 RPM) reads stopped, just over it reads
+// the speed
+static void test_rate_stopped_threshold(void) {
+    Spindle slow;
+    const double v_slow = countsPerUs(1.0);
+    slow.run(5000, [v_slow](uint32_t) { return v_slow; });
+    TEST_ASSERT_EQUAL_INT32(0, slow.rate.getMilliRpm());
+
+    Spindle fast;
+    const double v_fast = countsPerUs(1.5);
+    int nonzero = 0;
+    fast.run(5000, [v_fast](uint32_t) { return v_fast; }, [&](int i) {
+        if (i >= 1000 && fast.rate.getMilliRpm() > 0) nonzero++;
+    });
+    // Late in each event gap the cap brings it down, never to zero
+    TEST_ASSERT_EQUAL_INT32(4000, nonzero);
+}
+
+// A steady ramp, up and down: the acceleration settles on the true one,
+// and the speed extrapolated to now with it lands on the true speed
+static void test_rate_acceleration(void) {
+    const double accels[] = { 200.0, -200.0, 1000.0 };
+    for (double rpm_per_s : accels) {
+        Spindle s;
+        const double v0 = countsPerUs(rpm_per_s > 0 ? 100 : 2000);
+        const double a = countsPerUs(rpm_per_s) / 1e6;  // counts/us^2
+        s.run(200, [v0](uint32_t) { return v0; });
+        s.run(1500, [v0, a](uint32_t us) { return v0 + a * us; }, [&](int i) {
+            if (i < 300) return;
+            TEST_ASSERT_TRUE(fabs(s.rate.getRpmPerSec() - rpm_per_s) <= fabs(rpm_per_s) * 0.05 + 1);
+            const double want = (v0 + a * (i + 1) * TICK_US) * 1e6;
+            const double got = s.rate.getCountsPerSecAt(s.t_us);
+            TEST_ASSERT_TRUE(fabs(got - want) <= want * 0.005 + 2);
+        });
+    }
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_rate_constant_speed);
+    RUN_TEST(test_rate_window_grows);
+    RUN_TEST(test_rate_capped_after_last_event);
+    RUN_TEST(test_rate_stopped_threshold);
+    RUN_TEST(test_rate_acceleration);
+    return UNITY_END();
+}
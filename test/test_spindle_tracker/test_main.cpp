@@ -0,0 +1,161 @@
+#include <unity.h>
+#include <math.h>
+#include "spindle_tracker.h"
+#include "config_motion.h"
+
+// ============================================================================
+// SpindleTracker against a synthetic spindle: a true (real-valued) count,
+// floored to the integer count a 32-bit counter would show, sampled once per
+// 1 kHz motion tick. Interpolated positions must stay within the count's
+// quantization of the truth, and the raw counter may wrap anywhere.
+// ============================================================================
+
+static constexpr uint32_t TICK_US = 1000;
+// Ticks the filter is given to settle after a start or a speed change
+static constexpr int SETTLE_TICKS = 200;
+
+static uint32_t rng = 1;
+static uint32_t nextRand(uint32_t lo, uint32_t hi) {
+    rng = rng * 1664525u + 1013904223u;
+    return lo + (rng >> 8) % (hi - lo + 1);
+}
+
+void setUp(void) { rng = 1; }
+void tearDown(void) {}
+
+static double countsPerUs(double rpm) {
+    return rpm * C_COUNTS_PER_REV / 60.0 / 1e6;
+}
+
+// Raw counter for a true count, starting from raw0 and wrapping at 32 bits
+static int32_t rawFor(int32_t raw0, double truth) {
+    return (int32_t)((uint32_t)raw0 + (uint32_t)(int64_t)floor(truth));
+}
+
+// Constant speed from 1 to 3000 RPM, read back at random instants up to one
+// tick past the last sample: within half a count of the truth (the count is
+// taken as the middle of its interval) plus a small filter margin
+static void test_tracker_interpolates(void) {
+    const double rpms[] = { 1, 10, 60, 300, 1000, 3000 };
+    for (double rpm : rpms) {
+        SpindleTracker tracker;
+        const double rate = countsPerUs(rpm);
+        const double phase = nextRand(0, 65535) / 65536.0;
+        double worst = 0;
+        for (int i = 0; i < 4000; i++) {
+            const uint32_t t = i * TICK_US;
+            tracker.update(rawFor(0, phase + rate * t), t);
+            if (i < SETTLE_TICKS) continue;
+            const uint32_t at = t + nextRand(0, TICK_US);
+            const double got = tracker.positionAt(at) / 65536.0;
+            const double err = fabs(got - (phase + rate * at));
+            if (err > worst) worst = err;
+        }
+        TEST_ASSERT_TRUE(worst <= 0.55);
+    }
+}
+
+// The filtered velocity settles on the true rate
+static void test_tracker_velocity(void) {
+    const double rpms[] = { 30, 300, 3000 };
+    for (double rpm : rpms) {
+        SpindleTracker tracker;
+        const double rate = countsPerUs(rpm);
+        for (int i = 0; i < 2000; i++) {
+            tracker.update(rawFor(0, rate * i * TICK_US), i * TICK_US);
+        }
+        const double want = rate * 1e6;
+        TEST_ASSERT_TRUE(fabs(tracker.getCountsPerSec() - want) <= want * 0.01 + 1);
+    }
+}
+
+// Through the counter's wrap at 2^31 and 2^32, either way: the unwrapped
+// count carries straight on and the filter never restarts
+static void test_tracker_unwraps(void) {
+    const int32_t starts[] = { INT32_MAX - 40000, -40000 };
+    for (int32_t raw0 : starts) {
+        for (int d = -1; d <= 1; d += 2) {
+            SpindleTracker tracker;
+            const double rate = d * countsPerUs(3000);
+            int64_t last = 0;
+            for (int i = 0; i < 1000; i++) {
+                const uint32_t t = i * TICK_US;
+                const double truth = rate * t;
+                const int32_t raw = rawFor(raw0, truth);
+                tracker.update(raw, t);
+                const int64_t count = tracker.unwrap(raw);
+                if (i == 0) {
+                    last = count;
+                    continue;
+                }
+                TEST_ASSERT_EQUAL_INT64((int64_t)floor(truth) - (int64_t)floor(rate * (t - TICK_US)), count - last);
+                last = count;
+                if (i >= SETTLE_TICKS) {
+                    const double got = tracker.positionAt(t) / 65536.0 - (double)(count - (int64_t)floor(truth));
+                    TEST_ASSERT_TRUE(fabs(got - truth) <= 0.55);
+                }
+            }
+        }
+    }
+}
+
+// A jump past SPINDLE_TRACK_RESET_COUNTS (an MPG C jog) is taken at once
+// instead of being filtered in
+static void test_tracker_resets_on_jump(void) {
+    SpindleTracker tracker;
+    const double rate = countsPerUs(100);
+    uint32_t t = 0;
+    for (int i = 0; i < 500; i++, t += TICK_US) tracker.update(rawFor(0, rate * t), t);
+    const int32_t jump = 5 * SPINDLE_TRACK_RESET_COUNTS;
+    const int32_t raw = rawFor(0, rate * t) + jump;
+    tracker.update(raw, t);
+    TEST_ASSERT_EQUAL_INT64(((int64_t)raw << 16) + 32768, tracker.positionAt(t));
+}
+
+// shift() moves the position by exactly the counts, and leaves the speed
+static void test_tracker_shift(void) {
+    SpindleTracker tracker;
+    const double rate = countsPerUs(500);
+    uint32_t t = 0;
+    for (int i = 0; i < 500; i++, t += TICK_US) tracker.update(rawFor(0, rate * t), t);
+    t -= TICK_US;
+    const int64_t before = tracker.positionAt(t + 300);
+    const int32_t speed = tracker.getCountsPerSec();
+    const int32_t counts[] = { 1, -1, 800, -1600 };
+    int64_t moved = 0;
+    for (int32_t c : counts) {
+        tracker.shift(c);
+        moved += c;
+        TEST_ASSERT_EQUAL_INT64(before + (moved << 16), tracker.positionAt(t + 300));
+        TEST_ASSERT_EQUAL_INT32(speed, tracker.getCountsPerSec());
+    }
+    // The next sample, shifted the same way, is no jump
+    const int32_t raw = rawFor(0, rate * (t + TICK_US)) + (int32_t)moved;
+    tracker.update(raw, t + TICK_US);
+    TEST_ASSERT_TRUE(llabs(tracker.positionAt(t + TICK_US) - (((int64_t)raw << 16) + 32768)) < 65536);
+}
+
+// Prediction stops SPINDLE_TRACK_MAX_EXTRAP_US past the last sample
+static void test_tracker_extrapolation_capped(void) {
+    SpindleTracker tracker;
+    const double rate = countsPerUs(1000);
+    uint32_t t = 0;
+    for (int i = 0; i < 500; i++, t += TICK_US) tracker.update(rawFor(0, rate * t), t);
+    t -= TICK_US;
+    const int64_t cap = tracker.positionAt(t + SPINDLE_TRACK_MAX_EXTRAP_US);
+    TEST_ASSERT_TRUE(cap > tracker.positionAt(t + SPINDLE_TRACK_MAX_EXTRAP_US - 100));
+    TEST_ASSERT_EQUAL_INT64(cap, tracker.positionAt(t + 10 * SPINDLE_TRACK_MAX_EXTRAP_US));
+    TEST_ASSERT_EQUAL_INT64(tracker.positionAt(t - SPINDLE_TRACK_MAX_EXTRAP_US),
+                            tracker.positionAt(t - 10 * SPINDLE_TRACK_MAX_EXTRAP_US));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_tracker_interpolates);
+    RUN_TEST(test_tracker_velocity);
+    RUN_TEST(test_tracker_unwraps);
+    RUN_TEST(test_tracker_resets_on_jump);
+    RUN_TEST(test_tracker_shift);
+    RUN_TEST(test_tracker_extrapolation_capped);
+    return UNITY_END();
+}
@@ -0,0 +1,233 @@
+#include <unity.h>
+#include "step_queue.h"
+#include "step_symbols.h"
+#include "config_motion.h"
+
+// ============================================================================
+// StepQueue as Stepper drives it: producers push signed batches, and the
+// encoder pops them into StepSymbols and writes the symbols to a model RMT
+// channel. The channel holds ELS_RMT_MEM_SYMBOLS symbols, plays them out one
+// at a time, and asks for a refill each time half of them have gone
+// (ping-pong), the way the TX interrupt does. The backlog must never drop
+// before a step has really gone out.
+// ============================================================================
+
+static constexpr uint32_t MEM = ELS_RMT_MEM_SYMBOLS;
+
+static uint32_t rng = 1;
+static uint32_t nextRand(uint32_t lo, uint32_t hi) {
+    rng = rng * 1664525u + 1013904223u;
+    return lo + (rng >> 8) % (hi - lo + 1);
+}
+
+void setUp(void) { rng = 1; }
+void tearDown(void) {}
+
+struct Channel {
+    StepQueue q;
+    StepSymbols gen;
+    bool busy = false;
+    bool forward = true;
+    bool encoder_done = false;
+    bool mem[MEM] = {};        // Symbols waiting to play out: true for a step
+    uint32_t first = 0;
+    uint32_t count = 0;
+    uint32_t played = 0;       // Since the last refill
+    int64_t accepted = 0;      // Steps the queue took
+    int64_t out = 0;           // Steps played out
+
+    int32_t push(int32_t n, uint32_t span) {
+        const int32_t a = q.push(n, span);
+        accepted += (a < 0) ? -a : a;
+        return a;
+    }
+
+    // Stepper's next_segment(): stops at a change of direction
+    bool nextSegment() {
+        if (q.empty()) return false;
+        const StepQueue::Segment &seg = q.front();
+        if ((seg.steps > 0) != forward) return false;
+        gen.segment((uint32_t)((seg.steps < 0) ? -seg.steps : seg.steps), seg.span_ticks);
+        q.pop();
+        return true;
+    }
+
+    // Stepper's encode_steps() with symbols_free of the memory free
+    void encode(uint32_t symbols_free) {
+        q.sent(symbols_free);
+        uint32_t n = 0;
+        StepSymbols::Symbol sym;
+        while (n < symbols_free) {
+            if (!gen.next(sym)) {
+                if (!nextSegment()) {
+                    encoder_done = true;
+                    break;
+                }
+                continue;
+            }
+            q.written(sym.step);
+            mem[(first + count) % MEM] = sym.step;
+            count++;
+            n++;
+        }
+    }
+
+    // Stepper::kick()
+    void kick() {
+        if (busy || q.empty()) return;
+        busy = true;
+        forward = q.front().steps > 0;
+        encoder_done = false;
+        gen.begin();
+        q.begin();
+        played = 0;
+        encode(MEM);
+    }
+
+    // One symbol plays out; refills at half, on_tx_done once empty
+    void play() {
+        if (!busy) return;
+        if (count > 0) {
+            if (mem[first]) out++;
+            first = (first + 1) % MEM;
+            count--;
+            played++;
+        }
+        if (!encoder_done && played == MEM / 2) {
+            played = 0;
+            encode(MEM - count);
+            check(true);
+        } else if (encoder_done && count == 0) {
+            q.done();
+            busy = false;
+            kick();
+        }
+        check(false);
+    }
+
+    // Never early, and late by no more than the memory held at the last
+    // refill; at a refill or with the channel idle, exact
+    void check(bool exact) {
+        const int64_t unsent = accepted - out;
+        TEST_ASSERT_TRUE(q.backlog() >= unsent);
+        TEST_ASSERT_TRUE(q.backlog() <= ELS_STEP_QUEUE_MAX_STEPS);
+        TEST_ASSERT_TRUE(q.backlog() - unsent <= MEM);
+        if (exact || !busy) TEST_ASSERT_EQUAL_INT64(unsent, q.backlog());
+    }
+
+    void drain() {
+        for (int i = 0; i < 10000000 && (busy || !q.empty()); i++) {
+            play();
+            kick();
+        }
+        TEST_ASSERT_FALSE(busy);
+    }
+};
+
+// Segments come out in order, with their sign and span; a full accept is
+// no overload
+static void test_queue_order(void) {
+    StepQueue q;
+    const int32_t counts[] = { 5, -3, 1, 40, -40 };
+    for (int32_t c : counts) TEST_ASSERT_EQUAL_INT32(c, q.push(c, 1000 + c));
+    TEST_ASSERT_EQUAL_INT32(89, q.backlog());
+    TEST_ASSERT_EQUAL_UINT32(0, q.overloads());
+    TEST_ASSERT_EQUAL_INT32(0, q.push(0, 0));
+    TEST_ASSERT_EQUAL_UINT32(0, q.overloads());
+    for (int32_t c : counts) {
+        TEST_ASSERT_FALSE(q.empty());
+        TEST_ASSERT_EQUAL_INT32(c, q.front().steps);
+        TEST_ASSERT_EQUAL_UINT32(1000 + c, q.front().span_ticks);
+        q.pop();
+    }
+    TEST_ASSERT_TRUE(q.empty());
+    // Popped is not out: the backlog waits for the channel
+    TEST_ASSERT_EQUAL_INT32(89, q.backlog());
+}
+
+// Past ELS_STEP_QUEUE_MAX_STEPS only the room is taken, at the same step
+// spacing; with no room, or the ring full, nothing. Each short call is one
+// overload.
+static void test_queue_partial_and_overload(void) {
+    StepQueue q;
+    const int32_t first = ELS_STEP_QUEUE_MAX_STEPS - 100;
+    TEST_ASSERT_EQUAL_INT32(first, q.push(first, 0));
+    TEST_ASSERT_EQUAL_INT32(-100, q.push(-250, 5000));
+    TEST_ASSERT_EQUAL_UINT32(1, q.overloads());
+    q.pop();
+    TEST_ASSERT_EQUAL_INT32(-100, q.front().steps);
+    TEST_ASSERT_EQUAL_UINT32(2000, q.front().span_ticks);
+    TEST_ASSERT_EQUAL_INT32(ELS_STEP_QUEUE_MAX_STEPS, q.backlog());
+    TEST_ASSERT_EQUAL_INT32(0, q.push(7, 100));
+    TEST_ASSERT_EQUAL_UINT32(2, q.overloads());
+
+    // The ring full before the steps are
+    StepQueue r;
+    for (uint32_t i = 0; i < ELS_STEP_QUEUE_LEN; i++) TEST_ASSERT_EQUAL_INT32(1, r.push(1, 10));
+    TEST_ASSERT_EQUAL_INT32(0, r.push(1, 10));
+    TEST_ASSERT_EQUAL_UINT32(1, r.overloads());
+    r.pop();
+    TEST_ASSERT_EQUAL_INT32(-1, r.push(-1, 10));
+    TEST_ASSERT_EQUAL_UINT32(1, r.overloads());
+}
+
+// One batch through the channel: the backlog stays up until the last
+// step has played out, not until it was encoded
+static void test_queue_backlog_until_out(void) {
+    Channel ch;
+    TEST_ASSERT_EQUAL_INT32(300, ch.push(300, 300 * 50));
+    ch.kick();
+    bool encoded_all = false;
+    while (ch.busy) {
+        if (ch.q.empty() && ch.gen.stepsLeft() == 0 && ch.out < 300) {
+            // All encoded, some still in channel memory: still backlog
+            encoded_all = true;
+            TEST_ASSERT_TRUE(ch.q.backlog() > 0);
+        }
+        ch.play();
+    }
+    TEST_ASSERT_TRUE(encoded_all);
+    TEST_ASSERT_EQUAL_INT64(300, ch.out);
+    TEST_ASSERT_EQUAL_INT32(0, ch.q.backlog());
+}
+
+// Producers push random batches, both ways, into a queue the channel is
+// draining, overloading it now and then: the backlog follows what has not
+// gone out, every step accepted goes out once, and nothing more
+static void test_queue_random_stream(void) {
+    Channel ch;
+    int64_t wanted = 0;
+    int32_t dir = 1;
+    uint32_t overloads = 0;
+    for (int i = 0; i < 20000; i++) {
+        if (nextRand(0, 15) == 0) dir = -dir;
+        const int32_t n = dir * (int32_t)nextRand(1, (i % 500 < 50) ? 400 : 40);
+        const uint32_t span = nextRand(0, 3) == 0 ? 0 : nextRand(1, 2000);
+        const uint32_t before = ch.q.overloads();
+        const int32_t a = ch.push(n, span);
+        TEST_ASSERT_TRUE((a == 0 || (a > 0) == (n > 0)) && (a < 0 ? -a : a) <= (n < 0 ? -n : n));
+        if (a != n) {
+            TEST_ASSERT_EQUAL_UINT32(before + 1, ch.q.overloads());
+            overloads++;
+        }
+        wanted += (n < 0) ? -n : n;
+        ch.kick();
+        const uint32_t plays = nextRand(0, 60);
+        for (uint32_t j = 0; j < plays; j++) ch.play();
+    }
+    ch.drain();
+    TEST_ASSERT_TRUE(overloads > 0);
+    TEST_ASSERT_EQUAL_UINT32(overloads, ch.q.overloads());
+    TEST_ASSERT_TRUE(ch.accepted < wanted);
+    TEST_ASSERT_EQUAL_INT64(ch.accepted, ch.out);
+    TEST_ASSERT_EQUAL_INT32(0, ch.q.backlog());
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_queue_order);
+    RUN_TEST(test_queue_partial_and_overload);
+    RUN_TEST(test_queue_backlog_until_out);
+    RUN_TEST(test_queue_random_stream);
+    return UNITY_END();
+}
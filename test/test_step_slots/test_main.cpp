@@ -0,0 +1,268 @@
+#include <unity.h>
+#include "step_slots.h"
+#include "els_gear.h"
+#include "config_motion.h"
+
+// ============================================================================
+// StepSlots as SpindleStepper and Stepper drive it under ELS_DRIVE_COUPLED.
+// A spindle stream encodes slots a channel's worth ahead of its pulses; the
+// ELS hands it the gear mid-stream, and a Z stream pulls the same slots a
+// step at a time, its channel ahead of the spindle by a few slots. Sessions
+// end every way ElsCore ends them: a decouple that lets Z run out, a
+// decouple and an abort (endstop), or the spindle stream ending (stop).
+// Across all of them, every step the gear gave is either in Z's position or
+// owed back to the ELS.
+// ============================================================================
+
+static constexpr int64_t SUBCOUNTS_PER_STEP = 1 << ELS_SUBCOUNT_BITS;
+static constexpr uint32_t SPINDLE_AHEAD = 48;  // Slots the spindle channel holds
+static constexpr uint32_t Z_AHEAD = 6;         // Slots the Z channel runs ahead
+
+static uint32_t rng = 1;
+static uint32_t nextRand(uint32_t lo, uint32_t hi) {
+    rng = rng * 1664525u + 1013904223u;
+    return lo + (rng >> 8) % (hi - lo + 1);
+}
+
+void setUp(void) { rng = 1; }
+void tearDown(void) {}
+
+struct Rig {
+    StepSlots slots;
+    ElsGear gear;
+
+    // Spindle stream
+    bool busy = false;         // tx_busy
+    bool ended = false;        // End slot generated
+    bool forward = true;
+    uint32_t left = 0;         // Steps before the end slot
+    uint32_t encoded = 0;      // Slots the spindle took this stream
+    uint32_t out = 0;          // Pulses out this stream
+    bool spindle_done = false; // Took the end slot
+    uint32_t counted = 0xFFFFFF00u;  // Pulse counter, wraps
+    int64_t count_pos = 0;     // The same, unwrapped
+
+    // Z stream (Stepper's coupled encoder)
+    bool z_on = false;
+    int32_t z_left = 0;        // Steps of the slot being encoded
+    int32_t z_sign = 1;
+    uint32_t z_slots = 0;      // Slots Z took since coupling
+    uint32_t z_pulses = 0;     // Spindle pulses since coupling
+    int64_t emitted = 0;       // Z position: onCoupledEmitted less dropEmitted
+
+    bool generate() {
+        if (ended) return false;
+        if (left == 0) {
+            slots.generate(0, forward);
+            ended = true;
+        } else {
+            slots.generate((uint16_t)nextRand(100, 4000), forward);
+            left--;
+        }
+        return true;
+    }
+
+    void start(uint32_t steps) {
+        forward = nextRand(0, 1) == 1;
+        slots.startStream(counted);
+        busy = true;
+        ended = false;
+        spindle_done = false;
+        left = steps;
+        encoded = 0;
+        out = 0;
+        fillSpindle();
+    }
+
+    void fillSpindle() {
+        while (!spindle_done && encoded < out + SPINDLE_AHEAD) {
+            if (!(slots.spindleReady() || generate())) break;
+            if (slots.takeSpindle() == 0) spindle_done = true;
+            else encoded++;
+        }
+    }
+
+    // The encoder's refill: a few symbols, one per step (a slot with none
+    // still takes one)
+    void fillZ(uint32_t symbols) {
+        while (z_on && symbols > 0) {
+            if (z_left > 0) {
+                z_left--;
+                emitted += z_sign;
+                symbols--;
+                continue;
+            }
+            if (z_slots >= z_pulses + Z_AHEAD) return;
+            int32_t steps = 0;
+            uint32_t period = 0;
+            if (slots.zEnded() || !(slots.zReady() || (busy && generate())) ||
+                !slots.takeZ(steps, period)) {
+                z_on = false;  // Ran out: the channel finishes and goes idle
+                return;
+            }
+            TEST_ASSERT_TRUE(period > 0);
+            TEST_ASSERT_TRUE(steps <= ELS_COUPLED_MAX_STEPS_PER_SLOT && steps >= -ELS_COUPLED_MAX_STEPS_PER_SLOT);
+            z_slots++;
+            z_sign = (steps < 0) ? -1 : 1;
+            z_left = (steps < 0) ? -steps : steps;
+            symbols--;
+        }
+    }
+
+    // One spindle pulse goes out; Z keeps ahead of it as its channel must
+    void tick() {
+        fillZ(nextRand(0, 6));
+        while (z_on && z_slots < z_pulses + 2) fillZ(1);
+        if (busy && out < encoded) {
+            out++;
+            counted += forward ? 1 : -1;
+            count_pos += forward ? 1 : -1;
+            z_pulses++;
+        } else if (busy && spindle_done) {
+            busy = false;  // on_tx_done
+        }
+        fillSpindle();
+    }
+
+    int64_t abort(int32_t &owed) {
+        const int32_t unencoded = z_left * z_sign;
+        z_on = false;
+        z_left = 0;
+        const int32_t unsent = slots.abortZ(counted, forward, unencoded, owed);
+        emitted -= unsent;
+        return unsent;
+    }
+};
+
+// Steps a copy of the gear gives over delta sub-counts
+static int64_t gearSteps(ElsGear &g, int64_t delta) {
+    int64_t steps = 0;
+    while (delta != 0) {
+        const int64_t d = (delta > (1 << 20)) ? (1 << 20) : (delta < -(1 << 20)) ? -(1 << 20) : delta;
+        steps += g.advance((int32_t)d);
+        delta -= d;
+    }
+    return steps;
+}
+
+// Slots come out in order to both streams, each with its own cursor; the
+// end slot ends both
+static void test_slots_two_cursors(void) {
+    Rig r;
+    r.start(100);
+    TEST_ASSERT_EQUAL_UINT32(SPINDLE_AHEAD, r.encoded);
+    TEST_ASSERT_EQUAL_UINT32(SPINDLE_AHEAD, r.slots.ahead() + r.encoded);
+    for (int i = 0; i < 1000 && r.busy; i++) r.tick();
+    TEST_ASSERT_FALSE(r.busy);
+    TEST_ASSERT_EQUAL_UINT32(100, r.out);
+    TEST_ASSERT_EQUAL_UINT32(0, r.slots.ahead());
+    TEST_ASSERT_FALSE(r.slots.spindleReady());
+}
+
+// Many coupled sessions, random ratios (including ones past
+// ELS_COUPLED_MAX_STEPS_PER_SLOT per step, so steps are carried as owed),
+// both directions, every way of ending: the gear's steps over each session
+// are the Z steps emitted plus everything owed back
+static void test_slots_gear_steps_accounted(void) {
+    Rig r;
+    int64_t total_gear = 0;
+    int64_t total_emitted = 0;
+    int64_t total_owed = 0;
+    int aborts = 0;
+    int unsent_seen = 0;
+    int stream_ends = 0;
+    for (int session = 0; session < 3000; session++) {
+        const int64_t den = 1000 * SUBCOUNTS_PER_STEP;
+        const int64_t num = (int64_t)nextRand(1, (session % 4 == 0) ? 6000 : 3000) * (nextRand(0, 1) ? 1 : -1);
+        r.gear.setRatio(num, den, ELS_SUBCOUNT_BITS);
+        r.gear.setPhase((int32_t)nextRand(0, (uint32_t)den - 1));
+
+        r.start(nextRand(60, 600));
+        for (uint32_t i = nextRand(0, 40); i > 0 && r.busy; i--) r.tick();
+        if (!r.busy || r.ended) {
+            while (r.busy) r.tick();
+            continue;
+        }
+
+        // The ELS ran the gear to where the spindle is, a little ahead
+        const int64_t pos0 = (r.count_pos + (int64_t)nextRand(0, 3) * (r.forward ? 1 : -1)) * SUBCOUNTS_PER_STEP;
+        ElsGear shadow = r.gear;
+        r.slots.couple(&r.gear, pos0, r.counted, r.count_pos, r.forward);
+        r.z_on = true;
+        r.z_left = 0;
+        r.z_slots = 0;
+        r.z_pulses = 0;
+        const int64_t emitted0 = r.emitted;
+        r.fillZ(16);
+
+        const uint32_t run = nextRand(0, 400);
+        for (uint32_t i = 0; i < run && r.slots.isCoupled(); i++) r.tick();
+        if (!r.slots.isCoupled()) stream_ends++;
+
+        int64_t pos1 = 0;
+        int32_t owed_dec = 0;
+        r.slots.decouple(pos1, owed_dec);
+        TEST_ASSERT_FALSE(r.slots.isCoupled());
+        int32_t owed_abort = 0;
+        if (nextRand(0, 1) == 0) {
+            for (uint32_t i = nextRand(0, 4); i > 0; i--) r.tick();
+            if (r.z_on) {
+                if (r.abort(owed_abort) != 0) unsent_seen++;
+                aborts++;
+            }
+        }
+        // What is left runs out on Z
+        for (int i = 0; i < 100000 && (r.z_on || r.busy); i++) r.tick();
+        TEST_ASSERT_FALSE(r.z_on);
+        TEST_ASSERT_TRUE(r.slots.zEnded());
+
+        const int64_t given = gearSteps(shadow, pos1 - pos0);
+        TEST_ASSERT_EQUAL_INT32(shadow.getRemainder(), r.gear.getRemainder());
+        const int64_t emitted = r.emitted - emitted0;
+        TEST_ASSERT_EQUAL_INT64(given, emitted + owed_dec + owed_abort);
+        total_gear += given;
+        total_emitted += emitted;
+        total_owed += owed_dec + owed_abort;
+    }
+    TEST_ASSERT_EQUAL_INT64(total_gear, total_emitted + total_owed);
+    TEST_ASSERT_TRUE(aborts > 100);
+    TEST_ASSERT_TRUE(unsent_seen > 50);
+    TEST_ASSERT_TRUE(stream_ends > 20);
+    TEST_ASSERT_TRUE(total_owed != 0);
+}
+
+// An abort right after coupling, before Z took a slot past the one going
+// out: nothing is lost and nothing is dropped twice
+static void test_slots_abort_at_couple(void) {
+    Rig r;
+    for (int k = 0; k < 200; k++) {
+        r.gear.setRatio(3000 + k, 1000 * SUBCOUNTS_PER_STEP, ELS_SUBCOUNT_BITS);
+        r.start(200);
+        for (uint32_t i = nextRand(0, 3); i > 0; i--) r.tick();
+        const int64_t pos0 = r.count_pos * SUBCOUNTS_PER_STEP;
+        ElsGear shadow = r.gear;
+        r.slots.couple(&r.gear, pos0, r.counted, r.count_pos, r.forward);
+        r.z_on = true;
+        r.z_left = 0;
+        r.z_slots = 0;
+        r.z_pulses = 0;
+        const int64_t emitted0 = r.emitted;
+        r.fillZ(nextRand(0, 3));
+        int64_t pos1 = 0;
+        int32_t owed_dec = 0;
+        int32_t owed_abort = 0;
+        r.slots.decouple(pos1, owed_dec);
+        r.abort(owed_abort);
+        TEST_ASSERT_EQUAL_INT64(gearSteps(shadow, pos1 - pos0),
+                                r.emitted - emitted0 + owed_dec + owed_abort);
+        while (r.busy) r.tick();
+    }
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_slots_two_cursors);
+    RUN_TEST(test_slots_gear_steps_accounted);
+    RUN_TEST(test_slots_abort_at_couple);
+    return UNITY_END();
+}
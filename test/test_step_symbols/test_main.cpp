@@ -0,0 +1,188 @@
+#include <unity.h>
+#include "step_symbols.h"
+#include "config_motion.h"
+
+// ============================================================================
+// StepSymbols as Stepper's encoder drives it: every symbol must fit the RMT
+// word, and the steps of a segment must come out spaced over its span
+// ============================================================================
+
+static constexpr uint32_t PULSE = StepSymbols::PULSE_TICKS;
+static constexpr uint32_t MIN_PERIOD = StepSymbols::MIN_PERIOD_TICKS;
+// What Stepper::spanUs() gives the 1 kHz cycle, and its cap, in ticks
+static constexpr uint32_t CYCLE_SPAN = 1000 * ELS_STEP_SPREAD_PCT / 100 * StepSymbols::TICKS_PER_US;
+static constexpr uint32_t MAX_SPAN = ELS_STEP_SPAN_MAX_US * ELS_STEP_SPREAD_PCT / 100 * StepSymbols::TICKS_PER_US;
+// A coupled segment's span: one spindle period, up to the 16-bit slot field
+static constexpr uint32_t Z_TICKS_PER_TICK = ELS_RMT_RES_HZ / SPINDLE_RMT_RES_HZ;
+static constexpr uint32_t MAX_SLOT_SPAN = 0xFFFF * Z_TICKS_PER_TICK;
+
+static uint32_t rng = 1;
+static uint32_t nextRand(uint32_t lo, uint32_t hi) {
+    rng = rng * 1664525u + 1013904223u;
+    return lo + (rng >> 8) % (hi - lo + 1);
+}
+
+void setUp(void) { rng = 1; }
+void tearDown(void) {}
+
+// A symbol the RMT word can hold: 15-bit halves, neither empty
+static void checkSymbol(const StepSymbols::Symbol &sym) {
+    TEST_ASSERT_TRUE(sym.d0 >= 1 && sym.d0 <= StepSymbols::MAX_DURATION);
+    TEST_ASSERT_TRUE(sym.d1 >= 1 && sym.d1 <= StepSymbols::MAX_DURATION);
+    if (sym.step) TEST_ASSERT_EQUAL_UINT32(PULSE, sym.d0);
+}
+
+// Runs one segment out and checks its spacing: each step period (pulse to
+// next pulse, the last one to the segment end) is the span split evenly,
+// or MIN_PERIOD where that is shorter. Returns the ticks it took.
+static uint64_t runSegment(StepSymbols &gen, uint32_t steps, uint32_t span) {
+    gen.segment(steps, span);
+    const uint32_t q = span / steps;
+    uint64_t total = 0;
+    uint64_t period = 0;
+    uint32_t seen = 0;
+    StepSymbols::Symbol sym;
+    while (gen.next(sym)) {
+        checkSymbol(sym);
+        if (sym.step) {
+            if (seen != 0) {
+                TEST_ASSERT_TRUE(period == q || period == q + 1 || (q < MIN_PERIOD && period == MIN_PERIOD));
+            }
+            seen++;
+            period = 0;
+        }
+        period += (uint64_t)sym.d0 + sym.d1;
+        total += (uint64_t)sym.d0 + sym.d1;
+    }
+    TEST_ASSERT_TRUE(period == q || period == q + 1 || (q < MIN_PERIOD && period == MIN_PERIOD));
+    TEST_ASSERT_EQUAL_UINT32(steps, seen);
+    TEST_ASSERT_EQUAL_UINT32(0, gen.stepsLeft());
+    return total;
+}
+
+static uint64_t expectedTicks(uint32_t steps, uint32_t span) {
+    return (span / steps < MIN_PERIOD) ? (uint64_t)steps * MIN_PERIOD : span;
+}
+
+// Batches of the 1 kHz cycle and its longest span: the steps fill the span
+static void test_symbols_cycle_spans(void) {
+    StepSymbols gen;
+    gen.begin();
+    StepSymbols::Symbol sym;
+    TEST_ASSERT_TRUE(gen.next(sym));  // The hold
+    const uint32_t spans[] = { CYCLE_SPAN, MAX_SPAN };
+    for (uint32_t span : spans) {
+        for (uint32_t steps = 1; steps <= span / MIN_PERIOD; steps++) {
+            TEST_ASSERT_EQUAL_UINT64(span, runSegment(gen, steps, span));
+        }
+    }
+}
+
+// More steps than the span has room for: back to back at MIN_PERIOD
+static void test_symbols_short_span_clamps(void) {
+    StepSymbols gen;
+    const uint32_t spans[] = { 0, 1, 7, CYCLE_SPAN };
+    for (uint32_t span : spans) {
+        const uint32_t steps = span / MIN_PERIOD + 50;
+        TEST_ASSERT_EQUAL_UINT64(expectedTicks(steps, span), runSegment(gen, steps, span));
+    }
+}
+
+// Lows past 15 bits carry on in all-low symbols, with no time lost and no
+// 1-tick leftover, right around each split point
+static void test_symbols_long_lows_split(void) {
+    StepSymbols gen;
+    const uint32_t M = StepSymbols::MAX_DURATION;
+    const uint32_t edges[] = { M, 2 * M, 3 * M };
+    for (uint32_t edge : edges) {
+        for (uint32_t span = edge + PULSE - 3; span <= edge + PULSE + 3; span++) {
+            TEST_ASSERT_EQUAL_UINT64(span, runSegment(gen, 1, span));
+            TEST_ASSERT_EQUAL_UINT64(3ULL * span, runSegment(gen, 3, 3 * span));
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT64(MAX_SLOT_SPAN, runSegment(gen, 1, MAX_SLOT_SPAN));
+    TEST_ASSERT_EQUAL_UINT64(10000000ULL, runSegment(gen, 7, 10000000));
+}
+
+// Delays (zero-step coupled slots) keep the timeline too; a span too short
+// for one symbol becomes the shortest one
+static void test_symbols_delays(void) {
+    StepSymbols gen;
+    const uint32_t spans[] = { 0, 1, 2, 3, 1000, 2 * StepSymbols::MAX_DURATION + 1, MAX_SLOT_SPAN };
+    for (uint32_t span : spans) {
+        gen.segment(0, span);
+        uint64_t total = 0;
+        StepSymbols::Symbol sym;
+        while (gen.next(sym)) {
+            checkSymbol(sym);
+            TEST_ASSERT_FALSE(sym.step);
+            total += (uint64_t)sym.d0 + sym.d1;
+        }
+        TEST_ASSERT_EQUAL_UINT64((span < 2) ? 2 : span, total);
+    }
+}
+
+// Random segments and delays as the queue and the coupled source hand them
+// over, the direction changing now and then. A change ends the transmission
+// and the next starts with STEP held low while DIR settles; no step is lost
+// and every span is kept.
+static void test_symbols_direction_changes(void) {
+    StepSymbols gen;
+    bool forward = true;
+    uint64_t steps_in = 0;
+    uint64_t steps_out = 0;
+    for (int i = 0; i < 200000; i++) {
+        int32_t steps = (int32_t)nextRand(0, 40);
+        if (nextRand(0, 15) == 0) steps = -steps;
+        const uint32_t span = (nextRand(0, 7) == 0) ? nextRand(0, MAX_SLOT_SPAN) : nextRand(0, MAX_SPAN);
+        if (steps != 0 && (steps > 0) != forward) {
+            forward = !forward;
+            gen.begin();
+            StepSymbols::Symbol sym;
+            TEST_ASSERT_TRUE(gen.next(sym));
+            TEST_ASSERT_FALSE(sym.step);
+            TEST_ASSERT_EQUAL_UINT32(PULSE, sym.d0);
+            TEST_ASSERT_EQUAL_UINT32(PULSE, sym.d1);
+        }
+        const uint32_t n = (uint32_t)((steps < 0) ? -steps : steps);
+        if (n == 0) {
+            gen.segment(0, span);
+            StepSymbols::Symbol sym;
+            while (gen.next(sym)) {
+                checkSymbol(sym);
+                TEST_ASSERT_FALSE(sym.step);
+            }
+            continue;
+        }
+        steps_in += n;
+        TEST_ASSERT_EQUAL_UINT64(expectedTicks(n, span), runSegment(gen, n, span));
+        steps_out += n;
+    }
+    TEST_ASSERT_EQUAL_UINT64(steps_in, steps_out);
+}
+
+// An aborted transmission drops the rest of its segment
+static void test_symbols_begin_drops_segment(void) {
+    StepSymbols gen;
+    gen.segment(10, 100000);
+    StepSymbols::Symbol sym;
+    TEST_ASSERT_TRUE(gen.next(sym));
+    TEST_ASSERT_TRUE(gen.next(sym));
+    TEST_ASSERT_EQUAL_UINT32(8, gen.stepsLeft());
+    gen.begin();
+    TEST_ASSERT_EQUAL_UINT32(0, gen.stepsLeft());
+    TEST_ASSERT_TRUE(gen.next(sym));
+    TEST_ASSERT_FALSE(sym.step);
+    TEST_ASSERT_FALSE(gen.next(sym));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_symbols_cycle_spans);
+    RUN_TEST(test_symbols_short_span_clamps);
+    RUN_TEST(test_symbols_long_lows_split);
+    RUN_TEST(test_symbols_delays);
+    RUN_TEST(test_symbols_direction_changes);
+    RUN_TEST(test_symbols_begin_drops_segment);
+    return UNITY_END();
+}